@@ -0,0 +1,376 @@
+#include "DeltaOta.h"
+#include <new>
+
+static const char *const StateNames[] = {"idle", "checking", "next", "verifying", "verified", "switched", "failed"};
+
+static uint16_t ReadUint16(const uint8_t *Data)
+{
+    return Data[0] | (Data[1] << 8);
+}
+
+static bool ReadVarint(const uint8_t *&Data, const uint8_t *End, uint32_t &Value)
+{
+    Value = 0;
+    for (uint8_t Shift = 0; Data < End && Shift < 32; Shift += 7)
+    {
+        uint8_t Byte = *Data++;
+        Value |= (uint32_t)(Byte & 0x7F) << Shift;
+        if (!(Byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+DeltaOta::DeltaOta(DeltaOtaReplyFunction Reply)
+    : reply(Reply), session(nullptr), source(nullptr), target(nullptr), handle(0), state(OtaIdle), failure(""), imageSize(0),
+      imageCrc(0), sourceSize(0), sourceCrc(0), hashed(0), crc(0), windows(0), window(0), packedLength(0), packedReceived(0),
+      unacknowledged(0), resumeSent(false), lastFragmentAt(0), received(0), duplicates(0), gaps(0)
+{
+}
+
+bool DeltaOta::Begin(uint32_t ImageSize, uint32_t ImageCrc, uint32_t SourceSize, uint32_t SourceCrc)
+{
+    Abort();
+    source = esp_ota_get_running_partition();
+    target = esp_ota_get_next_update_partition(nullptr);
+    if (!source || !target || !ImageSize || ImageSize > target->size || !SourceSize || SourceSize > source->size ||
+        (ImageSize + DELTA_OTA_WINDOW - 1) / DELTA_OTA_WINDOW > UINT16_MAX)
+    {
+        Fail("size");
+        return false;
+    }
+    // Only while updating, most nodes never see one
+    session = new (std::nothrow) Session;
+    if (!session)
+    {
+        Fail("memory");
+        return false;
+    }
+
+    imageSize = ImageSize;
+    imageCrc = ImageCrc;
+    sourceSize = SourceSize;
+    sourceCrc = SourceCrc;
+    windows = (ImageSize + DELTA_OTA_WINDOW - 1) / DELTA_OTA_WINDOW;
+    window = 0;
+    packedLength = 0;
+    packedReceived = 0;
+    unacknowledged = 0;
+    resumeSent = false;
+    hashed = 0;
+    crc = MZ_CRC32_INIT;
+    received = 0;
+    duplicates = 0;
+    gaps = 0;
+    state = OtaCheckingSource;
+    Report();
+    return true;
+}
+
+bool DeltaOta::IsFragment(const char *Msg, size_t Length)
+{
+    return Length > DELTA_OTA_FRAGMENT_HEADER && (uint8_t)Msg[0] == DELTA_OTA_FRAGMENT_MARKER;
+}
+
+bool DeltaOta::Fragment(const uint8_t *Msg, size_t Length)
+{
+    if (state != OtaReceiving || !IsFragment((const char *)Msg, Length))
+    {
+        return false;
+    }
+    uint16_t Window = ReadUint16(Msg + 1);
+    uint16_t Offset = ReadUint16(Msg + 3);
+    uint16_t Total = ReadUint16(Msg + 5);
+    const uint8_t *Data = Msg + DELTA_OTA_FRAGMENT_HEADER;
+    uint16_t DataLength = Length - DELTA_OTA_FRAGMENT_HEADER;
+    received += Length;
+    lastFragmentAt = millis();
+
+    // Resent data that already arrived. Not acknowledged: the sender has
+    // moved on already, or asks with "ota" after a lost acknowledgement.
+    if (Window < window || (Window == window && Offset + DataLength <= packedReceived))
+    {
+        duplicates++;
+        return false;
+    }
+    // A fragment was lost: one acknowledgement tells the sender where to resume
+    if (Window != window || Offset != packedReceived || !Total || Total > DELTA_OTA_PACKED_SIZE || Offset + DataLength > Total ||
+        (packedReceived && Total != packedLength))
+    {
+        gaps++;
+        if (!resumeSent)
+        {
+            resumeSent = true;
+            Acknowledge();
+        }
+        return false;
+    }
+
+    packedLength = Total;
+    memcpy(session->Packed + Offset, Data, DataLength);
+    packedReceived += DataLength;
+    unacknowledged++;
+    resumeSent = false;
+    if (packedReceived < packedLength)
+    {
+        if (unacknowledged >= DELTA_OTA_ACK_FRAGMENTS)
+        {
+            Acknowledge();
+        }
+        return true;
+    }
+
+    if (!ApplyWindow())
+    {
+        return false;
+    }
+    window++;
+    packedLength = 0;
+    packedReceived = 0;
+    if (window < windows)
+    {
+        Acknowledge();
+        return true;
+    }
+
+    // esp_ota_end() checks the image header, the CRC covers every byte
+    esp_err_t Ended = esp_ota_end(handle);
+    handle = 0;
+    if (Ended != ESP_OK)
+    {
+        Fail("image");
+        return false;
+    }
+    state = OtaVerifying;
+    hashed = 0;
+    crc = MZ_CRC32_INIT;
+    Report();
+    return true;
+}
+
+void DeltaOta::Loop()
+{
+    if (state == OtaReceiving && millis() - lastFragmentAt >= DELTA_OTA_TIMEOUT_MS)
+    {
+        Fail("timeout");
+        return;
+    }
+    if (state != OtaCheckingSource && state != OtaVerifying)
+    {
+        return;
+    }
+
+    const esp_partition_t *Partition = state == OtaCheckingSource ? source : target;
+    uint32_t Size = state == OtaCheckingSource ? sourceSize : imageSize;
+    uint32_t End = Size - hashed > DELTA_OTA_CHECK_STEP ? hashed + DELTA_OTA_CHECK_STEP : Size;
+    while (hashed < End)
+    {
+        uint32_t Chunk = End - hashed < sizeof(session->Ops) ? End - hashed : sizeof(session->Ops);
+        if (esp_partition_read(Partition, hashed, session->Ops, Chunk) != ESP_OK)
+        {
+            Fail("read");
+            return;
+        }
+        crc = mz_crc32(crc, session->Ops, Chunk);
+        hashed += Chunk;
+    }
+    if (hashed < Size)
+    {
+        return;
+    }
+
+    if (state == OtaVerifying)
+    {
+        if (crc != imageCrc)
+        {
+            Fail("crc");
+            return;
+        }
+        Release();
+        state = OtaVerified;
+        Report();
+        return;
+    }
+
+    // The patch only fits the image it was made against
+    if (crc != sourceCrc)
+    {
+        Fail("source");
+        return;
+    }
+    // Sector by sector while writing: erasing the whole slot up front would
+    // block loop() for seconds
+    if (esp_ota_begin(target, OTA_WITH_SEQUENTIAL_WRITES, &handle) != ESP_OK)
+    {
+        Fail("begin");
+        return;
+    }
+    state = OtaReceiving;
+    lastFragmentAt = millis();
+    Acknowledge();
+}
+
+uint32_t DeltaOta::NextDueMs() const
+{
+    if (state == OtaCheckingSource || state == OtaVerifying)
+    {
+        return 0;
+    }
+    if (state != OtaReceiving)
+    {
+        return UINT32_MAX;
+    }
+    unsigned long Idle = millis() - lastFragmentAt;
+    return Idle >= DELTA_OTA_TIMEOUT_MS ? 0 : DELTA_OTA_TIMEOUT_MS - Idle;
+}
+
+bool DeltaOta::Switch()
+{
+    if (state != OtaVerified)
+    {
+        Report();
+        return false;
+    }
+    if (esp_ota_set_boot_partition(target) != ESP_OK)
+    {
+        Fail("boot");
+        return false;
+    }
+    state = OtaSwitched;
+    Report();
+    return true;
+}
+
+void DeltaOta::Abort()
+{
+    if (handle)
+    {
+        esp_ota_abort(handle);
+        handle = 0;
+    }
+    Release();
+    state = OtaIdle;
+}
+
+void DeltaOta::Report()
+{
+    char Msg[64];
+    snprintf(Msg, sizeof(Msg), "MQTT ota %s %u %u%s%s", StateName(), window, packedReceived, state == OtaFailed ? " " : "",
+             state == OtaFailed ? failure : "");
+    reply(Msg);
+}
+
+const char *DeltaOta::StateName() const
+{
+    return StateNames[state];
+}
+
+bool DeltaOta::ApplyWindow()
+{
+    // The whole window at once, so the inflater needs no dictionary of its own
+    tinfl_init(&session->Inflater);
+    size_t In = packedLength;
+    size_t Out = sizeof(session->Ops);
+    tinfl_status Status = tinfl_decompress(&session->Inflater, session->Packed, &In, session->Ops, session->Ops, &Out,
+                                           TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+    if (Status != TINFL_STATUS_DONE)
+    {
+        Fail("inflate");
+        return false;
+    }
+    uint32_t Remaining = imageSize - (uint32_t)window * DELTA_OTA_WINDOW;
+    if (!Apply(session->Ops, Out, Remaining < DELTA_OTA_WINDOW ? Remaining : DELTA_OTA_WINDOW))
+    {
+        Fail("patch");
+        return false;
+    }
+    return true;
+}
+
+bool DeltaOta::Apply(const uint8_t *Ops, size_t Length, uint32_t Expected)
+{
+    const uint8_t *End = Ops + Length;
+    uint32_t Written = 0;
+    while (Ops < End)
+    {
+        uint8_t Op = *Ops++;
+        uint32_t Offset = 0;
+        uint32_t Count = 0;
+        if ((Op != DeltaOtaLiteral && !ReadVarint(Ops, End, Offset)) || !ReadVarint(Ops, End, Count) || Count > Expected - Written)
+        {
+            return false;
+        }
+        if (Op == DeltaOtaLiteral)
+        {
+            if ((size_t)(End - Ops) < Count || !Write(Ops, Count))
+            {
+                return false;
+            }
+            Ops += Count;
+            Written += Count;
+            continue;
+        }
+        if ((Op != DeltaOtaCopy && Op != DeltaOtaAdd) || Offset > sourceSize || Count > sourceSize - Offset ||
+            (Op == DeltaOtaAdd && (size_t)(End - Ops) < Count))
+        {
+            return false;
+        }
+        uint8_t Chunk[256];
+        while (Count)
+        {
+            uint32_t Part = Count < sizeof(Chunk) ? Count : sizeof(Chunk);
+            if (esp_partition_read(source, Offset, Chunk, Part) != ESP_OK)
+            {
+                return false;
+            }
+            if (Op == DeltaOtaAdd)
+            {
+                for (uint32_t i = 0; i < Part; i++)
+                {
+                    Chunk[i] += Ops[i];
+                }
+                Ops += Part;
+            }
+            if (!Write(Chunk, Part))
+            {
+                return false;
+            }
+            Offset += Part;
+            Count -= Part;
+            Written += Part;
+        }
+    }
+    return Written == Expected;
+}
+
+bool DeltaOta::Write(const uint8_t *Data, size_t Length)
+{
+    return esp_ota_write(handle, Data, Length) == ESP_OK;
+}
+
+void DeltaOta::Acknowledge()
+{
+    unacknowledged = 0;
+    Report();
+}
+
+void DeltaOta::Fail(const char *Reason)
+{
+    if (handle)
+    {
+        esp_ota_abort(handle);
+        handle = 0;
+    }
+    Release();
+    state = OtaFailed;
+    failure = Reason;
+    Report();
+}
+
+void DeltaOta::Release()
+{
+    delete session;
+    session = nullptr;
+}
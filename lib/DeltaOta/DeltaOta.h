@@ -0,0 +1,131 @@
+#ifndef DeltaOta_H
+#define DeltaOta_H
+
+#include <Arduino.h>
+#include "esp_ota_ops.h"
+#include "miniz.h"
+
+#define DELTA_OTA_WINDOW 4096        // image bytes per window, one flash sector
+#define DELTA_OTA_OPS_SIZE 4608      // inflated operations of one window
+#define DELTA_OTA_PACKED_SIZE 4608   // deflated window
+#define DELTA_OTA_FRAGMENT_DATA 184  // window bytes per mesh packet, fits a MeshMessageQueue slot
+#define DELTA_OTA_ACK_FRAGMENTS 4    // fragments per acknowledgement
+#define DELTA_OTA_CHECK_STEP 16384   // flash bytes hashed per Loop() while checking
+#define DELTA_OTA_TIMEOUT_MS 60000   // an update without fragments for this long is dropped
+#define DELTA_OTA_FRAGMENT_MARKER 0xC1 // unused in MessagePack, never the first byte of a text command
+
+// Window operations, after inflating. Offsets and lengths are varints
+// (7 bits per byte, low bits first), offsets address the running image.
+enum DeltaOtaOp : uint8_t
+{
+    DeltaOtaCopy,    // <offset> <length>: running image bytes as they are
+    DeltaOtaAdd,     // <offset> <length> <length bytes>: running image bytes plus these, mod 256
+    DeltaOtaLiteral, // <length> <length bytes>: new bytes
+};
+
+// One mesh packet of a window: marker, window, offset of the data in the
+// deflated window and the deflated window length (uint16 little endian
+// each), then up to DELTA_OTA_FRAGMENT_DATA bytes.
+#define DELTA_OTA_FRAGMENT_HEADER 7
+
+enum DeltaOtaState : uint8_t
+{
+    OtaIdle,
+    OtaCheckingSource, // hashing the running image against the patch base
+    OtaReceiving,
+    OtaVerifying,      // hashing the written slot
+    OtaVerified,       // waiting for Switch()
+    OtaSwitched,       // boots into the new image with the next restart
+    OtaFailed,
+};
+
+// Sends "MQTT ota ..." replies
+typedef void (*DeltaOtaReplyFunction)(const char *Msg);
+
+// Applies a binary diff against the running app slot, window by window,
+// into the inactive one. The new image is cut into DELTA_OTA_WINDOW byte
+// windows; each one is a deflated list of operations, sent in fragments
+// of one mesh packet. A complete window is inflated in one go and written
+// with esp_ota_write(), so the update holds one window in RAM whatever
+// the image size. Session buffers are only allocated between Begin() and
+// the end of the update.
+//
+// Flow control is a cumulative acknowledgement: "MQTT ota next <window>
+// <offset>" after every DELTA_OTA_ACK_FRAGMENTS fragments, at the end of
+// each window and once on a gap. The sender continues (or resends) from
+// there; without an acknowledgement it asks with "ota" (Report()).
+// Switch() only accepts an image whose CRC matched.
+class DeltaOta
+{
+public:
+    DeltaOta(DeltaOtaReplyFunction Reply);
+
+    // Starts an update to an image of ImageSize bytes with ImageCrc
+    // (mz_crc32) made against the first SourceSize bytes of the running
+    // slot, which must have SourceCrc. A running update is dropped.
+    bool Begin(uint32_t ImageSize, uint32_t ImageCrc, uint32_t SourceSize, uint32_t SourceCrc);
+    static bool IsFragment(const char *Msg, size_t Length);
+    // Returns false if the fragment was not the next one expected
+    bool Fragment(const uint8_t *Msg, size_t Length);
+    // Hashes the next DELTA_OTA_CHECK_STEP bytes while checking or
+    // verifying, drops a stalled update
+    void Loop();
+    // 0 while hashing, the stall timeout while receiving, UINT32_MAX otherwise
+    uint32_t NextDueMs() const;
+    // Makes the verified image the boot slot, the caller reboots
+    bool Switch();
+    void Abort();
+    // Replies "MQTT ota <state> <window> <offset>", a failure with its reason
+    void Report();
+
+    DeltaOtaState State() const { return state; }
+    const char *StateName() const;
+    uint16_t Window() const { return window; }
+    uint16_t Windows() const { return windows; }
+    uint32_t Received() const { return received; } // fragment bytes, headers included
+    uint32_t Duplicates() const { return duplicates; }
+    uint32_t Gaps() const { return gaps; }
+
+private:
+    struct Session
+    {
+        tinfl_decompressor Inflater;
+        uint8_t Packed[DELTA_OTA_PACKED_SIZE];
+        uint8_t Ops[DELTA_OTA_OPS_SIZE]; // also the read buffer while hashing
+    };
+
+    bool ApplyWindow();
+    bool Apply(const uint8_t *Ops, size_t Length, uint32_t Expected);
+    bool Write(const uint8_t *Data, size_t Length);
+    void Acknowledge();
+    void Fail(const char *Reason);
+    void Release();
+
+    DeltaOtaReplyFunction reply;
+    Session *session;
+    const esp_partition_t *source;
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    DeltaOtaState state;
+    const char *failure;
+
+    uint32_t imageSize;
+    uint32_t imageCrc;
+    uint32_t sourceSize;
+    uint32_t sourceCrc;
+    uint32_t hashed; // bytes hashed so far
+    uint32_t crc;
+    uint16_t windows;
+    uint16_t window;
+    uint16_t packedLength;
+    uint16_t packedReceived;
+    uint8_t unacknowledged;
+    bool resumeSent; // acknowledged a gap, until the next fragment fits
+    unsigned long lastFragmentAt;
+
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t gaps;
+};
+
+#endif
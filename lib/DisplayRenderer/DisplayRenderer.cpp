@@ -0,0 +1,200 @@
+#include "DisplayRenderer.h"
+
+// The SH1106 RAM is 132 columns wide, the visible 128 start at column 2
+#define DISPLAY_COLUMN_OFFSET 2
+#define DISPLAY_CHUNK (I2C_MAX_TRANSACTION - 1)
+
+DisplayRenderer::DisplayRenderer(SH1106Wire &Display, uint8_t Address)
+    : display(Display), address(Address), shown(nullptr), dirtyRows(0), refreshes(0), skipped(0), lastBytes(0), totalBytes(0)
+{
+    line.reserve(DISPLAY_LINE_LENGTH);
+}
+
+void DisplayRenderer::Invalidate()
+{
+    shown = nullptr;
+}
+
+uint8_t DisplayRenderer::RowsOf(const DisplayLine &Line)
+{
+    int16_t First = Line.Y < 0 ? 0 : Line.Y / 8;
+    int16_t Last = (Line.Y + DISPLAY_LINE_HEIGHT - 1) / 8;
+    if (Last >= DISPLAY_ROWS)
+    {
+        Last = DISPLAY_ROWS - 1;
+    }
+
+    uint8_t Rows = 0;
+    for (int16_t Row = First; Row <= Last; Row++)
+    {
+        Rows |= 1 << Row;
+    }
+    return Rows;
+}
+
+void DisplayRenderer::Render(const DisplayPage &Page)
+{
+    bool Full = shown != &Page;
+    uint8_t DirtyRows = Full ? 0xFF : 0;
+    uint8_t Count = Page.Count < DISPLAY_MAX_LINES ? Page.Count : DISPLAY_MAX_LINES;
+    char Text[DISPLAY_LINE_LENGTH];
+
+    for (uint8_t i = 0; i < Count; i++)
+    {
+        Page.Lines[i].Format(Text, sizeof(Text));
+        if (Full || strcmp(Text, text[i]))
+        {
+            strcpy(text[i], Text);
+            DirtyRows |= RowsOf(Page.Lines[i]);
+        }
+    }
+
+    if (!DirtyRows)
+    {
+        skipped++;
+        return;
+    }
+
+    if (Full)
+    {
+        display.clear();
+        shown = &Page;
+    }
+    else
+    {
+        display.setColor(BLACK);
+        for (uint8_t Row = 0; Row < DISPLAY_ROWS; Row++)
+        {
+            if (DirtyRows & (1 << Row))
+            {
+                display.fillRect(0, Row * 8, display.width(), 8);
+            }
+        }
+        display.setColor(WHITE);
+    }
+
+    // Lines overlapping a cleared row are redrawn even if their text is unchanged
+    for (uint8_t i = 0; i < Count; i++)
+    {
+        if (RowsOf(Page.Lines[i]) & DirtyRows)
+        {
+            line = text[i];
+            display.drawString(Page.Lines[i].X, Page.Lines[i].Y, line);
+        }
+    }
+
+    refreshes++;
+    Flush();
+}
+
+// Address byte + control byte + 3 commands, then each data chunk with its
+// address and control byte
+uint32_t DisplayRenderer::RowBytes(uint8_t Columns)
+{
+    return 5 + (Columns + DISPLAY_CHUNK - 1) / DISPLAY_CHUNK * 2 + Columns;
+}
+
+void DisplayRenderer::Flush()
+{
+    // buffer_back holds what the panel shows (or will, once queued rows are sent)
+    uint16_t Width = display.width();
+    lastBytes = 0;
+
+    for (uint8_t Row = 0; Row < DISPLAY_ROWS; Row++)
+    {
+        const uint8_t *Front = display.buffer + Row * Width;
+        const uint8_t *Back = display.buffer_back + Row * Width;
+        int16_t MinX = -1, MaxX = -1;
+        for (int16_t x = 0; x < Width; x++)
+        {
+            if (Front[x] != Back[x])
+            {
+                MinX = MinX < 0 ? x : MinX;
+                MaxX = x;
+            }
+        }
+        if (MinX < 0)
+        {
+            continue;
+        }
+
+        RowRange &Range = rows[Row];
+        if (dirtyRows & (1 << Row))
+        {
+            // Still sending this row: widen the range, re-address if it starts earlier
+            if (MinX < Range.MinX)
+            {
+                Range.MinX = MinX;
+                Range.Addressed = false;
+            }
+            Range.MaxX = MaxX > Range.MaxX ? MaxX : Range.MaxX;
+        }
+        else
+        {
+            Range.MinX = MinX;
+            Range.MaxX = MaxX;
+            Range.Addressed = false;
+            Range.Since = micros();
+            dirtyRows |= 1 << Row;
+        }
+        lastBytes += RowBytes(MaxX - MinX + 1);
+    }
+    totalBytes += lastBytes;
+}
+
+bool DisplayRenderer::NextChunk(I2cTransaction &Next)
+{
+    if (!dirtyRows)
+    {
+        return false;
+    }
+
+    uint8_t Row = 0;
+    while (!(dirtyRows & (1 << Row)))
+    {
+        Row++;
+    }
+    RowRange &Range = rows[Row];
+    Next.Address = address;
+    Next.QueuedAt = Range.Since;
+
+    if (!Range.Addressed)
+    {
+        // Control byte 0x00: a stream of commands (page, column low, column high)
+        uint8_t Column = Range.MinX + DISPLAY_COLUMN_OFFSET;
+        Next.Data[0] = 0x00;
+        Next.Data[1] = 0xB0 | Row;
+        Next.Data[2] = Column & 0x0F;
+        Next.Data[3] = 0x10 | (Column >> 4);
+        Next.Length = 4;
+        Range.Addressed = true;
+        return true;
+    }
+
+    // Control byte 0x40: data, the column address advances by itself
+    uint8_t Count = Range.MaxX - Range.MinX + 1;
+    Count = Count > DISPLAY_CHUNK ? DISPLAY_CHUNK : Count;
+    uint16_t Offset = Row * display.width() + Range.MinX;
+    Next.Data[0] = 0x40;
+    memcpy(Next.Data + 1, display.buffer + Offset, Count);
+    memcpy(display.buffer_back + Offset, display.buffer + Offset, Count);
+    Next.Length = Count + 1;
+
+    if (Range.MaxX - Range.MinX + 1 == Count)
+    {
+        dirtyRows &= ~(1 << Row);
+    }
+    else
+    {
+        Range.MinX += Count;
+    }
+    return true;
+}
+
+void DisplayRenderer::ResetStats()
+{
+    refreshes = 0;
+    skipped = 0;
+    lastBytes = 0;
+    totalBytes = 0;
+}
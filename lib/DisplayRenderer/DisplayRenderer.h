@@ -0,0 +1,84 @@
+#ifndef DisplayRenderer_H
+#define DisplayRenderer_H
+
+#include <Arduino.h>
+#include "SH1106Wire.h"
+#include "I2cScheduler.h"
+
+#define DISPLAY_MAX_LINES 6
+#define DISPLAY_LINE_LENGTH 32
+#define DISPLAY_LINE_HEIGHT 13 // ArialMT_Plain_10
+#define DISPLAY_ROWS 8         // 8 pixel high SH1106 pages
+
+// Writes the current text of one display line
+typedef void (*DisplayLineFunction)(char *Text, size_t Size);
+
+struct DisplayLine
+{
+    int16_t X;
+    int16_t Y;
+    DisplayLineFunction Format;
+};
+
+struct DisplayPage
+{
+    const DisplayLine *Lines;
+    uint8_t Count;
+};
+
+// Renders pages described by line bindings. Each line's text is cached;
+// only the 8 pixel rows under changed lines are cleared and redrawn, and
+// nothing is sent to the panel if no line changed.
+//
+// The panel is not written by the driver's display(): Flush() records the
+// changed columns of every page row and NextChunk() hands them to the I2C
+// scheduler one small transaction at a time, taken from the framebuffer
+// when sent, so several refreshes of the same row go out only once.
+class DisplayRenderer
+{
+public:
+    DisplayRenderer(SH1106Wire &Display, uint8_t Address);
+
+    void Render(const DisplayPage &Page);
+    // The framebuffer was drawn or cleared elsewhere, redraw everything next time
+    void Invalidate();
+    // Queues whatever differs between the framebuffer and the panel
+    void Flush();
+    // Background source for I2cScheduler
+    bool NextChunk(I2cTransaction &Next);
+    bool Busy() const { return dirtyRows != 0; }
+
+    uint32_t Refreshes() const { return refreshes; }
+    uint32_t Skipped() const { return skipped; }
+    // I2C bytes queued by the last and by all refreshes
+    uint32_t LastBytes() const { return lastBytes; }
+    uint32_t TotalBytes() const { return totalBytes; }
+    void ResetStats();
+
+private:
+    // Columns of one page row still to be sent
+    struct RowRange
+    {
+        uint8_t MinX;
+        uint8_t MaxX;
+        bool Addressed; // page and column already sent to the panel
+        unsigned long Since;
+    };
+
+    static uint8_t RowsOf(const DisplayLine &Line);
+    static uint32_t RowBytes(uint8_t Columns);
+
+    SH1106Wire &display;
+    uint8_t address;
+    const DisplayPage *shown;
+    char text[DISPLAY_MAX_LINES][DISPLAY_LINE_LENGTH];
+    String line; // drawString() takes a String, refilled in its reserved buffer
+    RowRange rows[DISPLAY_ROWS];
+    uint8_t dirtyRows;
+    uint32_t refreshes;
+    uint32_t skipped;
+    uint32_t lastBytes;
+    uint32_t totalBytes;
+};
+
+#endif
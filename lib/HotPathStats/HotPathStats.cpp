@@ -0,0 +1,79 @@
+#include "HotPathStats.h"
+
+#if HOTPATH_STATS
+
+HotPathStats Stats;
+
+HotPathStats::HotPathStats()
+{
+    Reset();
+}
+
+void HotPathStats::Record(HotPathProbe Probe, uint32_t Cycles)
+{
+    HotPathHistogram &Histogram = probes[Probe];
+    if (!Histogram.Count || Cycles < Histogram.Min)
+    {
+        Histogram.Min = Cycles;
+    }
+    if (Cycles > Histogram.Max)
+    {
+        Histogram.Max = Cycles;
+    }
+    Histogram.Count++;
+    Histogram.Total += Cycles;
+    uint8_t Bucket = 31 - __builtin_clz(Cycles | 1);
+    if (Histogram.Buckets[Bucket] != UINT16_MAX)
+    {
+        Histogram.Buckets[Bucket]++;
+    }
+}
+
+void HotPathStats::Reset()
+{
+    memset(probes, 0, sizeof(probes));
+    for (uint8_t i = 0; i < StatsCounters; i++)
+    {
+        counters[i] = 0;
+    }
+}
+
+const char *HotPathStats::Name(HotPathProbe Probe)
+{
+    static const char *const Names[StatsProbes] = {"loop", "mesh", "display", "mqtt", "output", "i2c", "onewire"};
+    return Names[Probe];
+}
+
+size_t HotPathStats::Format(char *Buffer, size_t Size) const
+{
+    size_t Length = snprintf(Buffer, Size, "heap:%u/%u meshIn:%u meshOut:%u", ESP.getFreeHeap(), ESP.getMinFreeHeap(),
+                             counters[StatsMeshIn], counters[StatsMeshOut]);
+    for (uint8_t Probe = 0; Probe < StatsProbes && Length < Size; Probe++)
+    {
+        const HotPathHistogram &Histogram = probes[Probe];
+        if (!Histogram.Count)
+        {
+            continue;
+        }
+        // name:count/min/avg/max/first bucket:counts of the used buckets
+        uint8_t First = 0;
+        uint8_t Last = STATS_BUCKETS - 1;
+        while (!Histogram.Buckets[First])
+        {
+            First++;
+        }
+        while (!Histogram.Buckets[Last])
+        {
+            Last--;
+        }
+        Length += snprintf(Buffer + Length, Size - Length, " %s:%u/%u/%u/%u/%u:", Name((HotPathProbe)Probe),
+                           Histogram.Count, Histogram.Min, (uint32_t)(Histogram.Total / Histogram.Count), Histogram.Max, First);
+        for (uint8_t Bucket = First; Bucket <= Last && Length < Size; Bucket++)
+        {
+            Length += snprintf(Buffer + Length, Size - Length, Bucket == First ? "%u" : ".%u", Histogram.Buckets[Bucket]);
+        }
+    }
+    return Length < Size ? Length : Size - 1;
+}
+
+#endif
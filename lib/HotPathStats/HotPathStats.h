@@ -0,0 +1,98 @@
+#ifndef HotPathStats_H
+#define HotPathStats_H
+
+#include <Arduino.h>
+
+// Cycle counter instrumentation of the hot paths. Build with
+// -D HOTPATH_STATS=1 to enable it; without the flag the STATS_* macros are
+// empty and nothing of this library ends up in the firmware.
+
+enum HotPathProbe
+{
+    StatsLoop,
+    StatsMeshMessage,
+    StatsDisplay,
+    StatsMqtt,
+    StatsOutput,
+    StatsI2c,
+    StatsOneWire,
+    StatsProbes
+};
+
+enum HotPathCounter
+{
+    StatsMeshIn,
+    StatsMeshOut,
+    StatsCounters
+};
+
+// Histogram bucket n counts durations of 2^n .. 2^(n+1)-1 cycles
+#define STATS_BUCKETS 32
+
+struct HotPathHistogram
+{
+    uint32_t Count;
+    uint32_t Min;
+    uint32_t Max;
+    uint64_t Total;
+    uint16_t Buckets[STATS_BUCKETS]; // saturating
+};
+
+#if HOTPATH_STATS
+
+class HotPathStats
+{
+public:
+    HotPathStats();
+
+    void Record(HotPathProbe Probe, uint32_t Cycles);
+    // Safe from other tasks on the single core build, one writer per counter
+    void Count(HotPathCounter Counter) { counters[Counter]++; }
+    const HotPathHistogram &Probe(HotPathProbe Probe) const { return probes[Probe]; }
+    uint32_t Counter(HotPathCounter Counter) const { return counters[Counter]; }
+    void Reset();
+
+    // Compact snapshot, see README. Returns the length written.
+    size_t Format(char *Buffer, size_t Size) const;
+    static const char *Name(HotPathProbe Probe);
+
+private:
+    HotPathHistogram probes[StatsProbes];
+    volatile uint32_t counters[StatsCounters];
+};
+
+extern HotPathStats Stats;
+
+// Records the time until the end of the enclosing scope
+class HotPathScope
+{
+public:
+    explicit HotPathScope(HotPathProbe Probe) : probe(Probe), start(ESP.getCycleCount()) {}
+    ~HotPathScope() { Stats.Record(probe, ESP.getCycleCount() - start); }
+
+private:
+    HotPathProbe probe;
+    uint32_t start;
+};
+
+#define STATS_CONCAT_(A, B) A##B
+#define STATS_CONCAT(A, B) STATS_CONCAT_(A, B)
+#define STATS_SCOPE(Probe) HotPathScope STATS_CONCAT(StatsScope, __LINE__)(Probe)
+// For spans that do not end with a scope
+#define STATS_BEGIN(Probe) uint32_t STATS_CONCAT(StatsStart, Probe) = ESP.getCycleCount()
+#define STATS_END(Probe) Stats.Record(Probe, ESP.getCycleCount() - STATS_CONCAT(StatsStart, Probe))
+#define STATS_COUNT(Counter) Stats.Count(Counter)
+
+#else
+
+#define STATS_SCOPE(Probe) \
+    do                     \
+    {                      \
+    } while (0)
+#define STATS_BEGIN(Probe) STATS_SCOPE(Probe)
+#define STATS_END(Probe) STATS_SCOPE(Probe)
+#define STATS_COUNT(Counter) STATS_SCOPE(Counter)
+
+#endif
+
+#endif
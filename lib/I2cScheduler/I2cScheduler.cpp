@@ -0,0 +1,103 @@
+#include "I2cScheduler.h"
+
+I2cScheduler::I2cScheduler(TwoWire &Bus, uint8_t BackgroundPerLoop)
+    : bus(Bus), backgroundPerLoop(BackgroundPerLoop), background(nullptr), head(0), tail(0), fullDrains(0), deviceCount(0)
+{
+}
+
+bool I2cScheduler::Submit(uint8_t Address, const uint8_t *Data, uint8_t Length)
+{
+    if (Length > I2C_MAX_TRANSACTION)
+    {
+        return false;
+    }
+    if ((uint8_t)(head - tail) >= I2C_URGENT_CAPACITY)
+    {
+        // Never drop an actuator write, send what is queued right away
+        fullDrains++;
+        RunUrgent();
+    }
+
+    I2cTransaction &Transaction = urgent[head & (I2C_URGENT_CAPACITY - 1)];
+    Transaction.Address = Address;
+    Transaction.Length = Length;
+    memcpy(Transaction.Data, Data, Length);
+    Transaction.QueuedAt = micros();
+    head++;
+    return true;
+}
+
+void I2cScheduler::Loop()
+{
+    RunUrgent();
+
+    I2cTransaction Chunk;
+    for (uint8_t i = 0; i < backgroundPerLoop && background && background(Chunk); i++)
+    {
+        Run(Chunk);
+        RunUrgent();
+    }
+}
+
+void I2cScheduler::RunUrgent()
+{
+    while (tail != head)
+    {
+        Run(urgent[tail & (I2C_URGENT_CAPACITY - 1)]);
+        tail++;
+    }
+}
+
+void I2cScheduler::Run(const I2cTransaction &Transaction)
+{
+    bus.beginTransmission(Transaction.Address);
+    bus.write(Transaction.Data, Transaction.Length);
+    uint8_t Error = bus.endTransmission();
+
+    I2cDeviceStats *Device = nullptr;
+    for (uint8_t i = 0; i < deviceCount && !Device; i++)
+    {
+        if (devices[i].Address == Transaction.Address)
+        {
+            Device = &devices[i];
+        }
+    }
+    if (!Device)
+    {
+        if (deviceCount >= I2C_MAX_DEVICES)
+        {
+            return;
+        }
+        Device = &devices[deviceCount++];
+        memset(Device, 0, sizeof(*Device));
+        Device->Address = Transaction.Address;
+    }
+
+    uint32_t Latency = micros() - Transaction.QueuedAt;
+    Device->Transactions++;
+    Device->Bytes += Transaction.Length;
+    Device->Errors += Error ? 1 : 0;
+    Device->TotalLatencyUs += Latency;
+    if (Latency > Device->MaxLatencyUs)
+    {
+        Device->MaxLatencyUs = Latency;
+    }
+}
+
+const I2cDeviceStats *I2cScheduler::Stats(uint8_t Address) const
+{
+    for (uint8_t i = 0; i < deviceCount; i++)
+    {
+        if (devices[i].Address == Address)
+        {
+            return &devices[i];
+        }
+    }
+    return nullptr;
+}
+
+void I2cScheduler::ResetStats()
+{
+    fullDrains = 0;
+    deviceCount = 0;
+}
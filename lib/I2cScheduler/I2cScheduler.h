@@ -0,0 +1,68 @@
+#ifndef I2cScheduler_H
+#define I2cScheduler_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define I2C_MAX_TRANSACTION 17 // control byte + 16 data bytes
+#define I2C_URGENT_CAPACITY 8  // queued urgent transactions, power of two
+#define I2C_MAX_DEVICES 4
+
+struct I2cTransaction
+{
+    uint8_t Address;
+    uint8_t Length;
+    uint8_t Data[I2C_MAX_TRANSACTION];
+    unsigned long QueuedAt; // micros(), for the latency statistics
+};
+
+// Fills in the next background transaction, false if there is none
+typedef bool (*I2cBackgroundFunction)(I2cTransaction &Next);
+
+struct I2cDeviceStats
+{
+    uint8_t Address;
+    uint32_t Transactions;
+    uint32_t Bytes;
+    uint32_t Errors;
+    uint32_t TotalLatencyUs;
+    uint32_t MaxLatencyUs;
+};
+
+// Owns the shared I2C bus. Urgent transactions (relay writes) always go
+// out before background work (display chunks), which is pulled in small
+// transactions so an urgent write never waits for more than one chunk.
+// Submit() and Loop() must be called from the same task.
+class I2cScheduler
+{
+public:
+    I2cScheduler(TwoWire &Bus, uint8_t BackgroundPerLoop);
+
+    void SetBackground(I2cBackgroundFunction Next) { background = Next; }
+    bool Submit(uint8_t Address, const uint8_t *Data, uint8_t Length);
+    // Sends all urgent transactions, then up to BackgroundPerLoop chunks
+    void Loop();
+
+    uint8_t Pending() const { return head - tail; }
+    // Submits that found the queue full and had to send it synchronously
+    uint32_t FullDrains() const { return fullDrains; }
+    // Statistics of one device, nullptr if nothing was sent to it yet
+    const I2cDeviceStats *Stats(uint8_t Address) const;
+    void ResetStats();
+
+private:
+    void RunUrgent();
+    void Run(const I2cTransaction &Transaction);
+
+    TwoWire &bus;
+    uint8_t backgroundPerLoop;
+    I2cBackgroundFunction background;
+    I2cTransaction urgent[I2C_URGENT_CAPACITY];
+    uint8_t head;
+    uint8_t tail;
+    uint32_t fullDrains;
+    I2cDeviceStats devices[I2C_MAX_DEVICES];
+    uint8_t deviceCount;
+};
+
+#endif
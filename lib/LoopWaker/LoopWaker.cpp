@@ -0,0 +1,81 @@
+#include "LoopWaker.h"
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+LoopWaker::LoopWaker()
+    : events(nullptr), sleeps(0), eventWakes(0), lastIdle(0), lastTotal(0), idlePercent(0)
+{
+}
+
+void LoopWaker::Begin()
+{
+    if (!events)
+    {
+        events = xEventGroupCreate();
+    }
+    lastIdle = ulTaskGetIdleRunTimeCounter();
+    lastTotal = (uint32_t)esp_timer_get_time();
+}
+
+void LoopWaker::Signal(EventBits_t Bits)
+{
+    if (events)
+    {
+        xEventGroupSetBits(events, Bits);
+    }
+}
+
+void IRAM_ATTR LoopWaker::SignalFromIsr(EventBits_t Bits)
+{
+    if (!events)
+    {
+        return;
+    }
+    BaseType_t Woken = pdFALSE;
+    if (xEventGroupSetBitsFromISR(events, Bits, &Woken) == pdPASS && Woken)
+    {
+        portYIELD_FROM_ISR();
+    }
+}
+
+EventBits_t LoopWaker::Wait(uint32_t TimeoutMs)
+{
+    if (!events)
+    {
+        return 0;
+    }
+    if (!TimeoutMs)
+    {
+        return xEventGroupClearBits(events, LOOP_WAKE_ALL) & LOOP_WAKE_ALL;
+    }
+
+    sleeps++;
+    TickType_t Ticks = TimeoutMs == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(TimeoutMs);
+    EventBits_t Bits = xEventGroupWaitBits(events, LOOP_WAKE_ALL, pdTRUE, pdFALSE, Ticks) & LOOP_WAKE_ALL;
+    if (Bits)
+    {
+        eventWakes++;
+    }
+    return Bits;
+}
+
+uint8_t LoopWaker::SampleIdle()
+{
+    uint32_t Idle = ulTaskGetIdleRunTimeCounter();
+    uint32_t Total = (uint32_t)esp_timer_get_time();
+    uint32_t IdleDelta = Idle - lastIdle;
+    uint32_t TotalDelta = Total - lastTotal;
+    lastIdle = Idle;
+    lastTotal = Total;
+    if (TotalDelta)
+    {
+        idlePercent = (uint8_t)((uint64_t)IdleDelta * 100 / TotalDelta);
+    }
+    return idlePercent;
+}
+
+void LoopWaker::ResetStats()
+{
+    sleeps = 0;
+    eventWakes = 0;
+}
@@ -0,0 +1,50 @@
+#ifndef LoopWaker_H
+#define LoopWaker_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+
+// Reasons for loop() to wake before its deadline
+#define LOOP_WAKE_MESH (1 << 0) // message queued by the mesh task
+#define LOOP_WAKE_GPIO (1 << 1) // button edge
+#define LOOP_WAKE_ALL (LOOP_WAKE_MESH | LOOP_WAKE_GPIO)
+
+// Lets loop() block on an event group until its next deadline or until
+// another task or an ISR signals work. While loopTask blocks, the idle task
+// runs; with power management and tickless idle enabled it lowers the CPU
+// clock or enters light sleep, as far as the Wi-Fi stack's PM locks allow.
+class LoopWaker
+{
+public:
+    LoopWaker();
+
+    void Begin();
+    // From any task
+    void Signal(EventBits_t Bits);
+    // From an ISR only
+    void SignalFromIsr(EventBits_t Bits);
+    // Blocks up to TimeoutMs, returns and clears the wake reasons (0 when
+    // the deadline passed)
+    EventBits_t Wait(uint32_t TimeoutMs);
+
+    // Blocking waits, and how many of them an event ended early
+    uint32_t Sleeps() const { return sleeps; }
+    uint32_t EventWakes() const { return eventWakes; }
+    // Idle task share of the CPU since the previous sample, from the
+    // FreeRTOS run time counters (esp_timer based, so sample well within
+    // the 71 min wrap of the 32 bit counters)
+    uint8_t SampleIdle();
+    uint8_t IdlePercent() const { return idlePercent; }
+    void ResetStats();
+
+private:
+    EventGroupHandle_t events;
+    uint32_t sleeps;
+    uint32_t eventWakes;
+    uint32_t lastIdle;
+    uint32_t lastTotal;
+    uint8_t idlePercent;
+};
+
+#endif
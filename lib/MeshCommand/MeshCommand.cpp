@@ -0,0 +1,164 @@
+#include "MeshCommand.h"
+#include <ArduinoJson.h>
+
+const char *MeshCommandArgs::Text(uint8_t Index) const
+{
+    return Index < Count ? Token[Index] : "";
+}
+
+long MeshCommandArgs::Int(uint8_t Index) const
+{
+    long Value = 0;
+    MeshParseInt(Text(Index), Value);
+    return Value;
+}
+
+uint8_t MeshCommandTokenize(char *Msg, MeshCommandArgs &Args)
+{
+    Args.Count = 0;
+    char *p = Msg;
+
+    while (*p && Args.Count < MESH_COMMAND_MAX_TOKENS)
+    {
+        while (*p == ' ')
+        {
+            p++;
+        }
+        if (!*p)
+        {
+            break;
+        }
+        Args.Token[Args.Count++] = p;
+        while (*p && *p != ' ')
+        {
+            p++;
+        }
+        // The last token keeps the rest of the line
+        if (*p && Args.Count < MESH_COMMAND_MAX_TOKENS)
+        {
+            *p++ = 0;
+        }
+    }
+    return Args.Count;
+}
+
+bool MeshParseInt(const char *Text, long &Value)
+{
+    while (*Text == ' ' || *Text == '\t')
+    {
+        Text++;
+    }
+
+    bool Negative = false;
+    if (*Text == '-' || *Text == '+')
+    {
+        Negative = *Text == '-';
+        Text++;
+    }
+
+    if (*Text < '0' || *Text > '9')
+    {
+        return false;
+    }
+
+    long Result = 0;
+    while (*Text >= '0' && *Text <= '9')
+    {
+        Result = Result * 10 + (*Text++ - '0');
+    }
+    Value = Negative ? -Result : Result;
+    return true;
+}
+
+const MeshCommandEntry *MeshCommandLookup(const MeshCommandEntry *Table, size_t Count, const char *Name)
+{
+    size_t Low = 0;
+    size_t High = Count;
+
+    while (Low < High)
+    {
+        size_t Mid = (Low + High) / 2;
+        int Order = strcmp(Name, Table[Mid].Name);
+        if (Order == 0)
+        {
+            return &Table[Mid];
+        }
+        if (Order < 0)
+        {
+            High = Mid;
+        }
+        else
+        {
+            Low = Mid + 1;
+        }
+    }
+    return nullptr;
+}
+
+bool MeshCommandDispatch(const MeshCommandEntry *Table, size_t Count, char *Msg)
+{
+    MeshCommandArgs Args;
+    if (!MeshCommandTokenize(Msg, Args))
+    {
+        return false;
+    }
+
+    const MeshCommandEntry *Entry = MeshCommandLookup(Table, Count, Args.Token[0]);
+    if (!Entry)
+    {
+        return false;
+    }
+    Entry->Handler(Args);
+    return true;
+}
+
+bool MeshCommandIsMsgPack(const char *Msg, size_t Length)
+{
+    uint8_t Marker = Length ? (uint8_t)Msg[0] : 0;
+    // fixarray or array 16
+    return (Marker & 0xF0) == 0x90 || Marker == 0xDC;
+}
+
+bool MeshCommandFromMsgPack(const char *Msg, size_t Length, char *Line, size_t Size)
+{
+    StaticJsonDocument<MESH_COMMAND_MAX_LENGTH + 128> Doc;
+    if (deserializeMsgPack(Doc, Msg, Length))
+    {
+        return false;
+    }
+
+    JsonArrayConst Tokens = Doc.as<JsonArrayConst>();
+    if (Tokens.isNull() || Tokens.size() == 0 || Tokens.size() > MESH_COMMAND_MAX_TOKENS)
+    {
+        return false;
+    }
+
+    size_t Used = 0;
+    for (JsonVariantConst Token : Tokens)
+    {
+        const char *Separator = Used ? " " : "";
+        int Written;
+        if (Token.is<const char *>())
+        {
+            Written = snprintf(Line + Used, Size - Used, "%s%s", Separator, Token.as<const char *>());
+        }
+        else if (Token.is<long>())
+        {
+            Written = snprintf(Line + Used, Size - Used, "%s%ld", Separator, Token.as<long>());
+        }
+        else if (Token.is<bool>())
+        {
+            Written = snprintf(Line + Used, Size - Used, "%s%d", Separator, Token.as<bool>() ? 1 : 0);
+        }
+        else
+        {
+            return false;
+        }
+        if (Written < 0 || Used + Written >= Size)
+        {
+            return false;
+        }
+        Used += Written;
+    }
+    return true;
+}
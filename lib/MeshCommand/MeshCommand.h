@@ -0,0 +1,70 @@
+#ifndef MeshCommand_H
+#define MeshCommand_H
+
+#include <Arduino.h>
+
+#define MESH_COMMAND_MAX_TOKENS 6
+#define MESH_COMMAND_MAX_LENGTH 200
+
+// Space separated tokens of one message. The pointers refer into the
+// message buffer, which MeshCommandTokenize() splits in place.
+struct MeshCommandArgs
+{
+    char *Token[MESH_COMMAND_MAX_TOKENS];
+    uint8_t Count;
+
+    // Token text, "" if the message has fewer tokens
+    const char *Text(uint8_t Index) const;
+    // Token as integer with Arduino toInt() semantics: 0 if not a number
+    long Int(uint8_t Index) const;
+};
+
+typedef void (*MeshCommandHandler)(const MeshCommandArgs &Args);
+
+struct MeshCommandEntry
+{
+    const char *Name;
+    MeshCommandHandler Handler;
+};
+
+uint8_t MeshCommandTokenize(char *Msg, MeshCommandArgs &Args);
+bool MeshParseInt(const char *Text, long &Value);
+
+const MeshCommandEntry *MeshCommandLookup(const MeshCommandEntry *Table, size_t Count, const char *Name);
+
+// Tokenizes Msg in place and calls the handler registered for the first
+// token. Returns false if the command is unknown. Does not allocate.
+bool MeshCommandDispatch(const MeshCommandEntry *Table, size_t Count, char *Msg);
+
+template <size_t N>
+bool MeshCommandDispatch(const MeshCommandEntry (&Table)[N], char *Msg)
+{
+    return MeshCommandDispatch(Table, N, Msg);
+}
+
+// Binary commands are a MessagePack array of strings and integers, e.g.
+// ["output", 3, 1]. Text commands never start with an array marker.
+bool MeshCommandIsMsgPack(const char *Msg, size_t Length);
+
+// Converts a binary command into the equivalent text line, so it runs
+// through the same table. Returns false if it is malformed or too long.
+bool MeshCommandFromMsgPack(const char *Msg, size_t Length, char *Line, size_t Size);
+
+// Compile time checks for command tables (C++11 constexpr, so recursive)
+constexpr int MeshCommandCompare(const char *A, const char *B)
+{
+    return (*A != *B || *A == 0) ? (int)(unsigned char)*A - (int)(unsigned char)*B : MeshCommandCompare(A + 1, B + 1);
+}
+
+constexpr bool MeshCommandTableIsSorted(const MeshCommandEntry *Table, size_t Count)
+{
+    return Count < 2 || (MeshCommandCompare(Table[0].Name, Table[1].Name) < 0 && MeshCommandTableIsSorted(Table + 1, Count - 1));
+}
+
+template <size_t N>
+constexpr bool MeshCommandTableIsSorted(const MeshCommandEntry (&Table)[N])
+{
+    return MeshCommandTableIsSorted(Table, N);
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "MeshMessageQueue.h"
+
+MeshMessageQueue::MeshMessageQueue()
+    : head(0), tail(0), highWater(0), overflows(0), oversized(0), received(0)
+{
+}
+
+bool MeshMessageQueue::Push(const char *Payload, size_t Length, const uint8_t SrcMac[6])
+{
+    received.fetch_add(1, std::memory_order_relaxed);
+
+    if (Length >= MESH_QUEUE_PAYLOAD_SIZE)
+    {
+        // A truncated command could mean something else, drop it
+        oversized.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint16_t Head = head.load(std::memory_order_relaxed);
+    uint16_t Tail = tail.load(std::memory_order_acquire);
+    uint16_t Used = Head - Tail;
+
+    if (Used >= MESH_QUEUE_CAPACITY)
+    {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    MeshMessageSlot &Slot = slots[Head & (MESH_QUEUE_CAPACITY - 1)];
+    memcpy(Slot.Payload, Payload, Length);
+    Slot.Payload[Length] = 0;
+    Slot.Length = Length;
+    memcpy(Slot.SrcMac, SrcMac, sizeof(Slot.SrcMac));
+
+    head.store(Head + 1, std::memory_order_release);
+
+    if (Used + 1 > highWater.load(std::memory_order_relaxed))
+    {
+        highWater.store(Used + 1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+MeshMessageSlot *MeshMessageQueue::Front()
+{
+    uint16_t Tail = tail.load(std::memory_order_relaxed);
+    if (Tail == head.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+    return &slots[Tail & (MESH_QUEUE_CAPACITY - 1)];
+}
+
+void MeshMessageQueue::Pop()
+{
+    uint16_t Tail = tail.load(std::memory_order_relaxed);
+    if (Tail != head.load(std::memory_order_acquire))
+    {
+        tail.store(Tail + 1, std::memory_order_release);
+    }
+}
+
+uint16_t MeshMessageQueue::Size() const
+{
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
+
+void MeshMessageQueue::ResetStats()
+{
+    highWater.store(Size(), std::memory_order_relaxed);
+    overflows.store(0, std::memory_order_relaxed);
+    oversized.store(0, std::memory_order_relaxed);
+    received.store(0, std::memory_order_relaxed);
+}
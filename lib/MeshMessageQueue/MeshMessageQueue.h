@@ -0,0 +1,61 @@
+#ifndef MeshMessageQueue_H
+#define MeshMessageQueue_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Number of slots, must be a power of two
+#ifndef MESH_QUEUE_CAPACITY
+#define MESH_QUEUE_CAPACITY 8
+#endif
+
+// Payload bytes per slot including the terminating zero
+#ifndef MESH_QUEUE_PAYLOAD_SIZE
+#define MESH_QUEUE_PAYLOAD_SIZE 200
+#endif
+
+struct MeshMessageSlot
+{
+    uint16_t Length;
+    uint8_t SrcMac[6];
+    char Payload[MESH_QUEUE_PAYLOAD_SIZE];
+};
+
+// Lock-free single producer / single consumer ring between the mesh receive
+// callback (producer) and loop() (consumer). Slots are preallocated; a full
+// queue drops the new message and counts it instead of overwriting.
+class MeshMessageQueue
+{
+public:
+    MeshMessageQueue();
+
+    // Producer side. Returns false if the message was dropped.
+    bool Push(const char *Payload, size_t Length, const uint8_t SrcMac[6]);
+
+    // Consumer side: the oldest message, or nullptr if empty. The slot stays
+    // valid (and may be modified in place) until Pop().
+    MeshMessageSlot *Front();
+    void Pop();
+
+    uint16_t Size() const;
+    uint16_t HighWater() const { return highWater.load(std::memory_order_relaxed); }
+    uint32_t Overflows() const { return overflows.load(std::memory_order_relaxed); }
+    uint32_t Oversized() const { return oversized.load(std::memory_order_relaxed); }
+    uint32_t Received() const { return received.load(std::memory_order_relaxed); }
+    void ResetStats();
+
+private:
+    static_assert((MESH_QUEUE_CAPACITY & (MESH_QUEUE_CAPACITY - 1)) == 0, "MESH_QUEUE_CAPACITY must be a power of two");
+
+    MeshMessageSlot slots[MESH_QUEUE_CAPACITY];
+    // Free running indices, only written by the producer (head) and the consumer (tail)
+    std::atomic<uint16_t> head;
+    std::atomic<uint16_t> tail;
+
+    std::atomic<uint16_t> highWater;
+    std::atomic<uint32_t> overflows;
+    std::atomic<uint32_t> oversized;
+    std::atomic<uint32_t> received;
+};
+
+#endif
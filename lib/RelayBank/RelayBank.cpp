@@ -0,0 +1,43 @@
+#include "RelayBank.h"
+
+RelayBank::RelayBank(RelayBankWrite Write, bool ActiveLow)
+    : write(Write), activeLow(ActiveLow), state(0), committed(0), changes(0), writes(0)
+{
+}
+
+void RelayBank::Set(uint8_t Output, bool Value)
+{
+    if (Output < 1 || Output > 8)
+    {
+        return;
+    }
+    uint8_t Bit = 1 << (Output - 1);
+    Apply(Bit, Value ? Bit : 0);
+}
+
+void RelayBank::Apply(uint8_t Mask, uint8_t Values)
+{
+    changes++;
+    state = (state & ~Mask) | (Values & Mask);
+}
+
+bool RelayBank::Commit(bool Force)
+{
+    if (!Force && state == committed)
+    {
+        return false;
+    }
+    if (!write(activeLow ? ~state : state))
+    {
+        return false;
+    }
+    committed = state;
+    writes++;
+    return true;
+}
+
+void RelayBank::ResetStats()
+{
+    changes = 0;
+    writes = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef RelayBank_H
+#define RelayBank_H
+
+#include <Arduino.h>
+
+// Writes the port byte to the relay card, false if it could not be queued
+typedef bool (*RelayBankWrite)(uint8_t Port);
+
+// Shadow of the 8 relay outputs (bit 0 = output 1, 1 = on). Set() and
+// Apply() only change the shadow; Commit() sends all changes since the
+// last commit as one port write. Changes of one output between two
+// commits collapse, so a pulse needs a hold time in between.
+class RelayBank
+{
+public:
+    RelayBank(RelayBankWrite Write, bool ActiveLow);
+
+    // Output 1..8, others are ignored
+    void Set(uint8_t Output, bool Value);
+    void Apply(uint8_t Mask, uint8_t Values);
+    // Sends the shadow if it differs from the card (or Force), true if written
+    bool Commit(bool Force = false);
+
+    uint8_t State() const { return state; }
+    bool Get(uint8_t Output) const { return Output >= 1 && Output <= 8 && (state & (1 << (Output - 1))); }
+    bool Pending() const { return state != committed; }
+
+    uint32_t Changes() const { return changes; }
+    uint32_t Writes() const { return writes; }
+    void ResetStats();
+
+private:
+    RelayBankWrite write;
+    bool activeLow;
+    uint8_t state;
+    uint8_t committed;
+    uint32_t changes;
+    uint32_t writes;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "RelaySequencer.h"
+
+RelaySequencer::RelaySequencer(RelayOutputFunction output)
+    : output(output), steps(nullptr), count(0), next(0), holdStart(0), holdMs(0), done(nullptr)
+{
+}
+
+void RelaySequencer::Start(const RelayStep *newSteps, uint8_t newCount, RelaySequenceDone newDone)
+{
+    if (steps)
+    {
+        Finish(false);
+    }
+
+    steps = newSteps;
+    count = newCount;
+    next = 0;
+    holdMs = 0;
+    done = newDone;
+    RunSteps();
+}
+
+void RelaySequencer::Cancel()
+{
+    if (steps)
+    {
+        Finish(false);
+    }
+}
+
+void RelaySequencer::Loop()
+{
+    if (steps && millis() - holdStart >= holdMs)
+    {
+        RunSteps();
+    }
+}
+
+uint32_t RelaySequencer::NextDueMs() const
+{
+    if (!steps)
+    {
+        return UINT32_MAX;
+    }
+    unsigned long Held = millis() - holdStart;
+    return Held >= holdMs ? 0 : holdMs - Held;
+}
+
+void RelaySequencer::RunSteps()
+{
+    // Execute every step whose predecessor does not hold
+    while (next < count)
+    {
+        const RelayStep &step = steps[next++];
+        if (step.Output)
+        {
+            output(step.Output, step.Value);
+        }
+        if (step.HoldMs)
+        {
+            holdStart = millis();
+            holdMs = step.HoldMs;
+            return;
+        }
+    }
+    Finish(true);
+}
+
+void RelaySequencer::Finish(bool completed)
+{
+    RelaySequenceDone callback = done;
+    steps = nullptr;
+    done = nullptr;
+    if (callback)
+    {
+        callback(completed);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef RelaySequencer_H
+#define RelaySequencer_H
+
+#include <Arduino.h>
+
+// One step of a relay sequence: drive Output to Value, then hold for HoldMs
+// before the next step. Output 0 is a pure wait.
+struct RelayStep
+{
+    uint8_t Output;
+    bool Value;
+    uint16_t HoldMs;
+};
+
+typedef void (*RelayOutputFunction)(uint8_t Output, bool Value);
+
+// Called once per sequence: Completed is false when it was cancelled or
+// preempted by a newer sequence on the same sequencer.
+typedef void (*RelaySequenceDone)(bool Completed);
+
+// Time-stepped replacement for SetOutput()/delay() chains. Steps are
+// advanced from loop() via Loop(), so the main loop never blocks.
+class RelaySequencer
+{
+public:
+    explicit RelaySequencer(RelayOutputFunction output);
+
+    // Starts a sequence right away, preempting the running one. The step
+    // array must outlive the sequence (use static const tables).
+    void Start(const RelayStep *steps, uint8_t count, RelaySequenceDone done = nullptr);
+    void Cancel();
+    bool IsRunning() const { return steps != nullptr; }
+    void Loop();
+    // Milliseconds until Loop() has a step to run, UINT32_MAX when idle
+    uint32_t NextDueMs() const;
+
+private:
+    void RunSteps();
+    void Finish(bool completed);
+
+    RelayOutputFunction output;
+    const RelayStep *steps;
+    uint8_t count;
+    uint8_t next;
+    unsigned long holdStart;
+    uint16_t holdMs;
+    RelaySequenceDone done;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "ScheduleTable.h"
+
+ScheduleTable::ScheduleTable(ScheduleSlot *Slots, uint8_t Count, ScheduleStartFunction Start, uint8_t GraceMinutes)
+    : slots(Slots), count(Count < SCHEDULE_MAX_SLOTS ? Count : SCHEDULE_MAX_SLOTS), start(Start), grace(GraceMinutes * 60),
+      started(0)
+{
+    for (uint8_t i = 0; i < SCHEDULE_MAX_SLOTS; i++)
+    {
+        firedDay[i] = 0;
+    }
+}
+
+uint32_t ScheduleTable::Run(const WallClock &Clock)
+{
+    if (!Clock.Synced())
+    {
+        return UINT32_MAX;
+    }
+
+    uint64_t NowMs = Clock.NowMs();
+    uint32_t Day = NowMs / 1000 / CLOCK_DAY_SECONDS;
+    uint32_t Second = NowMs / 1000 % CLOCK_DAY_SECONDS;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint32_t Start = slots[i].Hour * 3600UL + slots[i].Minute * 60UL;
+        if (slots[i].Active && Second >= Start && Second < Start + grace && firedDay[i] != Day)
+        {
+            firedDay[i] = Day;
+            started++;
+            start(i, slots[i]);
+        }
+    }
+
+    uint32_t Next = UINT32_MAX;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!slots[i].Active)
+        {
+            continue;
+        }
+        uint32_t Start = slots[i].Hour * 3600UL + slots[i].Minute * 60UL;
+        uint32_t Wait = Start > Second || (Start == Second && firedDay[i] != Day) ? Start - Second
+                                                                                  : Start + CLOCK_DAY_SECONDS - Second;
+        Next = Wait < Next ? Wait : Next;
+    }
+    if (Next == UINT32_MAX)
+    {
+        return UINT32_MAX;
+    }
+    return Next * 1000 > NowMs % 1000 ? Clock.LocalMs(Next * 1000 - NowMs % 1000) : 0;
+}
+
+void ScheduleTable::Changed(uint8_t Index, const WallClock &Clock)
+{
+    if (Index >= count || !Clock.Synced())
+    {
+        return;
+    }
+    uint32_t Start = slots[Index].Hour * 3600UL + slots[Index].Minute * 60UL;
+    if (Clock.SecondOfDay() >= Start)
+    {
+        firedDay[Index] = Clock.Day();
+    }
+}
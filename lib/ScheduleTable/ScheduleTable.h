@@ -0,0 +1,51 @@
+#ifndef ScheduleTable_H
+#define ScheduleTable_H
+
+#include <Arduino.h>
+#include "WallClock.h"
+
+#define SCHEDULE_MAX_SLOTS 8
+
+// One daily start: filter pump for PumpHours, salt system for SaltHours
+struct ScheduleSlot
+{
+    bool Active;
+    uint8_t Hour;
+    uint8_t Minute;
+    uint8_t PumpHours;
+    uint8_t SaltHours;
+};
+
+typedef void (*ScheduleStartFunction)(uint8_t Slot, const ScheduleSlot &Entry);
+
+// Daily start times evaluated against the local WallClock, so a lost time
+// message no longer costs a day. A slot starts once per day, also if the
+// clock only reaches it up to GraceMinutes late (reboot, first sync).
+// Slot storage is provided by the caller (persisted with the settings).
+class ScheduleTable
+{
+public:
+    ScheduleTable(ScheduleSlot *Slots, uint8_t Count, ScheduleStartFunction Start, uint8_t GraceMinutes);
+
+    // Starts every due slot, returns the millis() until the next start
+    // (UINT32_MAX if the clock is not synced or no slot is active)
+    uint32_t Run(const WallClock &Clock);
+
+    // After editing a slot: a start time already passed today waits for
+    // tomorrow instead of starting within the grace time
+    void Changed(uint8_t Index, const WallClock &Clock);
+
+    uint8_t Count() const { return count; }
+    ScheduleSlot &Slot(uint8_t Index) { return slots[Index]; }
+    uint32_t Started() const { return started; }
+
+private:
+    ScheduleSlot *slots;
+    uint8_t count;
+    ScheduleStartFunction start;
+    uint16_t grace;
+    uint32_t firedDay[SCHEDULE_MAX_SLOTS];
+    uint32_t started;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "SettingsStore.h"
+
+static const char *const BlobKey = "settings";
+
+SettingsStore::SettingsStore(const char *Namespace, const SettingsField *Fields, uint8_t Count, uint16_t Version,
+                             uint32_t CommitDelayMs, uint32_t MaxDelayMs)
+    : name(Namespace), fields(Fields), count(Count), version(Version), commitDelay(CommitDelayMs), maxDelay(MaxDelayMs),
+      opened(false), dirty(false), restored(false), stored(false), firstChange(0), lastChange(0), storedCrc(0), writes(0),
+      coalesced(0), unchanged(0), failed(0)
+{
+}
+
+bool SettingsStore::Begin()
+{
+    opened = nvs.begin(name, false);
+    if (!opened)
+    {
+        // Commit() opens it again
+        return false;
+    }
+
+    uint8_t Blob[sizeof(Header) + SETTINGS_MAX_SIZE];
+    uint8_t Current[SETTINGS_MAX_SIZE];
+    size_t Size = Pack(Current);
+    size_t Length = nvs.getBytesLength(BlobKey);
+    if (Length < sizeof(Header) || Length > sizeof(Blob) || nvs.getBytes(BlobKey, Blob, Length) != Length)
+    {
+        return false;
+    }
+
+    Header Stored;
+    memcpy(&Stored, Blob, sizeof(Header));
+    // Keep counting writes even if the layout changed
+    writes = Stored.Writes;
+    if (Stored.Version != version || Stored.Size > Size || Length != sizeof(Header) + Stored.Size ||
+        Stored.Crc != Crc32(Blob + sizeof(Header), Stored.Size))
+    {
+        return false;
+    }
+
+    // A blob from before fields were appended restores the ones it has
+    uint8_t Restore = 0;
+    size_t Used = 0;
+    while (Restore < count && Used + fields[Restore].Size <= Stored.Size)
+    {
+        Used += fields[Restore++].Size;
+    }
+    if (Used != Stored.Size)
+    {
+        return false;
+    }
+
+    const uint8_t *Data = Blob + sizeof(Header);
+    for (uint8_t i = 0; i < Restore; i++)
+    {
+        memcpy(fields[i].Value, Data, fields[i].Size);
+        Data += fields[i].Size;
+    }
+    storedCrc = Stored.Crc;
+    stored = Stored.Size == Size;
+    restored = true;
+    return true;
+}
+
+void SettingsStore::MarkDirty()
+{
+    if (dirty)
+    {
+        coalesced++;
+    }
+    else
+    {
+        dirty = true;
+        firstChange = millis();
+    }
+    lastChange = millis();
+}
+
+void SettingsStore::Loop()
+{
+    if (!dirty)
+    {
+        return;
+    }
+    unsigned long Now = millis();
+    if (Now - lastChange >= commitDelay || Now - firstChange >= maxDelay)
+    {
+        Commit();
+    }
+}
+
+uint32_t SettingsStore::NextDueMs() const
+{
+    if (!dirty)
+    {
+        return UINT32_MAX;
+    }
+    unsigned long Now = millis();
+    unsigned long Quiet = Now - lastChange;
+    unsigned long Pending = Now - firstChange;
+    if (Quiet >= commitDelay || Pending >= maxDelay)
+    {
+        return 0;
+    }
+    uint32_t Due = commitDelay - Quiet;
+    return maxDelay - Pending < Due ? maxDelay - Pending : Due;
+}
+
+bool SettingsStore::Commit()
+{
+    uint8_t Blob[sizeof(Header) + SETTINGS_MAX_SIZE];
+    size_t Size = Pack(Blob + sizeof(Header));
+    uint32_t Crc = Crc32(Blob + sizeof(Header), Size);
+    if (stored && Crc == storedCrc)
+    {
+        dirty = false;
+        unchanged++;
+        return false;
+    }
+
+    Header Stored = {version, (uint16_t)Size, writes + 1, Crc};
+    memcpy(Blob, &Stored, sizeof(Header));
+    if (!opened)
+    {
+        opened = nvs.begin(name, false);
+    }
+    if (!opened || nvs.putBytes(BlobKey, Blob, sizeof(Header) + Size) != sizeof(Header) + Size)
+    {
+        // Still pending: Loop() tries again once CommitDelayMs passed
+        failed++;
+        dirty = true;
+        firstChange = lastChange = millis();
+        return false;
+    }
+    dirty = false;
+    writes++;
+    storedCrc = Crc;
+    stored = true;
+    return true;
+}
+
+size_t SettingsStore::Pack(uint8_t *Data) const
+{
+    size_t Size = 0;
+    for (uint8_t i = 0; i < count && Size + fields[i].Size <= SETTINGS_MAX_SIZE; i++)
+    {
+        memcpy(Data + Size, fields[i].Value, fields[i].Size);
+        Size += fields[i].Size;
+    }
+    return Size;
+}
+
+uint32_t SettingsStore::Crc32(const uint8_t *Data, size_t Length)
+{
+    uint32_t Crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < Length; i++)
+    {
+        Crc ^= Data[i];
+        for (uint8_t Bit = 0; Bit < 8; Bit++)
+        {
+            Crc = (Crc >> 1) ^ (0xEDB88320 & -(Crc & 1));
+        }
+    }
+    return ~Crc;
+}
@@ -0,0 +1,88 @@
+#ifndef SettingsStore_H
+#define SettingsStore_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+#define SETTINGS_MAX_SIZE 128 // bytes of all fields together
+
+// One persisted variable. The blob is the fields back to back in table
+// order, so reordering or resizing fields needs a new version. Fields
+// appended at the end do not: an older blob restores the fields it has.
+struct SettingsField
+{
+    const char *Name;
+    void *Value;
+    uint8_t Size;
+};
+
+#define SETTINGS_FIELD(Variable) {#Variable, &Variable, sizeof(Variable)}
+
+// Keeps a table of variables in one NVS blob with a version and a CRC.
+// MarkDirty() only arms a timer: the blob is written once the settings
+// were quiet for CommitDelayMs (at most MaxDelayMs after the first
+// change), and not at all if the content ends up unchanged. A failed
+// write stays pending and is tried again after CommitDelayMs. Every write
+// erases flash, so the lifetime write count is stored with the blob.
+class SettingsStore
+{
+public:
+    SettingsStore(const char *Namespace, const SettingsField *Fields, uint8_t Count, uint16_t Version,
+                  uint32_t CommitDelayMs, uint32_t MaxDelayMs);
+
+    // Opens NVS and restores the fields. Returns false (fields keep their
+    // defaults) if there is no blob or it has another version or layout.
+    bool Begin();
+    void MarkDirty();
+    void Loop();
+    // Milliseconds until Loop() commits, UINT32_MAX when nothing is pending
+    uint32_t NextDueMs() const;
+    // Writes now if the fields differ from the stored blob. Returns false
+    // if nothing was written; after a failed write the commit stays pending.
+    bool Commit();
+
+    bool Pending() const { return dirty; }
+    bool Restored() const { return restored; }
+    // Blob writes over the lifetime of the flash
+    uint32_t Writes() const { return writes; }
+    // MarkDirty() calls folded into an already pending commit
+    uint32_t Coalesced() const { return coalesced; }
+    // Commits that found nothing changed
+    uint32_t Unchanged() const { return unchanged; }
+    // Blob writes NVS refused since boot, each retried
+    uint32_t Failed() const { return failed; }
+
+private:
+    struct Header
+    {
+        uint16_t Version;
+        uint16_t Size;
+        uint32_t Writes;
+        uint32_t Crc;
+    };
+
+    size_t Pack(uint8_t *Data) const;
+    static uint32_t Crc32(const uint8_t *Data, size_t Length);
+
+    Preferences nvs;
+    const char *name;
+    const SettingsField *fields;
+    uint8_t count;
+    uint16_t version;
+    uint32_t commitDelay;
+    uint32_t maxDelay;
+
+    bool opened;
+    bool dirty;
+    bool restored;
+    bool stored; // storedCrc describes the blob on flash
+    unsigned long firstChange;
+    unsigned long lastChange;
+    uint32_t storedCrc;
+    uint32_t writes;
+    uint32_t coalesced;
+    uint32_t unchanged;
+    uint32_t failed;
+};
+
+#endif
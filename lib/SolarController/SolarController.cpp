@@ -0,0 +1,79 @@
+#include "SolarController.h"
+
+SolarController::SolarController(const SolarConfig &Config)
+    : config(Config), lastMove(0), moved(false), backoff(0), actuations(0)
+{
+}
+
+SolarTemp SolarController::FromCelsius(float TempC)
+{
+    // DEVICE_DISCONNECTED_C is -127, the DS18B20 range ends at -55
+    if (TempC < -55 || TempC > 125)
+    {
+        return SOLAR_NO_TEMP;
+    }
+    return (SolarTemp)lroundf(TempC * SOLAR_TEMP_SCALE);
+}
+
+uint32_t SolarController::DwellMs() const
+{
+    return ((uint32_t)config.DwellMinutes * 60 * 1000) << backoff;
+}
+
+void SolarController::Moved(bool Solar)
+{
+    unsigned long Now = millis();
+    if (!Solar && moved)
+    {
+        // A short solar run means the roof only looked warm while standing
+        uint32_t Run = Now - lastMove;
+        if (Run < 2 * DwellMs())
+        {
+            backoff = backoff < SOLAR_BACKOFF_MAX ? backoff + 1 : backoff;
+        }
+        else
+        {
+            backoff = 0;
+        }
+    }
+    lastMove = Now;
+    moved = true;
+    actuations++;
+}
+
+bool SolarController::Update(SolarTemp Water, SolarTemp Roof, SolarTemp Flow, SolarTemp Return, SolarTemp WaterMax,
+                             bool Pumping, bool Solar)
+{
+    if (Water == SOLAR_NO_TEMP)
+    {
+        return Solar;
+    }
+    // The water maximum overrides the dwell time
+    if (Solar && Water >= WaterMax)
+    {
+        return false;
+    }
+    if (!Pumping || (moved && millis() - lastMove < DwellMs()))
+    {
+        return Solar;
+    }
+
+    if (!Solar)
+    {
+        if (Water > WaterMax - FromTenths(config.Hysteresis))
+        {
+            return false;
+        }
+        return Roof == SOLAR_NO_TEMP || Roof - Water >= FromTenths(config.OnDelta);
+    }
+
+    if (Flow != SOLAR_NO_TEMP && Return != SOLAR_NO_TEMP)
+    {
+        return Flow - Return >= FromTenths(config.OffDelta);
+    }
+    if (Roof != SOLAR_NO_TEMP)
+    {
+        return Roof - Water >= FromTenths(config.OffDelta);
+    }
+    return true;
+}
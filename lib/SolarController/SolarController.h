@@ -0,0 +1,55 @@
+#ifndef SolarController_H
+#define SolarController_H
+
+#include <Arduino.h>
+
+// Temperatures in 1/16 K, the resolution of a DS18B20 at 12 bit
+typedef int16_t SolarTemp;
+#define SOLAR_TEMP_SCALE 16
+#define SOLAR_NO_TEMP INT16_MIN // sensor missing or failed
+#define SOLAR_BACKOFF_MAX 3     // dwell doubles up to 8 times after short runs
+
+// Thresholds in 1/10 K, persisted with the settings
+struct SolarConfig
+{
+    uint8_t OnDelta;      // roof above water to go to solar
+    uint8_t OffDelta;     // flow above return (roof above water without them) to stay on solar
+    uint8_t Hysteresis;   // below the water maximum to go to solar again
+    uint8_t DwellMinutes; // between two valve moves, except for the water maximum
+};
+
+// Decides the heating valve from the collector and water temperatures.
+// Going to solar needs the stagnating roof OnDelta above the water; staying
+// needs the running collector to heat the water by OffDelta, measured
+// between flow and return. The gap between the two, the water hysteresis
+// and the dwell time keep the motor from chasing clouds, and a solar run
+// that ended before two dwell times doubles the dwell for the next start.
+// Without a roof reading it falls back to the water temperature alone.
+class SolarController
+{
+public:
+    explicit SolarController(const SolarConfig &Config);
+
+    static SolarTemp FromCelsius(float TempC);
+
+    // One evaluation per measurement cycle, returns the wanted valve position
+    // (true = solar). Without pump flow the valve stays where it is.
+    bool Update(SolarTemp Water, SolarTemp Roof, SolarTemp Flow, SolarTemp Return, SolarTemp WaterMax, bool Pumping, bool Solar);
+    // The valve moved (also by hand), restarts the dwell time
+    void Moved(bool Solar);
+
+    uint32_t Actuations() const { return actuations; }
+    uint8_t Backoff() const { return backoff; }
+
+private:
+    static SolarTemp FromTenths(uint8_t Tenths) { return (SolarTemp)(Tenths * SOLAR_TEMP_SCALE / 10); }
+    uint32_t DwellMs() const;
+
+    const SolarConfig &config;
+    unsigned long lastMove;
+    bool moved;
+    uint8_t backoff;
+    uint32_t actuations;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include "StaticDeflate.h"
+
+// Position + 1 of the newest 3 bytes per hash, 0 = none, and for every
+// position in the window the previous one with the same hash
+static uint16_t Head[1 << STATIC_DEFLATE_HASH_BITS];
+static uint16_t Prev[STATIC_DEFLATE_WINDOW];
+
+static const uint16_t LengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                        31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DistanceBase[30] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                          193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t DistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Deflate bit order: values LSB first, Huffman codes MSB first
+struct BitWriter
+{
+    uint8_t *Out;
+    size_t Size;
+    size_t Used;
+    uint32_t Bits;
+    uint8_t Count;
+    bool Overflow;
+
+    void Put(uint32_t Value, uint8_t Length)
+    {
+        Bits |= Value << Count;
+        Count += Length;
+        while (Count >= 8)
+        {
+            Byte(Bits);
+            Bits >>= 8;
+            Count -= 8;
+        }
+    }
+
+    void Code(uint16_t Code, uint8_t Length)
+    {
+        uint16_t Reversed = 0;
+        for (uint8_t i = 0; i < Length; i++)
+        {
+            Reversed = (Reversed << 1) | ((Code >> i) & 1);
+        }
+        Put(Reversed, Length);
+    }
+
+    void Byte(uint8_t Value)
+    {
+        if (Used < Size)
+        {
+            Out[Used++] = Value;
+        }
+        else
+        {
+            Overflow = true;
+        }
+    }
+
+    void Flush()
+    {
+        if (Count)
+        {
+            Byte(Bits);
+            Bits = 0;
+            Count = 0;
+        }
+    }
+};
+
+static void PutSymbol(BitWriter &Writer, uint16_t Symbol)
+{
+    if (Symbol < 144)
+    {
+        Writer.Code(0x30 + Symbol, 8);
+    }
+    else if (Symbol < 256)
+    {
+        Writer.Code(0x190 + Symbol - 144, 9);
+    }
+    else if (Symbol < 280)
+    {
+        Writer.Code(Symbol - 256, 7);
+    }
+    else
+    {
+        Writer.Code(0xC0 + Symbol - 280, 8);
+    }
+}
+
+static void PutMatch(BitWriter &Writer, uint16_t Length, uint16_t Distance)
+{
+    uint8_t Code = 28;
+    while (LengthBase[Code] > Length)
+    {
+        Code--;
+    }
+    PutSymbol(Writer, 257 + Code);
+    Writer.Put(Length - LengthBase[Code], LengthExtra[Code]);
+
+    Code = 29;
+    while (DistanceBase[Code] > Distance)
+    {
+        Code--;
+    }
+    Writer.Code(Code, 5);
+    Writer.Put(Distance - DistanceBase[Code], DistanceExtra[Code]);
+}
+
+static uint16_t Hash(const uint8_t *Data)
+{
+    uint32_t Key = Data[0] | Data[1] << 8 | (uint32_t)Data[2] << 16;
+    return (Key * 2654435761U) >> (32 - STATIC_DEFLATE_HASH_BITS);
+}
+
+// Links Position into its hash chain, returns the previous head
+static uint16_t Insert(const uint8_t *Data, size_t Position)
+{
+    uint16_t Slot = Hash(Data + Position);
+    uint16_t Previous = Head[Slot];
+    Prev[Position % STATIC_DEFLATE_WINDOW] = Previous;
+    Head[Slot] = Position + 1;
+    return Previous;
+}
+
+static uint32_t Adler32(const uint8_t *Data, size_t Length)
+{
+    uint32_t A = 1;
+    uint32_t B = 0;
+    for (size_t i = 0; i < Length; i++)
+    {
+        A = (A + Data[i]) % 65521;
+        B = (B + A) % 65521;
+    }
+    return B << 16 | A;
+}
+
+static void PutAdler(uint8_t *Out, uint32_t Adler)
+{
+    Out[0] = Adler >> 24;
+    Out[1] = Adler >> 16;
+    Out[2] = Adler >> 8;
+    Out[3] = Adler;
+}
+
+size_t StaticDeflate(const uint8_t *Data, size_t Length, uint8_t *Out, size_t Size)
+{
+    if (Length > STATIC_DEFLATE_MAX_INPUT || Size < 6)
+    {
+        return 0;
+    }
+    // zlib header: deflate, 32 KB window, fastest level
+    Out[0] = 0x78;
+    Out[1] = 0x01;
+
+    // Never larger than storing the data, the last 4 bytes are for Adler-32
+    size_t Limit = Size < STATIC_DEFLATE_BOUND(Length) ? Size : STATIC_DEFLATE_BOUND(Length);
+    BitWriter Writer = {Out + 2, Limit - 6, 0, 0, 0, false};
+    Writer.Put(1, 1); // last block
+    Writer.Put(1, 2); // fixed Huffman codes
+
+    memset(Head, 0, sizeof(Head));
+    size_t Position = 0;
+    while (Position < Length && !Writer.Overflow)
+    {
+        uint16_t Best = 0;
+        size_t BestAt = 0;
+        if (Position + 3 <= Length)
+        {
+            size_t Max = Length - Position < 258 ? Length - Position : 258;
+            uint16_t Candidate = Insert(Data, Position);
+            for (uint8_t Probe = 0; Candidate && Probe < STATIC_DEFLATE_PROBES && Best < Max; Probe++)
+            {
+                size_t At = Candidate - 1;
+                if (Position - At > STATIC_DEFLATE_WINDOW)
+                {
+                    break;
+                }
+                uint16_t Match = 0;
+                while (Match < Max && Data[At + Match] == Data[Position + Match])
+                {
+                    Match++;
+                }
+                if (Match > Best)
+                {
+                    Best = Match;
+                    BestAt = At;
+                }
+                Candidate = Prev[At % STATIC_DEFLATE_WINDOW];
+            }
+        }
+        if (Best >= 3)
+        {
+            PutMatch(Writer, Best, Position - BestAt);
+            // The skipped positions are match candidates for later data
+            for (size_t Skipped = Position + 1; Skipped < Position + Best && Skipped + 3 <= Length; Skipped++)
+            {
+                Insert(Data, Skipped);
+            }
+            Position += Best;
+        }
+        else
+        {
+            PutSymbol(Writer, Data[Position]);
+            Position++;
+        }
+    }
+    PutSymbol(Writer, 256);
+    Writer.Flush();
+
+    size_t Used = 2 + Writer.Used;
+    if (Writer.Overflow)
+    {
+        if (Size < STATIC_DEFLATE_BOUND(Length))
+        {
+            return 0;
+        }
+        // Stored block: last block, type 0, then LEN and its complement
+        Out[2] = 0x01;
+        Out[3] = Length;
+        Out[4] = Length >> 8;
+        Out[5] = ~Length;
+        Out[6] = ~Length >> 8;
+        memcpy(Out + 7, Data, Length);
+        Used = 7 + Length;
+    }
+    PutAdler(Out + Used, Adler32(Data, Length));
+    return Used + 4;
+}
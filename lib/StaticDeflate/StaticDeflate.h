@@ -0,0 +1,22 @@
+#ifndef StaticDeflate_H
+#define StaticDeflate_H
+
+#include <Arduino.h>
+
+#define STATIC_DEFLATE_HASH_BITS 10                     // 2 KB hash heads in .bss
+#define STATIC_DEFLATE_WINDOW 2048                      // match distance, 4 KB hash chains in .bss
+#define STATIC_DEFLATE_PROBES 16                        // chain entries tried per position
+#define STATIC_DEFLATE_MAX_INPUT 32768                  // positions fit the 16 bit tables, longer input is refused
+#define STATIC_DEFLATE_BOUND(Length) ((Length) + 11)    // largest output for Length input bytes
+
+// Compresses Data into a zlib stream (one fixed Huffman block, greedy
+// matches found through hash chains over the last 2 KB of input).
+// miniz's tdefl needs about 300 KB of heap for its state; this needs no
+// heap at all and compresses about as well as its fastest level on the
+// short inputs here (history chunks, telemetry batches). If the
+// block does not pay off, the data is stored instead, so Out never needs
+// more than STATIC_DEFLATE_BOUND(Length). Returns the stream length, 0 if
+// Size is too small. The tables are shared: call from loop() only.
+size_t StaticDeflate(const uint8_t *Data, size_t Length, uint8_t *Out, size_t Size);
+
+#endif
@@ -0,0 +1,195 @@
+#include "TelemetryBacklog.h"
+
+TelemetryBacklog::TelemetryBacklog(const ValueField *Fields, uint8_t Count, uint8_t *Ring, uint16_t Capacity,
+                                   TelemetryBacklogSendFunction Send, uint16_t IntervalMs)
+    : fields(Fields), count(Count < TELEMETRY_BACKLOG_VALUES ? Count : TELEMETRY_BACKLOG_VALUES), ring(Ring),
+      capacity(Capacity), send(Send), interval(IntervalMs), tail(0), sent(0), head(0), records(0), unsent(0), outage(false),
+      flushing(false), lastBatchAt(0), flushStartedAt(0), flushRecords(0), dropped(0), outages(0), batches(0),
+      flushedRecords(0), flushedBytes(0), lastFlushRecords(0), lastFlushMs(0)
+{
+}
+
+bool TelemetryBacklog::Record(uint32_t Values, uint8_t Outputs)
+{
+    bool WasLive = Live();
+    uint8_t Data[TELEMETRY_BACKLOG_RECORD_MAX];
+    size_t Length = Encode(Values, Outputs, Data);
+    if (Length > capacity)
+    {
+        return WasLive;
+    }
+    while (capacity - (head - tail) < Length)
+    {
+        DropOldest();
+    }
+    Write(head, Data, Length);
+    head += Length;
+    records++;
+    if (WasLive)
+    {
+        sent = head;
+    }
+    else
+    {
+        unsent++;
+    }
+    return WasLive;
+}
+
+void TelemetryBacklog::RootAlive()
+{
+    if (outage)
+    {
+        outage = false;
+        // The first batch goes out with the next Loop()
+        lastBatchAt = millis() - interval;
+    }
+    while (tail != sent)
+    {
+        tail += RecordLength(tail);
+        records--;
+    }
+}
+
+void TelemetryBacklog::RootLost()
+{
+    if (outage)
+    {
+        return;
+    }
+    outage = true;
+    outages++;
+    // Sent since the root last spoke, maybe into the void
+    sent = tail;
+    unsent = records;
+}
+
+void TelemetryBacklog::Loop()
+{
+    unsigned long Now = millis();
+    if (outage || sent == head || Now - lastBatchAt < interval)
+    {
+        return;
+    }
+
+    // Whole records, oldest first
+    uint8_t Plain[TELEMETRY_BACKLOG_BATCH];
+    size_t Length = 0;
+    uint16_t Count = 0;
+    uint32_t Position = sent;
+    while (Position != head)
+    {
+        uint8_t Size = RecordLength(Position);
+        if (Length + Size > sizeof(Plain))
+        {
+            break;
+        }
+        Read(Position, Plain + Length, Size);
+        Length += Size;
+        Position += Size;
+        Count++;
+    }
+
+    lastBatchAt = Now;
+    // No heap involved and Packed holds even incompressible records, so
+    // this cannot fail and leave the backlog stuck
+    uint8_t Packed[TELEMETRY_BACKLOG_PACKED];
+    size_t Compressed = StaticDeflate(Plain, Length, Packed, sizeof(Packed));
+
+    if (!flushing)
+    {
+        flushing = true;
+        flushStartedAt = Now;
+        flushRecords = 0;
+    }
+    sent = Position;
+    unsent -= Count;
+    batches++;
+    flushRecords += Count;
+    flushedRecords += Count;
+    flushedBytes += Compressed;
+    send(Packed, Compressed, Count, unsent);
+    if (sent == head)
+    {
+        flushing = false;
+        lastFlushRecords = flushRecords;
+        lastFlushMs = Now - flushStartedAt;
+    }
+}
+
+uint32_t TelemetryBacklog::NextDueMs() const
+{
+    if (outage || sent == head)
+    {
+        return UINT32_MAX;
+    }
+    unsigned long Waited = millis() - lastBatchAt;
+    return Waited >= interval ? 0 : interval - Waited;
+}
+
+size_t TelemetryBacklog::Encode(uint32_t Values, uint8_t Outputs, uint8_t *Out) const
+{
+    uint32_t Now = millis();
+    size_t Length = 7;
+    uint16_t Written = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!(Values & (1UL << i)))
+        {
+            continue;
+        }
+        float Value = ValueRead(fields[i]);
+        if (fields[i].Type == ValueFloat && Value <= -127)
+        {
+            continue;
+        }
+        memcpy(Out + Length, &Value, sizeof(Value));
+        Length += sizeof(Value);
+        Written |= 1 << i;
+    }
+    Out[0] = Now;
+    Out[1] = Now >> 8;
+    Out[2] = Now >> 16;
+    Out[3] = Now >> 24;
+    Out[4] = Written;
+    Out[5] = Written >> 8;
+    Out[6] = Outputs;
+    return Length;
+}
+
+uint8_t TelemetryBacklog::RecordLength(uint32_t Position) const
+{
+    uint8_t Mask[2];
+    Read(Position + 4, Mask, sizeof(Mask));
+    return 7 + 4 * __builtin_popcount(Mask[0] | (Mask[1] << 8));
+}
+
+void TelemetryBacklog::DropOldest()
+{
+    uint8_t Length = RecordLength(tail);
+    if (tail == sent)
+    {
+        // Never reached the root
+        sent += Length;
+        unsent--;
+        dropped++;
+    }
+    tail += Length;
+    records--;
+}
+
+void TelemetryBacklog::Write(uint32_t Position, const uint8_t *Data, size_t Length)
+{
+    size_t Offset = Position % capacity;
+    size_t First = capacity - Offset < Length ? capacity - Offset : Length;
+    memcpy(ring + Offset, Data, First);
+    memcpy(ring, Data + First, Length - First);
+}
+
+void TelemetryBacklog::Read(uint32_t Position, uint8_t *Data, size_t Length) const
+{
+    size_t Offset = Position % capacity;
+    size_t First = capacity - Offset < Length ? capacity - Offset : Length;
+    memcpy(Data, ring + Offset, First);
+    memcpy(Data + First, ring, Length - First);
+}
@@ -0,0 +1,98 @@
+#ifndef TelemetryBacklog_H
+#define TelemetryBacklog_H
+
+#include <Arduino.h>
+#include "ValueSchema.h"
+#include "StaticDeflate.h"
+
+#define TELEMETRY_BACKLOG_VALUES 16                                       // fields a record can carry
+#define TELEMETRY_BACKLOG_RECORD_MAX (7 + 4 * TELEMETRY_BACKLOG_VALUES)   // bytes of the largest record
+#define TELEMETRY_BACKLOG_BATCH 1024                                      // record bytes per batch, before deflating
+#define TELEMETRY_BACKLOG_PACKED STATIC_DEFLATE_BOUND(TELEMETRY_BACKLOG_BATCH) // deflated batch, incompressible data included
+
+// Sends one batch: Records records as a zlib stream, Remaining records are
+// still waiting for later batches
+typedef void (*TelemetryBacklogSendFunction)(const uint8_t *Batch, size_t Length, uint16_t Records, uint16_t Remaining);
+
+// Keeps telemetry updates until the root confirmed them. Every update is
+// recorded into a byte ring the caller owns; a record is
+//   uint32 millis, uint16 fields (bit i = Fields[i]), uint8 output state,
+//   one float per field bit, lowest bit first (all little endian).
+// While the root is there, updates also go out directly and RootAlive()
+// drops what was sent before it. When its messages stop, RootLost() starts
+// an outage: nothing goes out directly and what was sent since the last
+// RootAlive() is kept for resending, because it may have gone nowhere.
+// After the outage Loop() sends the backlog as deflated batches, one per
+// IntervalMs, and updates only go out directly again once it is empty.
+// A full ring drops its oldest records.
+class TelemetryBacklog
+{
+public:
+    TelemetryBacklog(const ValueField *Fields, uint8_t Count, uint8_t *Ring, uint16_t Capacity,
+                     TelemetryBacklogSendFunction Send, uint16_t IntervalMs);
+
+    // Records the fields in Values (read now, floats at or below -127 left
+    // out) and the output state. Returns true if the caller sends the
+    // update itself, false if it only went into the backlog.
+    bool Record(uint32_t Values, uint8_t Outputs);
+    // A message from the root: everything sent before it arrived
+    void RootAlive();
+    // No message from the root for too long
+    void RootLost();
+    // Sends the next batch when one is due
+    void Loop();
+    // Milliseconds until Loop() sends, UINT32_MAX when there is nothing to flush
+    uint32_t NextDueMs() const;
+
+    bool Outage() const { return outage; }
+    bool Live() const { return !outage && sent == head; }
+    uint16_t Records() const { return records; }
+    uint16_t Unsent() const { return unsent; }
+    uint16_t Used() const { return head - tail; }
+    uint16_t Capacity() const { return capacity; }
+    // Unsent records the ring had to give up
+    uint32_t Dropped() const { return dropped; }
+    uint32_t Outages() const { return outages; }
+    uint32_t Batches() const { return batches; }
+    uint32_t FlushedRecords() const { return flushedRecords; }
+    uint32_t FlushedBytes() const { return flushedBytes; } // deflated
+    // The last completed flush: records and the time from its first batch to its last
+    uint16_t LastFlushRecords() const { return lastFlushRecords; }
+    uint32_t LastFlushMs() const { return lastFlushMs; }
+
+private:
+    size_t Encode(uint32_t Values, uint8_t Outputs, uint8_t *Out) const;
+    uint8_t RecordLength(uint32_t Position) const;
+    void DropOldest();
+    void Write(uint32_t Position, const uint8_t *Data, size_t Length);
+    void Read(uint32_t Position, uint8_t *Data, size_t Length) const;
+
+    const ValueField *fields;
+    uint8_t count;
+    uint8_t *ring;
+    uint16_t capacity;
+    TelemetryBacklogSendFunction send;
+    uint16_t interval;
+
+    // Byte positions, only ever counting up: tail <= sent <= head
+    uint32_t tail;
+    uint32_t sent;
+    uint32_t head;
+    uint16_t records;
+    uint16_t unsent;
+    bool outage;
+    bool flushing;
+    unsigned long lastBatchAt;
+    unsigned long flushStartedAt;
+    uint16_t flushRecords;
+
+    uint32_t dropped;
+    uint32_t outages;
+    uint32_t batches;
+    uint32_t flushedRecords;
+    uint32_t flushedBytes;
+    uint16_t lastFlushRecords;
+    uint32_t lastFlushMs;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "TelemetryDelta.h"
+
+TelemetryDelta::TelemetryDelta(const ValueField *Fields, uint8_t Count, float *LastSent)
+    : fields(Fields), count(Count), lastSent(LastSent)
+{
+    Invalidate();
+}
+
+uint32_t TelemetryDelta::Collect(JsonDocument &Doc, uint32_t Candidates, bool Keyframe)
+{
+    uint32_t Written = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        const ValueField &Field = fields[i];
+        if (!Keyframe && !(Candidates & (1UL << i)))
+        {
+            continue;
+        }
+
+        float Value = ValueRead(Field);
+        if (Field.Type == ValueFloat && Value <= -127)
+        {
+            continue;
+        }
+        // NAN in lastSent (never sent) compares unequal and is never within the deadband
+        if (!Keyframe && (Field.Deadband > 0 ? fabsf(Value - lastSent[i]) < Field.Deadband : Value == lastSent[i]))
+        {
+            continue;
+        }
+
+        switch (Field.Type)
+        {
+        case ValueFloat:
+            Doc[Field.Key] = Value;
+            break;
+        case ValueBool:
+            Doc[Field.Key] = Value != 0;
+            break;
+        default:
+            Doc[Field.Key] = (long)Value;
+            break;
+        }
+        lastSent[i] = Value;
+        Written |= 1UL << i;
+    }
+    return Written;
+}
+
+void TelemetryDelta::Invalidate()
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        lastSent[i] = NAN;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef TelemetryDelta_H
+#define TelemetryDelta_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "ValueSchema.h"
+
+// Tracks what the gateway last received per field and writes only the
+// fields that moved beyond their deadband, as native JSON numbers/booleans.
+// Floats at or below -127 (DS18B20 read error) are never sent.
+class TelemetryDelta
+{
+public:
+    // LastSent must hold Count floats and lives as long as this object
+    TelemetryDelta(const ValueField *Fields, uint8_t Count, float *LastSent);
+
+    // Writes changed fields among Candidates (bit i = Fields[i]) into Doc.
+    // A keyframe writes every valid field. Returns the bits written.
+    uint32_t Collect(JsonDocument &Doc, uint32_t Candidates, bool Keyframe);
+
+    // Forget what was sent, the next Collect() sends everything that changed
+    void Invalidate();
+
+private:
+    const ValueField *fields;
+    uint8_t count;
+    float *lastSent;
+};
+
+#endif
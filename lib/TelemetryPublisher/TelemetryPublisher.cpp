@@ -0,0 +1,60 @@
+#include "TelemetryPublisher.h"
+
+TelemetryPublisher::TelemetryPublisher(TelemetryFlushFunction Flush, uint16_t WindowMs, uint32_t UrgentFields)
+    : flush(Flush), window(WindowMs), urgentFields(UrgentFields), dirty(0), urgent(false), firstDirtyAt(0), requested(0), sent(0)
+{
+}
+
+void TelemetryPublisher::MarkDirty(uint32_t Fields)
+{
+    requested++;
+
+    if (!dirty)
+    {
+        firstDirtyAt = millis();
+    }
+    dirty |= Fields;
+
+    if (Fields & urgentFields)
+    {
+        urgent = true;
+    }
+}
+
+void TelemetryPublisher::Loop()
+{
+    if (dirty && (urgent || millis() - firstDirtyAt >= window))
+    {
+        Flush();
+    }
+}
+
+uint32_t TelemetryPublisher::NextDueMs() const
+{
+    if (!dirty)
+    {
+        return UINT32_MAX;
+    }
+    unsigned long Waited = millis() - firstDirtyAt;
+    return urgent || Waited >= window ? 0 : window - Waited;
+}
+
+void TelemetryPublisher::Flush()
+{
+    if (!dirty)
+    {
+        return;
+    }
+
+    // Clear first, the flush function may mark fields again
+    uint32_t Fields = dirty;
+    dirty = 0;
+    urgent = false;
+    sent += flush(Fields);
+}
+
+void TelemetryPublisher::ResetStats()
+{
+    requested = 0;
+    sent = 0;
+}
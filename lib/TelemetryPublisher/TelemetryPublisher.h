@@ -0,0 +1,45 @@
+#ifndef TelemetryPublisher_H
+#define TelemetryPublisher_H
+
+#include <Arduino.h>
+
+// Sends the telemetry for the given dirty field bits, returns the number of
+// mesh packets it sent.
+typedef uint8_t (*TelemetryFlushFunction)(uint32_t Fields);
+
+// Coalesces telemetry updates: setters mark fields dirty and one merged
+// update is flushed per window. Fields in the urgent mask are flushed on the
+// next Loop() instead of waiting for the window.
+class TelemetryPublisher
+{
+public:
+    TelemetryPublisher(TelemetryFlushFunction Flush, uint16_t WindowMs, uint32_t UrgentFields = 0);
+
+    void MarkDirty(uint32_t Fields);
+    void Flush();
+    void Loop();
+    // Milliseconds until Loop() flushes, UINT32_MAX when nothing is dirty
+    uint32_t NextDueMs() const;
+
+    void SetWindow(uint16_t WindowMs) { window = WindowMs; }
+    uint16_t Window() const { return window; }
+    uint32_t Pending() const { return dirty; }
+
+    // Every MarkDirty() call stands for one packet the node used to send
+    uint32_t Requested() const { return requested; }
+    uint32_t Sent() const { return sent; }
+    uint32_t Saved() const { return requested > sent ? requested - sent : 0; }
+    void ResetStats();
+
+private:
+    TelemetryFlushFunction flush;
+    uint16_t window;
+    uint32_t urgentFields;
+    uint32_t dirty;
+    bool urgent;
+    unsigned long firstDirtyAt;
+    uint32_t requested;
+    uint32_t sent;
+};
+
+#endif
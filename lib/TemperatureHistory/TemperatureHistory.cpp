@@ -0,0 +1,184 @@
+#include "TemperatureHistory.h"
+
+TemperatureHistory::TemperatureHistory(HistorySample *Raw, uint16_t RawCapacity, HistoryRollup *Hours, uint16_t HourCapacity,
+                                       HistoryRollup *Days, uint16_t DayCapacity)
+    : raw(Raw), rawCapacity(RawCapacity), rawHead(0), rawCount(0)
+{
+    rings[0] = {Hours, HourCapacity, 0, 0};
+    rings[1] = {Days, DayCapacity, 0, 0};
+    memset(open, 0, sizeof(open));
+}
+
+void TemperatureHistory::Add(uint32_t UptimeMinute, const float *TempC)
+{
+    HistorySample &Sample = raw[rawHead];
+    Sample.Minute = UptimeMinute;
+    for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+    {
+        Sample.Value[i] = TempC[i] > -127 ? (int16_t)lroundf(TempC[i] * 100) : HISTORY_INVALID;
+    }
+    rawHead = (rawHead + 1) % rawCapacity;
+    if (rawCount < rawCapacity)
+    {
+        rawCount++;
+    }
+
+    Accumulate(open[0], rings[0], UptimeMinute / 60, Sample.Value);
+    Accumulate(open[1], rings[1], UptimeMinute / (24 * 60), Sample.Value);
+}
+
+void TemperatureHistory::Accumulate(Accumulator &Open, Ring &Closed, uint16_t Period, const int16_t *Values)
+{
+    if (Open.Open && Open.Period != Period)
+    {
+        HistoryRollup &Rollup = Closed.Records[Closed.Head];
+        Rollup.Period = Open.Period;
+        for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+        {
+            bool Valid = Open.Samples[i] > 0;
+            Rollup.Min[i] = Valid ? Open.Min[i] : HISTORY_INVALID;
+            Rollup.Max[i] = Valid ? Open.Max[i] : HISTORY_INVALID;
+            Rollup.Avg[i] = Valid ? (int16_t)lroundf((float)Open.Sum[i] / Open.Samples[i]) : HISTORY_INVALID;
+        }
+        Closed.Head = (Closed.Head + 1) % Closed.Capacity;
+        if (Closed.Count < Closed.Capacity)
+        {
+            Closed.Count++;
+        }
+        Open.Open = false;
+    }
+
+    if (!Open.Open)
+    {
+        Open.Open = true;
+        Open.Period = Period;
+        for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+        {
+            Open.Min[i] = INT16_MAX;
+            Open.Max[i] = INT16_MIN;
+            Open.Sum[i] = 0;
+            Open.Samples[i] = 0;
+        }
+    }
+
+    for (uint8_t i = 0; i < HISTORY_CHANNELS; i++)
+    {
+        if (Values[i] == HISTORY_INVALID)
+        {
+            continue;
+        }
+        Open.Min[i] = Values[i] < Open.Min[i] ? Values[i] : Open.Min[i];
+        Open.Max[i] = Values[i] > Open.Max[i] ? Values[i] : Open.Max[i];
+        Open.Sum[i] += Values[i];
+        Open.Samples[i]++;
+    }
+}
+
+uint16_t TemperatureHistory::Count(HistoryTier Tier) const
+{
+    switch (Tier)
+    {
+    case HistoryRaw:
+        return rawCount;
+    case HistoryHours:
+    case HistoryDays:
+        return rings[Tier - HistoryHours].Count;
+    default:
+        return 0;
+    }
+}
+
+uint16_t TemperatureHistory::Chunks(HistoryTier Tier) const
+{
+    return (Count(Tier) + HISTORY_CHUNK_RECORDS - 1) / HISTORY_CHUNK_RECORDS;
+}
+
+const HistorySample &TemperatureHistory::Sample(uint16_t Age) const
+{
+    return raw[(rawHead + rawCapacity - 1 - Age) % rawCapacity];
+}
+
+const HistoryRollup &TemperatureHistory::Rollup(HistoryTier Tier, uint16_t Age) const
+{
+    const Ring &Closed = rings[Tier - HistoryHours];
+    return Closed.Records[(Closed.Head + Closed.Capacity - 1 - Age) % Closed.Capacity];
+}
+
+size_t TemperatureHistory::MemoryBytes() const
+{
+    return rawCapacity * sizeof(HistorySample) + (rings[0].Capacity + rings[1].Capacity) * sizeof(HistoryRollup);
+}
+
+// Appends Value - Previous as zigzag varint, false if Out is full
+static bool PutDelta(uint8_t *Out, size_t Size, size_t &Used, int32_t Value, int32_t &Previous)
+{
+    int32_t Delta = Value - Previous;
+    uint32_t Zigzag = ((uint32_t)Delta << 1) ^ (uint32_t)(Delta >> 31);
+    Previous = Value;
+    do
+    {
+        if (Used >= Size)
+        {
+            return false;
+        }
+        Out[Used++] = (Zigzag & 0x7F) | (Zigzag > 0x7F ? 0x80 : 0);
+        Zigzag >>= 7;
+    } while (Zigzag);
+    return true;
+}
+
+size_t TemperatureHistory::Encode(HistoryTier Tier, uint16_t Chunk, uint8_t *Out, size_t Size) const
+{
+    uint16_t Total = Count(Tier);
+    uint32_t Newest = (uint32_t)Chunk * HISTORY_CHUNK_RECORDS;
+    if (Newest >= Total)
+    {
+        return 0;
+    }
+    uint16_t Records = Total - Newest < HISTORY_CHUNK_RECORDS ? Total - Newest : HISTORY_CHUNK_RECORDS;
+
+    const uint8_t Fields = Tier == HistoryRaw ? HISTORY_CHANNELS : 3 * HISTORY_CHANNELS;
+    int32_t Previous[1 + 3 * HISTORY_CHANNELS] = {0};
+    size_t Used = 0;
+    for (uint16_t Age = Newest + Records; Age-- > Newest;)
+    {
+        int32_t Period;
+        int16_t Values[3 * HISTORY_CHANNELS];
+        if (Tier == HistoryRaw)
+        {
+            Period = Sample(Age).Minute;
+            memcpy(Values, Sample(Age).Value, sizeof(Sample(Age).Value));
+        }
+        else
+        {
+            const HistoryRollup &Record = Rollup(Tier, Age);
+            Period = Record.Period;
+            memcpy(Values, Record.Min, sizeof(Record.Min));
+            memcpy(Values + HISTORY_CHANNELS, Record.Max, sizeof(Record.Max));
+            memcpy(Values + 2 * HISTORY_CHANNELS, Record.Avg, sizeof(Record.Avg));
+        }
+        if (!PutDelta(Out, Size, Used, Period, Previous[0]))
+        {
+            return 0;
+        }
+        for (uint8_t i = 0; i < Fields; i++)
+        {
+            if (!PutDelta(Out, Size, Used, Values[i], Previous[1 + i]))
+            {
+                return 0;
+            }
+        }
+    }
+    return Used;
+}
+
+size_t TemperatureHistory::Export(HistoryTier Tier, uint16_t Chunk, uint8_t *Out, size_t Size) const
+{
+    uint8_t Plain[HISTORY_CHUNK_ENCODED_MAX];
+    size_t Length = Encode(Tier, Chunk, Plain, sizeof(Plain));
+    if (!Length)
+    {
+        return 0;
+    }
+    return StaticDeflate(Plain, Length, Out, Size);
+}
@@ -0,0 +1,96 @@
+#ifndef TemperatureHistory_H
+#define TemperatureHistory_H
+
+#include <Arduino.h>
+#include "StaticDeflate.h"
+
+#define HISTORY_CHANNELS 4
+#define HISTORY_INVALID INT16_MIN // no valid reading in this slot
+#define HISTORY_CHUNK_RECORDS 32   // records per exported chunk
+// Encoded chunk worst case: a 3 byte period and 3 bytes per value per record
+#define HISTORY_CHUNK_ENCODED_MAX (HISTORY_CHUNK_RECORDS * 3 * (1 + 3 * HISTORY_CHANNELS))
+#define HISTORY_EXPORT_MAX STATIC_DEFLATE_BOUND(HISTORY_CHUNK_ENCODED_MAX) // Export() never needs more
+
+enum HistoryTier : uint8_t
+{
+    HistoryRaw,
+    HistoryHours,
+    HistoryDays,
+    HistoryTiers
+};
+
+// One measurement cycle, temperatures in 1/100 °C
+struct HistorySample
+{
+    uint16_t Minute; // uptime minute, wraps after 45 days
+    int16_t Value[HISTORY_CHANNELS];
+};
+
+// Min/max/average of one hour or day, in 1/100 °C
+struct HistoryRollup
+{
+    uint16_t Period; // uptime hour or day
+    int16_t Min[HISTORY_CHANNELS];
+    int16_t Max[HISTORY_CHANNELS];
+    int16_t Avg[HISTORY_CHANNELS];
+};
+
+// Fixed-size temperature history: a ring of raw samples plus rings of
+// hourly and daily rollups. Add() updates the open hour and day in O(1)
+// and closes them into their ring when the period changes. The caller
+// owns the rings, so their sizes set the memory budget.
+class TemperatureHistory
+{
+public:
+    TemperatureHistory(HistorySample *Raw, uint16_t RawCapacity, HistoryRollup *Hours, uint16_t HourCapacity,
+                       HistoryRollup *Days, uint16_t DayCapacity);
+
+    // TempC at or below -127 (read error) is stored as HISTORY_INVALID
+    void Add(uint32_t UptimeMinute, const float *TempC);
+
+    // Stored records, without the hour and day still open
+    uint16_t Count(HistoryTier Tier) const;
+    uint16_t Chunks(HistoryTier Tier) const;
+    // Age 0 is the newest record
+    const HistorySample &Sample(uint16_t Age) const;
+    const HistoryRollup &Rollup(HistoryTier Tier, uint16_t Age) const;
+    size_t MemoryBytes() const;
+
+    // Chunk 0 holds the newest HISTORY_CHUNK_RECORDS records, oldest first.
+    // Each record is its period followed by its values (4 raw or 12 rollup:
+    // min, max, avg per channel), every field as a zigzag varint of the
+    // difference to the same field of the previous record. Returns the
+    // length, 0 if the chunk does not exist or Out is too small.
+    size_t Encode(HistoryTier Tier, uint16_t Chunk, uint8_t *Out, size_t Size) const;
+    // Encode() deflated into a zlib stream (StaticDeflate, no heap)
+    size_t Export(HistoryTier Tier, uint16_t Chunk, uint8_t *Out, size_t Size) const;
+
+private:
+    struct Accumulator
+    {
+        uint16_t Period;
+        bool Open;
+        int16_t Min[HISTORY_CHANNELS];
+        int16_t Max[HISTORY_CHANNELS];
+        int32_t Sum[HISTORY_CHANNELS];
+        uint16_t Samples[HISTORY_CHANNELS];
+    };
+    struct Ring
+    {
+        HistoryRollup *Records;
+        uint16_t Capacity;
+        uint16_t Head; // next slot to write
+        uint16_t Count;
+    };
+
+    static void Accumulate(Accumulator &Open, Ring &Closed, uint16_t Period, const int16_t *Values);
+
+    HistorySample *raw;
+    uint16_t rawCapacity;
+    uint16_t rawHead;
+    uint16_t rawCount;
+    Ring rings[2]; // hours, days
+    Accumulator open[2];
+};
+
+#endif
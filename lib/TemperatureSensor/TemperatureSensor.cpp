@@ -0,0 +1,259 @@
+#include "TemperatureSensor.h"
+#include "HotPathStats.h"
+
+TemperatureSensorManager::TemperatureSensorManager(DallasTemperature &Bus, uint8_t Resolution, uint32_t IntervalMs, TemperatureReadingFunction Reading)
+    : bus(Bus), resolution(Resolution), interval(IntervalMs), reading(Reading), count(0), converting(false), requestNow(true), rediscover(false),
+      pending(0), attempt(0), cycleStart(0), conversionStart(0), conversionWait(0), cycles(0), retries(0), failures(0), waitMs(0)
+{
+    memset(roleBound, 0, sizeof(roleBound));
+}
+
+uint8_t TemperatureSensorManager::Discover()
+{
+    // begin() runs the OneWire search
+    bus.begin();
+    count = 0;
+    uint8_t Found = bus.getDeviceCount();
+    for (uint8_t i = 0; i < Found && count < TEMPERATURE_MAX_SENSORS; i++)
+    {
+        if (bus.getAddress(addresses[count], i))
+        {
+            bus.setResolution(addresses[count], resolution);
+            count++;
+        }
+    }
+    bus.setWaitForConversion(false);
+
+    // One role without its sensor and one unknown sensor: the probe was replaced
+    uint8_t MissingRole = TEMPERATURE_NO_ROLE, Missing = 0;
+    for (uint8_t Role = 0; Role < TEMPERATURE_MAX_ROLES; Role++)
+    {
+        bool Present = false;
+        for (uint8_t i = 0; i < count && roleBound[Role] && !Present; i++)
+        {
+            Present = !memcmp(addresses[i], roles[Role], sizeof(DeviceAddress));
+        }
+        if (roleBound[Role] && !Present)
+        {
+            MissingRole = Role;
+            Missing++;
+        }
+    }
+    uint8_t Unknown = TEMPERATURE_MAX_SENSORS, Unassigned = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (RoleOfSensor(i) == TEMPERATURE_NO_ROLE)
+        {
+            Unknown = i;
+            Unassigned++;
+        }
+    }
+    if (Missing == 1 && Unassigned == 1)
+    {
+        SetRole(MissingRole, addresses[Unknown]);
+    }
+    return count;
+}
+
+void TemperatureSensorManager::SetRole(uint8_t Role, const uint8_t *Address)
+{
+    if (Role >= TEMPERATURE_MAX_ROLES)
+    {
+        return;
+    }
+    memcpy(roles[Role], Address, sizeof(DeviceAddress));
+    roleBound[Role] = true;
+}
+
+const uint8_t *TemperatureSensorManager::RoleAddress(uint8_t Role) const
+{
+    return Role < TEMPERATURE_MAX_ROLES && roleBound[Role] ? roles[Role] : nullptr;
+}
+
+uint8_t TemperatureSensorManager::RoleOfSensor(uint8_t Index) const
+{
+    for (uint8_t Role = 0; Role < TEMPERATURE_MAX_ROLES; Role++)
+    {
+        if (roleBound[Role] && !memcmp(addresses[Index], roles[Role], sizeof(DeviceAddress)))
+        {
+            return Role;
+        }
+    }
+    return TEMPERATURE_NO_ROLE;
+}
+
+bool TemperatureSensorManager::Loop()
+{
+    if (!converting)
+    {
+        if (!requestNow && millis() - cycleStart < interval)
+        {
+            return false;
+        }
+        if (rediscover)
+        {
+            rediscover = false;
+            Discover();
+        }
+        requestNow = false;
+        cycleStart = millis();
+        attempt = 0;
+        StartConversion(count >= 8 ? 0xFF : (1 << count) - 1);
+        return false;
+    }
+
+    if (millis() - conversionStart < conversionWait)
+    {
+        return false;
+    }
+    waitMs += conversionWait;
+    ReadSensors();
+    return !converting;
+}
+
+uint32_t TemperatureSensorManager::NextDueMs() const
+{
+    unsigned long Start = converting ? conversionStart : cycleStart;
+    uint32_t Wait = converting ? conversionWait : interval;
+    unsigned long Elapsed = millis() - Start;
+    return (!converting && requestNow) || Elapsed >= Wait ? 0 : Wait - Elapsed;
+}
+
+void TemperatureSensorManager::StartConversion(uint8_t Sensors)
+{
+    STATS_SCOPE(StatsOneWire);
+    pending = Sensors;
+    converting = true;
+    conversionStart = millis();
+
+    if (attempt == 0)
+    {
+        // All sensors share the resolution, one Convert T for the whole bus
+        bus.requestTemperatures();
+    }
+    else
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (pending & (1 << i))
+            {
+                bus.requestTemperaturesByAddress(addresses[i]);
+            }
+        }
+    }
+    conversionWait = bus.millisToWaitForConversion(resolution);
+}
+
+void TemperatureSensorManager::ReadSensors()
+{
+    STATS_SCOPE(StatsOneWire);
+    uint8_t Failed = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (!(pending & (1 << i)))
+        {
+            continue;
+        }
+        float TempC = bus.getTempC(addresses[i]);
+        if (TempC == DEVICE_DISCONNECTED_C || TempC == TEMPERATURE_POWER_ON_C)
+        {
+            Failed |= 1 << i;
+            continue;
+        }
+        uint8_t Role = RoleOfSensor(i);
+        if (Role != TEMPERATURE_NO_ROLE)
+        {
+            reading(Role, TempC);
+        }
+    }
+
+    if (Failed && attempt < TEMPERATURE_RETRIES)
+    {
+        attempt++;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            retries += (Failed >> i) & 1;
+        }
+        StartConversion(Failed);
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (Failed & (1 << i))
+        {
+            failures++;
+            uint8_t Role = RoleOfSensor(i);
+            if (Role != TEMPERATURE_NO_ROLE)
+            {
+                reading(Role, DEVICE_DISCONNECTED_C);
+            }
+        }
+    }
+
+    // Roles whose sensor is not on the bus at all
+    for (uint8_t Role = 0; Role < TEMPERATURE_MAX_ROLES; Role++)
+    {
+        bool Present = false;
+        for (uint8_t i = 0; i < count && !Present; i++)
+        {
+            Present = RoleOfSensor(i) == Role;
+        }
+        if (roleBound[Role] && !Present)
+        {
+            reading(Role, DEVICE_DISCONNECTED_C);
+            rediscover = true;
+        }
+    }
+    // A sensor that keeps failing may have been unplugged, search again
+    rediscover |= Failed != 0;
+
+    converting = false;
+    cycles++;
+}
+
+bool TemperatureSensorManager::ParseAddress(const char *Hex, uint8_t *Address)
+{
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        char c = Hex[i];
+        uint8_t Nibble;
+        if (c >= '0' && c <= '9')
+        {
+            Nibble = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            Nibble = c - 'a' + 10;
+        }
+        else if (c >= 'A' && c <= 'F')
+        {
+            Nibble = c - 'A' + 10;
+        }
+        else
+        {
+            return false;
+        }
+        Address[i / 2] = (i & 1) ? (Address[i / 2] | Nibble) : (Nibble << 4);
+    }
+    return Hex[16] == 0;
+}
+
+void TemperatureSensorManager::FormatAddress(const uint8_t *Address, char *Hex)
+{
+    static const char Digits[] = "0123456789ABCDEF";
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        Hex[i * 2] = Digits[Address[i] >> 4];
+        Hex[i * 2 + 1] = Digits[Address[i] & 0x0F];
+    }
+    Hex[16] = 0;
+}
+
+void TemperatureSensorManager::ResetStats()
+{
+    cycles = 0;
+    retries = 0;
+    failures = 0;
+    waitMs = 0;
+}
@@ -5,23 +5,82 @@
 #include <DallasTemperature.h>
 #include <OneWire.h>
 
-#define ONE_WIRE_BUS 16
-#define TEMPERATURE_PRECISION 12
+#define TEMPERATURE_MAX_SENSORS 8
+#define TEMPERATURE_MAX_ROLES 4
+#define TEMPERATURE_RETRIES 2 // extra conversions for sensors that read -127 or 85
+#define TEMPERATURE_NO_ROLE 0xFF
+#define TEMPERATURE_POWER_ON_C 85 // scratchpad value if no conversion happened
 
-//Temperature definitions
-DeviceAddress WaterThermometer = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
-DeviceAddress VorlaufThermometer = {0x28, 0x52, 0x04, 0xE8, 0x50, 0x20, 0x01, 0xF0};
-DeviceAddress RucklaufThermometer = {0x28, 0x47, 0x53, 0xF2, 0x50, 0x20, 0x01, 0xA7};
-DeviceAddress GarageRoofThermometer = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
-float WaterThermometerValue, VorlaufThermometerValue, RucklaufThermometerValue, GarageRoofThermometerValue;
-const long durationTemp = 1 * 60 * 1000; //The frequency of temperature measurement
-bool NewTemperatures = false;
+// Called for every sensor with a role once per cycle. TempC is
+// DEVICE_DISCONNECTED_C if the sensor still failed after the retries.
+typedef void (*TemperatureReadingFunction)(uint8_t Role, float TempC);
 
-void readSensor();
-void startConversion();
+// Discovers the DS18B20s on a OneWire bus and reads them without blocking.
+// Roles (water, roof, ...) are bound to sensor addresses at run time; a
+// role whose sensor disappeared is taken over by the only unknown sensor
+// on the bus, so swapping a probe needs no rebuild. The conversion wait
+// follows the configured resolution, and sensors reading -127 (CRC error
+// or disconnected) or 85 (no conversion) are converted again.
+class TemperatureSensorManager
+{
+public:
+    TemperatureSensorManager(DallasTemperature &Bus, uint8_t Resolution, uint32_t IntervalMs, TemperatureReadingFunction Reading);
 
-OneWire oneWire(ONE_WIRE_BUS);
+    // Searches the bus, sets the resolution and rebinds missing roles
+    uint8_t Discover();
+    void SetRole(uint8_t Role, const uint8_t *Address);
+    // Address bound to a role, nullptr if none
+    const uint8_t *RoleAddress(uint8_t Role) const;
+    // Starts a cycle on the next Loop() instead of waiting for the interval
+    void RequestNow() { requestNow = true; }
+    // Returns true when a measurement cycle has finished
+    bool Loop();
+    // Milliseconds until Loop() talks to the bus again
+    uint32_t NextDueMs() const;
 
-DallasTemperature sensors(&oneWire);
+    uint8_t Count() const { return count; }
+    const uint8_t *Address(uint8_t Index) const { return addresses[Index]; }
+    // Role of a discovered sensor, TEMPERATURE_NO_ROLE if unassigned
+    uint8_t RoleOfSensor(uint8_t Index) const;
 
-#endif
\ No newline at end of file
+    // 16 hex digits, most significant (family code) first
+    static bool ParseAddress(const char *Hex, uint8_t *Address);
+    static void FormatAddress(const uint8_t *Address, char *Hex);
+
+    uint32_t Cycles() const { return cycles; }
+    uint32_t Retries() const { return retries; }
+    uint32_t Failures() const { return failures; }
+    // Time spent waiting for conversions, the bus is idle otherwise
+    uint32_t WaitMs() const { return waitMs; }
+    void ResetStats();
+
+private:
+    void StartConversion(uint8_t Sensors);
+    void ReadSensors();
+
+    DallasTemperature &bus;
+    uint8_t resolution;
+    uint32_t interval;
+    TemperatureReadingFunction reading;
+
+    DeviceAddress addresses[TEMPERATURE_MAX_SENSORS];
+    uint8_t count;
+    DeviceAddress roles[TEMPERATURE_MAX_ROLES];
+    bool roleBound[TEMPERATURE_MAX_ROLES];
+
+    bool converting;
+    bool requestNow;
+    bool rediscover;
+    uint8_t pending; // bit per discovered sensor
+    uint8_t attempt;
+    unsigned long cycleStart;
+    unsigned long conversionStart;
+    uint16_t conversionWait;
+
+    uint32_t cycles;
+    uint32_t retries;
+    uint32_t failures;
+    uint32_t waitMs;
+};
+
+#endif
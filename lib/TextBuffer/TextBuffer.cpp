@@ -0,0 +1,86 @@
+#include "TextBuffer.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+TextBuffer::TextBuffer(char *Storage, size_t Capacity)
+    : data(Storage), capacity(Capacity), length(0), truncated(false)
+{
+    data[0] = 0;
+}
+
+void TextBuffer::Clear()
+{
+    length = 0;
+    truncated = false;
+    data[0] = 0;
+}
+
+TextBuffer &TextBuffer::Append(const char *Text)
+{
+    return Append(Text, strlen(Text));
+}
+
+TextBuffer &TextBuffer::Append(const char *Data, size_t Length)
+{
+    if (Length > Free())
+    {
+        Length = Free();
+        truncated = true;
+    }
+    memcpy(data + length, Data, Length);
+    Commit(Length);
+    return *this;
+}
+
+TextBuffer &TextBuffer::Printf(const char *Format, ...)
+{
+    va_list Args;
+    va_start(Args, Format);
+    int Written = vsnprintf(Tail(), Free() + 1, Format, Args);
+    va_end(Args);
+    if (Written < 0)
+    {
+        data[length] = 0;
+        truncated = true;
+    }
+    else if ((size_t)Written > Free())
+    {
+        truncated = true;
+        length = capacity - 1;
+    }
+    else
+    {
+        length += Written;
+    }
+    return *this;
+}
+
+TextBuffer &TextBuffer::AppendHex(const uint8_t *Bytes, size_t Count, char Separator)
+{
+    static const char HexDigits[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < Count; i++)
+    {
+        char Hex[3] = {Separator, HexDigits[Bytes[i] >> 4], HexDigits[Bytes[i] & 0x0F]};
+        if (i == 0 || !Separator)
+        {
+            Append(Hex + 1, 2);
+        }
+        else
+        {
+            Append(Hex, 3);
+        }
+    }
+    return *this;
+}
+
+void TextBuffer::Commit(size_t Written)
+{
+    if (Written > Free())
+    {
+        Written = Free();
+        truncated = true;
+    }
+    length += Written;
+    data[length] = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef TextBuffer_H
+#define TextBuffer_H
+
+#include <Arduino.h>
+
+// Builds a message in caller-provided storage instead of concatenating
+// Strings. Appends stop at the capacity and set Truncated(); the text
+// stays NUL terminated, binary parts may contain NULs of their own.
+class TextBuffer
+{
+public:
+    TextBuffer(char *Storage, size_t Capacity);
+
+    void Clear();
+    TextBuffer &Append(const char *Text);
+    TextBuffer &Append(const char *Data, size_t Length);
+    TextBuffer &Printf(const char *Format, ...) __attribute__((format(printf, 2, 3)));
+    // Bytes as two upper case hex digits each, Separator between them (0 for none)
+    TextBuffer &AppendHex(const uint8_t *Bytes, size_t Count, char Separator);
+
+    // Space after the text, for serializers writing into the buffer
+    // directly; Commit() takes over what they wrote
+    char *Tail() { return data + length; }
+    size_t Free() const { return capacity - 1 - length; }
+    void Commit(size_t Written);
+
+    const char *c_str() const { return data; }
+    size_t Length() const { return length; }
+    bool Truncated() const { return truncated; }
+
+private:
+    char *data;
+    size_t capacity;
+    size_t length;
+    bool truncated;
+};
+
+#endif
@@ -0,0 +1,348 @@
+#include "TimerWheel.h"
+
+// Bits of the expiry time that select the slot within a level
+static inline uint16_t LevelSlot(uint32_t Time, uint8_t Level)
+{
+    return (Time >> (TIMER_ROOT_BITS + Level * TIMER_LEVEL_BITS)) & (TIMER_LEVEL_SLOTS - 1);
+}
+
+TimerWheel::TimerWheel(TimerSlot *Slots, uint16_t Capacity)
+    : slots(Slots), capacity(Capacity < None ? Capacity : None - 1), freeList(None), clock(0), started(false),
+      armed(0), highWater(0), fired(0), failures(0), maxLate(0), totalLate(0)
+{
+    for (uint16_t i = 0; i < TIMER_BUCKETS; i++)
+    {
+        heads[i] = None;
+    }
+    for (uint16_t i = capacity; i-- > 0;)
+    {
+        slots[i].Generation = 0;
+        slots[i].Bucket = None;
+        slots[i].Next = freeList;
+        freeList = i;
+    }
+}
+
+TimerHandle TimerWheel::Schedule(uint32_t DelayMs, TimerFunction Function, void *Context, uint32_t PeriodMs)
+{
+    if (freeList == None)
+    {
+        failures++;
+        return 0;
+    }
+    if (!started)
+    {
+        clock = millis();
+        started = true;
+    }
+
+    uint16_t Index = freeList;
+    TimerSlot &Slot = slots[Index];
+    freeList = Slot.Next;
+    Slot.Function = Function;
+    Slot.Context = Context;
+    Slot.Expires = millis() + DelayMs;
+    Slot.Period = PeriodMs;
+    Insert(Index);
+
+    armed++;
+    highWater = armed > highWater ? armed : highWater;
+    return (uint32_t)Slot.Generation << 16 | (Index + 1);
+}
+
+TimerHandle TimerWheel::Schedule(uint32_t DelayMs, TimerPlainFunction Function, uint32_t PeriodMs)
+{
+    return Schedule(DelayMs, CallPlain, (void *)Function, PeriodMs);
+}
+
+void TimerWheel::CallPlain(void *Function)
+{
+    ((TimerPlainFunction)Function)();
+}
+
+TimerSlot *TimerWheel::Lookup(TimerHandle Handle) const
+{
+    uint16_t Index = (Handle & 0xFFFF) - 1;
+    if (!Handle || Index >= capacity)
+    {
+        return nullptr;
+    }
+    TimerSlot *Slot = &slots[Index];
+    return Slot->Generation == Handle >> 16 && Slot->Bucket != None ? Slot : nullptr;
+}
+
+bool TimerWheel::Active(TimerHandle Handle) const
+{
+    return Lookup(Handle) != nullptr;
+}
+
+bool TimerWheel::Cancel(TimerHandle &Handle)
+{
+    TimerSlot *Slot = Lookup(Handle);
+    Handle = 0;
+    if (!Slot)
+    {
+        return false;
+    }
+    uint16_t Index = Slot - slots;
+    if (Slot->Bucket != Running)
+    {
+        Unlink(Index);
+    }
+    Release(Index);
+    return true;
+}
+
+bool TimerWheel::Reschedule(TimerHandle Handle, uint32_t DelayMs)
+{
+    TimerSlot *Slot = Lookup(Handle);
+    if (!Slot)
+    {
+        return false;
+    }
+    uint16_t Index = Slot - slots;
+    if (Slot->Bucket != Running)
+    {
+        Unlink(Index);
+    }
+    Slot->Expires = millis() + DelayMs;
+    Insert(Index);
+    return true;
+}
+
+bool TimerWheel::Arm(TimerHandle &Handle, uint32_t DelayMs, TimerFunction Function, void *Context)
+{
+    TimerSlot *Slot = Lookup(Handle);
+    if (Slot && Slot->Function == Function && Slot->Context == Context)
+    {
+        return Reschedule(Handle, DelayMs);
+    }
+    Cancel(Handle);
+    Handle = Schedule(DelayMs, Function, Context);
+    return Handle != 0;
+}
+
+bool TimerWheel::Arm(TimerHandle &Handle, uint32_t DelayMs, TimerPlainFunction Function)
+{
+    return Arm(Handle, DelayMs, CallPlain, (void *)Function);
+}
+
+void TimerWheel::Insert(uint16_t Index)
+{
+    uint32_t Expires = slots[Index].Expires;
+    int32_t Delta = (int32_t)(Expires - clock);
+    uint16_t Bucket;
+    if (Delta < 0)
+    {
+        // Already due: the next tick picks it up
+        Bucket = clock & (TIMER_ROOT_SLOTS - 1);
+    }
+    else if (Delta < TIMER_ROOT_SLOTS)
+    {
+        Bucket = Expires & (TIMER_ROOT_SLOTS - 1);
+    }
+    else
+    {
+        uint8_t Level = 0;
+        while (Level < TIMER_LEVELS - 1 && (uint32_t)Delta >= 1UL << (TIMER_ROOT_BITS + (Level + 1) * TIMER_LEVEL_BITS))
+        {
+            Level++;
+        }
+        Bucket = TIMER_ROOT_SLOTS + Level * TIMER_LEVEL_SLOTS + LevelSlot(Expires, Level);
+    }
+    Link(Index, Bucket);
+}
+
+void TimerWheel::Link(uint16_t Index, uint16_t Bucket)
+{
+    TimerSlot &Slot = slots[Index];
+    Slot.Bucket = Bucket;
+    Slot.Prev = None;
+    Slot.Next = heads[Bucket];
+    if (Slot.Next != None)
+    {
+        slots[Slot.Next].Prev = Index;
+    }
+    heads[Bucket] = Index;
+}
+
+void TimerWheel::Unlink(uint16_t Index)
+{
+    TimerSlot &Slot = slots[Index];
+    if (Slot.Prev != None)
+    {
+        slots[Slot.Prev].Next = Slot.Next;
+    }
+    else
+    {
+        heads[Slot.Bucket] = Slot.Next;
+    }
+    if (Slot.Next != None)
+    {
+        slots[Slot.Next].Prev = Slot.Prev;
+    }
+}
+
+void TimerWheel::Release(uint16_t Index)
+{
+    TimerSlot &Slot = slots[Index];
+    Slot.Generation++;
+    Slot.Bucket = None;
+    Slot.Next = freeList;
+    freeList = Index;
+    armed--;
+}
+
+bool TimerWheel::Cascade(uint8_t Level)
+{
+    // Re-sort one outer slot into the finer levels, true if it was slot 0
+    uint16_t Slot = LevelSlot(clock, Level);
+    uint16_t Bucket = TIMER_ROOT_SLOTS + Level * TIMER_LEVEL_SLOTS + Slot;
+    uint16_t Index = heads[Bucket];
+    heads[Bucket] = None;
+    while (Index != None)
+    {
+        uint16_t Next = slots[Index].Next;
+        Insert(Index);
+        Index = Next;
+    }
+    return Slot == 0;
+}
+
+bool TimerWheel::OuterArmed() const
+{
+    for (uint16_t Bucket = TIMER_ROOT_SLOTS + TIMER_LEVEL_SLOTS; Bucket < TIMER_BUCKETS; Bucket++)
+    {
+        if (heads[Bucket] != None)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t TimerWheel::NextDueMs() const
+{
+    if (!armed)
+    {
+        return UINT32_MAX;
+    }
+    if (!started)
+    {
+        return 0;
+    }
+
+    // Root slots hold the timers due before the root wheel wraps
+    const uint32_t Mask = TIMER_ROOT_SLOTS - 1;
+    uint32_t Wrap = (clock | Mask) + 1;
+    uint32_t Due = clock;
+    while (Due != Wrap && heads[Due & Mask] == None)
+    {
+        Due++;
+    }
+
+    // Level 0 moves in one slot per wrap. Advance() catches up tick by tick,
+    // so sleeping over a wrap is fine unless that wrap cascades an outer level.
+    bool Found = Due != Wrap;
+    bool Outer = OuterArmed();
+    uint32_t Cascade = (clock & Mask) ? Wrap : clock;
+    for (uint8_t i = 0; i < TIMER_LEVEL_SLOTS; i++, Cascade += TIMER_ROOT_SLOTS)
+    {
+        if (Found && (int32_t)(Cascade - Due) >= 0)
+        {
+            break;
+        }
+        uint16_t Index = heads[TIMER_ROOT_SLOTS + LevelSlot(Cascade, 0)];
+        if (Index != None)
+        {
+            uint32_t First = slots[Index].Expires;
+            for (; Index != None; Index = slots[Index].Next)
+            {
+                First = (int32_t)(slots[Index].Expires - First) < 0 ? slots[Index].Expires : First;
+            }
+            Due = Found && (int32_t)(Due - First) < 0 ? Due : First;
+            Found = true;
+            break;
+        }
+        if (Outer && LevelSlot(Cascade, 0) == 0)
+        {
+            Due = Found && (int32_t)(Due - Cascade) < 0 ? Due : Cascade;
+            Found = true;
+            break;
+        }
+    }
+    if (!Found)
+    {
+        return UINT32_MAX;
+    }
+
+    int32_t Wait = (int32_t)(Due - millis());
+    return Wait > 0 ? Wait : 0;
+}
+
+void TimerWheel::Advance(uint32_t Now)
+{
+    if (!started)
+    {
+        clock = Now;
+        started = true;
+    }
+
+    while ((int32_t)(Now - clock) >= 0)
+    {
+        uint16_t Bucket = clock & (TIMER_ROOT_SLOTS - 1);
+        if (Bucket == 0)
+        {
+            for (uint8_t Level = 0; Level < TIMER_LEVELS && Cascade(Level); Level++)
+            {
+            }
+        }
+        clock++;
+
+        // Callbacks may schedule or cancel, so take one timer at a time
+        while (heads[Bucket] != None)
+        {
+            uint16_t Index = heads[Bucket];
+            TimerSlot &Slot = slots[Index];
+            Unlink(Index);
+            Slot.Bucket = Running;
+            uint16_t Generation = Slot.Generation;
+
+            uint32_t Late = Now - Slot.Expires;
+            fired++;
+            totalLate += Late;
+            maxLate = Late > maxLate ? Late : maxLate;
+
+            Slot.Function(Slot.Context);
+
+            // Cancelled or rescheduled from its own callback
+            if (Slot.Generation != Generation || Slot.Bucket != Running)
+            {
+                continue;
+            }
+            if (Slot.Period)
+            {
+                // Keep the phase, but never queue up missed periods
+                Slot.Expires += Slot.Period;
+                if ((int32_t)(Slot.Expires - Now) <= 0)
+                {
+                    Slot.Expires = Now + Slot.Period;
+                }
+                Insert(Index);
+            }
+            else
+            {
+                Release(Index);
+            }
+        }
+    }
+}
+
+void TimerWheel::ResetStats()
+{
+    highWater = armed;
+    fired = 0;
+    failures = 0;
+    maxLate = 0;
+    totalLate = 0;
+}
@@ -0,0 +1,101 @@
+#ifndef TimerWheel_H
+#define TimerWheel_H
+
+#include <Arduino.h>
+
+// Wheel geometry in 1 ms ticks: 256 slots for the next 256 ms, then four
+// levels of 64 slots, together covering the full 32 bit millis() range
+#define TIMER_ROOT_BITS 8
+#define TIMER_LEVEL_BITS 6
+#define TIMER_LEVELS 4
+#define TIMER_ROOT_SLOTS (1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SLOTS (1 << TIMER_LEVEL_BITS)
+#define TIMER_BUCKETS (TIMER_ROOT_SLOTS + TIMER_LEVELS * TIMER_LEVEL_SLOTS)
+
+// 0 is never a valid handle
+typedef uint32_t TimerHandle;
+typedef void (*TimerFunction)(void *Context);
+typedef void (*TimerPlainFunction)();
+
+// Timer storage, provided by the caller (one per concurrently armed timer)
+struct TimerSlot
+{
+    TimerFunction Function;
+    void *Context;
+    uint32_t Expires; // millis() when due
+    uint32_t Period;  // 0 for one-shot timers
+    uint16_t Next;
+    uint16_t Prev;
+    uint16_t Bucket; // list the slot is linked into
+    uint16_t Generation;
+};
+
+// Hierarchical timer wheel (Varghese & Lauck, as in the classic Linux
+// timer code). Schedule, Cancel and Reschedule are O(1) through handles
+// that carry a generation, so a stale handle never hits a reused slot.
+// Loop() advances one tick per elapsed millisecond and cascades the outer
+// levels every 256 ticks. Times compare by difference, so the millis()
+// wrap after 49.7 days is harmless.
+class TimerWheel
+{
+public:
+    TimerWheel(TimerSlot *Slots, uint16_t Capacity);
+
+    // Returns 0 if all slots are in use (counted in Failures())
+    TimerHandle Schedule(uint32_t DelayMs, TimerFunction Function, void *Context = nullptr, uint32_t PeriodMs = 0);
+    TimerHandle Schedule(uint32_t DelayMs, TimerPlainFunction Function, uint32_t PeriodMs = 0);
+    // Both clear Handle if the timer is gone; false for a stale handle
+    bool Cancel(TimerHandle &Handle);
+    // Moves an armed timer to DelayMs from now
+    bool Reschedule(TimerHandle Handle, uint32_t DelayMs);
+    // Restarts Handle if it is still armed, schedules a new timer otherwise
+    bool Arm(TimerHandle &Handle, uint32_t DelayMs, TimerFunction Function, void *Context = nullptr);
+    bool Arm(TimerHandle &Handle, uint32_t DelayMs, TimerPlainFunction Function);
+    bool Active(TimerHandle Handle) const;
+
+    void Loop() { Advance(millis()); }
+    // Runs every timer due at or before Now
+    void Advance(uint32_t Now);
+    // Milliseconds until the next timer is due (or an outer level cascades),
+    // UINT32_MAX if nothing is armed. Scans one turn of the root wheel and
+    // of level 0 at most.
+    uint32_t NextDueMs() const;
+
+    uint16_t Armed() const { return armed; }
+    uint16_t HighWater() const { return highWater; }
+    uint32_t Fired() const { return fired; }
+    uint32_t Failures() const { return failures; }
+    // How late timers ran relative to their due time
+    uint32_t MaxLateMs() const { return maxLate; }
+    float AverageLateMs() const { return fired ? (float)totalLate / fired : 0; }
+    void ResetStats();
+
+private:
+    static const uint16_t None = 0xFFFF;
+    static const uint16_t Running = TIMER_BUCKETS; // unlinked, callback in progress
+
+    TimerSlot *Lookup(TimerHandle Handle) const;
+    void Insert(uint16_t Index);
+    void Link(uint16_t Index, uint16_t Bucket);
+    void Unlink(uint16_t Index);
+    void Release(uint16_t Index);
+    bool Cascade(uint8_t Level);
+    bool OuterArmed() const;
+    static void CallPlain(void *Function);
+
+    TimerSlot *slots;
+    uint16_t capacity;
+    uint16_t heads[TIMER_BUCKETS];
+    uint16_t freeList;
+    uint32_t clock; // next tick to process
+    bool started;
+
+    uint16_t armed;
+    uint16_t highWater;
+    uint32_t fired;
+    uint32_t failures;
+    uint32_t maxLate;
+    uint64_t totalLate;
+};
+
+#endif
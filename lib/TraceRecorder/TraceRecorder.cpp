@@ -0,0 +1,240 @@
+#include "TraceRecorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if TRACE_RECORD
+
+static void TraceToSerial(const char *Data, size_t Length)
+{
+    Serial.write((const uint8_t *)Data, Length);
+}
+
+TraceRecorder TraceLog(TraceToSerial);
+
+#endif
+
+static const char HexDigits[] = "0123456789ABCDEF";
+
+TraceRecorder::TraceRecorder(TraceWriteFunction Write)
+    : write(Write), used(0), overflow(false), records(0), dropped(0)
+{
+}
+
+void TraceRecorder::Begin(char Kind)
+{
+    char Head[24];
+    snprintf(Head, sizeof(Head), "TR %lu %c", (unsigned long)millis(), Kind);
+    used = 0;
+    overflow = false;
+    Put(Head);
+}
+
+void TraceRecorder::PutByte(char Byte)
+{
+    if (used == sizeof(line))
+    {
+        overflow = true;
+        return;
+    }
+    line[used++] = Byte;
+}
+
+void TraceRecorder::Put(const char *Text)
+{
+    while (*Text)
+    {
+        PutByte(*Text++);
+    }
+}
+
+void TraceRecorder::End()
+{
+    PutByte('\n');
+    if (overflow)
+    {
+        dropped++;
+    }
+    else
+    {
+        write(line, used);
+        records++;
+    }
+    used = 0;
+}
+
+void TraceRecorder::Boot(const char *Firmware)
+{
+    Begin(TRACE_BOOT);
+    PutByte(' ');
+    Put(Firmware);
+    End();
+}
+
+void TraceRecorder::Message(char Kind, const char *Payload, size_t Length, const uint8_t *Mac)
+{
+    Begin(Kind);
+    PutByte(' ');
+    if (Mac)
+    {
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            PutByte(HexDigits[Mac[i] >> 4]);
+            PutByte(HexDigits[Mac[i] & 0x0F]);
+        }
+    }
+    else
+    {
+        PutByte('-');
+    }
+    PutByte(' ');
+    for (size_t i = 0; i < Length && i < TRACE_MAX_PAYLOAD; i++)
+    {
+        uint8_t Byte = Payload[i];
+        if (Byte < 0x20 || Byte > 0x7E || Byte == '\\')
+        {
+            PutByte('\\');
+            PutByte('x');
+            PutByte(HexDigits[Byte >> 4]);
+            PutByte(HexDigits[Byte & 0x0F]);
+        }
+        else
+        {
+            PutByte(Byte);
+        }
+    }
+    End();
+}
+
+void TraceRecorder::Sensor(uint8_t Role, float TempC)
+{
+    char Fields[24];
+    snprintf(Fields, sizeof(Fields), " %u %.4f", Role, TempC);
+    Begin(TRACE_SENSOR);
+    Put(Fields);
+    End();
+}
+
+void TraceRecorder::Button(uint8_t Index, bool Level)
+{
+    char Fields[12];
+    snprintf(Fields, sizeof(Fields), " %u %u", Index, Level);
+    Begin(TRACE_BUTTON);
+    Put(Fields);
+    End();
+}
+
+void TraceRecorder::Relay(uint8_t Port)
+{
+    char Fields[8];
+    snprintf(Fields, sizeof(Fields), " %02X", Port);
+    Begin(TRACE_RELAY);
+    Put(Fields);
+    End();
+}
+
+static int HexValue(char Digit)
+{
+    if (Digit >= '0' && Digit <= '9')
+    {
+        return Digit - '0';
+    }
+    if (Digit >= 'A' && Digit <= 'F')
+    {
+        return Digit - 'A' + 10;
+    }
+    if (Digit >= 'a' && Digit <= 'f')
+    {
+        return Digit - 'a' + 10;
+    }
+    return -1;
+}
+
+bool TraceRecorder::Parse(const char *Line, TraceRecord &Record)
+{
+    unsigned long Ms;
+    char Kind;
+    int Offset = 0;
+    if (sscanf(Line, "TR %lu %c%n", &Ms, &Kind, &Offset) != 2)
+    {
+        return false;
+    }
+    Record.Ms = Ms;
+    Record.Kind = Kind;
+    Record.Index = 0;
+    Record.Value = 0;
+    Record.Length = 0;
+    Record.Payload[0] = 0;
+    const char *Fields = Line + Offset;
+    unsigned Index = 0;
+    switch (Kind)
+    {
+    case TRACE_BOOT:
+        return true;
+    case TRACE_SENSOR:
+        if (sscanf(Fields, "%u %f", &Index, &Record.Value) != 2)
+        {
+            return false;
+        }
+        Record.Index = Index;
+        return true;
+    case TRACE_BUTTON:
+    case TRACE_RELAY:
+        if (sscanf(Fields, Kind == TRACE_RELAY ? "%x" : "%u %f", &Index, &Record.Value) < 1)
+        {
+            return false;
+        }
+        Record.Index = Index;
+        return true;
+    case TRACE_INBOUND:
+    case TRACE_OUTBOUND:
+        break;
+    default:
+        return false;
+    }
+
+    // " <mac or -> <payload>"
+    if (*Fields++ != ' ')
+    {
+        return false;
+    }
+    if (*Fields == '-')
+    {
+        memset(Record.Mac, 0, sizeof(Record.Mac));
+        Fields++;
+    }
+    else
+    {
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            int High = HexValue(Fields[0]);
+            int Low = High < 0 ? -1 : HexValue(Fields[1]);
+            if (Low < 0)
+            {
+                return false;
+            }
+            Record.Mac[i] = High << 4 | Low;
+            Fields += 2;
+        }
+    }
+    if (*Fields++ != ' ')
+    {
+        return false;
+    }
+    while (*Fields && *Fields != '\n' && *Fields != '\r' && Record.Length < TRACE_MAX_PAYLOAD)
+    {
+        int High = Fields[0] == '\\' && Fields[1] == 'x' ? HexValue(Fields[2]) : -1;
+        int Low = High < 0 ? -1 : HexValue(Fields[3]);
+        if (Low >= 0)
+        {
+            Record.Payload[Record.Length++] = High << 4 | Low;
+            Fields += 4;
+        }
+        else
+        {
+            Record.Payload[Record.Length++] = *Fields++;
+        }
+    }
+    Record.Payload[Record.Length] = 0;
+    return true;
+}
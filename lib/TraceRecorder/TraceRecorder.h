@@ -0,0 +1,94 @@
+#ifndef TraceRecorder_H
+#define TraceRecorder_H
+
+#include <Arduino.h>
+
+#define TRACE_MAX_PAYLOAD 512 // longest message payload a record keeps
+// Longest line: header, MAC and a payload written entirely as \xHH
+#define TRACE_MAX_LINE (TRACE_MAX_PAYLOAD * 4 + 64)
+
+// One line per record, "TR <millis> <kind> <fields>", so a trace can be cut
+// out of a serial log with grep "^TR ".
+#define TRACE_BOOT 'V'     // <firmware version>
+#define TRACE_INBOUND 'I'  // <source MAC> <payload>, when loop() handles it
+#define TRACE_OUTBOUND 'O' // - <payload>
+#define TRACE_SENSOR 'S'   // <role> <degC>
+#define TRACE_BUTTON 'B'   // <button> <0|1>, debounced
+#define TRACE_RELAY 'R'    // <port>, relay card write (raw, active low)
+
+typedef void (*TraceWriteFunction)(const char *Data, size_t Length);
+
+struct TraceRecord
+{
+    uint32_t Ms;
+    char Kind;
+    uint8_t Index; // role, button or port
+    float Value;   // degC or button level
+    uint8_t Mac[6];
+    uint16_t Length;
+    char Payload[TRACE_MAX_PAYLOAD + 1]; // NUL terminated, binary payloads may hold NULs
+};
+
+// Writes the inputs of the control logic (handled mesh messages, sensor
+// readings, button edges) and its outputs (relay writes, sent messages) as
+// text lines, for replay against src/main.cpp on the host. Payload bytes
+// outside printable ASCII and the backslash are written as \xHH. A line
+// is only written once it is complete, so other Serial output cannot land
+// inside a record; one that does not fit is dropped and counted.
+class TraceRecorder
+{
+public:
+    explicit TraceRecorder(TraceWriteFunction Write);
+    void SetWriter(TraceWriteFunction Write) { write = Write; }
+
+    void Boot(const char *Firmware);
+    void Message(char Kind, const char *Payload, size_t Length, const uint8_t *Mac);
+    void Sensor(uint8_t Role, float TempC);
+    void Button(uint8_t Index, bool Level);
+    void Relay(uint8_t Port);
+
+    uint32_t Records() const { return records; }
+    uint32_t Dropped() const { return dropped; }
+
+    // Parses one line, false for anything that is not a trace record
+    static bool Parse(const char *Line, TraceRecord &Record);
+
+private:
+    void Begin(char Kind);
+    void Put(const char *Text);
+    void PutByte(char Byte);
+    void End();
+
+    TraceWriteFunction write;
+    char line[TRACE_MAX_LINE];
+    size_t used;
+    bool overflow;
+    uint32_t records;
+    uint32_t dropped;
+};
+
+#if TRACE_RECORD
+
+// Writes to Serial; the host simulation redirects it with SetWriter()
+extern TraceRecorder TraceLog;
+
+#define TRACE_BOOT_RECORD(Firmware) TraceLog.Boot(Firmware)
+#define TRACE_MESSAGE(Kind, Payload, Length, Mac) TraceLog.Message(Kind, Payload, Length, Mac)
+#define TRACE_SENSOR_RECORD(Role, TempC) TraceLog.Sensor(Role, TempC)
+#define TRACE_BUTTON_RECORD(Index, Level) TraceLog.Button(Index, Level)
+#define TRACE_RELAY_RECORD(Port) TraceLog.Relay(Port)
+
+#else
+
+#define TRACE_BOOT_RECORD(Firmware) \
+    do                              \
+    {                               \
+    } while (0)
+#define TRACE_MESSAGE(Kind, Payload, Length, Mac) TRACE_BOOT_RECORD(Kind)
+#define TRACE_SENSOR_RECORD(Role, TempC) TRACE_BOOT_RECORD(Role)
+#define TRACE_BUTTON_RECORD(Index, Level) TRACE_BOOT_RECORD(Index)
+#define TRACE_RELAY_RECORD(Port) TRACE_BOOT_RECORD(Port)
+
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+#include "ValueSchema.h"
+
+float ValueRead(const ValueField &Field)
+{
+    switch (Field.Type)
+    {
+    case ValueFloat:
+        return *(const float *)Field.Storage;
+    case ValueInt:
+        return *(const int *)Field.Storage;
+    case ValueInt8:
+        return *(const int8_t *)Field.Storage;
+    case ValueBool:
+        return *(const bool *)Field.Storage;
+    }
+    return 0;
+}
+
+bool ValueWritable(const ValueField &Field)
+{
+    return Field.Min < Field.Max;
+}
+
+bool ValueInRange(const ValueField &Field, long Value)
+{
+    return ValueWritable(Field) && Value >= Field.Min && Value <= Field.Max;
+}
+
+void ValueStore(const ValueField &Field, long Value)
+{
+    switch (Field.Type)
+    {
+    case ValueFloat:
+        *(float *)Field.Storage = Value;
+        break;
+    case ValueInt:
+        *(int *)Field.Storage = Value;
+        break;
+    case ValueInt8:
+        *(int8_t *)Field.Storage = Value;
+        break;
+    case ValueBool:
+        *(bool *)Field.Storage = Value != 0;
+        break;
+    }
+}
+
+long ValueStep(const ValueField &Field, int Delta)
+{
+    long Value = (long)ValueRead(Field) + Delta;
+    if (Value > Field.Max)
+    {
+        return Field.Min;
+    }
+    if (Value < Field.Min)
+    {
+        return Field.Max;
+    }
+    return Value;
+}
+
+const char *ValueFormat(const ValueField &Field, char *Text, size_t Size)
+{
+    if (Field.Type == ValueFloat)
+    {
+        snprintf(Text, Size, "%.2f", *(const float *)Field.Storage);
+    }
+    else
+    {
+        snprintf(Text, Size, "%d", (int)ValueRead(Field));
+    }
+    return Text;
+}
+
+void ValueFormatLine(const ValueField &Field, const char *Prefix, char *Text, size_t Size)
+{
+    const char *Label = Field.Label ? Field.Label : Field.Key;
+    if (Field.Type == ValueFloat)
+    {
+        snprintf(Text, Size, "%s%s: %.2f", Prefix, Label, *(const float *)Field.Storage);
+    }
+    else
+    {
+        snprintf(Text, Size, "%s%s: %d", Prefix, Label, (int)ValueRead(Field));
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef ValueSchema_H
+#define ValueSchema_H
+
+#include <Arduino.h>
+
+enum ValueType : uint8_t
+{
+    ValueFloat,
+    ValueInt,
+    ValueInt8,
+    ValueBool
+};
+
+// Applies a value that passed the range check, with whatever else has to
+// follow (relays, timers, schedule)
+typedef void (*ValueSetter)(int Value);
+
+// One node value as the gateway, the display and the command parser see
+// it. Key is the JSON key and the command name, Min..Max is what a command
+// or a button may set. The table is constexpr, so the entries and their
+// strings stay in flash; everything else refers to a value by its index.
+struct ValueField
+{
+    const char *Key;
+    ValueType Type;
+    void *Storage;
+    float Deadband;    // telemetry: change needed before it is sent again
+    int16_t Min;
+    int16_t Max;       // Min == Max: read only
+    const char *Label; // display text, nullptr if never shown
+    ValueSetter Set;   // nullptr: stored as is
+};
+
+float ValueRead(const ValueField &Field);
+bool ValueWritable(const ValueField &Field);
+bool ValueInRange(const ValueField &Field, long Value);
+// Converts Value to the field's type and stores it, without side effects
+void ValueStore(const ValueField &Field, long Value);
+// The next value in Delta's direction, wrapping around within Min..Max
+long ValueStep(const ValueField &Field, int Delta);
+
+// The string String(value) made of it: "%.2f" for floats, "%d" otherwise
+const char *ValueFormat(const ValueField &Field, char *Text, size_t Size);
+// Display line "<Prefix><Label>: <value>"
+void ValueFormatLine(const ValueField &Field, const char *Prefix, char *Text, size_t Size);
+
+// Compile time checks for value tables (C++11 constexpr, so recursive)
+constexpr bool ValueTableIsValid(const ValueField *Table, size_t Count)
+{
+    return Count == 0 || (Table[0].Key != nullptr && Table[0].Storage != nullptr && Table[0].Min <= Table[0].Max &&
+                          (Table[0].Type != ValueBool || (Table[0].Min >= 0 && Table[0].Max <= 1)) &&
+                          (Table[0].Type != ValueInt8 || (Table[0].Min >= -128 && Table[0].Max <= 127)) &&
+                          ValueTableIsValid(Table + 1, Count - 1));
+}
+
+template <size_t N>
+constexpr bool ValueTableIsValid(const ValueField (&Table)[N])
+{
+    return ValueTableIsValid(Table, N);
+}
+
+#endif
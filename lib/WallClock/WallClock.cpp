@@ -0,0 +1,109 @@
+#include "WallClock.h"
+
+static const int64_t DayMs = (int64_t)CLOCK_DAY_SECONDS * 1000;
+
+WallClock::WallClock()
+    : synced(false), anchorMs(0), anchorLocal(0), refValid(false), refLocal(0), refMs(0), drift(0), syncs(0), steps(0),
+      lastError(0)
+{
+}
+
+uint64_t WallClock::NowMs() const
+{
+    uint32_t Elapsed = millis() - anchorLocal;
+    return anchorMs + Elapsed + (int64_t)Elapsed * drift / 1000000000LL;
+}
+
+uint32_t WallClock::LocalMs(uint32_t WallMs) const
+{
+    // Rounded up, a timer on it must not fire before the wall time
+    int64_t Rate = 1000000000LL + drift;
+    return ((int64_t)WallMs * 1000000000LL + Rate - 1) / Rate;
+}
+
+void WallClock::Tick()
+{
+    if (!synced)
+    {
+        return;
+    }
+    unsigned long Local = millis();
+    anchorMs = NowMs();
+    anchorLocal = Local;
+}
+
+int32_t WallClock::Sync(uint32_t SecondOfDay, uint8_t Resolution)
+{
+    unsigned long Local = millis();
+    syncs++;
+    int64_t Received = (int64_t)(SecondOfDay % CLOCK_DAY_SECONDS) * 1000;
+    if (!synced)
+    {
+        // Day 1, so a later sync may still go back over midnight
+        synced = true;
+        anchorMs = Received + DayMs + (Resolution == 1 ? 500 : 0);
+        anchorLocal = Local;
+        refValid = Resolution == 1;
+        refLocal = Local;
+        refMs = anchorMs;
+        lastError = 0;
+        return 0;
+    }
+
+    int64_t Now = NowMs();
+    // The received time of day on the day nearest to the local clock
+    int64_t Day = Now / DayMs * DayMs;
+    Received += Day;
+    if (Received - Now > DayMs / 2)
+    {
+        Received -= DayMs;
+    }
+    else if (Now - Received > DayMs / 2)
+    {
+        Received += DayMs;
+    }
+
+    // Inside the window the clock is as good as the message can tell. Out
+    // of it, "HH:MM" (sent as the minute starts) pulls to the nearer edge,
+    // "HH:MM:SS" (truncated) to the middle of its second.
+    int64_t Window = (int64_t)(Resolution ? Resolution : 1) * 1000;
+    int64_t Error = 0;
+    if (Now < Received || Now >= Received + Window)
+    {
+        int64_t Target = Now < Received ? Received : Received + Window - 1;
+        Error = (Resolution <= 1 ? Received + Window / 2 : Target) - Now;
+    }
+    lastError = (int32_t)Error;
+
+    anchorMs = Now + Error;
+    anchorLocal = Local;
+    if (Error > (int64_t)CLOCK_STEP_LIMIT_MS || -Error > (int64_t)CLOCK_STEP_LIMIT_MS)
+    {
+        // Someone set the gateway clock, not drift: start a new baseline
+        steps++;
+        refValid = false;
+        return lastError;
+    }
+    if (Resolution != 1)
+    {
+        return lastError;
+    }
+
+    // Rate from the longest baseline of second resolution syncs: the
+    // truncation of both ends costs at most 1 s over the whole span
+    int64_t Wall = Received + Window / 2;
+    uint32_t Span = Local - refLocal;
+    if (!refValid || Span > CLOCK_REBASE_MS)
+    {
+        refValid = true;
+        refLocal = Local;
+        refMs = Wall;
+    }
+    else if (Span >= CLOCK_DRIFT_SPAN_MS)
+    {
+        int64_t Drift = (Wall - refMs - (int64_t)Span) * 1000000000LL / Span;
+        Drift = Drift > CLOCK_MAX_DRIFT_PPB ? CLOCK_MAX_DRIFT_PPB : Drift;
+        drift = Drift < -CLOCK_MAX_DRIFT_PPB ? -CLOCK_MAX_DRIFT_PPB : Drift;
+    }
+    return lastError;
+}
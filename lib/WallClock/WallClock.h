@@ -0,0 +1,59 @@
+#ifndef WallClock_H
+#define WallClock_H
+
+#include <Arduino.h>
+
+#define CLOCK_DAY_SECONDS 86400UL
+#define CLOCK_STEP_LIMIT_MS 120000UL        // larger errors step the clock, the drift estimate stays
+#define CLOCK_DRIFT_SPAN_MS (30UL * 60 * 1000) // shorter baselines only correct the offset
+#define CLOCK_REBASE_MS (20UL * 24 * 3600 * 1000) // baseline restarts well before millis() wraps
+#define CLOCK_MAX_DRIFT_PPB 500000L          // 500 ppm, far beyond any crystal
+
+// Local wall clock on top of millis(), disciplined by occasional time
+// messages. Each sync corrects the offset; syncs with second resolution
+// also measure the crystal's rate against the gateway over the span since
+// the first of them, so the clock stays within a second or so over hours
+// without any traffic.
+// Time counts in seconds from midnight before the day of the first sync.
+class WallClock
+{
+public:
+    WallClock();
+
+    // Time of day from the gateway, valid from SecondOfDay for Resolution
+    // seconds (60 for "HH:MM", 1 for "HH:MM:SS"). A sync that agrees with the
+    // clock within that window changes nothing. Returns the correction in ms.
+    int32_t Sync(uint32_t SecondOfDay, uint8_t Resolution);
+    bool Synced() const { return synced; }
+
+    uint64_t NowMs() const;
+    uint32_t Now() const { return NowMs() / 1000; }
+    uint32_t Day() const { return Now() / CLOCK_DAY_SECONDS; }
+    uint32_t SecondOfDay() const { return Now() % CLOCK_DAY_SECONDS; }
+    uint8_t Hour() const { return SecondOfDay() / 3600; }
+    uint8_t Minute() const { return SecondOfDay() / 60 % 60; }
+    // millis() that pass while the wall clock advances WallMs
+    uint32_t LocalMs(uint32_t WallMs) const;
+    // Folds the elapsed time into the anchor, so millis() may wrap; call at
+    // least every few weeks (the schedule does it every hour)
+    void Tick();
+
+    int32_t DriftPpb() const { return drift; }
+    uint32_t Syncs() const { return syncs; }
+    uint32_t Steps() const { return steps; }
+    int32_t LastErrorMs() const { return lastError; }
+
+private:
+    bool synced;
+    uint64_t anchorMs;        // wall time at anchorLocal
+    unsigned long anchorLocal; // millis() of the anchor
+    bool refValid;
+    unsigned long refLocal;    // millis() of the first sync of the drift baseline
+    int64_t refMs;             // its received wall time
+    int32_t drift;             // ppb the local clock runs slow (positive) or fast
+    uint32_t syncs;
+    uint32_t steps;
+    int32_t lastError;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "SimHarness.h"
+#include <malloc.h>
+
+// Interposes the glibc allocator so every heap operation of the firmware
+// (Arduino String, ArduinoJson, operator new) is counted.
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+extern "C" void __libc_free(void *ptr);
+
+SimAllocCounters SimAlloc;
+
+static bool Counting = false;
+static int PauseDepth = 0;
+
+SimAllocPause::SimAllocPause()
+{
+  PauseDepth++;
+}
+
+SimAllocPause::~SimAllocPause()
+{
+  PauseDepth--;
+}
+
+void SimAllocTracking(bool counting)
+{
+  Counting = counting;
+}
+
+static void Track(void *ptr)
+{
+  if (!ptr || PauseDepth)
+  {
+    return;
+  }
+  size_t size = malloc_usable_size(ptr);
+  SimAlloc.LiveBytes += size;
+  if (SimAlloc.LiveBytes > SimAlloc.PeakLiveBytes)
+  {
+    SimAlloc.PeakLiveBytes = SimAlloc.LiveBytes;
+  }
+  if (Counting)
+  {
+    SimAlloc.Allocs++;
+    SimAlloc.Bytes += size;
+  }
+}
+
+static void Untrack(void *ptr)
+{
+  if (!ptr || PauseDepth)
+  {
+    return;
+  }
+  SimAlloc.LiveBytes -= malloc_usable_size(ptr);
+  if (Counting)
+  {
+    SimAlloc.Frees++;
+  }
+}
+
+extern "C" void *malloc(size_t size)
+{
+  void *ptr = __libc_malloc(size);
+  Track(ptr);
+  return ptr;
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  void *ptr = __libc_calloc(count, size);
+  Track(ptr);
+  return ptr;
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+  Untrack(ptr);
+  void *grown = __libc_realloc(ptr, size);
+  if (grown || size)
+  {
+    Track(grown ? grown : ptr);
+  }
+  return grown;
+}
+
+extern "C" void free(void *ptr)
+{
+  Untrack(ptr);
+  __libc_free(ptr);
+}
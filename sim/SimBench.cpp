@@ -0,0 +1,261 @@
+#include "SimBench.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+struct SimScenario
+{
+  const char *Name;
+  const char *Description;
+  SimScenarioFunction Run;
+};
+
+static std::vector<SimScenario> &Scenarios()
+{
+  static std::vector<SimScenario> scenarios;
+  return scenarios;
+}
+
+SimScenarioRegistrar::SimScenarioRegistrar(const char *name, const char *description, SimScenarioFunction run)
+{
+  Scenarios().push_back({name, description, run});
+}
+
+SimLatency::~SimLatency()
+{
+  SimAllocPause pause;
+  std::vector<uint64_t>().swap(samples);
+}
+
+void SimLatency::Reserve(uint64_t count)
+{
+  SimAllocPause pause;
+  samples.reserve(count);
+}
+
+void SimLatency::Add(uint64_t nanos)
+{
+  SimAllocPause pause;
+  samples.push_back(nanos);
+  sorted = false;
+}
+
+uint64_t SimLatency::Percentile(double p)
+{
+  if (samples.empty())
+  {
+    return 0;
+  }
+  if (!sorted)
+  {
+    std::sort(samples.begin(), samples.end());
+    sorted = true;
+  }
+  size_t index = (size_t)(p / 100.0 * (samples.size() - 1) + 0.5);
+  return samples[index];
+}
+
+uint64_t SimLatency::Max()
+{
+  return Percentile(100.0);
+}
+
+uint64_t SimHostNanos()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Same wiring as the installation: BUTTON_PINS in src/main.cpp
+static const uint8_t SimButtonPins[] = {15, 4, 2};
+
+static uint8_t WallHour = 9;
+static uint8_t WallMinute = 0;
+static uint64_t WallSetAt = 0;
+
+void SimBootNode()
+{
+  static const uint8_t water[8] = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
+  static const uint8_t vorlauf[8] = {0x28, 0x52, 0x04, 0xE8, 0x50, 0x20, 0x01, 0xF0};
+  static const uint8_t rucklauf[8] = {0x28, 0x47, 0x53, 0xF2, 0x50, 0x20, 0x01, 0xA7};
+  static const uint8_t roof[8] = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
+
+  SimClearSensors();
+  SimAddSensor(water, 24.5f);
+  SimAddSensor(vorlauf, 31.0f);
+  SimAddSensor(rucklauf, 27.25f);
+  SimAddSensor(roof, 38.0f);
+  for (uint8_t pin : SimButtonPins)
+  {
+    SimSetPin(pin, 0);
+  }
+  SimResetCounters();
+  setup();
+}
+
+void SimSetWallClock(uint8_t hour, uint8_t minute)
+{
+  WallHour = hour;
+  WallMinute = minute;
+  WallSetAt = SimMicros();
+}
+
+static void BroadcastTime()
+{
+  uint64_t minutes = WallHour * 60 + WallMinute + (SimMicros() - WallSetAt) / 60000000ULL;
+  char msg[16];
+  snprintf(msg, sizeof(msg), "time %u:%u", (unsigned)(minutes / 60 % 24), (unsigned)(minutes % 60));
+  SimInjectCommand(msg);
+  SimScheduleIn(60000000ULL, BroadcastTime);
+}
+
+void SimStartTimeBroadcasts()
+{
+  // Align to the next full minute of the wall clock
+  uint64_t elapsed = (SimMicros() - WallSetAt) % 60000000ULL;
+  SimScheduleIn(60000000ULL - elapsed, BroadcastTime);
+}
+
+void SimPressButton(uint8_t button, uint32_t holdMs)
+{
+  uint8_t pin = SimButtonPins[button];
+  SimSetPin(pin, 1);
+  SimScheduleIn((uint64_t)holdMs * 1000, [pin]() { SimSetPin(pin, 0); });
+}
+
+void SimInjectCommand(const char *command)
+{
+  static const uint8_t gateway[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0xFE};
+  SimInjectMeshMessage(command, gateway);
+}
+
+void SimRunLoop(const SimOptions &options, SimLatency &latency)
+{
+  latency.Reserve(options.Iterations);
+  for (uint64_t i = 0; i < options.Iterations; i++)
+  {
+    SimAdvance(options.StepMicros);
+
+    uint64_t blockedBefore = SimStats.DelayMicros;
+    uint64_t start = SimHostNanos();
+    SimAllocTracking(true);
+    loop();
+    SimAllocTracking(false);
+    uint64_t elapsed = SimHostNanos() - start;
+
+    latency.Add(elapsed + (SimStats.DelayMicros - blockedBefore) * 1000);
+  }
+}
+
+static void PrintHeader()
+{
+  printf("%-14s %10s %9s %9s %11s %10s %9s %11s %8s %9s %7s %9s %11s\n",
+         "scenario", "iterations", "p50[us]", "p99[us]", "max[us]", "blocked[ms]",
+         "allocs", "alloc/kiter", "heapPeak", "meshOut", "relayW", "dispFlush", "dispI2cB");
+}
+
+void SimReport(const char *scenario, SimLatency &latency)
+{
+  uint64_t count = latency.Count();
+  printf("%-14s %10llu %9.2f %9.2f %11.2f %10llu %9llu %11.2f %8lld %9llu %7llu %9llu %11llu\n",
+         scenario,
+         (unsigned long long)count,
+         latency.Percentile(50) / 1000.0,
+         latency.Percentile(99) / 1000.0,
+         latency.Max() / 1000.0,
+         (unsigned long long)(SimStats.DelayMicros / 1000),
+         (unsigned long long)SimAlloc.Allocs,
+         count ? SimAlloc.Allocs * 1000.0 / count : 0.0,
+         (long long)SimAlloc.PeakLiveBytes,
+         (unsigned long long)SimStats.MeshOut,
+         (unsigned long long)SimStats.RelayWrites,
+         (unsigned long long)SimStats.DisplayFlushes,
+         (unsigned long long)SimStats.DisplayI2cBytes);
+  fflush(stdout);
+}
+
+static void Usage(const char *program)
+{
+  printf("usage: %s [--iterations N] [--step-us N] [--arg VALUE] [scenario ...]\n\n", program);
+  for (const SimScenario &scenario : Scenarios())
+  {
+    printf("  %-14s %s\n", scenario.Name, scenario.Description);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  SimOptions options = {2000000, 1000, nullptr};
+  std::vector<const SimScenario *> selected;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+    {
+      options.Iterations = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--step-us") && i + 1 < argc)
+    {
+      options.StepMicros = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--arg") && i + 1 < argc)
+    {
+      options.Argument = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "--list"))
+    {
+      Usage(argv[0]);
+      return 0;
+    }
+    else
+    {
+      const SimScenario *match = nullptr;
+      for (const SimScenario &scenario : Scenarios())
+      {
+        if (!strcmp(scenario.Name, argv[i]))
+        {
+          match = &scenario;
+        }
+      }
+      if (!match)
+      {
+        fprintf(stderr, "unknown scenario '%s'\n", argv[i]);
+        Usage(argv[0]);
+        return 2;
+      }
+      selected.push_back(match);
+    }
+  }
+  if (selected.empty())
+  {
+    for (const SimScenario &scenario : Scenarios())
+    {
+      selected.push_back(&scenario);
+    }
+  }
+
+  PrintHeader();
+  int failures = 0;
+  for (const SimScenario *scenario : selected)
+  {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      scenario->Run(options);
+      fflush(stdout);
+      _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      fprintf(stderr, "scenario '%s' failed (status %d)\n", scenario->Name, status);
+      failures++;
+    }
+  }
+  return failures ? 1 : 0;
+}
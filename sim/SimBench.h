@@ -0,0 +1,73 @@
+#ifndef SimBench_H
+#define SimBench_H
+
+// Benchmark driver for the host simulation. Scenarios register themselves
+// with SIM_SCENARIO and each one runs in its own forked process, so every
+// scenario starts from a freshly initialised firmware image.
+
+#include "SimHarness.h"
+#include <stdint.h>
+#include <vector>
+
+struct SimOptions
+{
+  uint64_t Iterations;
+  uint64_t StepMicros;
+  const char *Argument;
+};
+
+typedef void (*SimScenarioFunction)(const SimOptions &options);
+
+struct SimScenarioRegistrar
+{
+  SimScenarioRegistrar(const char *name, const char *description, SimScenarioFunction run);
+};
+
+#define SIM_SCENARIO(name, description)                                                           \
+  static void SimScenario_##name(const SimOptions &options);                                      \
+  static SimScenarioRegistrar SimScenarioRegistrar_##name(#name, description, SimScenario_##name); \
+  static void SimScenario_##name(const SimOptions &options)
+
+// Collects one duration per iteration and reports percentiles
+class SimLatency
+{
+public:
+  ~SimLatency();
+  void Reserve(uint64_t count);
+  void Add(uint64_t nanos);
+  uint64_t Count() const { return samples.size(); }
+  uint64_t Percentile(double p);
+  uint64_t Max();
+
+private:
+  std::vector<uint64_t> samples;
+  bool sorted = false;
+};
+
+// Monotonic host time, for measuring the firmware's own CPU cost
+uint64_t SimHostNanos();
+
+// Firmware entry points from src/main.cpp
+void setup();
+void loop();
+
+// Pool node with the four DS18B20 of the real installation, then setup().
+// Counters are reset before setup(), so reports include the boot traffic.
+void SimBootNode();
+
+// Sets the simulated wall clock the gateway broadcasts with "time HH:MM"
+void SimSetWallClock(uint8_t hour, uint8_t minute);
+// Broadcasts "time HH:MM" every virtual minute, like the gateway does
+void SimStartTimeBroadcasts();
+// Presses a button (index into BUTTON_PINS) for the given time
+void SimPressButton(uint8_t button, uint32_t holdMs = 120);
+void SimInjectCommand(const char *command);
+
+// Runs loop() options.Iterations times, advancing the virtual clock by
+// options.StepMicros before each call. Loop latency is the host CPU time of
+// loop() plus the virtual time it spent blocked in delay().
+void SimRunLoop(const SimOptions &options, SimLatency &latency);
+
+void SimReport(const char *scenario, SimLatency &latency);
+
+#endif
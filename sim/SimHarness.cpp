@@ -0,0 +1,276 @@
+#include "SimHarness.h"
+#include <string.h>
+#include <map>
+#include <stdio.h>
+#include <string>
+#include <utility>
+
+SimCounters SimStats;
+bool SimEchoSerial = false;
+bool SimIdleWait = false;
+// Free heap of an ESP32 without SPIRAM right after the mesh stack is up
+const uint32_t SimHeapSize = 180 * 1024;
+
+std::function<void(const char *data, size_t len)> SimOnMeshSend;
+std::function<void(uint8_t pcfValue)> SimOnRelayWrite;
+std::function<void(uint8_t address, const uint8_t *data, size_t len)> SimOnI2cWrite;
+
+static uint64_t Clock = 0;
+static std::multimap<uint64_t, std::function<void()>> Events;
+static uint8_t Pins[64];
+static void (*PinHandlers[64])();
+static int PinModes[64];
+static std::vector<SimSensor> Sensors;
+static std::map<std::string, std::vector<uint8_t>> Nvs; // "namespace/key"
+
+uint64_t SimMicros()
+{
+  return Clock;
+}
+
+void SimSetClock(uint64_t us)
+{
+  Clock = us;
+}
+
+void SimAdvance(uint64_t us)
+{
+  uint64_t target = Clock + us;
+  while (!Events.empty() && Events.begin()->first <= target)
+  {
+    std::function<void()> event;
+    {
+      SimAllocPause pause;
+      auto next = Events.begin();
+      if (next->first > Clock)
+      {
+        Clock = next->first;
+      }
+      event = std::move(next->second);
+      Events.erase(next);
+    }
+    event();
+    SimAllocPause pause;
+    event = nullptr;
+  }
+  Clock = target;
+}
+
+void SimScheduleAt(uint64_t us, std::function<void()> event)
+{
+  SimAllocPause pause;
+  Events.emplace(us, std::move(event));
+}
+
+void SimScheduleIn(uint64_t us, std::function<void()> event)
+{
+  SimScheduleAt(Clock + us, std::move(event));
+}
+
+uint64_t SimNextEventAt()
+{
+  return Events.empty() ? UINT64_MAX : Events.begin()->first;
+}
+
+void SimClearEvents()
+{
+  SimAllocPause pause;
+  Events.clear();
+}
+
+void SimSetPin(uint8_t pin, int level)
+{
+  if (pin >= sizeof(Pins))
+  {
+    return;
+  }
+  uint8_t before = Pins[pin];
+  Pins[pin] = level ? 1 : 0;
+  if (!PinHandlers[pin] || before == Pins[pin])
+  {
+    return;
+  }
+  // CHANGE is RISING | FALLING
+  if (PinModes[pin] & (Pins[pin] ? 0x01 : 0x02))
+  {
+    PinHandlers[pin]();
+  }
+}
+
+void SimAttachInterrupt(uint8_t pin, void (*handler)(), int mode)
+{
+  if (pin < sizeof(Pins))
+  {
+    PinHandlers[pin] = handler;
+    PinModes[pin] = mode;
+  }
+}
+
+int SimGetPin(uint8_t pin)
+{
+  return pin < sizeof(Pins) ? Pins[pin] : 0;
+}
+
+SimSensor *SimSensorAt(uint8_t index)
+{
+  return index < Sensors.size() ? &Sensors[index] : nullptr;
+}
+
+SimSensor *SimFindSensor(const uint8_t address[8])
+{
+  for (SimSensor &sensor : Sensors)
+  {
+    if (memcmp(sensor.Address, address, 8) == 0)
+    {
+      return &sensor;
+    }
+  }
+  return nullptr;
+}
+
+uint8_t SimSensorCount()
+{
+  return (uint8_t)Sensors.size();
+}
+
+void SimAddSensor(const uint8_t address[8], float tempC)
+{
+  SimAllocPause pause;
+  SimSensor sensor;
+  memcpy(sensor.Address, address, 8);
+  sensor.TempC = tempC;
+  sensor.Resolution = 12;
+  sensor.FaultReads = 0;
+  sensor.FaultValue = 0;
+  Sensors.push_back(sensor);
+}
+
+void SimSetTemperature(const uint8_t address[8], float tempC)
+{
+  SimSensor *sensor = SimFindSensor(address);
+  if (sensor)
+  {
+    sensor->TempC = tempC;
+  }
+}
+
+void SimRemoveSensor(const uint8_t address[8])
+{
+  SimAllocPause pause;
+  for (size_t i = 0; i < Sensors.size(); i++)
+  {
+    if (memcmp(Sensors[i].Address, address, 8) == 0)
+    {
+      Sensors.erase(Sensors.begin() + i);
+      return;
+    }
+  }
+}
+
+void SimSensorFault(const uint8_t address[8], uint8_t reads, float value)
+{
+  SimSensor *sensor = SimFindSensor(address);
+  if (sensor)
+  {
+    sensor->FaultReads = reads;
+    sensor->FaultValue = value;
+  }
+}
+
+void SimClearSensors()
+{
+  SimAllocPause pause;
+  Sensors.clear();
+}
+
+static std::string NvsName(const char *space, const char *key)
+{
+  return std::string(space) + "/" + key;
+}
+
+const std::vector<uint8_t> *SimNvsFind(const char *space, const char *key)
+{
+  SimAllocPause pause;
+  auto entry = Nvs.find(NvsName(space, key));
+  return entry == Nvs.end() ? nullptr : &entry->second;
+}
+
+void SimNvsWrite(const char *space, const char *key, const uint8_t *data, size_t len)
+{
+  SimAllocPause pause;
+  Nvs[NvsName(space, key)].assign(data, data + len);
+  SimStats.NvsWrites++;
+  SimStats.NvsBytes += len;
+}
+
+bool SimNvsErase(const char *space, const char *key)
+{
+  SimAllocPause pause;
+  return Nvs.erase(NvsName(space, key)) > 0;
+}
+
+void SimNvsClear(const char *space)
+{
+  SimAllocPause pause;
+  if (!space)
+  {
+    Nvs.clear();
+    return;
+  }
+  std::string prefix = std::string(space) + "/";
+  for (auto entry = Nvs.begin(); entry != Nvs.end();)
+  {
+    entry = entry->first.compare(0, prefix.size(), prefix) ? std::next(entry) : Nvs.erase(entry);
+  }
+}
+
+bool SimNvsSave(const char *path)
+{
+  SimAllocPause pause;
+  FILE *file = fopen(path, "wb");
+  if (!file)
+  {
+    return false;
+  }
+  for (const auto &entry : Nvs)
+  {
+    uint32_t sizes[2] = {(uint32_t)entry.first.size(), (uint32_t)entry.second.size()};
+    fwrite(sizes, sizeof(sizes), 1, file);
+    fwrite(entry.first.data(), 1, sizes[0], file);
+    fwrite(entry.second.data(), 1, sizes[1], file);
+  }
+  return fclose(file) == 0;
+}
+
+bool SimNvsLoad(const char *path)
+{
+  SimAllocPause pause;
+  FILE *file = fopen(path, "rb");
+  if (!file)
+  {
+    return false;
+  }
+  Nvs.clear();
+  uint32_t sizes[2];
+  while (fread(sizes, sizeof(sizes), 1, file) == 1)
+  {
+    std::string name(sizes[0], 0);
+    std::vector<uint8_t> value(sizes[1]);
+    if (fread(&name[0], 1, sizes[0], file) != sizes[0] || fread(value.data(), 1, sizes[1], file) != sizes[1])
+    {
+      break;
+    }
+    Nvs[name] = std::move(value);
+  }
+  fclose(file);
+  return true;
+}
+
+void SimResetCounters()
+{
+  memset(&SimStats, 0, sizeof(SimStats));
+  SimAlloc.Allocs = 0;
+  SimAlloc.Frees = 0;
+  SimAlloc.Bytes = 0;
+  SimAlloc.PeakLiveBytes = SimAlloc.LiveBytes;
+}
@@ -0,0 +1,160 @@
+#ifndef SimHarness_H
+#define SimHarness_H
+
+// Shared state of the host simulation ([env:native]).
+// The fake libraries in sim/fakes read and write this state, scenarios in
+// sim/scenarios script it. Everything runs on one thread against a virtual
+// microsecond clock that only moves when something advances it.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+struct SimCounters
+{
+  uint64_t DelayCalls;
+  uint64_t DelayMicros;
+  uint64_t MeshIn;
+  uint64_t MeshOut;
+  uint64_t MeshOutBytes;
+  uint64_t RelayWrites;
+  uint64_t DisplayFlushes;
+  uint64_t DisplayI2cBytes;
+  uint64_t I2cTransactions;
+  uint64_t I2cBytes;
+  uint64_t I2cBusMicros;
+  uint64_t SensorConversions;
+  uint64_t SensorReads;
+  uint64_t NvsWrites;
+  uint64_t NvsBytes;
+  uint64_t IdleMicros; // virtual time loop() spent blocked waiting for work
+  uint64_t SerialBytes;
+  uint64_t Restarts;
+  uint64_t FlashErases; // 4 KB sectors
+  uint64_t FlashWriteBytes;
+  uint64_t FlashReadBytes;
+};
+
+struct SimAllocCounters
+{
+  uint64_t Allocs;
+  uint64_t Frees;
+  uint64_t Bytes;
+  int64_t LiveBytes;
+  int64_t PeakLiveBytes;
+};
+
+extern SimCounters SimStats;
+extern SimAllocCounters SimAlloc;
+extern bool SimEchoSerial;
+// Lets loop() block in the FreeRTOS event group fake instead of returning
+// right away (off by default, SimRunLoop() then keeps its fixed steps)
+extern bool SimIdleWait;
+extern const uint32_t SimHeapSize;
+
+// Virtual clock. SimAdvance() delivers every scheduled event that falls due
+// on the way, the same way the mesh task would interrupt a blocking delay().
+uint64_t SimMicros();
+void SimAdvance(uint64_t us);
+void SimSetClock(uint64_t us);
+
+// Scripted events, ordered by virtual time (FIFO for equal times).
+void SimScheduleAt(uint64_t us, std::function<void()> event);
+void SimScheduleIn(uint64_t us, std::function<void()> event);
+uint64_t SimNextEventAt();
+void SimClearEvents();
+
+// GPIO levels seen by digitalRead() and the Bounce fake. A level change
+// runs the handler registered with attachInterrupt() for that edge.
+void SimSetPin(uint8_t pin, int level);
+int SimGetPin(uint8_t pin);
+void SimAttachInterrupt(uint8_t pin, void (*handler)(), int mode);
+
+// OneWire bus population for the DallasTemperature fake
+struct SimSensor
+{
+  uint8_t Address[8];
+  float TempC;
+  uint8_t Resolution;
+  // The next FaultReads reads return FaultValue (-127 for a CRC error, 85 if
+  // the conversion did not run)
+  uint8_t FaultReads;
+  float FaultValue;
+};
+
+SimSensor *SimSensorAt(uint8_t index);
+SimSensor *SimFindSensor(const uint8_t address[8]);
+uint8_t SimSensorCount();
+void SimAddSensor(const uint8_t address[8], float tempC);
+void SimSetTemperature(const uint8_t address[8], float tempC);
+void SimRemoveSensor(const uint8_t address[8]);
+void SimSensorFault(const uint8_t address[8], uint8_t reads, float value);
+void SimClearSensors();
+
+// NVS contents for the Preferences fake, kept across simulated reboots
+const std::vector<uint8_t> *SimNvsFind(const char *space, const char *key);
+void SimNvsWrite(const char *space, const char *key, const uint8_t *data, size_t len);
+bool SimNvsErase(const char *space, const char *key);
+void SimNvsClear(const char *space = nullptr);
+// The next n Preferences::putBytes() calls fail, as on a full or worn
+// NVS partition
+extern uint32_t SimNvsFailWrites;
+// Hands the flash image to another scenario process (e.g. across a fork)
+bool SimNvsSave(const char *path);
+bool SimNvsLoad(const char *path);
+
+// Flash with the two app slots of partitions.csv for the esp_partition and
+// esp_ota fakes. It is a file, so an update written in one scenario process
+// can be booted in another; nullptr opens an anonymous temporary file. The
+// first use of the fakes opens one if no scenario did.
+bool SimFlashOpen(const char *path);
+void SimFlashClose();
+// Writes an image the way a serial flasher would and makes it the boot slot
+bool SimFlashProgram(uint8_t slot, const uint8_t *data, size_t len);
+bool SimFlashRead(uint8_t slot, uint32_t offset, uint8_t *data, size_t len);
+// The bootloader starts whatever slot otadata selects
+void SimFlashReboot();
+uint8_t SimFlashRunningSlot();
+uint8_t SimFlashBootSlot();
+
+// Mesh association: the connected callback runs this long after
+// MeshApp::start() (0: within start(), as before association was modelled),
+// never with SIM_MESH_NO_ROOT. Set before SimBootNode().
+#define SIM_MESH_NO_ROOT UINT64_MAX
+extern uint64_t SimMeshAssociationUs;
+
+// Mesh: inject an inbound message through the registered onMessage callback
+void SimInjectMeshMessage(const char *payload, const uint8_t srcMac[6]);
+void SimInjectMeshMessage(const char *payload, size_t length, const uint8_t srcMac[6]);
+
+// Observation hooks, called for every outbound mesh message, relay write
+// and I2C write transaction
+extern std::function<void(const char *data, size_t len)> SimOnMeshSend;
+extern std::function<void(uint8_t pcfValue)> SimOnRelayWrite;
+extern std::function<void(uint8_t address, const uint8_t *data, size_t len)> SimOnI2cWrite;
+uint8_t SimRelayValue();
+
+// I2C devices on the fake Wire bus
+#define SIM_PCF8574_ADDRESS 0x20
+#define SIM_SH1106_ADDRESS 0x3c
+// SH1106 panel model: consumes command/data transactions, and compares its
+// visible RAM with a 128x64 framebuffer
+void SimPanelReceive(const uint8_t *data, size_t length);
+bool SimPanelMatches(const uint8_t *frame);
+
+// Allocation tracking (sim/SimAlloc.cpp hooks malloc and friends).
+// Live/peak bytes are always tracked, Allocs/Frees/Bytes only while counting
+// is enabled. Harness bookkeeping runs inside a SimAllocPause scope so it
+// never shows up in the firmware numbers.
+void SimAllocTracking(bool counting);
+
+struct SimAllocPause
+{
+  SimAllocPause();
+  ~SimAllocPause();
+};
+
+void SimResetCounters();
+
+#endif
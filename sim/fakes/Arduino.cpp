@@ -0,0 +1,460 @@
+#include "Arduino.h"
+#include "SimHarness.h"
+#include <chrono>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+unsigned long millis()
+{
+  return (unsigned long)(uint32_t)(SimMicros() / 1000);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)(uint32_t)SimMicros();
+}
+
+void delay(uint32_t ms)
+{
+  SimStats.DelayCalls++;
+  SimStats.DelayMicros += (uint64_t)ms * 1000;
+  SimAdvance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+  SimStats.DelayCalls++;
+  SimStats.DelayMicros += us;
+  SimAdvance(us);
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+int digitalRead(uint8_t pin)
+{
+  return SimGetPin(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  SimSetPin(pin, val);
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode)
+{
+  SimAttachInterrupt(pin, handler, mode);
+}
+
+void detachInterrupt(uint8_t pin)
+{
+  SimAttachInterrupt(pin, nullptr, 0);
+}
+
+// ---------------------------------------------------------------------------
+// String
+
+String::String(const char *cstr) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  sso[0] = 0;
+  if (cstr)
+  {
+    assign(cstr, strlen(cstr));
+  }
+}
+
+String::String(const String &str) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  sso[0] = 0;
+  assign(str.buffer(), str.len);
+}
+
+String::String(String &&str) : heap(str.heap), capacity(str.capacity), len(str.len)
+{
+  memcpy(sso, str.sso, sizeof(sso));
+  str.heap = nullptr;
+  str.capacity = SsoCapacity;
+  str.len = 0;
+  str.sso[0] = 0;
+}
+
+String::String(char c) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  char buf[2] = {c, 0};
+  assign(buf, 1);
+}
+
+static void FormatUnsigned(char *buf, unsigned long value, unsigned char base)
+{
+  char tmp[33];
+  int i = 0;
+  if (base < 2)
+  {
+    base = 10;
+  }
+  do
+  {
+    unsigned digit = value % base;
+    tmp[i++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  int j = 0;
+  while (i)
+  {
+    buf[j++] = tmp[--i];
+  }
+  buf[j] = 0;
+}
+
+static void FormatSigned(char *buf, long value, unsigned char base)
+{
+  if (value < 0 && base == 10)
+  {
+    buf[0] = '-';
+    FormatUnsigned(buf + 1, (unsigned long)(-value), base);
+  }
+  else
+  {
+    FormatUnsigned(buf, (unsigned long)value, base);
+  }
+}
+
+String::String(unsigned char value, unsigned char base) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  char buf[34];
+  FormatUnsigned(buf, value, base);
+  assign(buf, strlen(buf));
+}
+
+String::String(int value, unsigned char base) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  char buf[34];
+  FormatSigned(buf, value, base);
+  assign(buf, strlen(buf));
+}
+
+String::String(unsigned int value, unsigned char base) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  char buf[34];
+  FormatUnsigned(buf, value, base);
+  assign(buf, strlen(buf));
+}
+
+String::String(long value, unsigned char base) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  char buf[34];
+  FormatSigned(buf, value, base);
+  assign(buf, strlen(buf));
+}
+
+String::String(unsigned long value, unsigned char base) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  char buf[34];
+  FormatUnsigned(buf, value, base);
+  assign(buf, strlen(buf));
+}
+
+String::String(float value, unsigned int decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned int decimalPlaces) : heap(nullptr), capacity(SsoCapacity), len(0)
+{
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  assign(buf, strlen(buf));
+}
+
+String::~String()
+{
+  free(heap);
+}
+
+bool String::reserve(unsigned int size)
+{
+  if (size <= capacity)
+  {
+    return true;
+  }
+  char *grown = (char *)realloc(heap, size + 1);
+  if (!grown)
+  {
+    return false;
+  }
+  if (!heap)
+  {
+    memcpy(grown, sso, len + 1);
+  }
+  heap = grown;
+  capacity = size;
+  return true;
+}
+
+bool String::assign(const char *cstr, unsigned int length)
+{
+  if (!reserve(length))
+  {
+    return false;
+  }
+  memmove(buffer(), cstr, length);
+  len = length;
+  buffer()[len] = 0;
+  return true;
+}
+
+String &String::operator=(const String &rhs)
+{
+  if (this != &rhs)
+  {
+    assign(rhs.buffer(), rhs.len);
+  }
+  return *this;
+}
+
+String &String::operator=(String &&rhs)
+{
+  if (this != &rhs)
+  {
+    free(heap);
+    heap = rhs.heap;
+    capacity = rhs.capacity;
+    len = rhs.len;
+    memcpy(sso, rhs.sso, sizeof(sso));
+    rhs.heap = nullptr;
+    rhs.capacity = SsoCapacity;
+    rhs.len = 0;
+    rhs.sso[0] = 0;
+  }
+  return *this;
+}
+
+String &String::operator=(const char *cstr)
+{
+  assign(cstr ? cstr : "", cstr ? strlen(cstr) : 0);
+  return *this;
+}
+
+bool String::concat(const char *cstr, unsigned int length)
+{
+  if (!length)
+  {
+    return true;
+  }
+  if (!reserve(len + length))
+  {
+    return false;
+  }
+  memmove(buffer() + len, cstr, length);
+  len += length;
+  buffer()[len] = 0;
+  return true;
+}
+
+bool String::concat(const String &str)
+{
+  return concat(str.buffer(), str.len);
+}
+
+bool String::concat(const char *cstr)
+{
+  return cstr ? concat(cstr, strlen(cstr)) : false;
+}
+
+bool String::concat(char c)
+{
+  return concat(&c, 1);
+}
+
+bool String::equals(const String &s) const
+{
+  return len == s.len && memcmp(buffer(), s.buffer(), len) == 0;
+}
+
+bool String::equals(const char *cstr) const
+{
+  return cstr ? strcmp(buffer(), cstr) == 0 : len == 0;
+}
+
+bool String::startsWith(const String &prefix) const
+{
+  return prefix.len <= len && memcmp(buffer(), prefix.buffer(), prefix.len) == 0;
+}
+
+bool String::startsWith(const char *prefix) const
+{
+  size_t n = strlen(prefix);
+  return n <= len && memcmp(buffer(), prefix, n) == 0;
+}
+
+char String::charAt(unsigned int index) const
+{
+  return index < len ? buffer()[index] : 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const
+{
+  for (unsigned int i = fromIndex; i < len; i++)
+  {
+    if (buffer()[i] == ch)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const
+{
+  if (beginIndex > endIndex)
+  {
+    unsigned int t = beginIndex;
+    beginIndex = endIndex;
+    endIndex = t;
+  }
+  if (beginIndex > len)
+  {
+    return String();
+  }
+  if (endIndex > len)
+  {
+    endIndex = len;
+  }
+  String out;
+  out.assign(buffer() + beginIndex, endIndex - beginIndex);
+  return out;
+}
+
+void String::trim()
+{
+  unsigned int begin = 0;
+  while (begin < len && isspace((unsigned char)buffer()[begin]))
+  {
+    begin++;
+  }
+  unsigned int end = len;
+  while (end > begin && isspace((unsigned char)buffer()[end - 1]))
+  {
+    end--;
+  }
+  memmove(buffer(), buffer() + begin, end - begin);
+  len = end - begin;
+  buffer()[len] = 0;
+}
+
+long String::toInt() const
+{
+  return atol(buffer());
+}
+
+float String::toFloat() const
+{
+  return atof(buffer());
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+String operator+(const String &lhs, const char *rhs)
+{
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+String operator+(const char *lhs, const String &rhs)
+{
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+String operator+(const String &lhs, char rhs)
+{
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+// ---------------------------------------------------------------------------
+// Serial
+
+size_t HardwareSerial::write(const uint8_t *data, size_t size)
+{
+  SimStats.SerialBytes += size;
+  if (SimEchoSerial)
+  {
+    fwrite(data, 1, size, stdout);
+  }
+  return size;
+}
+
+size_t HardwareSerial::print(const char *s)
+{
+  return write((const uint8_t *)s, strlen(s));
+}
+
+size_t HardwareSerial::print(long value)
+{
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", value);
+  return print(buf);
+}
+
+size_t HardwareSerial::println(const char *s)
+{
+  return print(s) + print("\r\n");
+}
+
+size_t HardwareSerial::println(long value)
+{
+  return print(value) + print("\r\n");
+}
+
+size_t HardwareSerial::printf(const char *format, ...)
+{
+  char buf[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (n < 0)
+  {
+    return 0;
+  }
+  return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+}
+
+// ---------------------------------------------------------------------------
+// ESP
+
+void EspClass::restart()
+{
+  SimStats.Restarts++;
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+  return SimHeapSize - (uint32_t)SimAlloc.LiveBytes;
+}
+
+uint32_t EspClass::getMinFreeHeap()
+{
+  return SimHeapSize - (uint32_t)SimAlloc.PeakLiveBytes;
+}
+
+uint32_t EspClass::getHeapSize()
+{
+  return SimHeapSize;
+}
+
+uint32_t EspClass::getCycleCount()
+{
+  // 160 MHz core clock, as configured in sdkconfig. Virtual time covers
+  // blocking; host CPU time stands in for the cycles the code itself takes.
+  uint64_t hostNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                           .count();
+  return (uint32_t)(SimMicros() * 160 + hostNanos * 160 / 1000);
+}
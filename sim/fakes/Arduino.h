@@ -0,0 +1,180 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// Host stand-in for the ESP32 Arduino core, used by [env:native] only.
+// Time is virtual: millis()/micros() read the simulation clock and delay()
+// advances it, so blocking code shows up as blocked time instead of wall time.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <ctype.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define PULLUP 0x04
+#define INPUT_PULLUP 0x05
+#define PULLDOWN 0x08
+#define INPUT_PULLDOWN 0x09
+
+#define CHANGE 0x03
+#define RISING 0x01
+#define FALLING 0x02
+
+#define PROGMEM
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define F(s) (s)
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum
+{
+  ESP_LOG_NONE,
+  ESP_LOG_ERROR,
+  ESP_LOG_WARN,
+  ESP_LOG_INFO,
+  ESP_LOG_DEBUG,
+  ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+inline void esp_log_level_set(const char *, esp_log_level_t) {}
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+inline void yield() {}
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t val);
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+class String
+{
+public:
+  String(const char *cstr = "");
+  String(const String &str);
+  String(String &&str);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+  ~String();
+
+  String &operator=(const String &rhs);
+  String &operator=(String &&rhs);
+  String &operator=(const char *cstr);
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len; }
+  const char *c_str() const { return buffer(); }
+
+  bool concat(const String &str);
+  bool concat(const char *cstr);
+  bool concat(const char *cstr, unsigned int length);
+  bool concat(char c);
+  String &operator+=(const String &rhs)
+  {
+    concat(rhs);
+    return *this;
+  }
+  String &operator+=(const char *cstr)
+  {
+    concat(cstr);
+    return *this;
+  }
+  String &operator+=(char c)
+  {
+    concat(c);
+    return *this;
+  }
+
+  bool equals(const String &s) const;
+  bool equals(const char *cstr) const;
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+
+  bool startsWith(const String &prefix) const;
+  bool startsWith(const char *prefix) const;
+  char charAt(unsigned int index) const;
+  char operator[](unsigned int index) const { return charAt(index); }
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, len); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  void trim();
+  long toInt() const;
+  float toFloat() const;
+
+private:
+  // Mirrors the small string optimisation of the ESP32 core (11 chars inline)
+  enum
+  {
+    SsoCapacity = 11
+  };
+  char *buffer() { return heap ? heap : sso; }
+  const char *buffer() const { return heap ? heap : sso; }
+  bool assign(const char *cstr, unsigned int length);
+
+  char *heap;
+  unsigned int capacity;
+  unsigned int len;
+  char sso[SsoCapacity + 1];
+};
+
+String operator+(const String &lhs, const String &rhs);
+String operator+(const String &lhs, const char *rhs);
+String operator+(const char *lhs, const String &rhs);
+String operator+(const String &lhs, char rhs);
+
+class HardwareSerial
+{
+public:
+  void begin(unsigned long) {}
+  size_t write(const uint8_t *data, size_t size);
+  size_t print(const char *s);
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(long value);
+  size_t println(const char *s = "");
+  size_t println(const String &s) { return println(s.c_str()); }
+  size_t println(long value);
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  int available() { return 0; }
+  int read() { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass
+{
+public:
+  void restart();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getHeapSize();
+  uint32_t getCycleCount();
+};
+
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef Bounce2_h
+#define Bounce2_h
+
+// Host stand-in for thomasfredericks/Bounce2, reading the simulated pin
+// levels through digitalRead() with the same stable-interval debounce.
+
+#include "Arduino.h"
+
+class Bounce
+{
+public:
+  Bounce() : pin(0), intervalMillis(10), previousMillis(0), state(0) {}
+
+  void attach(int attachPin, int mode)
+  {
+    pinMode(attachPin, mode);
+    attach(attachPin);
+  }
+  void attach(int attachPin)
+  {
+    pin = attachPin;
+    state = digitalRead(pin) ? (DebouncedState | UnstableState) : 0;
+    previousMillis = millis();
+  }
+  void interval(uint16_t intervalMs) { intervalMillis = intervalMs; }
+
+  bool update()
+  {
+    state &= ~ChangedState;
+    bool current = digitalRead(pin);
+    if (current != (bool)(state & UnstableState))
+    {
+      previousMillis = millis();
+      state ^= UnstableState;
+    }
+    else if (millis() - previousMillis >= intervalMillis)
+    {
+      if ((bool)(state & DebouncedState) != current)
+      {
+        previousMillis = millis();
+        state ^= DebouncedState;
+        state |= ChangedState;
+      }
+    }
+    return state & ChangedState;
+  }
+
+  bool read() const { return state & DebouncedState; }
+  bool changed() const { return state & ChangedState; }
+  bool rose() const { return (state & DebouncedState) && (state & ChangedState); }
+  bool fell() const { return !(state & DebouncedState) && (state & ChangedState); }
+
+private:
+  enum
+  {
+    DebouncedState = 1,
+    UnstableState = 2,
+    ChangedState = 4
+  };
+
+  uint8_t pin;
+  uint16_t intervalMillis;
+  unsigned long previousMillis;
+  uint8_t state;
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "DallasTemperature.h"
+#include "SimHarness.h"
+
+uint8_t DallasTemperature::getDeviceCount()
+{
+  return SimSensorCount();
+}
+
+bool DallasTemperature::getAddress(uint8_t *deviceAddress, uint8_t index)
+{
+  SimSensor *sensor = SimSensorAt(index);
+  if (!sensor)
+  {
+    return false;
+  }
+  memcpy(deviceAddress, sensor->Address, 8);
+  return true;
+}
+
+bool DallasTemperature::isConnected(const uint8_t *deviceAddress)
+{
+  return SimFindSensor(deviceAddress) != nullptr;
+}
+
+bool DallasTemperature::validAddress(const uint8_t *deviceAddress)
+{
+  return deviceAddress[0] != 0;
+}
+
+uint8_t DallasTemperature::getResolution()
+{
+  uint8_t resolution = 9;
+  for (uint8_t i = 0; i < SimSensorCount(); i++)
+  {
+    if (SimSensorAt(i)->Resolution > resolution)
+    {
+      resolution = SimSensorAt(i)->Resolution;
+    }
+  }
+  return resolution;
+}
+
+uint8_t DallasTemperature::getResolution(const uint8_t *deviceAddress)
+{
+  SimSensor *sensor = SimFindSensor(deviceAddress);
+  return sensor ? sensor->Resolution : 0;
+}
+
+bool DallasTemperature::setResolution(const uint8_t *deviceAddress, uint8_t newResolution, bool)
+{
+  SimSensor *sensor = SimFindSensor(deviceAddress);
+  if (!sensor)
+  {
+    return false;
+  }
+  sensor->Resolution = newResolution < 9 ? 9 : (newResolution > 12 ? 12 : newResolution);
+  return true;
+}
+
+int16_t DallasTemperature::millisToWaitForConversion(uint8_t bitResolution)
+{
+  switch (bitResolution)
+  {
+  case 9:
+    return 94;
+  case 10:
+    return 188;
+  case 11:
+    return 375;
+  default:
+    return 750;
+  }
+}
+
+void DallasTemperature::startConversion(uint8_t bitResolution)
+{
+  SimStats.SensorConversions++;
+  conversionStart = millis();
+  conversionWait = millisToWaitForConversion(bitResolution);
+  if (waitForConversion)
+  {
+    delay(conversionWait);
+  }
+}
+
+void DallasTemperature::requestTemperatures()
+{
+  startConversion(getResolution());
+}
+
+bool DallasTemperature::requestTemperaturesByAddress(const uint8_t *deviceAddress)
+{
+  SimSensor *sensor = SimFindSensor(deviceAddress);
+  if (!sensor)
+  {
+    return false;
+  }
+  startConversion(sensor->Resolution);
+  return true;
+}
+
+bool DallasTemperature::isConversionComplete()
+{
+  return millis() - conversionStart >= conversionWait;
+}
+
+float DallasTemperature::getTempC(const uint8_t *deviceAddress)
+{
+  SimSensor *sensor = SimFindSensor(deviceAddress);
+  if (!sensor)
+  {
+    return DEVICE_DISCONNECTED_C;
+  }
+  SimStats.SensorReads++;
+  if (sensor->FaultReads)
+  {
+    sensor->FaultReads--;
+    return sensor->FaultValue;
+  }
+  // Quantise to the sensor resolution like the scratchpad does
+  float step = 1.0f / (1 << (sensor->Resolution - 8));
+  return roundf(sensor->TempC / step) * step;
+}
@@ -0,0 +1,50 @@
+#ifndef DallasTemperature_h
+#define DallasTemperature_h
+
+// Host stand-in for milesburton/DallasTemperature. The sensors on the bus and
+// their temperatures come from SimHarness; conversion time follows the
+// DS18B20 datasheet so non-blocking callers see realistic timing.
+
+#include "Arduino.h"
+#include "OneWire.h"
+
+typedef uint8_t DeviceAddress[8];
+
+#define DEVICE_DISCONNECTED_C -127
+#define DEVICE_DISCONNECTED_RAW -7040
+
+class DallasTemperature
+{
+public:
+  explicit DallasTemperature(OneWire *oneWire) : bus(oneWire), waitForConversion(true), conversionStart(0), conversionWait(0) {}
+
+  void begin() {}
+  uint8_t getDeviceCount();
+  bool getAddress(uint8_t *deviceAddress, uint8_t index);
+  bool isConnected(const uint8_t *deviceAddress);
+  bool validAddress(const uint8_t *deviceAddress);
+
+  uint8_t getResolution();
+  uint8_t getResolution(const uint8_t *deviceAddress);
+  bool setResolution(const uint8_t *deviceAddress, uint8_t newResolution, bool skipGlobalBitResolutionCalculation = false);
+
+  void setWaitForConversion(bool flag) { waitForConversion = flag; }
+  bool getWaitForConversion() { return waitForConversion; }
+
+  void requestTemperatures();
+  bool requestTemperaturesByAddress(const uint8_t *deviceAddress);
+  bool isConversionComplete();
+  int16_t millisToWaitForConversion(uint8_t bitResolution);
+
+  float getTempC(const uint8_t *deviceAddress);
+
+private:
+  void startConversion(uint8_t bitResolution);
+
+  OneWire *bus;
+  bool waitForConversion;
+  unsigned long conversionStart;
+  unsigned long conversionWait;
+};
+
+#endif
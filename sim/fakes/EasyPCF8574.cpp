@@ -0,0 +1,35 @@
+#include "EasyPCF8574.h"
+#include "Wire.h"
+
+bool EasyPCF8574::startI2C(int sda, int scl)
+{
+  Wire.begin(sda, scl);
+  write();
+  return true;
+}
+
+void EasyPCF8574::WriteBit(bool bitValue, uint8_t bit)
+{
+  if (bitValue)
+  {
+    value |= (1 << bit);
+  }
+  else
+  {
+    value &= ~(1 << bit);
+  }
+  write();
+}
+
+void EasyPCF8574::setPCFValue(uint8_t newValue)
+{
+  value = newValue;
+  write();
+}
+
+void EasyPCF8574::write()
+{
+  Wire.beginTransmission(address);
+  Wire.write(value);
+  Wire.endTransmission();
+}
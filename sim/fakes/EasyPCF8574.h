@@ -0,0 +1,28 @@
+#ifndef EasyPCF8574_h
+#define EasyPCF8574_h
+
+// Host stand-in for djamessuhanko/EasyPCF8574. Every write is one I2C
+// transaction on the fake Wire carrying the whole port byte.
+
+#include "Arduino.h"
+
+class EasyPCF8574
+{
+public:
+  EasyPCF8574(uint8_t addr, uint8_t initial) : address(addr), value(initial) {}
+
+  bool startI2C(int sda, int scl);
+  bool startI2C() { return startI2C(21, 22); }
+  void WriteBit(bool bitValue, uint8_t bit);
+  bool ReadBit(uint8_t bit) { return value & (1 << bit); }
+  void setPCFValue(uint8_t newValue);
+  uint8_t getPCFValue() { return value; }
+
+private:
+  void write();
+
+  uint8_t address;
+  uint8_t value;
+};
+
+#endif
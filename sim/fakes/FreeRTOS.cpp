@@ -0,0 +1,102 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "SimHarness.h"
+
+struct SimEventGroup
+{
+  EventBits_t Bits;
+};
+
+static bool BitsReady(EventGroupHandle_t group, EventBits_t bits, BaseType_t waitForAllBits)
+{
+  return waitForAllBits ? (group->Bits & bits) == bits : (group->Bits & bits) != 0;
+}
+
+EventGroupHandle_t xEventGroupCreate()
+{
+  return new SimEventGroup{0};
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+  group->Bits |= bits;
+  return group->Bits;
+}
+
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t *higherPriorityTaskWoken)
+{
+  group->Bits |= bits;
+  if (higherPriorityTaskWoken)
+  {
+    *higherPriorityTaskWoken = pdFALSE;
+  }
+  return pdPASS;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+  EventBits_t before = group->Bits;
+  group->Bits &= ~bits;
+  return before;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAllBits, TickType_t ticksToWait)
+{
+  if (SimIdleWait && ticksToWait)
+  {
+    uint64_t deadline = ticksToWait == portMAX_DELAY ? UINT64_MAX : SimMicros() + (uint64_t)ticksToWait * 1000;
+    while (!BitsReady(group, bits, waitForAllBits))
+    {
+      uint64_t next = SimNextEventAt();
+      uint64_t until = next < deadline ? next : deadline;
+      if (until == UINT64_MAX)
+      {
+        // Nothing scripted could ever wake it
+        break;
+      }
+      uint64_t now = SimMicros();
+      uint64_t idle = until > now ? until - now : 0;
+      SimStats.IdleMicros += idle;
+      SimAdvance(idle);
+      if (until == deadline)
+      {
+        break;
+      }
+    }
+  }
+
+  EventBits_t result = group->Bits;
+  if (clearOnExit && BitsReady(group, bits, waitForAllBits))
+  {
+    group->Bits &= ~bits;
+  }
+  return result;
+}
+
+uint32_t ulTaskGetIdleRunTimeCounter()
+{
+  return (uint32_t)SimStats.IdleMicros;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *, uint32_t, void *parameters, UBaseType_t,
+                                   TaskHandle_t *createdTask, BaseType_t)
+{
+  if (createdTask)
+  {
+    *createdTask = nullptr;
+  }
+  function(parameters);
+  return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t)
+{
+}
+
+int64_t esp_timer_get_time()
+{
+  return (int64_t)SimMicros();
+}
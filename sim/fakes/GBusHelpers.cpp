@@ -0,0 +1,38 @@
+#include "GBusHelpers.h"
+#include "WiFi.h"
+
+String getValue(String data, char separator, int index)
+{
+  int found = 0;
+  int strIndex[] = {0, -1};
+  int maxIndex = data.length() - 1;
+
+  for (int i = 0; i <= maxIndex && found <= index; i++)
+  {
+    if (data.charAt(i) == separator || i == maxIndex)
+    {
+      found++;
+      strIndex[0] = strIndex[1] + 1;
+      strIndex[1] = (i == maxIndex) ? i + 1 : i;
+    }
+  }
+  return found > index ? data.substring(strIndex[0], strIndex[1]) : "";
+}
+
+int getWifiStrength(int points)
+{
+  long rssi = 0;
+  for (int i = 0; i < points; i++)
+  {
+    rssi += WiFi.RSSI();
+  }
+  return rssi / points;
+}
+
+String hextab_to_string(uint8_t *hextab)
+{
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
+           hextab[0], hextab[1], hextab[2], hextab[3], hextab[4], hextab[5]);
+  return String(buf);
+}
@@ -0,0 +1,12 @@
+#ifndef GBusHelpers_H
+#define GBusHelpers_H
+
+// Host stand-in for GBusLib/GBusHelpers
+
+#include "Arduino.h"
+
+String getValue(String data, char separator, int index);
+int getWifiStrength(int points);
+String hextab_to_string(uint8_t *hextab);
+
+#endif
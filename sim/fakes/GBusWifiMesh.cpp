@@ -0,0 +1,59 @@
+#include "GBusWifiMesh.h"
+#include "SimHarness.h"
+
+static MeshApp *Instance = nullptr;
+
+esp_err_t esp_mesh_get_parent_bssid(mesh_addr_t *bssid)
+{
+  static const uint8_t parent[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0xFE};
+  memcpy(bssid->addr, parent, sizeof(parent));
+  return ESP_OK;
+}
+
+uint64_t SimMeshAssociationUs = 0;
+
+void MeshApp::start(bool)
+{
+  Instance = this;
+  if (!connectedCallback || SimMeshAssociationUs == SIM_MESH_NO_ROOT)
+  {
+    return;
+  }
+  if (!SimMeshAssociationUs)
+  {
+    connectedCallback();
+    return;
+  }
+  MeshConnectedCallback callback = connectedCallback;
+  SimScheduleIn(SimMeshAssociationUs, callback);
+}
+
+void MeshApp::SendMessage(String &msg)
+{
+  SimStats.MeshOut++;
+  SimStats.MeshOutBytes += msg.length();
+  if (SimOnMeshSend)
+  {
+    SimAllocPause pause;
+    SimOnMeshSend(msg.c_str(), msg.length());
+  }
+}
+
+void SimInjectMeshMessage(const char *payload, const uint8_t srcMac[6])
+{
+  SimInjectMeshMessage(payload, strlen(payload), srcMac);
+}
+
+void SimInjectMeshMessage(const char *payload, size_t length, const uint8_t srcMac[6])
+{
+  SimStats.MeshIn++;
+  if (Instance && Instance->messageCallback)
+  {
+    uint8_t mac[6];
+    memcpy(mac, srcMac, sizeof(mac));
+    // Binary payloads may contain NUL bytes
+    String msg;
+    msg.concat(payload, length);
+    Instance->messageCallback(msg, mac);
+  }
+}
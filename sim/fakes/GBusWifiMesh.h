@@ -0,0 +1,44 @@
+#ifndef GBusWifiMesh_H
+#define GBusWifiMesh_H
+
+// Host stand-in for GBusLib/GBusWifiMesh and the parts of ESP-MDF it pulls in.
+// SendMessage() hands every outbound packet to SimOnMeshSend and counts it;
+// inbound traffic is injected with SimInjectMeshMessage(). start() returns
+// right away; the node counts as connected SimMeshAssociationUs later.
+
+#include "Arduino.h"
+
+static const char *TAG = "GBusMesh";
+
+#define CheckForRootNodeIntervall 5 * 60 * 1000
+
+#define MDF_LOGE(format, ...) ((void)0)
+#define MDF_LOGW(format, ...) ((void)0)
+#define MDF_LOGI(format, ...) ((void)0)
+#define MDF_LOGD(format, ...) ((void)0)
+#define MDF_LOGV(format, ...) ((void)0)
+
+typedef union
+{
+  uint8_t addr[6];
+} mesh_addr_t;
+
+esp_err_t esp_mesh_get_parent_bssid(mesh_addr_t *bssid);
+
+typedef void (*MeshMessageCallback)(String msg, uint8_t SrcMac[6]);
+typedef void (*MeshConnectedCallback)();
+
+class MeshApp
+{
+public:
+  void onMessage(MeshMessageCallback callback) { messageCallback = callback; }
+  void onConnected(MeshConnectedCallback callback) { connectedCallback = callback; }
+  void start(bool root);
+  void Task() {}
+  void SendMessage(String &msg);
+
+  MeshMessageCallback messageCallback = nullptr;
+  MeshConnectedCallback connectedCallback = nullptr;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef OneWire_h
+#define OneWire_h
+
+// Host stand-in for the OneWire bus; the devices live in SimHarness
+
+#include "Arduino.h"
+
+class OneWire
+{
+public:
+  explicit OneWire(uint8_t pin) : pin(pin) {}
+  uint8_t reset() { return 1; }
+
+  uint8_t pin;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "Preferences.h"
+#include "SimHarness.h"
+
+uint32_t SimNvsFailWrites = 0;
+
+bool Preferences::begin(const char *name, bool ro, const char *)
+{
+  // NVS namespaces are limited to 15 characters
+  if (strlen(name) > 15)
+  {
+    return false;
+  }
+  space = name;
+  readOnly = ro;
+  open = true;
+  return true;
+}
+
+bool Preferences::clear()
+{
+  if (!open || readOnly)
+  {
+    return false;
+  }
+  SimNvsClear(space.c_str());
+  return true;
+}
+
+bool Preferences::remove(const char *key)
+{
+  if (!open || readOnly)
+  {
+    return false;
+  }
+  return SimNvsErase(space.c_str(), key);
+}
+
+bool Preferences::isKey(const char *key)
+{
+  return open && SimNvsFind(space.c_str(), key) != nullptr;
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len)
+{
+  // Keys are limited to 15 characters, blobs to what fits the partition
+  if (!open || readOnly || strlen(key) > 15 || !len)
+  {
+    return 0;
+  }
+  if (SimNvsFailWrites)
+  {
+    SimNvsFailWrites--;
+    return 0;
+  }
+  SimNvsWrite(space.c_str(), key, (const uint8_t *)value, len);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char *key)
+{
+  const std::vector<uint8_t> *value = open ? SimNvsFind(space.c_str(), key) : nullptr;
+  return value ? value->size() : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen)
+{
+  const std::vector<uint8_t> *value = open ? SimNvsFind(space.c_str(), key) : nullptr;
+  if (!value || value->size() > maxLen)
+  {
+    return 0;
+  }
+  memcpy(buf, value->data(), value->size());
+  return value->size();
+}
@@ -0,0 +1,31 @@
+#ifndef _PREFERENCES_H_
+#define _PREFERENCES_H_
+
+// Host stand-in for the arduino-esp32 Preferences (NVS) library. Entries
+// live in SimHarness so they survive a simulated reboot; every put counts
+// as one NVS write in SimStats.
+
+#include "Arduino.h"
+
+class Preferences
+{
+public:
+  Preferences() : open(false), readOnly(false) {}
+
+  bool begin(const char *name, bool readOnly = false, const char *partition_label = nullptr);
+  void end() { open = false; }
+  bool clear();
+  bool remove(const char *key);
+  bool isKey(const char *key);
+
+  size_t putBytes(const char *key, const void *value, size_t len);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buf, size_t maxLen);
+
+private:
+  String space;
+  bool open;
+  bool readOnly;
+};
+
+#endif
@@ -0,0 +1,219 @@
+#include "SH1106Wire.h"
+#include "SimHarness.h"
+#include "Wire.h"
+
+// width, height, first char, char count
+const uint8_t ArialMT_Plain_10[] = {0x0A, 0x0D, 0x20, 0xE0};
+
+static const uint8_t GlyphWidth = 6;
+
+SH1106Wire::SH1106Wire(uint8_t address, int, int, OLEDDISPLAY_GEOMETRY, HW_I2C, int)
+    : buffer(nullptr), buffer_back(nullptr), address(address), font(ArialMT_Plain_10), color(WHITE)
+{
+}
+
+SH1106Wire::~SH1106Wire()
+{
+  free(buffer);
+  free(buffer_back);
+}
+
+bool SH1106Wire::init()
+{
+  size_t size = displayWidth * displayHeight / 8;
+  buffer = (uint8_t *)calloc(size, 1);
+  buffer_back = (uint8_t *)malloc(size);
+  Wire.begin();
+  // Force the first display() to push the whole frame
+  memset(buffer_back, 0xFF, size);
+  return buffer && buffer_back;
+}
+
+void SH1106Wire::clear()
+{
+  memset(buffer, 0, displayWidth * displayHeight / 8);
+}
+
+void SH1106Wire::setPixel(int16_t x, int16_t y)
+{
+  if (x < 0 || x >= displayWidth || y < 0 || y >= displayHeight)
+  {
+    return;
+  }
+  uint8_t *cell = &buffer[x + (y / 8) * displayWidth];
+  uint8_t bit = 1 << (y & 7);
+  switch (color)
+  {
+  case WHITE:
+    *cell |= bit;
+    break;
+  case BLACK:
+    *cell &= ~bit;
+    break;
+  case INVERSE:
+    *cell ^= bit;
+    break;
+  }
+}
+
+void SH1106Wire::fillRect(int16_t x, int16_t y, int16_t width, int16_t height)
+{
+  for (int16_t py = y; py < y + height; py++)
+  {
+    for (int16_t px = x; px < x + width; px++)
+    {
+      setPixel(px, py);
+    }
+  }
+}
+
+uint16_t SH1106Wire::getStringWidth(const char *text, uint16_t length)
+{
+  (void)text;
+  return length * GlyphWidth;
+}
+
+uint16_t SH1106Wire::drawString(int16_t x, int16_t y, const String &text)
+{
+  const char *s = text.c_str();
+  uint16_t length = text.length();
+  for (uint16_t i = 0; i < length; i++)
+  {
+    uint8_t c = (uint8_t)s[i];
+    for (uint8_t column = 0; column < GlyphWidth - 1; column++)
+    {
+      // Stable per-character column pattern, 10 rows high like the real font
+      uint16_t pattern = (uint16_t)((c * 0x9E37u) >> (column * 2)) | 0x0201;
+      for (uint8_t row = 0; row < 10; row++)
+      {
+        if (pattern & (1 << row))
+        {
+          setPixel(x + i * GlyphWidth + column, y + 2 + row);
+        }
+      }
+    }
+  }
+  return length * GlyphWidth;
+}
+
+void SH1106Wire::display()
+{
+  uint8_t minBoundY = UINT8_MAX;
+  uint8_t maxBoundY = 0;
+  uint8_t minBoundX = UINT8_MAX;
+  uint8_t maxBoundX = 0;
+
+  for (uint8_t y = 0; y < displayHeight / 8; y++)
+  {
+    for (uint8_t x = 0; x < displayWidth; x++)
+    {
+      uint16_t pos = x + y * displayWidth;
+      if (buffer[pos] != buffer_back[pos])
+      {
+        minBoundY = y < minBoundY ? y : minBoundY;
+        maxBoundY = y > maxBoundY ? y : maxBoundY;
+        minBoundX = x < minBoundX ? x : minBoundX;
+        maxBoundX = x > maxBoundX ? x : maxBoundX;
+      }
+      buffer_back[pos] = buffer[pos];
+    }
+  }
+
+  SimStats.DisplayFlushes++;
+  if (minBoundY == UINT8_MAX)
+  {
+    return;
+  }
+
+  // The SH1106 RAM is 132 columns wide, the visible 128 start at column 2
+  uint8_t column = minBoundX + 2;
+  for (uint8_t y = minBoundY; y <= maxBoundY; y++)
+  {
+    sendCommand(0xB0 + y);
+    sendCommand(column & 0x0F);
+    sendCommand(0x10 | (column >> 4));
+
+    for (uint8_t x = minBoundX; x <= maxBoundX;)
+    {
+      Wire.beginTransmission(address);
+      Wire.write(0x40);
+      for (uint8_t k = 0; k < 16 && x <= maxBoundX; k++, x++)
+      {
+        Wire.write(buffer[x + y * displayWidth]);
+      }
+      Wire.endTransmission();
+    }
+  }
+}
+
+void SH1106Wire::sendCommand(uint8_t command)
+{
+  Wire.beginTransmission(address);
+  Wire.write(0x80);
+  Wire.write(command);
+  Wire.endTransmission();
+}
+
+// Model of the panel RAM, fed by the fake Wire with everything sent to 0x3c
+static uint8_t PanelRam[8][132];
+static uint8_t PanelPage = 0;
+static uint8_t PanelColumn = 0;
+
+static void PanelCommand(uint8_t command)
+{
+  if ((command & 0xF0) == 0xB0)
+  {
+    PanelPage = command & 0x07;
+  }
+  else if ((command & 0xF0) == 0x00)
+  {
+    PanelColumn = (PanelColumn & 0xF0) | command;
+  }
+  else if ((command & 0xF0) == 0x10)
+  {
+    PanelColumn = (PanelColumn & 0x0F) | (command & 0x0F) << 4;
+  }
+}
+
+static void PanelData(uint8_t data)
+{
+  if (PanelColumn < 132)
+  {
+    PanelRam[PanelPage][PanelColumn++] = data;
+  }
+}
+
+void SimPanelReceive(const uint8_t *data, size_t length)
+{
+  size_t i = 0;
+  while (i < length)
+  {
+    // Control byte: Co (bit 7) = one byte follows, D/C# (bit 6) = data
+    uint8_t control = data[i++];
+    bool isData = control & 0x40;
+    size_t end = (control & 0x80) ? (i + 1 < length ? i + 1 : length) : length;
+    for (; i < end; i++)
+    {
+      if (isData)
+      {
+        PanelData(data[i]);
+      }
+      else
+      {
+        PanelCommand(data[i]);
+      }
+    }
+  }
+}
+
+bool SimPanelMatches(const uint8_t *frame)
+{
+  for (uint8_t page = 0; page < 8; page++)
+  {
+    if (memcmp(&PanelRam[page][2], frame + page * 128, 128))
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,69 @@
+#ifndef SH1106Wire_h
+#define SH1106Wire_h
+
+// Host stand-in for the ThingPulse SH1106Wire driver. Text is rendered as a
+// deterministic pseudo font so changed strings change pixels, and display()
+// follows the double-buffered driver: only the bounding box of changed bytes
+// is sent over the fake Wire, as single commands and 16-byte data transfers.
+
+#include "Arduino.h"
+
+extern const uint8_t ArialMT_Plain_10[];
+
+enum OLEDDISPLAY_COLOR
+{
+  BLACK = 0,
+  WHITE = 1,
+  INVERSE = 2
+};
+
+enum OLEDDISPLAY_GEOMETRY
+{
+  GEOMETRY_128_64 = 0
+};
+
+enum HW_I2C
+{
+  I2C_ONE,
+  I2C_TWO
+};
+
+class SH1106Wire
+{
+public:
+  SH1106Wire(uint8_t address, int sda, int scl, OLEDDISPLAY_GEOMETRY g = GEOMETRY_128_64, HW_I2C i2cBus = I2C_ONE, int frequency = 700000);
+  ~SH1106Wire();
+
+  bool init();
+  void resetDisplay() {}
+  void displayOn() {}
+  void displayOff() {}
+  void flipScreenVertically() {}
+  void setContrast(uint8_t) {}
+  void setFont(const uint8_t *fontData) { font = fontData; }
+  void setColor(OLEDDISPLAY_COLOR newColor) { color = newColor; }
+
+  void clear();
+  void setPixel(int16_t x, int16_t y);
+  void fillRect(int16_t x, int16_t y, int16_t width, int16_t height);
+  uint16_t drawString(int16_t x, int16_t y, const String &text);
+  uint16_t getStringWidth(const char *text, uint16_t length);
+  void display();
+
+  uint16_t width() const { return displayWidth; }
+  uint16_t height() const { return displayHeight; }
+
+  uint8_t *buffer;
+  uint8_t *buffer_back;
+
+private:
+  void sendCommand(uint8_t command);
+
+  uint8_t address;
+  const uint8_t *font;
+  OLEDDISPLAY_COLOR color;
+  static const uint16_t displayWidth = 128;
+  static const uint16_t displayHeight = 64;
+};
+
+#endif
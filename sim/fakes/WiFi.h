@@ -0,0 +1,47 @@
+#ifndef WiFi_h
+#define WiFi_h
+
+// Host stand-in for the ESP32 WiFi class
+
+#include "Arduino.h"
+
+class IPAddress
+{
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : octets{a, b, c, d} {}
+  String toString() const
+  {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", octets[0], octets[1], octets[2], octets[3]);
+    return String(buf);
+  }
+  uint8_t operator[](int index) const { return octets[index]; }
+
+private:
+  uint8_t octets[4];
+};
+
+class WiFiClass
+{
+public:
+  int8_t RSSI() { return -67; }
+  IPAddress localIP() { return IPAddress(10, 0, 0, 42); }
+  uint8_t *macAddress(uint8_t *mac)
+  {
+    static const uint8_t simMac[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+    memcpy(mac, simMac, 6);
+    return mac;
+  }
+  String macAddress()
+  {
+    uint8_t mac[6];
+    macAddress(mac);
+    char buf[18];
+    snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return String(buf);
+  }
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,90 @@
+#include "Wire.h"
+#include "SimHarness.h"
+
+TwoWire Wire;
+
+static uint8_t LastRelayValue = 0xFF;
+
+uint8_t SimRelayValue()
+{
+  return LastRelayValue;
+}
+
+bool TwoWire::begin(int, int, uint32_t frequency)
+{
+  if (frequency)
+  {
+    clock = frequency;
+  }
+  return true;
+}
+
+void TwoWire::beginTransmission(uint16_t addr)
+{
+  address = addr;
+  length = 0;
+  overflow = false;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (length >= SIM_I2C_BUFFER_LENGTH)
+  {
+    overflow = true;
+    return 0;
+  }
+  buffer[length++] = data;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+  for (size_t i = 0; i < quantity; i++)
+  {
+    if (!write(data[i]))
+    {
+      return i;
+    }
+  }
+  return quantity;
+}
+
+uint8_t TwoWire::endTransmission(bool)
+{
+  if (overflow)
+  {
+    return 1; // data too long for the transmit buffer
+  }
+
+  // Start, address byte, data bytes, stop: 9 clocks per byte
+  uint64_t busMicros = ((uint64_t)(length + 1) * 9 * 1000000 + clock - 1) / clock;
+  SimStats.I2cTransactions++;
+  SimStats.I2cBytes += length + 1;
+  SimStats.I2cBusMicros += busMicros;
+  // The ESP32 driver blocks the calling task for the whole transfer
+  SimAdvance(busMicros);
+
+  if (SimOnI2cWrite)
+  {
+    SimAllocPause pause;
+    SimOnI2cWrite(address, buffer, length);
+  }
+
+  if (address == SIM_PCF8574_ADDRESS && length)
+  {
+    SimStats.RelayWrites++;
+    LastRelayValue = buffer[length - 1];
+    if (SimOnRelayWrite)
+    {
+      SimAllocPause pause;
+      SimOnRelayWrite(LastRelayValue);
+    }
+  }
+  else if (address == SIM_SH1106_ADDRESS)
+  {
+    // Address byte plus payload, as the old per-flush estimate counted it
+    SimStats.DisplayI2cBytes += length + 1;
+    SimPanelReceive(buffer, length);
+  }
+  return 0;
+}
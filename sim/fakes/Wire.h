@@ -0,0 +1,35 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+// Host stand-in for the ESP32 TwoWire master. endTransmission() takes the
+// bus time of the transfer off the virtual clock, counts it and hands the
+// bytes to the device models: the PCF8574 relay card at 0x20 and the
+// SH1106 panel at 0x3c.
+
+#include "Arduino.h"
+
+#define SIM_I2C_BUFFER_LENGTH 128
+
+class TwoWire
+{
+public:
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+  void setClock(uint32_t frequency) { clock = frequency; }
+  uint32_t getClock() const { return clock; }
+
+  void beginTransmission(uint16_t address);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t *data, size_t quantity);
+  uint8_t endTransmission(bool sendStop = true);
+
+private:
+  uint32_t clock = 400000;
+  uint16_t address = 0;
+  uint8_t length = 0;
+  bool overflow = false;
+  uint8_t buffer[SIM_I2C_BUFFER_LENGTH];
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,267 @@
+#include "esp_ota_ops.h"
+#include "SimHarness.h"
+#include <stdio.h>
+#include <string.h>
+
+// 4 MB flash as one file, offsets are flash addresses as in partitions.csv
+static const uint32_t FlashSize = 4 * 1024 * 1024;
+static const uint32_t OtaDataAddress = 0xd000;
+
+static const esp_partition_t Slots[2] = {
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x10000, 1920 * 1024, "ota_0", false},
+    {ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x10000 + 1920 * 1024, 1920 * 1024, "ota_1", false},
+};
+
+static FILE *Flash = nullptr;
+static uint8_t Running = 0;
+
+struct OtaSession
+{
+  const esp_partition_t *Partition;
+  uint32_t Written;
+  uint32_t Erased;
+  bool Open;
+};
+static OtaSession Session;
+
+static bool FlashRead(uint32_t address, void *data, size_t size)
+{
+  if (!Flash && !SimFlashOpen(nullptr))
+  {
+    return false;
+  }
+  SimStats.FlashReadBytes += size;
+  return address + size <= FlashSize && fseek(Flash, address, SEEK_SET) == 0 && fread(data, 1, size, Flash) == size;
+}
+
+static bool FlashErase(uint32_t address)
+{
+  uint8_t sector[SPI_FLASH_SEC_SIZE];
+  memset(sector, 0xFF, sizeof(sector));
+  SimStats.FlashErases++;
+  return fseek(Flash, address, SEEK_SET) == 0 && fwrite(sector, 1, sizeof(sector), Flash) == sizeof(sector);
+}
+
+// NOR programming: bits only go from 1 to 0
+static bool FlashProgram(uint32_t address, const uint8_t *data, size_t size)
+{
+  uint8_t current[256];
+  while (size)
+  {
+    size_t part = size < sizeof(current) ? size : sizeof(current);
+    if (!FlashRead(address, current, part))
+    {
+      return false;
+    }
+    SimStats.FlashReadBytes -= part;
+    for (size_t i = 0; i < part; i++)
+    {
+      current[i] &= data[i];
+    }
+    if (fseek(Flash, address, SEEK_SET) != 0 || fwrite(current, 1, part, Flash) != part)
+    {
+      return false;
+    }
+    SimStats.FlashWriteBytes += part;
+    address += part;
+    data += part;
+    size -= part;
+  }
+  return true;
+}
+
+static uint8_t BootSlot()
+{
+  uint8_t slot = 0;
+  FlashRead(OtaDataAddress, &slot, 1);
+  SimStats.FlashReadBytes--;
+  return slot == 1 ? 1 : 0;
+}
+
+bool SimFlashOpen(const char *path)
+{
+  SimAllocPause pause;
+  SimFlashClose();
+  Flash = path ? fopen(path, "r+b") : nullptr;
+  if (!Flash)
+  {
+    // A new chip: everything erased
+    Flash = path ? fopen(path, "w+b") : tmpfile();
+    if (!Flash)
+    {
+      return false;
+    }
+    for (uint32_t address = 0; address < FlashSize; address += SPI_FLASH_SEC_SIZE)
+    {
+      FlashErase(address);
+    }
+    SimStats.FlashErases -= FlashSize / SPI_FLASH_SEC_SIZE;
+  }
+  Running = BootSlot();
+  return true;
+}
+
+void SimFlashClose()
+{
+  if (Flash)
+  {
+    fclose(Flash);
+    Flash = nullptr;
+  }
+  Session = OtaSession();
+}
+
+bool SimFlashProgram(uint8_t slot, const uint8_t *data, size_t len)
+{
+  if ((!Flash && !SimFlashOpen(nullptr)) || slot > 1 || len > Slots[slot].size)
+  {
+    return false;
+  }
+  for (uint32_t offset = 0; offset < len; offset += SPI_FLASH_SEC_SIZE)
+  {
+    FlashErase(Slots[slot].address + offset);
+  }
+  bool ok = FlashProgram(Slots[slot].address, data, len);
+  FlashErase(OtaDataAddress);
+  ok = ok && FlashProgram(OtaDataAddress, &slot, 1);
+  Running = slot;
+  fflush(Flash);
+  return ok;
+}
+
+bool SimFlashRead(uint8_t slot, uint32_t offset, uint8_t *data, size_t len)
+{
+  return slot <= 1 && offset + len <= Slots[slot].size && FlashRead(Slots[slot].address + offset, data, len);
+}
+
+void SimFlashReboot()
+{
+  Session = OtaSession();
+  Running = BootSlot();
+}
+
+uint8_t SimFlashRunningSlot()
+{
+  return Running;
+}
+
+uint8_t SimFlashBootSlot()
+{
+  return BootSlot();
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+  if (!partition || src_offset + size > partition->size)
+  {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  return FlashRead(partition->address + src_offset, dst, size) ? ESP_OK : ESP_FAIL;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+  if (!Flash)
+  {
+    SimFlashOpen(nullptr);
+  }
+  return &Slots[Running];
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+  return &Slots[BootSlot()];
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+  const esp_partition_t *from = start_from ? start_from : esp_ota_get_running_partition();
+  return from == &Slots[0] ? &Slots[1] : &Slots[0];
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+  if (partition != &Slots[0] && partition != &Slots[1])
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (partition == &Slots[Running])
+  {
+    return ESP_ERR_OTA_PARTITION_CONFLICT;
+  }
+  if (image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES && image_size > partition->size)
+  {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  // As in ESP-IDF: a known size is erased up front, OTA_SIZE_UNKNOWN erases
+  // the whole slot, OTA_WITH_SEQUENTIAL_WRITES sector by sector while writing
+  Session = {partition, 0, 0, true};
+  uint32_t erase = image_size == OTA_WITH_SEQUENTIAL_WRITES ? 0
+                   : image_size == OTA_SIZE_UNKNOWN         ? partition->size
+                                                            : (image_size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+  for (; Session.Erased < erase; Session.Erased += SPI_FLASH_SEC_SIZE)
+  {
+    FlashErase(partition->address + Session.Erased);
+  }
+  *out_handle = 1;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  if (handle != 1 || !Session.Open)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  if (Session.Written == 0 && size && bytes[0] != 0xE9)
+  {
+    return ESP_ERR_OTA_VALIDATE_FAILED;
+  }
+  if (Session.Written + size > Session.Partition->size)
+  {
+    return ESP_ERR_INVALID_SIZE;
+  }
+  for (; Session.Erased < Session.Written + size; Session.Erased += SPI_FLASH_SEC_SIZE)
+  {
+    FlashErase(Session.Partition->address + Session.Erased);
+  }
+  if (!FlashProgram(Session.Partition->address + Session.Written, bytes, size))
+  {
+    return ESP_FAIL;
+  }
+  Session.Written += size;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+  if (handle != 1 || !Session.Open)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  Session.Open = false;
+  uint8_t magic = 0;
+  FlashRead(Session.Partition->address, &magic, 1);
+  fflush(Flash);
+  return Session.Written && magic == 0xE9 ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+  Session.Open = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+  if (partition != &Slots[0] && partition != &Slots[1])
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+  uint8_t slot = partition == &Slots[1];
+  FlashErase(OtaDataAddress);
+  bool ok = FlashProgram(OtaDataAddress, &slot, 1);
+  fflush(Flash);
+  return ok ? ESP_OK : ESP_FAIL;
+}
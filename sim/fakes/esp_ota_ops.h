@@ -0,0 +1,29 @@
+#ifndef esp_ota_ops_h
+#define esp_ota_ops_h
+
+// Host stand-in for the ESP-IDF OTA API on top of the esp_partition fake.
+// Writes behave like NOR flash (erased to 0xFF, programming only clears
+// bits), esp_ota_end() checks the image magic, and the boot slot takes
+// effect with the next SimFlashReboot().
+
+#include "esp_partition.h"
+
+typedef uint32_t esp_ota_handle_t;
+
+#define OTA_SIZE_UNKNOWN 0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES 0xfffffffe
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_OTA_PARTITION_CONFLICT 0x1501
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_boot_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef esp_partition_h
+#define esp_partition_h
+
+// Host stand-in for the ESP-IDF partition API: the two app slots of
+// partitions.csv in the file-backed flash of SimHarness (SimFlashOpen()).
+
+#include "Arduino.h"
+
+#define SPI_FLASH_SEC_SIZE 4096
+
+typedef enum
+{
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef enum
+{
+  ESP_PARTITION_SUBTYPE_APP_OTA_0 = 0x10,
+  ESP_PARTITION_SUBTYPE_APP_OTA_1 = 0x11
+} esp_partition_subtype_t;
+
+typedef struct
+{
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+} esp_partition_t;
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size);
+
+#endif
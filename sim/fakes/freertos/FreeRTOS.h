@@ -0,0 +1,23 @@
+#ifndef FreeRTOS_h
+#define FreeRTOS_h
+
+// Host stand-in for the ESP-IDF FreeRTOS headers, used by [env:native] only.
+// There is one task (loopTask); blocking calls advance the virtual clock.
+// Other tasks run to completion when they are created (freertos/task.h).
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define portYIELD_FROM_ISR()
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef event_groups_h
+#define event_groups_h
+
+#include "freertos/FreeRTOS.h"
+
+typedef TickType_t EventBits_t;
+typedef struct SimEventGroup *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate();
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+BaseType_t xEventGroupSetBitsFromISR(EventGroupHandle_t group, EventBits_t bits, BaseType_t *higherPriorityTaskWoken);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+// Only blocks while SimIdleWait is set: then the virtual clock runs to the
+// next scripted event or the timeout, whichever comes first, and the time
+// counts as idle task time
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAllBits, TickType_t ticksToWait);
+
+#endif
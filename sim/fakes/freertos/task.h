@@ -0,0 +1,20 @@
+#ifndef task_h
+#define task_h
+
+#include "freertos/FreeRTOS.h"
+
+// Run time counter of the idle task in microseconds (esp_timer based, as in
+// sdkconfig), 32 bit like on the device
+uint32_t ulTaskGetIdleRunTimeCounter();
+
+typedef void (*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+
+// Runs the task function to its end right away, on the virtual clock: a
+// task that blocks on the device finishes within the call here, so fakes
+// it calls (MeshApp::start()) schedule what would happen later instead
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *createdTask, BaseType_t coreId);
+void vTaskDelete(TaskHandle_t task);
+
+#endif
@@ -0,0 +1,56 @@
+#include "miniz.h"
+#include <Arduino.h>
+#include <zlib.h>
+
+// sizeof(tdefl_compressor) in miniz's default configuration: the 32 KB
+// dictionary, 64 KB each for the LZ code buffer, hash and chain tables,
+// the 83 KB output buffer and the Huffman tables
+static const uint32_t TdeflStateSize = 319300;
+
+mz_ulong mz_compressBound(mz_ulong source_len)
+{
+  return compressBound(source_len);
+}
+
+int mz_compress2(unsigned char *pDest, mz_ulong *pDest_len, const unsigned char *pSource, mz_ulong source_len, int level)
+{
+  if (ESP.getFreeHeap() < TdeflStateSize)
+  {
+    return MZ_MEM_ERROR;
+  }
+  uLongf length = *pDest_len;
+  int status = compress2(pDest, &length, pSource, source_len, level);
+  *pDest_len = length;
+  return status;
+}
+
+int mz_uncompress(unsigned char *pDest, mz_ulong *pDest_len, const unsigned char *pSource, mz_ulong source_len)
+{
+  uLongf length = *pDest_len;
+  int status = uncompress(pDest, &length, pSource, source_len);
+  *pDest_len = length;
+  return status;
+}
+
+mz_ulong mz_crc32(mz_ulong crc, const unsigned char *ptr, size_t buf_len)
+{
+  return crc32(crc, ptr, buf_len);
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start,
+                              mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags)
+{
+  if (r->m_state || pOut_buf_next != pOut_buf_start || (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ||
+      !(decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) || !(decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF))
+  {
+    return TINFL_STATUS_FAILED;
+  }
+  uLongf length = *pOut_buf_size;
+  uLong consumed = *pIn_buf_size;
+  int status = uncompress2(pOut_buf_next, &length, pIn_buf_next, &consumed);
+  r->m_state = 1;
+  *pOut_buf_size = length;
+  *pIn_buf_size = consumed;
+  // Truncated input and a too small output buffer both end up here
+  return status == Z_OK ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+}
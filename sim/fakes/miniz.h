@@ -0,0 +1,64 @@
+#ifndef MINIZ_HEADER_INCLUDED
+#define MINIZ_HEADER_INCLUDED
+
+// Host stand-in for the miniz zlib-style API, backed by the system zlib.
+// Both produce standard zlib streams, so sizes match the device closely.
+// mz_compress2() fails like miniz does on the node: its deflate state is
+// allocated per call and larger than the whole heap.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned long mz_ulong;
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+#define MZ_OK 0
+#define MZ_MEM_ERROR (-4)
+#define MZ_BUF_ERROR (-5)
+#define MZ_NO_COMPRESSION 0
+#define MZ_BEST_SPEED 1
+#define MZ_BEST_COMPRESSION 9
+#define MZ_DEFAULT_COMPRESSION (-1)
+#define MZ_CRC32_INIT (0)
+
+mz_ulong mz_compressBound(mz_ulong source_len);
+int mz_compress2(unsigned char *pDest, mz_ulong *pDest_len, const unsigned char *pSource, mz_ulong source_len, int level);
+int mz_uncompress(unsigned char *pDest, mz_ulong *pDest_len, const unsigned char *pSource, mz_ulong source_len);
+mz_ulong mz_crc32(mz_ulong crc, const unsigned char *ptr, size_t buf_len);
+
+// Low level inflater. Only the one-shot use is supported: all input at
+// once into a non-wrapping output buffer. The state is as large as
+// miniz's, so static RAM budgets come out the same on the host.
+enum
+{
+  TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+  TINFL_FLAG_HAS_MORE_INPUT = 2,
+  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+  TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum
+{
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+struct tinfl_decompressor
+{
+  mz_uint32 m_state;
+  mz_uint8 m_tables[10992];
+};
+
+#define tinfl_init(r) \
+  do                  \
+  {                   \
+    (r)->m_state = 0; \
+  } while (0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start,
+                              mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags);
+
+#endif
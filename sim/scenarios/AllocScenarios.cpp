@@ -0,0 +1,72 @@
+#include "SimBench.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Heap allocations of a running node. Messages, display lines and log
+// output are built in fixed buffers, so once booted loop() must not touch
+// the heap at all, whatever the gateway sends. Inbound messages arrive as
+// Strings from the mesh library; that copy is made by the mesh task and is
+// not counted (the commands are injected between the loop() calls).
+
+static void Temperatures()
+{
+  static const uint8_t water[8] = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
+  static const uint8_t roof[8] = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
+  static float step = 0;
+  step += 1.0f;
+  SimSetTemperature(water, 24.5f + 0.05f * step);
+  SimSetTemperature(roof, 38.0f + 6.0f * sinf(step / 10.0f));
+  SimScheduleIn(20 * 1000000ULL, Temperatures);
+}
+
+static void EveryCommand()
+{
+  // Everything that answers or publishes, in both telemetry modes and encodings
+  static const char *const commands[] = {
+      "output 7 1", "outputs 192 64", "ValveToHeat 1", "GetNodeInfo", "stats", "schedule", "schedule 1 1 17:00 2 1", "SolarConfig", "SensorRole", "TelemetryMode 1", "ValveToHeat 0",
+      "output 7 0", "Encoding 1", "GetNodeInfo", "WaterMaxTemperature 29", "FilterPumpModeAutomatic 1",
+      "SaltSystemModeAutomatic 1", "SaltSystemAutomaticOnTime 3", "Encoding 0", "TelemetryMode 0", "I'm Root!",
+      "FilterPumpModeAutomatic 0", "SaltSystemModeAutomatic 0", "time 12:00:00", "history 0 0", "history 1 0",
+  };
+  static uint32_t tick = 0;
+  SimInjectCommand(commands[tick++ % (sizeof(commands) / sizeof(commands[0]))]);
+  SimScheduleIn(1500000ULL, EveryCommand);
+}
+
+static void Buttons()
+{
+  static uint32_t tick = 0;
+  SimPressButton(tick++ % 3);
+  SimScheduleIn(3 * 1000000ULL, Buttons);
+}
+
+SIM_SCENARIO(allocFree, "every command, telemetry mode and page: loop() must not allocate")
+{
+  SimSetWallClock(9, 45);
+  SimBootNode();
+  SimStartTimeBroadcasts();
+  Temperatures();
+  SimScheduleIn(500000ULL, EveryCommand);
+  SimScheduleIn(700000ULL, Buttons);
+
+  // Warm up: first use of every path, e.g. the send String growing to its reserve
+  SimLatency warmup;
+  SimOptions first = options;
+  first.Iterations = 60000;
+  SimRunLoop(first, warmup);
+
+  SimResetCounters();
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("allocFree", latency);
+  if (SimAlloc.Allocs)
+  {
+    printf("allocFree      FAILED: %llu allocations, %llu bytes in %llu loop() calls\n",
+           (unsigned long long)SimAlloc.Allocs, (unsigned long long)SimAlloc.Bytes,
+           (unsigned long long)latency.Count());
+    exit(1);
+  }
+  printf("allocFree      %llu mesh messages in, %llu out, 0 allocations\n", (unsigned long long)SimStats.MeshIn,
+         (unsigned long long)SimStats.MeshOut);
+}
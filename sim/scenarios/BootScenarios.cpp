@@ -0,0 +1,208 @@
+#include "SimBench.h"
+#include "SettingsStore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Boot: the relays get their state before the mesh is up, runs resume
+// after a power cut, the node works without a root
+
+extern uint8_t ActualDisplayPage;
+extern uint16_t FilterPumpMinutesLeft;
+extern SettingsStore RunState;
+
+// Relay card bits, active low
+static const uint8_t PumpBit = 1 << 0;
+static const uint8_t SaltPowerBit = 1 << 1;
+
+static void Fail(const char *what)
+{
+  printf("boot           FAILED: %s\n", what);
+  exit(1);
+}
+
+static void RunFor(uint32_t ms)
+{
+  for (uint32_t i = 0; i < ms; i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+}
+
+// Virtual time and value of the first relay write after SimBootNode()
+struct FirstRelayWrite
+{
+  uint64_t At = 0;
+  uint8_t Value = 0xFF;
+  bool Seen = false;
+};
+
+static void WatchRelays(FirstRelayWrite &first, uint64_t boot)
+{
+  SimOnRelayWrite = [&first, boot](uint8_t value) {
+    // The PCF8574 powers up with all outputs high, the first write with a
+    // relay on is the decision
+    if (!first.Seen && value != 0xFF)
+    {
+      first.Seen = true;
+      first.At = SimMicros() - boot;
+      first.Value = value;
+    }
+  };
+}
+
+static unsigned long InfoField(const std::string &info, const char *name)
+{
+  size_t at = info.find(name);
+  return at == std::string::npos ? 0 : strtoul(info.c_str() + at + strlen(name), nullptr, 10);
+}
+
+// First life: the mesh needs 8 s to associate, then a run is started and
+// the power fails 20 minutes into it
+static void FirstBoot(const char *image)
+{
+  SimNvsClear();
+  SimMeshAssociationUs = 8000000ULL;
+  std::string info;
+  uint64_t firstSend = 0;
+  SimOnMeshSend = [&info, &firstSend](const char *data, size_t len) {
+    std::string msg(data, len);
+    if (!firstSend)
+    {
+      firstSend = SimMicros();
+    }
+    if (info.empty() && msg.find("MQTT Info ") == 0)
+    {
+      info = msg;
+    }
+  };
+  FirstRelayWrite first;
+  uint64_t boot = SimMicros();
+  WatchRelays(first, boot);
+  SimBootNode();
+  uint64_t setupDone = SimMicros() - boot;
+  RunFor(10000);
+  SimOnMeshSend = nullptr;
+  SimOnRelayWrite = nullptr;
+  if (setupDone >= 1000000ULL)
+  {
+    Fail("setup() waited for the mesh");
+  }
+  if (info.empty() || firstSend - boot < SimMeshAssociationUs)
+  {
+    Fail("sent before the mesh was up, or no NodeInfo once it was");
+  }
+  unsigned long decisionMs = InfoField(info, "BootDecisionMs:");
+  unsigned long meshUpMs = InfoField(info, "MeshUpMs:");
+  if (!decisionMs || decisionMs >= 1000 || meshUpMs < 8000)
+  {
+    Fail("NodeInfo boot timing");
+  }
+  printf("bootLocal      setup() done after %.0f ms, mesh up after %.1f s, NodeInfo BootDecisionMs:%lu MeshUpMs:%lu\n",
+         setupDone / 1000.0, meshUpMs / 1000.0, decisionMs, meshUpMs);
+
+  SimInjectCommand("FilterPumpModeAutomatic 1");
+  SimInjectCommand("SaltSystemModeAutomatic 1");
+  SimIdleWait = true;
+  uint64_t powerCut = SimMicros() + 20 * 60 * 1000000ULL;
+  while (SimMicros() < powerCut)
+  {
+    loop();
+  }
+  SimIdleWait = false;
+  if (!SimNvsSave(image))
+  {
+    Fail("cannot save the NVS image");
+  }
+}
+
+SIM_SCENARIO(boot, "boot: relays restored before the mesh connects, runs resume without a root")
+{
+  char image[64];
+  snprintf(image, sizeof(image), "/tmp/gbuspool-boot-%d", (int)getpid());
+
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    FirstBoot(image);
+    fflush(stdout);
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    exit(1);
+  }
+
+  // Second life: no root anywhere
+  SimNvsLoad(image);
+  unlink(image);
+  SimMeshAssociationUs = SIM_MESH_NO_ROOT;
+  FirstRelayWrite first;
+  uint64_t boot = SimMicros();
+  WatchRelays(first, boot);
+  SimBootNode();
+  uint16_t minutesLeft = FilterPumpMinutesLeft;
+  RunFor(5000);
+  SimOnRelayWrite = nullptr;
+  if (!first.Seen || (first.Value & (PumpBit | SaltPowerBit)))
+  {
+    Fail("pump and salt system were not resumed with the first relay write");
+  }
+  if (first.At >= 1000000ULL)
+  {
+    Fail("first relay decision took a second or more");
+  }
+
+  // The buttons work without the mesh
+  uint8_t page = ActualDisplayPage;
+  SimPressButton(2);
+  RunFor(500);
+  if (ActualDisplayPage == page)
+  {
+    Fail("button ignored without the mesh");
+  }
+  printf("bootResume     pump and salt system on with the first relay write after %.0f ms, no root, %u min of the run left, button page %u -> %u\n",
+         first.At / 1000.0, minutesLeft, page, ActualDisplayPage);
+
+  // The run ends on its own, within the checkpoint interval of the time
+  // that was left at the power cut
+  SimIdleWait = true;
+  uint64_t resumed = SimMicros();
+  uint64_t timeout = resumed + (minutesLeft + 5) * 60 * 1000000ULL;
+  while (!(SimRelayValue() & PumpBit) && SimMicros() < timeout)
+  {
+    loop();
+  }
+  SimIdleWait = false;
+  double ranMinutes = (SimMicros() - boot) / 60e6;
+  if (!(SimRelayValue() & PumpBit) || ranMinutes > minutesLeft + 0.1 || ranMinutes < minutesLeft - 1)
+  {
+    Fail("resumed run did not end after the time left");
+  }
+  if (SimStats.MeshOut)
+  {
+    Fail("sent without a root");
+  }
+  printf("bootOutage     pump off %.1f min after the reboot (6 h run, power cut after 20 min), %llu mesh packets sent\n",
+         ranMinutes, (unsigned long long)SimStats.MeshOut);
+
+  // "Reboot" restarts 2 s later; a run started in between is still within
+  // the 1 s run state commit delay
+  uint64_t restarts = SimStats.Restarts;
+  SimInjectCommand("Reboot");
+  RunFor(1500);
+  SimInjectCommand("FilterPumpModeAutomatic 1");
+  RunFor(600);
+  if (SimStats.Restarts == restarts || RunState.Pending() || !FilterPumpMinutesLeft)
+  {
+    Fail("run started right before a reboot was not saved");
+  }
+  printf("bootReboot     run started 0.5 s before the restart: saved with %u min left\n", FilterPumpMinutesLeft);
+}
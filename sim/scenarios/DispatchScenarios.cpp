@@ -0,0 +1,127 @@
+#include "SimBench.h"
+#include "GBusHelpers.h"
+#include "MeshCommand.h"
+#include <vector>
+
+// Mesh command parsing in isolation: the former getValue()/String compare
+// chain against the in-place tokenizer with the sorted command table.
+// Handlers only count, so the numbers are parsing and dispatch cost alone;
+// the table is the firmware's own, names and order, with counting handlers.
+
+extern const MeshCommandEntry MeshCommands[];
+extern const size_t MeshCommandCount;
+
+static const char *const Traffic[] = {
+    "time 10:00",
+    "output 3 1",
+    "I'm Root!",
+    "ValveToHeat 1",
+    "FilterpumpAutomaticOnTime 6",
+    "SaltSystemModeAutomatic 0",
+    "WaterMaxTemperature 30",
+    "GetNodeInfo",
+    "AutomaticStartTime 10",
+    "unknown command 1",
+};
+static const size_t TrafficCount = sizeof(Traffic) / sizeof(Traffic[0]);
+
+static volatile long Sink;
+
+static void Count(const MeshCommandArgs &Args)
+{
+  Sink += Args.Int(1) + Args.Int(2);
+}
+
+static void LegacyDispatch(const String &msg)
+{
+  static const char *const names[] = {
+      "Config", "GetNodeInfo", "Reboot", "time", "output", "FilterPumpModeAutomatic",
+      "FilterpumpAutomaticOnTime", "SaltSystemModeAutomatic", "SaltSystemAutomaticOnTime",
+      "AutomaticStartActive", "AutomaticStartTime", "ValveToHeat", "WaterMaxTemperature",
+      "ValveAutomaticMode"};
+
+  String Type = getValue(msg, ' ', 0);
+  String Number = getValue(msg, ' ', 1);
+  String Command = getValue(msg, ' ', 2);
+
+  if (msg.startsWith("I'm Root!"))
+  {
+    Sink += 1;
+    return;
+  }
+  for (const char *name : names)
+  {
+    if (Type == name)
+    {
+      Sink += getValue(msg, ' ', 1).toInt() + getValue(msg, ' ', 2).toInt();
+      return;
+    }
+  }
+}
+
+static void Report(const char *name, uint64_t messages, uint64_t nanos)
+{
+  printf("%-14s %10llu msgs %12.0f msgs/s %8.1f ns/msg %8.2f allocs/msg %8.1f bytes/msg\n",
+         name, (unsigned long long)messages, messages * 1e9 / nanos, (double)nanos / messages,
+         (double)SimAlloc.Allocs / messages, (double)SimAlloc.Bytes / messages);
+}
+
+SIM_SCENARIO(dispatch, "mesh command parsing: legacy String chain vs command table")
+{
+  uint64_t messages = options.Iterations;
+
+  std::vector<MeshCommandEntry> commands(MeshCommands, MeshCommands + MeshCommandCount);
+  for (MeshCommandEntry &entry : commands)
+  {
+    entry.Handler = Count;
+  }
+  // The traffic must hit the firmware's commands, all but the last line
+  for (size_t i = 0; i < TrafficCount; i++)
+  {
+    char Buffer[MESH_COMMAND_MAX_LENGTH];
+    strncpy(Buffer, Traffic[i], sizeof(Buffer) - 1);
+    Buffer[sizeof(Buffer) - 1] = 0;
+    if (MeshCommandDispatch(commands.data(), commands.size(), Buffer) != (i + 1 < TrafficCount))
+    {
+      printf("dispatch       FAILED: \"%s\" does not match the firmware's command table\n", Traffic[i]);
+      exit(1);
+    }
+  }
+
+  // Both paths get the message as the String the mesh callback delivers
+  String *inbound = new String[TrafficCount];
+  for (size_t i = 0; i < TrafficCount; i++)
+  {
+    inbound[i] = Traffic[i];
+  }
+
+  SimResetCounters();
+  uint64_t start = SimHostNanos();
+  SimAllocTracking(true);
+  for (uint64_t i = 0; i < messages; i++)
+  {
+    LegacyDispatch(inbound[i % TrafficCount]);
+  }
+  SimAllocTracking(false);
+  Report("dispatchLegacy", messages, SimHostNanos() - start);
+
+  SimResetCounters();
+  start = SimHostNanos();
+  SimAllocTracking(true);
+  for (uint64_t i = 0; i < messages; i++)
+  {
+    const String &msg = inbound[i % TrafficCount];
+    char Buffer[MESH_COMMAND_MAX_LENGTH];
+    strncpy(Buffer, msg.c_str(), sizeof(Buffer) - 1);
+    Buffer[sizeof(Buffer) - 1] = 0;
+    MeshCommandDispatch(commands.data(), commands.size(), Buffer);
+  }
+  SimAllocTracking(false);
+  Report("dispatchTable", messages, SimHostNanos() - start);
+
+  if (SimAlloc.Allocs)
+  {
+    printf("dispatchTable allocated %llu times, expected none\n", (unsigned long long)SimAlloc.Allocs);
+    exit(1);
+  }
+}
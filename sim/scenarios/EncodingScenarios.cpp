@@ -0,0 +1,179 @@
+#include "SimBench.h"
+#include "MeshCommand.h"
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+// Telemetry and command encoding: the JSON/text protocol against the
+// MessagePack encoding a gateway can opt into with "Encoding 1".
+
+// Minimal MessagePack array writer for the gateway side of the benchmark
+static size_t PackCommand(uint8_t *out, const char *line)
+{
+  char copy[MESH_COMMAND_MAX_LENGTH];
+  strncpy(copy, line, sizeof(copy) - 1);
+  copy[sizeof(copy) - 1] = 0;
+  MeshCommandArgs args;
+  MeshCommandTokenize(copy, args);
+
+  size_t used = 0;
+  out[used++] = 0x90 | args.Count;
+  for (uint8_t i = 0; i < args.Count; i++)
+  {
+    // Small whole-token numbers become positive fixints, "10:00" stays text
+    long value;
+    if (strspn(args.Token[i], "0123456789") == strlen(args.Token[i]) && MeshParseInt(args.Token[i], value) && value < 128)
+    {
+      out[used++] = (uint8_t)value;
+      continue;
+    }
+    size_t length = strlen(args.Token[i]);
+    out[used++] = 0xA0 | (uint8_t)length;
+    memcpy(out + used, args.Token[i], length);
+    used += length;
+  }
+  return used;
+}
+
+static const char *const Commands[] = {
+    "time 10:00",
+    "output 3 1",
+    "I'm Root!",
+    "ValveToHeat 1",
+    "FilterpumpAutomaticOnTime 6",
+    "WaterMaxTemperature 30",
+    "GetNodeInfo",
+};
+static const size_t CommandCount = sizeof(Commands) / sizeof(Commands[0]);
+
+static void FillStrings(JsonDocument &doc)
+{
+  doc["WaterTemp"] = String(24.5f);
+  doc["VLTemp"] = String(31.0f);
+  doc["RLTemp"] = String(27.25f);
+  doc["TemperatureGarageRoof"] = String(38.06f);
+  doc["ValveAutomaticMode"] = String(1);
+  doc["WaterMaxTemperature"] = String(30);
+  doc["AutomaticStartActive"] = String(1);
+  doc["SaltSystemModeAutomatic"] = String(0);
+  doc["SaltSystemAutomaticOnTime"] = String(4);
+  doc["ValveToHeat"] = String(0);
+  doc["FilterPumpModeAutomatic"] = String(0);
+  doc["AutomaticStartTime"] = String(10);
+  doc["FilterpumpAutomaticOnTime"] = String(6);
+}
+
+static void FillTyped(JsonDocument &doc)
+{
+  doc["WaterTemp"] = 24.5f;
+  doc["VLTemp"] = 31.0f;
+  doc["RLTemp"] = 27.25f;
+  doc["TemperatureGarageRoof"] = 38.06f;
+  doc["ValveAutomaticMode"] = true;
+  doc["WaterMaxTemperature"] = 30;
+  doc["AutomaticStartActive"] = true;
+  doc["SaltSystemModeAutomatic"] = false;
+  doc["SaltSystemAutomaticOnTime"] = 4;
+  doc["ValveToHeat"] = false;
+  doc["FilterPumpModeAutomatic"] = false;
+  doc["AutomaticStartTime"] = 10;
+  doc["FilterpumpAutomaticOnTime"] = 6;
+}
+
+static void Report(const char *name, uint64_t count, uint64_t nanos, uint64_t bytes)
+{
+  printf("%-16s %10llu ops %8.1f ns/op %8.1f bytes/op\n", name, (unsigned long long)count,
+         (double)nanos / count, (double)bytes / count);
+}
+
+SIM_SCENARIO(encoding, "values and commands: JSON/text vs MessagePack, bytes and CPU time")
+{
+  uint64_t count = options.Iterations / 10 ? options.Iterations / 10 : 1;
+  char buffer[1000];
+  volatile size_t sink = 0;
+
+  StaticJsonDocument<1000> strings, typed;
+  FillStrings(strings);
+  FillTyped(typed);
+
+  uint64_t bytes = 0, start = SimHostNanos();
+  for (uint64_t i = 0; i < count; i++)
+  {
+    bytes += serializeJson(strings, buffer, sizeof(buffer));
+  }
+  Report("valuesJsonString", count, SimHostNanos() - start, bytes);
+
+  bytes = 0, start = SimHostNanos();
+  for (uint64_t i = 0; i < count; i++)
+  {
+    bytes += serializeJson(typed, buffer, sizeof(buffer));
+  }
+  Report("valuesJsonTyped", count, SimHostNanos() - start, bytes);
+
+  bytes = 0, start = SimHostNanos();
+  for (uint64_t i = 0; i < count; i++)
+  {
+    bytes += serializeMsgPack(typed, buffer, sizeof(buffer));
+  }
+  Report("valuesMsgPack", count, SimHostNanos() - start, bytes);
+
+  uint8_t packed[CommandCount][64];
+  size_t packedLength[CommandCount];
+  for (size_t i = 0; i < CommandCount; i++)
+  {
+    packedLength[i] = PackCommand(packed[i], Commands[i]);
+  }
+
+  bytes = 0, start = SimHostNanos();
+  for (uint64_t i = 0; i < count; i++)
+  {
+    const char *command = Commands[i % CommandCount];
+    size_t length = strlen(command);
+    memcpy(buffer, command, length + 1);
+    MeshCommandArgs args;
+    sink += MeshCommandTokenize(buffer, args);
+    bytes += length;
+  }
+  Report("commandText", count, SimHostNanos() - start, bytes);
+
+  bytes = 0, start = SimHostNanos();
+  for (uint64_t i = 0; i < count; i++)
+  {
+    size_t index = i % CommandCount;
+    MeshCommandArgs args;
+    if (MeshCommandFromMsgPack((const char *)packed[index], packedLength[index], buffer, MESH_COMMAND_MAX_LENGTH))
+    {
+      sink += MeshCommandTokenize(buffer, args);
+    }
+    bytes += packedLength[index];
+  }
+  Report("commandMsgPack", count, SimHostNanos() - start, bytes);
+
+  // End to end: opt in with a binary command, then expect binary values
+  SimBootNode();
+  std::string values;
+  SimOnMeshSend = [&values](const char *data, size_t len) {
+    if (len > 12 && !memcmp(data, "MQTT values ", 12))
+    {
+      values.assign(data, len);
+    }
+  };
+  static const uint8_t gateway[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0xFE};
+  size_t length = PackCommand((uint8_t *)buffer, "Encoding 1");
+  SimInjectMeshMessage(buffer, length, gateway);
+  length = PackCommand((uint8_t *)buffer, "WaterMaxTemperature 28");
+  SimInjectMeshMessage(buffer, length, gateway);
+  SimOptions shortRun = options;
+  shortRun.Iterations = 5000;
+  SimLatency latency;
+  SimRunLoop(shortRun, latency);
+  SimOnMeshSend = nullptr;
+
+  if (values.size() < 13 || ((uint8_t)values[12] & 0xF0) != 0x80)
+  {
+    printf("encoding: node did not switch to MessagePack values\n");
+    exit(1);
+  }
+  printf("%-16s %zu bytes values packet after opting in\n", "encodingNode", values.size());
+}
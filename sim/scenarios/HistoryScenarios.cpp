@@ -0,0 +1,157 @@
+#include "SimBench.h"
+#include "TemperatureHistory.h"
+#include "miniz.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Temperature history: rollup cost per sample and compressed export
+
+extern TemperatureHistory History;
+
+static void Fail(const char *what)
+{
+  printf("history        FAILED: %s\n", what);
+  exit(1);
+}
+
+static void PoolDay(uint32_t minute, float *tempC)
+{
+  // Daily swing on the roof, slow drift in the water, a read error now and then
+  float day = (minute % 1440) / 1440.0f;
+  tempC[0] = 24.0f + 0.5f * sinf(day * 6.283f) + (minute / 1440) * 0.1f;
+  tempC[1] = 30.0f + 6.0f * sinf(day * 6.283f);
+  tempC[2] = 27.0f + 3.0f * sinf(day * 6.283f);
+  tempC[3] = minute % 997 == 0 ? -127.0f : 20.0f + 25.0f * sinf(day * 6.283f);
+}
+
+static uint32_t ReadVarint(const uint8_t *&p)
+{
+  uint32_t value = 0;
+  for (uint8_t shift = 0;; shift += 7)
+  {
+    uint8_t b = *p++;
+    value |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+    {
+      return value;
+    }
+  }
+}
+
+static int32_t ReadDelta(const uint8_t *&p, int32_t &previous)
+{
+  uint32_t zigzag = ReadVarint(p);
+  previous += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+  return previous;
+}
+
+static void ReportExport(const char *name, TemperatureHistory &history, HistoryTier tier)
+{
+  uint8_t plain[2048];
+  uint8_t packed[1280];
+  size_t plainBytes = history.Encode(tier, 0, plain, sizeof(plain));
+  size_t packedBytes = history.Export(tier, 0, packed, sizeof(packed));
+  size_t recordBytes = tier == HistoryRaw ? sizeof(HistorySample) : sizeof(HistoryRollup);
+  uint16_t records = history.Count(tier) < HISTORY_CHUNK_RECORDS ? history.Count(tier) : HISTORY_CHUNK_RECORDS;
+  printf("%-14s %u records/chunk: %zu bytes in RAM, %zu delta-coded, %zu deflated\n", name, records,
+         records * recordBytes, plainBytes, packedBytes);
+}
+
+SIM_SCENARIO(history, "temperature history: rollup cost per sample, export sizes")
+{
+  // Standalone instance with the firmware's ring sizes, fed 90 days of samples
+  static HistorySample raw[360];
+  static HistoryRollup hours[168];
+  static HistoryRollup days[90];
+  TemperatureHistory history(raw, 360, hours, 168, days, 90);
+
+  const uint32_t samples = 90 * 720;
+  SimLatency latency;
+  latency.Reserve(samples);
+  float tempC[HISTORY_CHANNELS];
+  for (uint32_t i = 0; i < samples; i++)
+  {
+    PoolDay(i * 2, tempC);
+    uint64_t start = SimHostNanos();
+    SimAllocTracking(true);
+    history.Add(i * 2, tempC);
+    SimAllocTracking(false);
+    latency.Add(SimHostNanos() - start);
+  }
+  printf("historyAdd     %u samples, p50 %llu ns p99 %llu ns max %llu ns per sample, %llu allocations\n", samples,
+         (unsigned long long)latency.Percentile(50), (unsigned long long)latency.Percentile(99),
+         (unsigned long long)latency.Max(), (unsigned long long)SimAlloc.Allocs);
+  printf("historyMemory  %zu bytes: %u raw, %u hours, %u days stored\n", history.MemoryBytes(),
+         history.Count(HistoryRaw), history.Count(HistoryHours), history.Count(HistoryDays));
+
+  // The newest closed hour must match the raw samples it was built from
+  const HistoryRollup &hour = history.Rollup(HistoryHours, 0);
+  int16_t min = INT16_MAX, max = INT16_MIN;
+  for (uint16_t age = 0; age < history.Count(HistoryRaw); age++)
+  {
+    // Raw minutes wrap at 16 bits, use the minute the sample was added at
+    const HistorySample &sample = history.Sample(age);
+    if ((samples - 1 - age) * 2 / 60 == hour.Period)
+    {
+      min = sample.Value[1] < min ? sample.Value[1] : min;
+      max = sample.Value[1] > max ? sample.Value[1] : max;
+    }
+  }
+  if (min != hour.Min[1] || max != hour.Max[1])
+  {
+    Fail("hourly rollup differs from its raw samples");
+  }
+
+  ReportExport("historyRaw", history, HistoryRaw);
+  ReportExport("historyHours", history, HistoryHours);
+  ReportExport("historyDays", history, HistoryDays);
+
+  // Through the firmware: three hours of measurements, then "history 0 0"
+  SimBootNode();
+  SimOptions run = options;
+  run.StepMicros = 100000;
+  run.Iterations = 3 * 36000;
+  SimLatency loopLatency;
+  SimRunLoop(run, loopLatency);
+  std::string reply;
+  SimOnMeshSend = [&reply](const char *data, size_t len) { reply.assign(data, len); };
+  SimInjectCommand("history 0 0");
+  SimAdvance(1000);
+  loop();
+  SimOnMeshSend = nullptr;
+
+  unsigned tier, chunk, chunks;
+  unsigned long minute;
+  int header = 0;
+  if (sscanf(reply.c_str(), "MQTT history %u %u %u %lu %n", &tier, &chunk, &chunks, &minute, &header) != 4 || !header)
+  {
+    Fail("no history reply");
+  }
+  uint8_t plain[2048];
+  mz_ulong plainBytes = sizeof(plain);
+  if (mz_uncompress(plain, &plainBytes, (const uint8_t *)reply.data() + header, reply.size() - header) != MZ_OK)
+  {
+    Fail("history chunk does not inflate");
+  }
+  // Walk to the last (newest) record and compare with the live ring
+  const uint8_t *p = plain;
+  int32_t previous[1 + HISTORY_CHANNELS] = {0};
+  uint32_t records = 0;
+  while (p < plain + plainBytes)
+  {
+    for (uint8_t i = 0; i < 1 + HISTORY_CHANNELS; i++)
+    {
+      ReadDelta(p, previous[i]);
+    }
+    records++;
+  }
+  const HistorySample &newest = History.Sample(0);
+  if (previous[0] != newest.Minute || previous[1] != newest.Value[0] || previous[4] != newest.Value[3])
+  {
+    Fail("decoded newest sample differs from the ring");
+  }
+  printf("historyExport  %u of %u raw records in %zu bytes, %u chunks, newest minute %d water %.2f\n", records,
+         History.Count(HistoryRaw), reply.size(), chunks, previous[0], previous[1] / 100.0);
+}
@@ -0,0 +1,180 @@
+#include "SimBench.h"
+#include "DisplayRenderer.h"
+#include "I2cScheduler.h"
+#include "SH1106Wire.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Relay writes and display flushes sharing the I2C bus via I2cScheduler
+
+extern uint8_t ActualDisplayPage;
+extern SH1106Wire Display;
+extern DisplayRenderer DisplayLines;
+extern I2cScheduler I2cBus;
+void UpdateDisplay();
+
+static std::vector<uint8_t> Trace;
+
+static void Fail(const char *what)
+{
+  printf("i2cOrder       FAILED: %s\n", what);
+  exit(1);
+}
+
+static void RunUntilDisplayIdle()
+{
+  for (int i = 0; i < 1000 && DisplayLines.Busy(); i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+  if (DisplayLines.Busy())
+  {
+    Fail("display flush never finished");
+  }
+}
+
+static void ReportDevice(const char *name, uint8_t address)
+{
+  const I2cDeviceStats *stats = I2cBus.Stats(address);
+  if (!stats)
+  {
+    printf("%-14s no transactions\n", name);
+    return;
+  }
+  printf("%-14s %6u transactions %8u bytes %3u errors, latency avg %8.1f us max %8u us\n", name,
+         stats->Transactions, stats->Bytes, stats->Errors,
+         stats->Transactions ? (double)stats->TotalLatencyUs / stats->Transactions : 0.0, stats->MaxLatencyUs);
+}
+
+static void ToggleOutput()
+{
+  static bool on = false;
+  on = !on;
+  SimInjectCommand(on ? "output 7 1" : "output 7 0");
+  SimScheduleIn(1700 * 1000ULL, ToggleOutput);
+}
+
+static void FlipPage()
+{
+  SimPressButton(2);
+  SimScheduleIn(1100 * 1000ULL, FlipPage);
+}
+
+SIM_SCENARIO(i2c, "relay writes overtake display chunks on the shared bus")
+{
+  SimBootNode();
+  SimOnI2cWrite = [](uint8_t address, const uint8_t *, size_t) { Trace.push_back(address); };
+  RunUntilDisplayIdle();
+
+  // A page switch queues most of the 1 KB frame, one loop() sends a few chunks
+  ActualDisplayPage = ActualDisplayPage % 8 + 1;
+  UpdateDisplay();
+  Trace.clear();
+  SimAdvance(1000);
+  loop();
+  if (Trace.empty() || !DisplayLines.Busy())
+  {
+    Fail("page switch did not leave a flush in progress");
+  }
+
+  // An actuator command lands mid-flush: its write must be the first on the bus
+  Trace.clear();
+  SimInjectCommand("output 7 1");
+  SimAdvance(1000);
+  loop();
+  // Output 7 is bit 6, the relays are active low
+  if (Trace.empty() || Trace[0] != SIM_PCF8574_ADDRESS || (SimRelayValue() & 0x40))
+  {
+    Fail("relay write did not go ahead of the display chunks");
+  }
+  for (size_t i = 1; i < Trace.size(); i++)
+  {
+    if (Trace[i] != SIM_SH1106_ADDRESS)
+    {
+      Fail("unexpected device after the relay write");
+    }
+  }
+
+  RunUntilDisplayIdle();
+  if (!SimPanelMatches(Display.buffer))
+  {
+    Fail("panel RAM differs from the framebuffer after the flush");
+  }
+  printf("i2cOrder       relay write first during a flush, panel matches framebuffer\n");
+
+  // Sustained load: page flips and output toggles on top of the usual traffic
+  SimOnI2cWrite = nullptr;
+  I2cBus.ResetStats();
+  SimScheduleIn(300 * 1000ULL, ToggleOutput);
+  SimScheduleIn(500 * 1000ULL, FlipPage);
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("i2c", latency);
+  ReportDevice("i2cRelay", SIM_PCF8574_ADDRESS);
+  ReportDevice("i2cDisplay", SIM_SH1106_ADDRESS);
+
+  RunUntilDisplayIdle();
+  if (!SimPanelMatches(Display.buffer))
+  {
+    Fail("panel RAM differs from the framebuffer after the run");
+  }
+}
+
+SIM_SCENARIO(outputs, "outputs <mask> <values>: one relay write and one state message")
+{
+  SimBootNode();
+  for (int i = 0; i < 5000; i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+
+  uint64_t relayWrites = SimStats.RelayWrites;
+  std::vector<std::string> sent;
+  SimOnMeshSend = [&sent](const char *data, size_t len) { sent.emplace_back(data, len); };
+  // Outputs 6 and 7 on, 8 stays off
+  SimInjectCommand("outputs 224 96");
+  for (int i = 0; i < 3000; i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+  SimOnMeshSend = nullptr;
+
+  if (SimStats.RelayWrites - relayWrites != 1 || (SimRelayValue() & 0xE0) != 0x80)
+  {
+    printf("outputs        FAILED: %llu relay writes, port 0x%02X\n",
+           (unsigned long long)(SimStats.RelayWrites - relayWrites), SimRelayValue());
+    exit(1);
+  }
+  if (sent.size() != 1 || sent[0] != "MQTT outputs 96 96")
+  {
+    printf("outputs        FAILED: %zu messages, first '%s'\n", sent.size(), sent.empty() ? "" : sent[0].c_str());
+    exit(1);
+  }
+  printf("outputs        one relay write (port 0x%02X), one message '%s'\n", SimRelayValue(), sent[0].c_str());
+
+  // Out of range or non-numeric masks and values leave the card alone;
+  // 257 used to be truncated to output 1
+  static const char *const malformed[] = {"outputs 257 1", "outputs 1 256", "outputs -1 0", "outputs x 1",
+                                          "outputs 1 on", "outputs 1"};
+  relayWrites = SimStats.RelayWrites;
+  uint8_t port = SimRelayValue();
+  for (const char *command : malformed)
+  {
+    SimInjectCommand(command);
+  }
+  for (int i = 0; i < 3000; i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+  if (SimStats.RelayWrites != relayWrites || SimRelayValue() != port)
+  {
+    printf("outputs        FAILED: malformed command wrote port 0x%02X\n", SimRelayValue());
+    exit(1);
+  }
+  printf("outputs        %zu malformed commands rejected, no relay write\n", sizeof(malformed) / sizeof(malformed[0]));
+}
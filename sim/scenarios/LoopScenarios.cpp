@@ -0,0 +1,297 @@
+#include "SimBench.h"
+#include "MeshMessageQueue.h"
+#include "DisplayRenderer.h"
+#include "LoopWaker.h"
+#include <Bounce2.h>
+#include <math.h>
+#include <string>
+
+// loop() latency of a booted pool node under scripted conditions
+
+extern uint8_t ActualDisplayPage;
+extern MeshMessageQueue InboundMessages;
+extern DisplayRenderer DisplayLines;
+extern I2cScheduler I2cBus;
+extern float WaterThermometerValue;
+extern LoopWaker LoopEvents;
+extern Bounce *buttons;
+void UpdateDisplay();
+void UpdateMqtt();
+
+static void DriftTemperatures()
+{
+  static const uint8_t water[8] = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
+  static const uint8_t roof[8] = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
+  static float step = 0;
+  step += 1.0f;
+  SimSetTemperature(water, 24.5f + 0.05f * step);
+  SimSetTemperature(roof, 38.0f + 4.0f * sinf(step / 20.0f));
+  SimScheduleIn(30 * 1000000ULL, DriftTemperatures);
+}
+
+static void GatewayTraffic()
+{
+  static uint32_t tick = 0;
+  static const char *const commands[] = {
+      "output 7 1",
+      "output 7 0",
+      "WaterMaxTemperature 30",
+      "ValveAutomaticMode 1",
+      "FilterpumpAutomaticOnTime 6",
+      "GetNodeInfo",
+      "I'm Root!",
+  };
+  SimInjectCommand(commands[tick++ % (sizeof(commands) / sizeof(commands[0]))]);
+  SimScheduleIn(7 * 1000000ULL, GatewayTraffic);
+}
+
+static void ButtonTraffic()
+{
+  static uint32_t tick = 0;
+  // Mostly page flips, now and then a change on the current page
+  SimPressButton(tick % 5 == 4 ? 1 : 2);
+  tick++;
+  SimScheduleIn(20 * 1000000ULL, ButtonTraffic);
+}
+
+SIM_SCENARIO(idle, "no traffic, periodic temperature reads only")
+{
+  SimBootNode();
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("idle", latency);
+}
+
+SIM_SCENARIO(traffic, "time broadcasts, gateway commands, buttons, drifting sensors")
+{
+  SimSetWallClock(9, 45);
+  SimBootNode();
+  SimStartTimeBroadcasts();
+  DriftTemperatures();
+  SimScheduleIn(3 * 1000000ULL, GatewayTraffic);
+  SimScheduleIn(5 * 1000000ULL, ButtonTraffic);
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("traffic", latency);
+}
+
+SIM_SCENARIO(autostart, "automatic start at 10:00 with valve, pump and salt system")
+{
+  SimSetWallClock(9, 58);
+  SimBootNode();
+  SimStartTimeBroadcasts();
+  SimLatency latency;
+  SimOptions shortRun = options;
+  // Two virtual minutes around the start are enough
+  shortRun.Iterations = options.Iterations < 240000 ? options.Iterations : 240000;
+  SimRunLoop(shortRun, latency);
+  SimReport("autostart", latency);
+}
+
+static void GatewayBurst()
+{
+  // A time broadcast and a config change landing in the same instant
+  SimInjectCommand("time 12:30");
+  SimInjectCommand("WaterMaxTemperature 29");
+  SimInjectCommand("ValveAutomaticMode 1");
+  SimInjectCommand("FilterpumpAutomaticOnTime 7");
+  SimInjectCommand("output 7 1");
+  SimInjectCommand("GetNodeInfo");
+  SimScheduleIn(2 * 1000000ULL, GatewayBurst);
+}
+
+SIM_SCENARIO(burst, "six gateway messages arriving together every 2 s")
+{
+  SimBootNode();
+  SimScheduleIn(1000000ULL, GatewayBurst);
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("burst", latency);
+  printf("%-14s received %u, dropped %u, oversized %u, high water %u of %u slots\n", "burstQueue",
+         InboundMessages.Received(), InboundMessages.Overflows(), InboundMessages.Oversized(),
+         InboundMessages.HighWater(), MESH_QUEUE_CAPACITY);
+}
+
+static void MeasureCalls(const char *name, uint64_t calls, void (*call)())
+{
+  SimLatency latency;
+  latency.Reserve(calls);
+  SimResetCounters();
+  for (uint64_t i = 0; i < calls; i++)
+  {
+    uint64_t start = SimHostNanos();
+    SimAllocTracking(true);
+    call();
+    SimAllocTracking(false);
+    latency.Add(SimHostNanos() - start);
+    // Put the queued display chunks on the bus, as loop() would
+    while (DisplayLines.Busy())
+    {
+      I2cBus.Loop();
+    }
+  }
+  SimReport(name, latency);
+}
+
+static void DisplayAllPages()
+{
+  ActualDisplayPage = ActualDisplayPage % 8 + 1;
+  UpdateDisplay();
+}
+
+static void DisplayTemperatureChange()
+{
+  // A new water temperature on the temperature page, every other call unchanged
+  static uint32_t tick = 0;
+  ActualDisplayPage = 1;
+  WaterThermometerValue = 24.5f + (tick++ / 2 % 2) * 0.25f;
+  UpdateDisplay();
+}
+
+static void ReportDisplayBytes(const char *name)
+{
+  printf("%-14s %u refreshes, %u unchanged skipped, %.1f I2C bytes/refresh\n", name,
+         DisplayLines.Refreshes(), DisplayLines.Skipped(),
+         DisplayLines.Refreshes() ? (double)DisplayLines.TotalBytes() / DisplayLines.Refreshes() : 0.0);
+  DisplayLines.ResetStats();
+}
+
+SIM_SCENARIO(render, "cost of UpdateDisplay() per page and of UpdateMqtt()")
+{
+  SimBootNode();
+  uint64_t calls = options.Iterations / 10 ? options.Iterations / 10 : 1;
+  DisplayLines.ResetStats();
+  MeasureCalls("UpdateDisplay", calls, DisplayAllPages);
+  ReportDisplayBytes("displayPages");
+  MeasureCalls("UpdateDispTemp", calls, DisplayTemperatureChange);
+  ReportDisplayBytes("displayTemp");
+  MeasureCalls("UpdateMqtt", calls, UpdateMqtt);
+}
+
+static void RunTelemetry(const char *name, const SimOptions &options, bool delta)
+{
+  SimSetWallClock(9, 45);
+  SimBootNode();
+  if (delta)
+  {
+    SimInjectCommand("TelemetryMode 1");
+  }
+  SimStartTimeBroadcasts();
+  DriftTemperatures();
+  SimScheduleIn(3 * 1000000ULL, GatewayTraffic);
+  SimScheduleIn(5 * 1000000ULL, ButtonTraffic);
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport(name, latency);
+  printf("%-14s %llu packets, %llu bytes on air, %.1f bytes/packet\n", name,
+         (unsigned long long)SimStats.MeshOut, (unsigned long long)SimStats.MeshOutBytes,
+         SimStats.MeshOut ? (double)SimStats.MeshOutBytes / SimStats.MeshOut : 0.0);
+}
+
+SIM_SCENARIO(telemetryFull, "traffic scenario with full string telemetry (TelemetryMode 0)")
+{
+  RunTelemetry("telemetryFull", options, false);
+}
+
+SIM_SCENARIO(telemetryDelta, "traffic scenario with delta typed telemetry (TelemetryMode 1)")
+{
+  RunTelemetry("telemetryDelta", options, true);
+}
+
+// loop() blocking in the event group until its next deadline: passes per
+// virtual second and idle share, against the fixed 1 ms steps of SimRunLoop()
+static void RunSleeping(const char *name, uint64_t seconds)
+{
+  SimIdleWait = true;
+  LoopEvents.ResetStats();
+  uint64_t idleBefore = SimStats.IdleMicros;
+  uint64_t begin = SimMicros();
+  uint64_t end = begin + seconds * 1000000ULL;
+  SimLatency latency;
+  while (SimMicros() < end)
+  {
+    uint64_t start = SimHostNanos();
+    SimAllocTracking(true);
+    loop();
+    SimAllocTracking(false);
+    // Host CPU time, including the scripted events delivered while it slept
+    latency.Add(SimHostNanos() - start);
+  }
+  SimIdleWait = false;
+  SimReport(name, latency);
+  double elapsed = (SimMicros() - begin) / 1e6;
+  printf("%-14s %.0f s: %.2f loop passes/s (1000 at 1 ms steps), %u sleeps, %u woken by events, %.2f%% idle, NodeInfo Idle:%u%%\n",
+         name, elapsed, latency.Count() / elapsed, LoopEvents.Sleeps(), LoopEvents.EventWakes(),
+         (SimStats.IdleMicros - idleBefore) / 10000.0 / elapsed, LoopEvents.IdlePercent());
+}
+
+static void FailSleep(const char *what)
+{
+  printf("sleepWake      FAILED: %s\n", what);
+  exit(1);
+}
+
+SIM_SCENARIO(sleepIdle, "event-driven loop(): wakeups and idle share without traffic")
+{
+  SimBootNode();
+  RunSleeping("sleepIdle", options.Iterations / 1000 ? options.Iterations / 1000 : 1);
+}
+
+SIM_SCENARIO(sleepTraffic, "event-driven loop() under the traffic scenario, wake latency")
+{
+  SimSetWallClock(9, 45);
+  SimBootNode();
+  SimIdleWait = true;
+  for (int i = 0; i < 100; i++)
+  {
+    loop();
+  }
+
+  // A mesh message is handled in the pass it wakes, not at the next deadline
+  uint64_t injected = 0;
+  uint64_t replied = 0;
+  SimOnMeshSend = [&replied](const char *data, size_t len) {
+    if (!replied && std::string(data, len).find("Idle:") != std::string::npos)
+    {
+      replied = SimMicros();
+    }
+  };
+  SimScheduleIn(333333, [&injected]() {
+    injected = SimMicros();
+    SimInjectCommand("GetNodeInfo");
+  });
+  uint64_t timeout = SimMicros() + 5000000ULL;
+  while (!replied && SimMicros() < timeout)
+  {
+    loop();
+  }
+  SimOnMeshSend = nullptr;
+  if (!replied || replied != injected)
+  {
+    FailSleep("GetNodeInfo not answered when it arrived");
+  }
+
+  // A button edge wakes loop(), the press counts after the 40 ms debounce
+  uint64_t pressed = SimMicros() + 250000;
+  SimScheduleAt(pressed, []() { SimPressButton(2); });
+  bool seen = false;
+  while (!seen && SimMicros() < pressed + 1000000)
+  {
+    loop();
+    seen = buttons[2].rose();
+  }
+  if (!seen || SimMicros() > pressed + 50000)
+  {
+    FailSleep("button press not seen within 50 ms");
+  }
+  printf("sleepWake      mesh message handled after %llu us, button after %llu ms\n",
+         (unsigned long long)(replied - injected), (unsigned long long)((SimMicros() - pressed) / 1000));
+  SimIdleWait = false;
+
+  SimResetCounters();
+  SimStartTimeBroadcasts();
+  DriftTemperatures();
+  SimScheduleIn(3 * 1000000ULL, GatewayTraffic);
+  SimScheduleIn(5 * 1000000ULL, ButtonTraffic);
+  RunSleeping("sleepTraffic", options.Iterations / 1000 ? options.Iterations / 1000 : 1);
+}
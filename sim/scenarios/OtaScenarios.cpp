@@ -0,0 +1,561 @@
+#include "SimBench.h"
+#include "DeltaOta.h"
+#include "miniz.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// Delta OTA: a patch between two firmware builds goes through the mesh into
+// the inactive slot of the file-backed flash. Reports the bytes on the mesh
+// against the full image, flash traffic and peak heap, then checks that
+// only a verified image is booted.
+//
+// MakePatch() is the reference encoder for the format in DeltaOta.h. It
+// runs on the gateway, so it deflates with the host zlib, not the miniz fake.
+
+typedef std::vector<uint8_t> Bytes;
+
+extern DeltaOta Ota;
+
+static const uint64_t LinkDelayUs = 40000; // gateway to node across the mesh, one way
+static const uint64_t FragmentGapUs = 8000; // between fragments of a burst
+static const uint64_t RetryUs = 1000000;   // ask the node after a burst without acknowledgement
+static const uint32_t LossPercent = 2;     // fragments and acknowledgements lost on the way
+
+static uint32_t Seed = 20241017;
+
+static uint32_t OtaRandom()
+{
+  Seed = Seed * 1103515245 + 12345;
+  return Seed >> 8;
+}
+
+static void Fail(const char *what)
+{
+  printf("ota            FAILED: %s\n", what);
+  exit(1);
+}
+
+// --- Synthetic firmware: functions of Xtensa-like code with literal pools
+// and calls, so a moved function changes addresses all over the image
+
+struct SimFunction
+{
+  Bytes Body;
+  std::vector<uint32_t> Callees;
+};
+
+static const uint32_t IramBase = 0x400D0000;
+
+static void MakeBody(SimFunction &function, uint32_t functions, uint32_t &seed)
+{
+  uint32_t saved = Seed;
+  Seed = seed;
+  uint32_t length = 40 + OtaRandom() % 400;
+  function.Body.clear();
+  function.Callees.clear();
+  while (function.Body.size() < length)
+  {
+    uint32_t r = OtaRandom();
+    if (r % 16 == 0)
+    {
+      // call8 to another function, the offset is filled in by Link()
+      function.Callees.push_back(OtaRandom() % functions);
+      function.Body.insert(function.Body.end(), {0xE5, 0, 0});
+      continue;
+    }
+    // A few dozen common instruction shapes with varying registers
+    uint32_t shape = (r >> 4) % 48;
+    shape = shape * shape / 48;
+    function.Body.push_back(0x08 + shape * 5);
+    function.Body.push_back((shape * 37 & 0xF0) | (OtaRandom() % 3 ? shape & 0x0F : OtaRandom() & 0x0F));
+    if (shape % 3)
+    {
+      function.Body.push_back(OtaRandom() % 4 ? shape : OtaRandom());
+    }
+  }
+  seed = Seed;
+  Seed = saved;
+}
+
+static std::vector<SimFunction> MakeProgram(uint32_t functions)
+{
+  std::vector<SimFunction> program(functions);
+  uint32_t seed = 4711;
+  for (SimFunction &function : program)
+  {
+    MakeBody(function, functions, seed);
+  }
+  return program;
+}
+
+// The next release: a few functions changed, a few added in between
+static std::vector<SimFunction> NextRelease(std::vector<SimFunction> program)
+{
+  uint32_t seed = 815;
+  uint32_t functions = program.size();
+  for (uint32_t i = 0; i < 12; i++)
+  {
+    MakeBody(program[(i * 2654435761u) % functions], functions, seed);
+  }
+  for (uint32_t at : {functions * 2 / 5, functions * 3 / 5, functions * 7 / 10})
+  {
+    SimFunction added;
+    MakeBody(added, functions, seed);
+    program.insert(program.begin() + at, added);
+  }
+  return program;
+}
+
+static Bytes Link(const std::vector<SimFunction> &program, const char *version)
+{
+  std::vector<uint32_t> address(program.size());
+  uint32_t offset = 0x100;
+  for (size_t i = 0; i < program.size(); i++)
+  {
+    offset += program[i].Callees.size() * 4;
+    address[i] = IramBase + offset;
+    offset = (offset + program[i].Body.size() + 3) & ~3u;
+  }
+
+  // Image header, app description with the version, code
+  Bytes image(0x100, 0);
+  image[0] = 0xE9;
+  image[1] = 6;
+  snprintf((char *)image.data() + 0x30, 32, "%s", version);
+  for (size_t i = 0; i < program.size(); i++)
+  {
+    const SimFunction &function = program[i];
+    for (uint32_t callee : function.Callees)
+    {
+      uint32_t target = address[callee % address.size()];
+      image.insert(image.end(), {(uint8_t)target, (uint8_t)(target >> 8), (uint8_t)(target >> 16), (uint8_t)(target >> 24)});
+    }
+    size_t at = image.size();
+    image.insert(image.end(), function.Body.begin(), function.Body.end());
+    size_t call = 0;
+    for (size_t b = 0; b + 2 < function.Body.size(); b++)
+    {
+      if (function.Body[b] == 0xE5 && !function.Body[b + 1] && !function.Body[b + 2] && call < function.Callees.size())
+      {
+        int32_t relative = ((int32_t)(address[function.Callees[call++] % address.size()] - (IramBase + at + b))) >> 2;
+        image[at + b] |= (relative & 0x03) << 6;
+        image[at + b + 1] = relative >> 2;
+        image[at + b + 2] = relative >> 10;
+      }
+    }
+    image.resize((image.size() + 3) & ~(size_t)3);
+  }
+  // Checksum and SHA-256 trailer, different in every build
+  uint32_t crc = mz_crc32(MZ_CRC32_INIT, image.data(), image.size());
+  for (int i = 0; i < 32; i++)
+  {
+    crc = crc * 1103515245 + 12345;
+    image.push_back(crc >> 16);
+  }
+  return image;
+}
+
+// --- Encoder
+
+struct DeltaPatch
+{
+  std::vector<Bytes> Windows; // deflated operations
+  uint32_t Ops[3];
+  uint32_t OpsBytes;
+  uint32_t PackedBytes;
+};
+
+static void PutVarint(Bytes &out, uint32_t value)
+{
+  while (value >= 0x80)
+  {
+    out.push_back((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(value);
+}
+
+static uint32_t SeedHash(const uint8_t *data)
+{
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return (value * 0x9E3779B97F4A7C15ULL) >> 44; // 20 bits
+}
+
+struct Match
+{
+  uint32_t Source;
+  uint32_t Length;
+  uint32_t Equal;
+  int32_t Score;
+};
+
+// bsdiff-style: extend while equal bytes outweigh the differing ones, so a
+// function whose addresses moved becomes one add of a mostly zero diff
+static Match Extend(const Bytes &source, const Bytes &image, uint32_t from, uint32_t end, uint32_t at)
+{
+  Match match = {at, 0, 0, 0};
+  int32_t score = 0;
+  uint32_t equal = 0;
+  for (uint32_t k = 0; from + k < end && at + k < source.size(); k++)
+  {
+    bool same = image[from + k] == source[at + k];
+    score += same ? 1 : -1;
+    equal += same;
+    if (score > match.Score)
+    {
+      match = {at, k + 1, equal, score};
+    }
+    else if (score < match.Score - 24)
+    {
+      break;
+    }
+  }
+  return match;
+}
+
+// Corrupt > 0 shifts the first source offset of that window by one byte,
+// which only the CRC of the written image can notice
+static DeltaPatch MakePatch(const Bytes &source, const Bytes &image, uint32_t corrupt = 0)
+{
+  std::vector<uint32_t> index(1 << 20, UINT32_MAX);
+  for (uint32_t i = 0; i + 8 <= source.size(); i++)
+  {
+    index[SeedHash(&source[i])] = i;
+  }
+
+  DeltaPatch patch = {};
+  int64_t delta = 0; // source - image offset of the previous match
+  for (uint32_t start = 0; start < image.size(); start += DELTA_OTA_WINDOW)
+  {
+    uint32_t end = image.size() - start < DELTA_OTA_WINDOW ? image.size() : start + DELTA_OTA_WINDOW;
+    uint32_t window = start / DELTA_OTA_WINDOW;
+    uint32_t ops[3] = {};
+    Bytes out;
+    uint32_t literal = start;
+    auto flush = [&](uint32_t upTo) {
+      if (upTo > literal)
+      {
+        out.push_back(DeltaOtaLiteral);
+        PutVarint(out, upTo - literal);
+        out.insert(out.end(), image.begin() + literal, image.begin() + upTo);
+        ops[DeltaOtaLiteral]++;
+      }
+    };
+    for (uint32_t at = start; at < end;)
+    {
+      Match best = {0, 0, 0, 0};
+      if (at + delta >= 0 && at + delta < (int64_t)source.size())
+      {
+        best = Extend(source, image, at, end, at + delta);
+      }
+      if (at + 8 <= image.size() && index[SeedHash(&image[at])] != UINT32_MAX)
+      {
+        Match seeded = Extend(source, image, at, end, index[SeedHash(&image[at])]);
+        best = seeded.Score > best.Score ? seeded : best;
+      }
+      if (best.Score < 16)
+      {
+        at++;
+        continue;
+      }
+      flush(at);
+      uint32_t from = best.Source;
+      if (window == corrupt && corrupt && !ops[DeltaOtaCopy] && !ops[DeltaOtaAdd] && from + best.Length < source.size())
+      {
+        from++;
+      }
+      bool exact = best.Equal == best.Length;
+      out.push_back(exact ? DeltaOtaCopy : DeltaOtaAdd);
+      PutVarint(out, from);
+      PutVarint(out, best.Length);
+      if (!exact)
+      {
+        for (uint32_t k = 0; k < best.Length; k++)
+        {
+          out.push_back(image[at + k] - source[best.Source + k]);
+        }
+      }
+      ops[exact ? DeltaOtaCopy : DeltaOtaAdd]++;
+      delta = (int64_t)best.Source - at;
+      at += best.Length;
+      literal = at;
+    }
+    flush(end);
+    if (out.size() > DELTA_OTA_OPS_SIZE)
+    {
+      // Many short matches cost more than the window itself
+      out.clear();
+      literal = start;
+      ops[0] = ops[1] = ops[2] = 0;
+      flush(end);
+    }
+
+    uLongf packedLength = compressBound(out.size());
+    Bytes packed(packedLength);
+    if (compress2(packed.data(), &packedLength, out.data(), out.size(), Z_BEST_COMPRESSION) != Z_OK ||
+        packedLength > DELTA_OTA_PACKED_SIZE)
+    {
+      Fail("window does not fit DELTA_OTA_PACKED_SIZE");
+    }
+    packed.resize(packedLength);
+    patch.Windows.push_back(packed);
+    for (int i = 0; i < 3; i++)
+    {
+      patch.Ops[i] += ops[i];
+    }
+    patch.OpsBytes += out.size();
+    patch.PackedBytes += packedLength;
+  }
+  return patch;
+}
+
+// --- Gateway: sends bursts of fragments, continues from every
+// acknowledgement and resends a burst that was not acknowledged
+
+struct OtaGateway
+{
+  const DeltaPatch *Patch;
+  std::string State;
+  std::string Reply; // the last one
+  uint32_t Generation;
+  uint32_t Fragments;
+  uint64_t FragmentBytes;
+  uint32_t Lost;
+  uint32_t Retries;
+  uint32_t Replies;
+  uint64_t ReplyBytes;
+};
+
+static OtaGateway Gateway;
+
+static void SendBurst(uint16_t window, uint16_t offset)
+{
+  // Gateway side, not the node's heap
+  SimAllocPause pause;
+  uint32_t generation = ++Gateway.Generation;
+  uint64_t at = 0;
+  for (uint8_t i = 0; i < DELTA_OTA_ACK_FRAGMENTS && window < Gateway.Patch->Windows.size(); i++)
+  {
+    const Bytes &packed = Gateway.Patch->Windows[window];
+    uint16_t length = packed.size() - offset < DELTA_OTA_FRAGMENT_DATA ? packed.size() - offset : DELTA_OTA_FRAGMENT_DATA;
+    Bytes fragment = {DELTA_OTA_FRAGMENT_MARKER, (uint8_t)window, (uint8_t)(window >> 8), (uint8_t)offset, (uint8_t)(offset >> 8),
+                      (uint8_t)packed.size(), (uint8_t)(packed.size() >> 8)};
+    fragment.insert(fragment.end(), packed.begin() + offset, packed.begin() + offset + length);
+    Gateway.Fragments++;
+    Gateway.FragmentBytes += fragment.size();
+    if (OtaRandom() % 100 < LossPercent)
+    {
+      Gateway.Lost++;
+    }
+    else
+    {
+      SimScheduleIn(LinkDelayUs + at, [fragment]() {
+        SimAllocPause pause;
+        static const uint8_t gateway[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0xFE};
+        SimInjectMeshMessage((const char *)fragment.data(), fragment.size(), gateway);
+      });
+    }
+    at += FragmentGapUs;
+    offset += length;
+    if (offset == packed.size())
+    {
+      // The node acknowledges the end of every window
+      break;
+    }
+  }
+  // Without an acknowledgement (the last fragment or the acknowledgement
+  // itself was lost) the gateway asks where the node is
+  SimScheduleIn(at + RetryUs, [generation]() {
+    if (generation == Gateway.Generation && Gateway.State == "next")
+    {
+      Gateway.Retries++;
+      SimInjectCommand("ota");
+    }
+  });
+}
+
+static void GatewayReceive(const char *data, size_t len)
+{
+  char state[16];
+  unsigned window = 0, offset = 0;
+  if (strncmp(data, "MQTT ota ", 9) || sscanf(data + 9, "%15s %u %u", state, &window, &offset) < 1)
+  {
+    return;
+  }
+  Gateway.Replies++;
+  Gateway.ReplyBytes += len;
+  if (OtaRandom() % 100 < LossPercent && !strcmp(state, "next"))
+  {
+    Gateway.Lost++;
+    return;
+  }
+  Gateway.State = state;
+  Gateway.Reply.assign(data, len);
+  if (Gateway.State == "next")
+  {
+    SimScheduleIn(LinkDelayUs, [window, offset]() { SendBurst(window, offset); });
+  }
+}
+
+static void RunFor(uint32_t ms, SimLatency *latency = nullptr)
+{
+  for (uint32_t i = 0; i < ms; i++)
+  {
+    SimAdvance(1000);
+    uint64_t start = SimHostNanos();
+    loop();
+    if (latency)
+    {
+      latency->Add(SimHostNanos() - start);
+    }
+  }
+}
+
+// Sends begin and the patch, returns the final state the node reported
+static std::string Update(const Bytes &source, const Bytes &image, const DeltaPatch &patch, SimLatency *latency)
+{
+  Gateway = OtaGateway();
+  Gateway.Patch = &patch;
+  SimOnMeshSend = GatewayReceive;
+  char begin[96];
+  snprintf(begin, sizeof(begin), "ota begin %zu %lx %zu %lx", image.size(), mz_crc32(MZ_CRC32_INIT, image.data(), image.size()),
+           source.size(), mz_crc32(MZ_CRC32_INIT, source.data(), source.size()));
+  SimInjectCommand(begin);
+  for (uint32_t seconds = 0; seconds < 3600; seconds++)
+  {
+    RunFor(1000, latency);
+    if (Gateway.State == "verified" || Gateway.State == "failed")
+    {
+      break;
+    }
+  }
+  return Gateway.State;
+}
+
+static bool ReadFile(const char *path, Bytes &data)
+{
+  FILE *file = fopen(path, "rb");
+  if (!file)
+  {
+    return false;
+  }
+  data.clear();
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+  {
+    data.insert(data.end(), buffer, buffer + n);
+  }
+  fclose(file);
+  return true;
+}
+
+SIM_SCENARIO(ota, "delta OTA: mesh bytes against the full image, peak RAM, verify then switch (--arg old.bin,new.bin)")
+{
+  Bytes source, image;
+  if (options.Argument)
+  {
+    std::string paths = options.Argument;
+    size_t comma = paths.find(',');
+    if (comma == std::string::npos || !ReadFile(paths.substr(0, comma).c_str(), source) ||
+        !ReadFile(paths.substr(comma + 1).c_str(), image))
+    {
+      Fail("--arg needs two readable images, old.bin,new.bin");
+    }
+  }
+  else
+  {
+    std::vector<SimFunction> program = MakeProgram(4500);
+    source = Link(program, "1.43");
+    image = Link(NextRelease(program), "1.44");
+  }
+
+  SimFlashOpen(nullptr);
+  if (!SimFlashProgram(0, source.data(), source.size()))
+  {
+    Fail("cannot flash the running image");
+  }
+  SimBootNode();
+  RunFor(2000);
+
+  uLongf deflated = compressBound(image.size());
+  Bytes full(deflated);
+  compress2(full.data(), &deflated, image.data(), image.size(), Z_BEST_COMPRESSION);
+  DeltaPatch patch = MakePatch(source, image);
+  printf("otaImage       %zu -> %zu bytes, %lu deflated (%zu packets of %u bytes)\n", source.size(), image.size(), deflated,
+         (deflated + DELTA_OTA_FRAGMENT_DATA - 1) / DELTA_OTA_FRAGMENT_DATA, DELTA_OTA_FRAGMENT_DATA);
+  printf("otaPatch       %zu windows, %u copy %u add %u literal ops, %u bytes, %u deflated (%.1f%% of the deflated image)\n",
+         patch.Windows.size(), patch.Ops[DeltaOtaCopy], patch.Ops[DeltaOtaAdd], patch.Ops[DeltaOtaLiteral], patch.OpsBytes,
+         patch.PackedBytes, patch.PackedBytes * 100.0 / deflated);
+
+  // The update, with lost fragments and acknowledgements
+  SimCounters before = SimStats;
+  int64_t liveBefore = SimAlloc.LiveBytes;
+  SimAlloc.PeakLiveBytes = SimAlloc.LiveBytes;
+  uint64_t startedAt = SimMicros();
+  SimLatency latency;
+  std::string state = Update(source, image, patch, &latency);
+  if (state != "verified")
+  {
+    Fail("update did not verify");
+  }
+  printf("otaTransfer    %u fragments (%u lost, %u duplicates, %u gaps, %u queries), %u replies, %llu bytes on the mesh in %.1f s\n",
+         Gateway.Fragments, Gateway.Lost, Ota.Duplicates(), Ota.Gaps(), Gateway.Retries, Gateway.Replies,
+         (unsigned long long)(Gateway.FragmentBytes + Gateway.ReplyBytes), (SimMicros() - startedAt) / 1e6);
+  printf("otaFlash       %llu sectors erased, %llu bytes written, %llu bytes read\n",
+         (unsigned long long)(SimStats.FlashErases - before.FlashErases),
+         (unsigned long long)(SimStats.FlashWriteBytes - before.FlashWriteBytes),
+         (unsigned long long)(SimStats.FlashReadBytes - before.FlashReadBytes));
+  printf("otaRam         heap peak +%lld bytes during the update, +%lld after, loop() p99 %.1f us max %.1f us\n",
+         (long long)(SimAlloc.PeakLiveBytes - liveBefore), (long long)(SimAlloc.LiveBytes - liveBefore),
+         latency.Percentile(99) / 1000.0, latency.Max() / 1000.0);
+  if (SimAlloc.LiveBytes != liveBefore || SimAlloc.PeakLiveBytes - liveBefore > 24 * 1024)
+  {
+    Fail("update RAM is not bounded by one window");
+  }
+
+  // Verified: switch, reboot, and the bootloader starts the new slot
+  SimInjectCommand("ota switch");
+  RunFor(3000);
+  if (Gateway.State != "switched" || SimStats.Restarts != 1 || SimFlashBootSlot() != 1)
+  {
+    Fail("verified image was not made the boot slot");
+  }
+  SimFlashReboot();
+  Bytes written(image.size());
+  if (SimFlashRunningSlot() != 1 || !SimFlashRead(1, 0, written.data(), written.size()) || written != image)
+  {
+    Fail("ota_1 does not hold the new image");
+  }
+  printf("otaSwitch      verified, boots ota_1, image matches\n");
+
+  // The firmware globals cannot boot twice in one process, but the flash
+  // fake already runs ota_1: a patch made against the old image does not fit
+  RunFor(2000);
+  state = Update(source, image, patch, nullptr);
+  if (state != "failed" || Gateway.Reply.find(" source") == std::string::npos || SimFlashBootSlot() != 1)
+  {
+    Fail("patch against another image was accepted");
+  }
+
+  // A patch that inflates and applies but writes a wrong byte: the CRC
+  // catches it, and switching is refused
+  DeltaPatch corrupt = MakePatch(image, source, patch.Windows.size() / 2);
+  state = Update(image, source, corrupt, nullptr);
+  bool crcFailed = Gateway.Reply.find(" crc") != std::string::npos;
+  uint64_t restarts = SimStats.Restarts;
+  SimInjectCommand("ota switch");
+  RunFor(3000);
+  if (state != "failed" || !crcFailed || SimStats.Restarts != restarts || SimFlashBootSlot() != 1)
+  {
+    Fail("corrupt image was not rejected");
+  }
+  printf("otaReject      wrong base image and corrupt window both rejected, ota_1 stays the boot slot\n");
+  SimOnMeshSend = nullptr;
+  SimFlashClose();
+}
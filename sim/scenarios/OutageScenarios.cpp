@@ -0,0 +1,297 @@
+#include "SimBench.h"
+#include "TelemetryBacklog.h"
+#include "miniz.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Root outages: telemetry is kept while the root is gone and arrives in
+// rate limited, deflated batches once it is back
+
+extern TelemetryBacklog Backlog;
+extern uint8_t ActualDisplayPage;
+extern bool DisplayIsOn;
+
+static const uint8_t Water[8] = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
+static const uint8_t PumpBit = 1 << 0; // Outputs.State(), output 1
+static const uint32_t BatchIntervalMs = 500; // BacklogBatchIntervall in src/main.cpp
+
+static void Fail(const char *what)
+{
+  printf("outage         FAILED: %s\n", what);
+  exit(1);
+}
+
+// One backlog record as the gateway decodes it
+struct BacklogEntry
+{
+  uint64_t At; // virtual time, from the batch's millis
+  uint16_t Fields;
+  uint8_t Outputs;
+  float Water; // NAN if not in the record
+};
+
+// The root: keep-alives every minute while it is up, everything the node
+// sends while it is down is lost
+struct OutageGateway
+{
+  bool Up = true;
+  uint64_t LastKeepAlive = 0;
+  uint64_t Lost = 0;
+  uint64_t Received = 0;
+  uint64_t Batches = 0;
+  uint64_t PackedBytes = 0;
+  uint64_t PlainBytes = 0;
+  uint64_t FirstBatchAt = 0;
+  uint64_t LastBatchAt = 0;
+  uint64_t MinBatchGap = UINT64_MAX;
+  size_t LargestPacket = 0;
+  bool ValuesAfterFlush = false;
+  std::vector<BacklogEntry> Entries;
+
+  void Receive(const char *data, size_t len)
+  {
+    if (!Up)
+    {
+      Lost++;
+      return;
+    }
+    Received++;
+    LargestPacket = len > LargestPacket ? len : LargestPacket;
+    if (len > 13 && memcmp(data, "MQTT backlog ", 13) == 0)
+    {
+      Batch(data, len);
+    }
+    else if (Batches && len > 12 && memcmp(data, "MQTT values ", 12) == 0)
+    {
+      ValuesAfterFlush = true;
+    }
+  }
+
+  void Batch(const char *data, size_t len)
+  {
+    unsigned records = 0, remaining = 0;
+    unsigned long now = 0;
+    int header = 0;
+    if (sscanf(data, "MQTT backlog %u %u %lu %n", &records, &remaining, &now, &header) != 3 || !header)
+    {
+      Fail("malformed backlog header");
+    }
+    uint8_t plain[TELEMETRY_BACKLOG_BATCH];
+    mz_ulong plainBytes = sizeof(plain);
+    if (mz_uncompress(plain, &plainBytes, (const uint8_t *)data + header, len - header) != MZ_OK)
+    {
+      Fail("backlog batch does not inflate");
+    }
+    if (Batches)
+    {
+      uint64_t gap = SimMicros() - LastBatchAt;
+      MinBatchGap = gap < MinBatchGap ? gap : MinBatchGap;
+    }
+    else
+    {
+      FirstBatchAt = SimMicros();
+    }
+    LastBatchAt = SimMicros();
+    Batches++;
+    PackedBytes += len - header;
+    PlainBytes += plainBytes;
+
+    size_t at = 0;
+    for (unsigned i = 0; i < records; i++)
+    {
+      if (at + 7 > plainBytes)
+      {
+        Fail("backlog batch shorter than its record count");
+      }
+      uint32_t ms = plain[at] | plain[at + 1] << 8 | plain[at + 2] << 16 | (uint32_t)plain[at + 3] << 24;
+      BacklogEntry entry;
+      entry.At = SimMicros() - (uint64_t)(uint32_t)(now - ms) * 1000;
+      entry.Fields = plain[at + 4] | plain[at + 5] << 8;
+      entry.Outputs = plain[at + 6];
+      entry.Water = NAN;
+      at += 7;
+      for (uint8_t field = 0; field < 16; field++)
+      {
+        if (entry.Fields & (1 << field))
+        {
+          float value;
+          memcpy(&value, plain + at, sizeof(value));
+          if (field == 0)
+          {
+            entry.Water = value;
+          }
+          at += sizeof(value);
+        }
+      }
+      Entries.push_back(entry);
+    }
+    if (at != plainBytes)
+    {
+      Fail("backlog batch longer than its record count");
+    }
+  }
+};
+
+static OutageGateway Gateway;
+
+static void KeepAlive()
+{
+  if (Gateway.Up)
+  {
+    Gateway.LastKeepAlive = SimMicros();
+    SimInjectCommand("I'm Root!");
+  }
+  SimScheduleIn(60 * 1000000ULL, KeepAlive);
+}
+
+// Water warms by 0.25 K every 2 min, between two sensor reads
+struct WaterStep
+{
+  uint64_t At;
+  float TempC;
+};
+static std::vector<WaterStep> WaterSteps;
+
+static void WarmWater()
+{
+  float temp = WaterSteps.empty() ? 20.0f : WaterSteps.back().TempC + 0.25f;
+  if (temp > 32)
+  {
+    temp = 20;
+  }
+  SimSetTemperature(Water, temp);
+  WaterSteps.push_back({SimMicros(), temp});
+  SimScheduleIn(120 * 1000000ULL, WarmWater);
+}
+
+static void RunUntil(uint64_t until)
+{
+  SimIdleWait = true;
+  while (SimMicros() < until)
+  {
+    loop();
+  }
+  SimIdleWait = false;
+}
+
+static uint64_t Minutes(uint64_t m)
+{
+  return m * 60 * 1000000ULL;
+}
+
+SIM_SCENARIO(outage, "root outage: telemetry kept, flushed in deflated, rate limited batches (--arg hours of the long outage)")
+{
+  uint64_t longHours = options.Argument ? strtoull(options.Argument, nullptr, 10) : 24;
+  SimOnMeshSend = [](const char *data, size_t len) { Gateway.Receive(data, len); };
+  SimBootNode();
+  SimScheduleIn(30 * 1000000ULL, WarmWater);
+  KeepAlive();
+  RunUntil(SimMicros() + Minutes(30));
+  printf("outageLive     30 min with the root: %llu packets, %u records (%u bytes) kept since the last keep-alive\n",
+         (unsigned long long)Gateway.Received, Backlog.Records(), Backlog.Used());
+
+  // Two hours without the root, the pump started by hand in between
+  Gateway.Up = false;
+  uint64_t lastKeepAlive = Gateway.LastKeepAlive;
+  uint64_t down = SimMicros();
+  RunUntil(down + Minutes(40));
+  if (!Backlog.Outage())
+  {
+    Fail("missing keep-alives not detected");
+  }
+  uint64_t lostBeforeDetection = Gateway.Lost;
+  // Button 1 on page 2 toggles the pump, the first press only wakes the display
+  ActualDisplayPage = 2;
+  if (!DisplayIsOn)
+  {
+    SimPressButton(0);
+    RunUntil(SimMicros() + 1000000ULL);
+  }
+  SimPressButton(0);
+  RunUntil(down + Minutes(120));
+  if (Gateway.Lost != lostBeforeDetection)
+  {
+    Fail("sent into the void during the outage");
+  }
+  printf("outageBuffer   2 h without the root: %llu packets lost before the outage was detected, then none; %u records (%u of %u bytes) kept\n",
+         (unsigned long long)lostBeforeDetection, Backlog.Records(), Backlog.Used(), Backlog.Capacity());
+
+  // The root is back and announces itself: everything since its last
+  // keep-alive before the outage arrives
+  uint64_t up = SimMicros();
+  uint16_t kept = Backlog.Records();
+  Gateway.Up = true;
+  SimInjectCommand("I'm Root!");
+  RunUntil(up + Minutes(2));
+  if (!Backlog.Live() || Gateway.Batches == 0)
+  {
+    Fail("backlog not flushed");
+  }
+  if (Gateway.MinBatchGap < BatchIntervalMs * 1000ULL || Gateway.LargestPacket > 1400)
+  {
+    Fail("batches not rate limited or larger than a mesh packet");
+  }
+  size_t missing = 0;
+  for (const WaterStep &step : WaterSteps)
+  {
+    // Read within 2 min of the change, kept unless confirmed before the outage
+    if (step.At < lastKeepAlive || step.At + Minutes(2) > up)
+    {
+      continue;
+    }
+    bool found = false;
+    for (const BacklogEntry &entry : Gateway.Entries)
+    {
+      found |= entry.Water == step.TempC && entry.At >= step.At && entry.At <= step.At + Minutes(2);
+    }
+    missing += !found;
+  }
+  bool pumpSeen = false;
+  for (const BacklogEntry &entry : Gateway.Entries)
+  {
+    pumpSeen |= (entry.Outputs & PumpBit) != 0;
+  }
+  if (missing || !pumpSeen || Gateway.Entries.size() < kept)
+  {
+    Fail("backlog incomplete");
+  }
+  RunUntil(SimMicros() + Minutes(5));
+  if (!Gateway.ValuesAfterFlush)
+  {
+    Fail("live telemetry did not resume after the flush");
+  }
+  printf("outageFlush    %zu records in %llu batches %u ms apart, %llu -> %llu bytes deflated (%.0f%%), first %.0f ms after the root came back, done in %.1f s; every water reading and the pump start arrived\n",
+         Gateway.Entries.size(), (unsigned long long)Gateway.Batches, BatchIntervalMs,
+         (unsigned long long)Gateway.PlainBytes, (unsigned long long)Gateway.PackedBytes,
+         100.0 * Gateway.PackedBytes / Gateway.PlainBytes, (Gateway.FirstBatchAt - up) / 1e3,
+         (Gateway.LastBatchAt - Gateway.FirstBatchAt) / 1e6);
+
+  // Longer than the ring: the oldest records give way
+  Gateway.Entries.clear();
+  Gateway.Batches = 0;
+  Gateway.PackedBytes = 0;
+  Gateway.PlainBytes = 0;
+  Gateway.Up = false;
+  down = SimMicros();
+  RunUntil(down + longHours * Minutes(60));
+  up = SimMicros();
+  uint16_t used = Backlog.Used();
+  uint32_t dropped = Backlog.Dropped();
+  Gateway.Up = true;
+  SimInjectCommand("I'm Root!");
+  RunUntil(up + Minutes(5));
+  if (used > Backlog.Capacity() || !Backlog.Live() || Gateway.Entries.empty())
+  {
+    Fail("long outage not bounded or not flushed");
+  }
+  double keptHours = (up - Gateway.Entries.front().At) / 3600e6;
+  printf("outageLong     %llu h without the root: %u of %u bytes used, %u oldest records dropped, newest %.1f h flushed as %zu records in %llu batches (%.1f s), %llu deflated bytes\n",
+         (unsigned long long)longHours, used, Backlog.Capacity(), dropped, keptHours, Gateway.Entries.size(),
+         (unsigned long long)Gateway.Batches, (Gateway.LastBatchAt - Gateway.FirstBatchAt) / 1e6,
+         (unsigned long long)Gateway.PackedBytes);
+  SimOnMeshSend = nullptr;
+}
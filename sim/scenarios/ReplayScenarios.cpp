@@ -0,0 +1,462 @@
+#include "SimBench.h"
+#include "TraceRecorder.h"
+#include <map>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Record/replay of a node's inputs. traceRecord writes the trace of two
+// synthetic weeks, replay feeds a trace (from the host or cut out of a
+// device's serial log) back into src/main.cpp on the virtual clock and
+// compares the relay writes and sent messages with the recorded ones.
+//
+// Only inputs are replayed, the settings are not part of a trace: the
+// replay boots with factory settings, commands in the trace change them
+// from there.
+
+#if TRACE_RECORD
+
+struct ReplayRecord
+{
+  uint32_t Ms;
+  char Kind;
+  uint8_t Index;
+  float Value;
+  uint8_t Mac[6];
+  std::string Payload;
+};
+
+static const uint8_t ReplayButtonPins[] = {15, 4, 2};
+static const uint32_t ReplayBounceMs = 40;
+static const uint32_t ReplaySensorLeadMs = 60000; // half the measurement interval
+static const uint32_t RecordDays = 14;
+
+static FILE *TraceFile = nullptr;
+
+static void TraceToFile(const char *Data, size_t Length)
+{
+  SimAllocPause pause;
+  // Other Serial output may come between two writes, so each one has to
+  // be a whole record
+  if (Length < 4 || memcmp(Data, "TR ", 3) != 0 || Data[Length - 1] != '\n' || memchr(Data, '\n', Length - 1))
+  {
+    printf("trace          FAILED: write of %zu bytes is not one whole line\n", Length);
+    exit(1);
+  }
+  fwrite(Data, 1, Length, TraceFile);
+}
+
+static bool LoadTrace(const char *path, std::vector<ReplayRecord> &records)
+{
+  FILE *file = fopen(path, "r");
+  if (!file)
+  {
+    return false;
+  }
+  // Escaped payloads take up to 4 characters per byte
+  static char line[TRACE_MAX_LINE];
+  static TraceRecord record;
+  bool booted = false;
+  while (fgets(line, sizeof(line), file))
+  {
+    if (!TraceRecorder::Parse(line, record))
+    {
+      continue;
+    }
+    if (record.Kind == TRACE_BOOT)
+    {
+      if (booted)
+      {
+        // A reboot on the device, the replay ends with the first run
+        break;
+      }
+      booted = true;
+    }
+    if (booted)
+    {
+      ReplayRecord copy = {record.Ms, record.Kind, record.Index, record.Value, {}, std::string(record.Payload, record.Length)};
+      memcpy(copy.Mac, record.Mac, sizeof(copy.Mac));
+      records.push_back(copy);
+    }
+  }
+  fclose(file);
+  return booted;
+}
+
+// Two weeks of a normal pool node: gateway time every minute, daily
+// temperature swings, a few commands from the gateway and someone at the
+// buttons now and then
+static void RecordTrace(const char *path)
+{
+  static const uint8_t water[8] = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
+  static const uint8_t vorlauf[8] = {0x28, 0x52, 0x04, 0xE8, 0x50, 0x20, 0x01, 0xF0};
+  static const uint8_t rucklauf[8] = {0x28, 0x47, 0x53, 0xF2, 0x50, 0x20, 0x01, 0xA7};
+  static const uint8_t roof[8] = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
+  static const char *const commands[] = {
+      "FilterPumpModeAutomatic 1", "SaltSystemModeAutomatic 1", "AutomaticStartTime 8", "FilterpumpAutomaticOnTime 6",
+      "SaltSystemAutomaticOnTime 3", "ValveAutomaticMode 1", "GetNodeInfo", "WaterMaxTemperature 28",
+      "schedule 1 1 17:00 2 1", "output 3 1", "output 3 0", "history",
+  };
+
+  TraceFile = fopen(path, "w");
+  if (!TraceFile)
+  {
+    printf("traceRecord    FAILED: cannot write %s\n", path);
+    exit(1);
+  }
+  TraceLog.SetWriter(TraceToFile);
+  SimBootNode();
+  SimSetWallClock(6, 0);
+  SimStartTimeBroadcasts();
+
+  static uint32_t seed = 20240612;
+  struct Weather
+  {
+    static void Step()
+    {
+      double hour = fmod(6.0 + SimMicros() / 3600e6, 24.0);
+      double day = sin(M_PI * (hour - 9.0) / 12.0);
+      seed = seed * 1103515245 + 12345;
+      double noise = ((seed >> 16) % 100) / 400.0;
+      SimSetTemperature(water, (float)(25.0 + 1.5 * day + noise));
+      SimSetTemperature(vorlauf, (float)(27.0 + 6.0 * day + noise));
+      SimSetTemperature(rucklauf, (float)(25.5 + 2.0 * day + noise));
+      SimSetTemperature(roof, (float)(22.0 + 20.0 * day + 4 * noise));
+      SimScheduleIn(47 * 1000000ULL, Step);
+    }
+    static void Gateway()
+    {
+      seed = seed * 1103515245 + 12345;
+      SimInjectCommand(commands[(seed >> 16) % (sizeof(commands) / sizeof(commands[0]))]);
+      SimScheduleIn((2 + (seed >> 20) % 10) * 3600 * 1000000ULL, Gateway);
+    }
+    static void Buttons()
+    {
+      seed = seed * 1103515245 + 12345;
+      SimPressButton((seed >> 16) % 3, 100 + (seed >> 8) % 400);
+      SimScheduleIn((5 + (seed >> 20) % 20) * 3600 * 1000000ULL, Buttons);
+    }
+  };
+  Weather::Step();
+  SimInjectCommand("FilterPumpModeAutomatic 1");
+  SimInjectCommand("SaltSystemModeAutomatic 1");
+  SimScheduleIn(3600 * 1000000ULL, Weather::Gateway);
+  SimScheduleIn(5400 * 1000000ULL, Weather::Buttons);
+
+  SimIdleWait = true;
+  uint64_t end = RecordDays * 86400ULL * 1000000;
+  while (SimMicros() < end)
+  {
+    loop();
+  }
+  SimIdleWait = false;
+  fclose(TraceFile);
+  TraceFile = nullptr;
+}
+
+SIM_SCENARIO(traceRecord, "records the trace of 14 synthetic days to --arg trace.txt (or a temporary file)")
+{
+  char temporary[] = "/tmp/traceXXXXXX";
+  const char *path = options.Argument;
+  if (!path)
+  {
+    close(mkstemp(temporary));
+    path = temporary;
+  }
+  uint64_t hostStart = SimHostNanos();
+  RecordTrace(path);
+  printf("traceRecord    %u records (%u dropped) of %u days to %s in %.1f s\n", TraceLog.Records(), TraceLog.Dropped(),
+         RecordDays, options.Argument ? path : "a temporary file", (SimHostNanos() - hostStart) / 1e9);
+  if (!options.Argument)
+  {
+    unlink(path);
+  }
+}
+
+// Pairs the n-th recorded output of a kind with the n-th replayed one
+struct ReplayMatch
+{
+  uint32_t Pairs;
+  uint32_t Mismatches;
+  uint32_t Missing;
+  uint32_t Extra;
+  uint64_t DeviationMs;
+  uint32_t MaxDeviationMs;
+};
+
+static ReplayMatch Compare(const std::vector<ReplayRecord> &recorded, const std::vector<ReplayRecord> &replayed, char kind,
+                           uint32_t recordedBoot)
+{
+  std::vector<const ReplayRecord *> a, b;
+  for (const ReplayRecord &record : recorded)
+  {
+    if (record.Kind == kind)
+    {
+      a.push_back(&record);
+    }
+  }
+  for (const ReplayRecord &record : replayed)
+  {
+    if (record.Kind == kind)
+    {
+      b.push_back(&record);
+    }
+  }
+  ReplayMatch match = {};
+  size_t pairs = a.size() < b.size() ? a.size() : b.size();
+  for (size_t i = 0; i < pairs; i++)
+  {
+    bool same = a[i]->Index == b[i]->Index && a[i]->Value == b[i]->Value && a[i]->Payload == b[i]->Payload;
+    match.Mismatches += !same;
+    uint32_t deviation = (uint32_t)labs((long)(a[i]->Ms - recordedBoot) - (long)b[i]->Ms);
+    match.DeviationMs += deviation;
+    match.MaxDeviationMs = deviation > match.MaxDeviationMs ? deviation : match.MaxDeviationMs;
+  }
+  match.Pairs = pairs;
+  match.Missing = a.size() - pairs;
+  match.Extra = b.size() - pairs;
+  return match;
+}
+
+static void PrintMatch(const char *what, const ReplayMatch &match)
+{
+  printf("replay         %-8s %6u paired, %u differ, %u missing, %u extra, deviation avg %.1f ms max %u ms\n", what,
+         match.Pairs, match.Mismatches, match.Missing, match.Extra,
+         match.Pairs ? (double)match.DeviationMs / match.Pairs : 0.0, match.MaxDeviationMs);
+}
+
+static std::string MessageType(const std::string &payload)
+{
+  if (payload.compare(0, 5, "MQTT ") == 0)
+  {
+    size_t end = payload.find_first_of(" {", 5);
+    return payload.substr(5, end == std::string::npos ? std::string::npos : end - 5);
+  }
+  return payload.empty() || payload[0] == '{' ? "json" : "binary";
+}
+
+static void PrintTelemetry(const std::vector<ReplayRecord> &recorded, const std::vector<ReplayRecord> &replayed)
+{
+  struct Volume
+  {
+    uint32_t Packets[2];
+    uint64_t Bytes[2];
+  };
+  std::map<std::string, Volume> types;
+  const std::vector<ReplayRecord> *runs[2] = {&recorded, &replayed};
+  for (int run = 0; run < 2; run++)
+  {
+    for (const ReplayRecord &record : *runs[run])
+    {
+      if (record.Kind == TRACE_OUTBOUND)
+      {
+        Volume &volume = types[MessageType(record.Payload)];
+        volume.Packets[run]++;
+        volume.Bytes[run] += record.Payload.size();
+      }
+    }
+  }
+  for (const auto &type : types)
+  {
+    printf("replay           %-24s %6u / %6u packets %9llu / %9llu bytes (recorded / replayed)\n", type.first.c_str(),
+           type.second.Packets[0], type.second.Packets[1], (unsigned long long)type.second.Bytes[0],
+           (unsigned long long)type.second.Bytes[1]);
+  }
+}
+
+// Relay timeline: switches and on-time per output of the replay
+static void PrintRelayTimeline(const std::vector<ReplayRecord> &replayed, uint32_t endMs)
+{
+  uint32_t switches[8] = {};
+  uint64_t onMs[8] = {};
+  uint8_t port = 0xFF;
+  uint32_t since = 0;
+  for (const ReplayRecord &record : replayed)
+  {
+    if (record.Kind != TRACE_RELAY)
+    {
+      continue;
+    }
+    for (uint8_t output = 0; output < 8; output++)
+    {
+      uint8_t bit = 1 << output;
+      onMs[output] += port & bit ? 0 : record.Ms - since;
+      switches[output] += (port ^ record.Index) & bit ? 1 : 0;
+    }
+    port = record.Index;
+    since = record.Ms;
+  }
+  for (uint8_t output = 0; output < 8; output++)
+  {
+    onMs[output] += port & (1 << output) ? 0 : endMs - since;
+    if (switches[output])
+    {
+      printf("replay           output %u %5u switches, %8.1f h on\n", output + 1, switches[output], onMs[output] / 3.6e6);
+    }
+  }
+}
+
+static std::vector<ReplayRecord> ReplayedRecords;
+static std::string ReplayPath;
+
+static void ReplayTrace(const char *path, bool expectExact)
+{
+  std::vector<ReplayRecord> recorded;
+  if (!LoadTrace(path, recorded))
+  {
+    printf("replay         FAILED: no trace records in %s\n", path);
+    exit(1);
+  }
+  uint32_t boot = recorded.front().Ms;
+
+  ReplayPath = std::string(path) + ".replay";
+  TraceFile = fopen(ReplayPath.c_str(), "w");
+  if (!TraceFile)
+  {
+    printf("replay         FAILED: cannot write %s\n", ReplayPath.c_str());
+    exit(1);
+  }
+  TraceLog.SetWriter(TraceToFile);
+
+  // First readings of each role are there from the start
+  SimClearEvents();
+  bool initial[4] = {};
+  SimBootNode();
+  for (const ReplayRecord &record : recorded)
+  {
+    if (record.Kind == TRACE_SENSOR && record.Index < 4 && !initial[record.Index] && SimSensorAt(record.Index))
+    {
+      initial[record.Index] = true;
+      SimSetTemperature(SimSensorAt(record.Index)->Address, record.Value);
+    }
+  }
+
+  uint32_t inputs = 0;
+  for (const ReplayRecord &record : recorded)
+  {
+    uint64_t at = (uint64_t)(record.Ms - boot) * 1000;
+    const ReplayRecord *input = &record;
+    switch (record.Kind)
+    {
+    case TRACE_INBOUND:
+      SimScheduleAt(at, [input]() { SimInjectMeshMessage(input->Payload.data(), input->Payload.size(), input->Mac); });
+      break;
+    case TRACE_SENSOR:
+      if (SimSensorAt(record.Index))
+      {
+        uint64_t lead = ReplaySensorLeadMs * 1000ULL;
+        SimScheduleAt(at > lead ? at - lead : 0,
+                      [input]() { SimSetTemperature(SimSensorAt(input->Index)->Address, input->Value); });
+      }
+      break;
+    case TRACE_BUTTON:
+      if (record.Index < sizeof(ReplayButtonPins))
+      {
+        uint64_t lead = ReplayBounceMs * 1000ULL;
+        SimScheduleAt(at > lead ? at - lead : 0,
+                      [input]() { SimSetPin(ReplayButtonPins[input->Index], input->Value != 0); });
+      }
+      break;
+    default:
+      continue;
+    }
+    inputs++;
+  }
+
+  uint64_t hostStart = SimHostNanos();
+  uint64_t end = (uint64_t)(recorded.back().Ms - boot + 60000) * 1000;
+  SimIdleWait = true;
+  while (SimMicros() < end)
+  {
+    // A message handled in the pass that starts right when it is due was
+    // queued before that pass on the device
+    SimAdvance(0);
+    loop();
+  }
+  SimIdleWait = false;
+  double hostSeconds = (SimHostNanos() - hostStart) / 1e9;
+  fclose(TraceFile);
+  TraceFile = nullptr;
+
+  if (!LoadTrace(ReplayPath.c_str(), ReplayedRecords))
+  {
+    printf("replay         FAILED: no replay records in %s\n", ReplayPath.c_str());
+    exit(1);
+  }
+
+  double days = end / 86400e6;
+  printf("replay         %zu records, %u inputs, %.2f days in %.2f s host time (%.0fx), replay trace %s\n",
+         recorded.size(), inputs, days, hostSeconds, hostSeconds > 0 ? days * 86400 / hostSeconds : 0.0,
+         ReplayPath.c_str());
+  ReplayMatch relays = Compare(recorded, ReplayedRecords, TRACE_RELAY, boot);
+  ReplayMatch sent = Compare(recorded, ReplayedRecords, TRACE_OUTBOUND, boot);
+  ReplayMatch sensors = Compare(recorded, ReplayedRecords, TRACE_SENSOR, boot);
+  ReplayMatch buttons = Compare(recorded, ReplayedRecords, TRACE_BUTTON, boot);
+  PrintMatch("relays", relays);
+  PrintMatch("sent", sent);
+  PrintMatch("sensors", sensors);
+  PrintMatch("buttons", buttons);
+  PrintRelayTimeline(ReplayedRecords, end / 1000);
+  PrintTelemetry(recorded, ReplayedRecords);
+
+  if (expectExact)
+  {
+    const ReplayMatch *all[] = {&relays, &sent, &sensors, &buttons};
+    for (const ReplayMatch *match : all)
+    {
+      if (match->Mismatches || match->Missing || match->Extra || match->MaxDeviationMs)
+      {
+        printf("replay         FAILED: the replay of a host recording differs from it\n");
+        exit(1);
+      }
+    }
+    if (!relays.Pairs || !sent.Pairs)
+    {
+      printf("replay         FAILED: the recording has no relay writes or sent messages\n");
+      exit(1);
+    }
+  }
+}
+
+SIM_SCENARIO(replay, "replays a trace (--arg trace.txt), without one records 14 days and checks the replay is exact")
+{
+  if (options.Argument)
+  {
+    ReplayTrace(options.Argument, false);
+    return;
+  }
+
+  // Record in a child, so the replay starts from a fresh firmware image too
+  char path[] = "/tmp/replayXXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0)
+  {
+    printf("replay         FAILED: no temporary file\n");
+    exit(1);
+  }
+  close(fd);
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    RecordTrace(path);
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    printf("replay         FAILED: recording the trace\n");
+    exit(1);
+  }
+  ReplayTrace(path, true);
+  unlink(path);
+  unlink(ReplayPath.c_str());
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include "SimBench.h"
+#include "WallClock.h"
+#include "ScheduleTable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// Daily starts from the drift-corrected local clock, with a gateway that
+// only sends the time a few times a day and loses some of those messages
+
+extern WallClock Clock;
+extern ScheduleTable Schedule;
+extern bool FilterpumpAutomaticOn;
+extern bool SaltSystemAutomaticOn;
+
+// The gateway's clock runs this much faster than the node's crystal
+static const double GatewaySkew = 150e-6;
+static const uint64_t GatewayOffsetUs = 6ULL * 3600 * 1000000; // 06:00:00 at SimMicros() 0
+
+static uint64_t GatewayMicros()
+{
+  return GatewayOffsetUs + (uint64_t)(SimMicros() * (1.0 + GatewaySkew));
+}
+
+static uint32_t GatewaySyncs = 0;
+static uint32_t GatewayLost = 0;
+
+static void GatewayTime()
+{
+  // Every 3 h, every fourth message lost on the way
+  if (++GatewaySyncs % 4 == 0)
+  {
+    GatewayLost++;
+  }
+  else
+  {
+    uint64_t seconds = GatewayMicros() / 1000000 % 86400;
+    char msg[24];
+    snprintf(msg, sizeof(msg), "time %02u:%02u:%02u", (unsigned)(seconds / 3600), (unsigned)(seconds / 60 % 60),
+             (unsigned)(seconds % 60));
+    SimInjectCommand(msg);
+  }
+  SimScheduleIn(3ULL * 3600 * 1000000, GatewayTime);
+}
+
+struct ScheduleRun
+{
+  uint64_t StartUs; // gateway time of the pump start
+  uint64_t PumpUs;  // pump run time
+  uint64_t SaltUs;  // salt system run time
+};
+
+static void Fail(const char *what, unsigned day)
+{
+  printf("schedule       FAILED on day %u: %s\n", day, what);
+  exit(1);
+}
+
+SIM_SCENARIO(schedule, "7 days of two daily starts, time synced every 3 h by a gateway 150 ppm off")
+{
+  SimBootNode();
+  SimIdleWait = true;
+  SimScheduleIn(20 * 1000000ULL, GatewayTime);
+  SimInjectCommand("schedule 1 1 16:30 2 1");
+
+  // Sampled on the relay writes, loop() returns only after its idle wait
+  static std::vector<ScheduleRun> runs;
+  static bool pump = false;
+  static bool salt = false;
+  SimOnRelayWrite = [](uint8_t) {
+    if (FilterpumpAutomaticOn != pump)
+    {
+      pump = FilterpumpAutomaticOn;
+      if (pump)
+      {
+        runs.push_back({GatewayMicros(), 0, 0});
+      }
+      else if (!runs.empty())
+      {
+        runs.back().PumpUs = GatewayMicros() - runs.back().StartUs;
+      }
+    }
+    if (SaltSystemAutomaticOn != salt)
+    {
+      salt = SaltSystemAutomaticOn;
+      if (!salt && !runs.empty())
+      {
+        runs.back().SaltUs = GatewayMicros() - runs.back().StartUs;
+      }
+    }
+  };
+  uint64_t end = 7ULL * 86400 * 1000000;
+  uint32_t passes = 0;
+  while (SimMicros() < end)
+  {
+    loop();
+    passes++;
+  }
+  SimOnRelayWrite = nullptr;
+  SimIdleWait = false;
+
+  // Booted 06:00 on day 0: 10:00 (6 h pump, 4 h salt) and 16:30 (2 h, 1 h) each day
+  if (runs.size() != 14)
+  {
+    printf("schedule       FAILED: %zu starts in 7 days, expected 14\n", runs.size());
+    exit(1);
+  }
+  double worstMs = 0;
+  for (size_t i = 0; i < runs.size(); i++)
+  {
+    unsigned day = (unsigned)(i / 2);
+    bool morning = i % 2 == 0;
+    uint64_t expected = (uint64_t)day * 86400000000ULL + (morning ? 36000000000ULL : 59400000000ULL);
+    double errorMs = ((double)runs[i].StartUs - (double)expected) / 1000.0;
+    if (errorMs > 1000 || errorMs < -1000)
+    {
+      Fail(morning ? "10:00 start more than 1 s off" : "16:30 start more than 1 s off", day);
+    }
+    worstMs = errorMs > worstMs ? errorMs : (-errorMs > worstMs ? -errorMs : worstMs);
+    double pumpHours = runs[i].PumpUs / 3.6e9;
+    double saltHours = runs[i].SaltUs / 3.6e9;
+    if (pumpHours < (morning ? 5.99 : 1.99) || pumpHours > (morning ? 6.01 : 2.01) ||
+        saltHours < (morning ? 3.99 : 0.99) || saltHours > (morning ? 4.01 : 1.01))
+    {
+      Fail("wrong pump or salt run time", day);
+    }
+  }
+  printf("schedule       %zu starts, worst %.0f ms off the gateway clock, drift estimate %ld ppb (gateway %+.0f ppb)\n",
+         runs.size(), worstMs, (long)Clock.DriftPpb(), GatewaySkew * 1e9);
+  printf("schedule       %u time messages, %u lost, %u steps, %.2f loop passes/s\n", GatewaySyncs - GatewayLost,
+         GatewayLost, Clock.Steps(), passes / (end / 1e6));
+}
@@ -0,0 +1,100 @@
+#include "SimBench.h"
+#include "TemperatureSensor.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// DS18B20 discovery, retries and probe replacement via TemperatureSensorManager
+
+extern TemperatureSensorManager TemperatureSensors;
+extern float WaterThermometerValue;
+extern float GarageRoofThermometerValue;
+
+static const uint8_t Water[8] = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
+static const uint8_t Roof[8] = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
+static const uint8_t Replacement[8] = {0x28, 0x11, 0x22, 0x33, 0x44, 0x55, 0x01, 0x99};
+
+static void Fail(const char *what)
+{
+  printf("sensors        FAILED: %s\n", what);
+  exit(1);
+}
+
+// Runs loop() until the manager finishes the given number of cycles
+static void RunCycles(uint32_t cycles)
+{
+  uint32_t target = TemperatureSensors.Cycles() + cycles;
+  for (int i = 0; i < 10000000 && TemperatureSensors.Cycles() < target; i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+  if (TemperatureSensors.Cycles() < target)
+  {
+    Fail("measurement cycle never finished");
+  }
+}
+
+SIM_SCENARIO(sensors, "sensor discovery, retries of bad reads, probe replacement")
+{
+  SimBootNode();
+  if (TemperatureSensors.Count() != 4)
+  {
+    Fail("not all four probes discovered");
+  }
+
+  // Steady state: one conversion and four reads per cycle
+  RunCycles(1);
+  TemperatureSensors.ResetStats();
+  SimResetCounters();
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("sensors", latency);
+  uint32_t cycles = TemperatureSensors.Cycles();
+  printf("sensorBus      %u cycles, %.1f conversions and %.1f reads/cycle, %.0f ms conversion wait/cycle (was 1000)\n",
+         cycles, cycles ? (double)SimStats.SensorConversions / cycles : 0.0,
+         cycles ? (double)SimStats.SensorReads / cycles : 0.0,
+         cycles ? (double)TemperatureSensors.WaitMs() / cycles : 0.0);
+
+  // A power-on 85 and two CRC errors are converted again, never published
+  TemperatureSensors.ResetStats();
+  SimSetTemperature(Water, 26.0f);
+  SimSetTemperature(Roof, 41.5f);
+  SimSensorFault(Water, 1, 85.0f);
+  SimSensorFault(Roof, 2, DEVICE_DISCONNECTED_C);
+  TemperatureSensors.RequestNow();
+  RunCycles(1);
+  if (WaterThermometerValue != 26.0f || GarageRoofThermometerValue != 41.5f || TemperatureSensors.Failures())
+  {
+    Fail("bad reads were published instead of retried");
+  }
+  printf("sensorRetry    85 and -127 reads retried: %u retries, %u failures, water %.2f roof %.2f\n",
+         TemperatureSensors.Retries(), TemperatureSensors.Failures(), WaterThermometerValue, GarageRoofThermometerValue);
+
+  // The water probe is swapped: one failed cycle, then the new probe takes over
+  std::string list;
+  SimRemoveSensor(Water);
+  SimAddSensor(Replacement, 25.25f);
+  TemperatureSensors.RequestNow();
+  RunCycles(1);
+  if (WaterThermometerValue != DEVICE_DISCONNECTED_C)
+  {
+    Fail("missing probe not reported as disconnected");
+  }
+  TemperatureSensors.RequestNow();
+  RunCycles(1);
+  if (WaterThermometerValue != 25.25f)
+  {
+    Fail("replacement probe did not take over the water role");
+  }
+  SimOnMeshSend = [&list](const char *data, size_t len) { list.assign(data, len); };
+  SimInjectCommand("SensorScan");
+  SimAdvance(1000);
+  loop();
+  SimOnMeshSend = nullptr;
+  if (list.find("2811223344550199=0") == std::string::npos)
+  {
+    Fail("sensor list does not show the new probe as water");
+  }
+  printf("sensorReplace  new probe bound to the water role without a rebuild: %s\n", list.c_str());
+}
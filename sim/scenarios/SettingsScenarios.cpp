@@ -0,0 +1,192 @@
+#include "SimBench.h"
+#include "SettingsStore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Settings in NVS: coalesced commits and restore across a reboot
+
+extern SettingsStore Settings;
+extern uint8_t ActualDisplayPage;
+extern int8_t FilterpumpAutomaticOnTime;
+extern int WaterMaxTemperature;
+
+// SettingsCommitDelay in src/main.cpp plus a margin
+static const uint32_t CommitWaitMs = 6000;
+
+static void Fail(const char *what)
+{
+  printf("settings       FAILED: %s\n", what);
+  exit(1);
+}
+
+static void RunFor(uint32_t ms)
+{
+  for (uint32_t i = 0; i < ms; i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+}
+
+// First life of the node: factory defaults, then a burst of changes
+static void FirstBoot(const char *image)
+{
+  SimNvsClear();
+  SimBootNode();
+  RunFor(10000);
+  printf("settingsBoot   first boot: %s, %llu NVS writes (defaults and run state stored once)\n",
+         Settings.Restored() ? "restored" : "defaults", (unsigned long long)SimStats.NvsWrites);
+
+  // Twelve presses on page 4 (filter time +1 each) and a gateway command
+  uint64_t writes = SimStats.NvsWrites;
+  uint32_t coalesced = Settings.Coalesced();
+  int8_t filterTime = FilterpumpAutomaticOnTime;
+  ActualDisplayPage = 4;
+  for (int press = 0; press < 12; press++)
+  {
+    SimPressButton(1);
+    RunFor(300);
+  }
+  SimInjectCommand("WaterMaxTemperature 28");
+  RunFor(CommitWaitMs);
+  if (SimStats.NvsWrites - writes != 1 || Settings.Pending())
+  {
+    Fail("burst of changes was not committed exactly once");
+  }
+  printf("settingsBurst  %d changes, %llu NVS write, %u coalesced, %u lifetime writes\n",
+         FilterpumpAutomaticOnTime - filterTime + 1, (unsigned long long)(SimStats.NvsWrites - writes),
+         Settings.Coalesced() - coalesced, Settings.Writes());
+
+  // Changing a value back and forth leaves the flash alone
+  writes = SimStats.NvsWrites;
+  SimInjectCommand("WaterMaxTemperature 27");
+  RunFor(500);
+  SimInjectCommand("WaterMaxTemperature 28");
+  RunFor(CommitWaitMs);
+  if (SimStats.NvsWrites != writes)
+  {
+    Fail("unchanged settings were written again");
+  }
+  printf("settingsRevert change and revert: no write, %u unchanged commits skipped\n", Settings.Unchanged());
+
+  // Values outside the schema range never reach the variable or the flash
+  writes = SimStats.NvsWrites;
+  filterTime = FilterpumpAutomaticOnTime;
+  SimInjectCommand("WaterMaxTemperature 99");
+  SimInjectCommand("FilterpumpAutomaticOnTime 0");
+  SimInjectCommand("FilterpumpAutomaticOnTime six");
+  RunFor(CommitWaitMs);
+  if (WaterMaxTemperature != 28 || FilterpumpAutomaticOnTime != filterTime || SimStats.NvsWrites != writes)
+  {
+    Fail("out of range value was applied");
+  }
+  printf("settingsRange  3 out of range commands rejected, no write\n");
+
+  // "Reboot" restarts 2 s later, within the commit delay of a change
+  writes = SimStats.NvsWrites;
+  uint64_t restarts = SimStats.Restarts;
+  SimInjectCommand("WaterMaxTemperature 29");
+  SimInjectCommand("Reboot");
+  RunFor(2500);
+  if (SimStats.Restarts == restarts || Settings.Pending() || SimStats.NvsWrites - writes != 1)
+  {
+    Fail("change right before a reboot was not committed");
+  }
+  printf("settingsCommit change and Reboot: committed before the restart, 2 s into the 5 s commit delay\n");
+
+  // A write NVS refuses stays pending and is tried again
+  writes = SimStats.NvsWrites;
+  uint32_t failed = Settings.Failed();
+  SimNvsFailWrites = 1;
+  SimInjectCommand("WaterMaxTemperature 30");
+  RunFor(CommitWaitMs);
+  if (Settings.Failed() != failed + 1 || !Settings.Pending() || SimStats.NvsWrites != writes)
+  {
+    Fail("refused write was not kept pending");
+  }
+  RunFor(CommitWaitMs);
+  if (Settings.Pending() || SimStats.NvsWrites - writes != 1)
+  {
+    Fail("refused write was not retried");
+  }
+  // Also when the refused write is the one before a reboot
+  writes = SimStats.NvsWrites;
+  restarts = SimStats.Restarts;
+  SimNvsFailWrites = 1;
+  SimInjectCommand("WaterMaxTemperature 29");
+  SimInjectCommand("Reboot");
+  RunFor(2500);
+  if (SimStats.Restarts != restarts)
+  {
+    Fail("restarted with a refused settings write");
+  }
+  RunFor(1000);
+  if (SimStats.Restarts == restarts || Settings.Pending() || SimStats.NvsWrites - writes != 1)
+  {
+    Fail("settings write refused before a reboot was not retried");
+  }
+  printf("settingsRetry  refused writes retried: %u failed, stored after the commit delay or 1 s later at a reboot\n",
+         Settings.Failed());
+
+  // Remember what the next life has to see, next to the real settings
+  int8_t expected[2] = {FilterpumpAutomaticOnTime, (int8_t)WaterMaxTemperature};
+  SimNvsWrite("sim", "expected", (const uint8_t *)expected, sizeof(expected));
+  if (!SimNvsSave(image))
+  {
+    Fail("cannot save the NVS image");
+  }
+}
+
+SIM_SCENARIO(settings, "settings: one NVS commit per burst, restore before relays")
+{
+  char image[64];
+  snprintf(image, sizeof(image), "/tmp/gbuspool-nvs-%d", (int)getpid());
+
+  // Reboot: the first life runs in a child, this process boots from its flash
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    FirstBoot(image);
+    fflush(stdout);
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    exit(1);
+  }
+
+  SimNvsLoad(image);
+  unlink(image);
+  const std::vector<uint8_t> *expected = SimNvsFind("sim", "expected");
+  if (!expected)
+  {
+    Fail("no flash image from the first boot");
+  }
+  int8_t filterTime = (*expected)[0];
+  int8_t maxTemperature = (*expected)[1];
+  int8_t atFirstRelayWrite = -1;
+  SimOnRelayWrite = [&atFirstRelayWrite](uint8_t) {
+    if (atFirstRelayWrite < 0)
+    {
+      atFirstRelayWrite = FilterpumpAutomaticOnTime;
+    }
+  };
+  SimBootNode();
+  SimOnRelayWrite = nullptr;
+  if (!Settings.Restored() || FilterpumpAutomaticOnTime != filterTime || WaterMaxTemperature != maxTemperature)
+  {
+    Fail("settings not restored after the reboot");
+  }
+  if (atFirstRelayWrite != filterTime)
+  {
+    Fail("a relay was driven before the settings were restored");
+  }
+  RunFor(CommitWaitMs);
+  printf("settingsReboot restored FilterpumpAutomaticOnTime %d, WaterMaxTemperature %d before the first relay write, %llu NVS writes at boot\n",
+         FilterpumpAutomaticOnTime, WaterMaxTemperature, (unsigned long long)SimStats.NvsWrites);
+}
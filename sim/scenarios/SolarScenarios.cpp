@@ -0,0 +1,239 @@
+#include "SimBench.h"
+#include "SolarController.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// One cool, cloudy day of an unglazed roof collector on the pool circuit:
+// heat gained per valve actuation with the solar controller, a plain
+// thermostat and the old rule (solar at the automatic start, pool above
+// WaterMaxTemperature).
+//
+// The day is a list of 10 minute samples of irradiance and ambient
+// temperature, built in or read from --arg <csv> with lines of
+// "minute,W/m2,degC" (e.g. from a weather station log).
+
+extern SolarController SolarValve;
+extern float WaterThermometerValue;
+extern int WaterMaxTemperature;
+
+static const uint8_t WaterAddress[8] = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
+static const uint8_t VorlaufAddress[8] = {0x28, 0x52, 0x04, 0xE8, 0x50, 0x20, 0x01, 0xF0};
+static const uint8_t RucklaufAddress[8] = {0x28, 0x47, 0x53, 0xF2, 0x50, 0x20, 0x01, 0xA7};
+static const uint8_t RoofAddress[8] = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
+
+// Installation: 12 m2 of absorber mats, 40 m3 of water, 12 l/min through the roof
+static const double CollectorArea = 12.0;
+static const double CollectorGain = 0.85;         // absorbed share of the irradiance
+static const double CollectorLoss = 18.0;         // W/(m2 K), unglazed
+static const double CollectorCapacity = 60000.0;  // J/K, mats, water and pipes on the roof
+static const double FlowCapacity = 0.2 * 4186.0;  // W/K at 12 l/min
+static const double PoolCapacity = 40000.0 * 4186.0;
+static const double PoolLoss = 250.0;             // W/K to the air
+static const double PipeMinutes = 15.0;           // pipes in the garage settle to the air
+static const uint64_t PlantStepUs = 10 * 1000000ULL;
+static const uint64_t DayStartUs = 6ULL * 3600 * 1000000; // node booted at 06:00
+
+struct SolarSample
+{
+  double Irradiance;
+  double Ambient;
+};
+
+struct SolarPlant
+{
+  double Collector;
+  double Water;
+  double Vorlauf;
+  double Rucklauf;
+  bool Solar; // valve position, moves while its power relay is on
+  bool Pump;
+  uint32_t ValveMoves;
+  double GainedJ;
+  double LostJ; // collector colder than the water while on solar
+  double PumpSolarSeconds;
+};
+
+static std::vector<SolarSample> Day;
+static SolarPlant Plant;
+static bool Legacy;
+
+static void BuiltInDay()
+{
+  // Cool day with cumulus from 08:00 to 18:00: a sample under a cloud
+  // (about every third, from a fixed pseudo random sequence) gets a fifth of
+  // the irradiance
+  uint32_t seed = 20240521;
+  for (int i = 0; i < 144; i++)
+  {
+    double hour = i / 6.0;
+    double sun = hour > 5.5 && hour < 20.5 ? sin(M_PI * (hour - 5.5) / 15.0) : 0.0;
+    double irradiance = 800.0 * sun * sun;
+    seed = seed * 1103515245 + 12345;
+    if (hour >= 8 && hour < 18 && (seed >> 16) % 3 == 0)
+    {
+      irradiance *= 0.2;
+    }
+    double ambient = 16.0 + 7.0 * sin(M_PI * (hour - 9.0) / 12.0);
+    Day.push_back({irradiance, ambient});
+  }
+}
+
+static bool LoadDay(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (!file)
+  {
+    return false;
+  }
+  unsigned minute;
+  double irradiance, ambient;
+  char line[128];
+  while (fgets(line, sizeof(line), file))
+  {
+    if (sscanf(line, "%u,%lf,%lf", &minute, &irradiance, &ambient) == 3 && minute / 10 >= Day.size())
+    {
+      Day.resize(minute / 10 + 1, {irradiance, ambient});
+      Day[minute / 10] = {irradiance, ambient};
+    }
+  }
+  fclose(file);
+  return Day.size() == 144;
+}
+
+static SolarSample SampleAt(uint64_t us)
+{
+  // Linear between the 10 minute samples
+  double minute = fmod((DayStartUs + us) / 60e6, 1440.0);
+  size_t index = (size_t)(minute / 10);
+  double part = (minute - index * 10) / 10;
+  const SolarSample &a = Day[index];
+  const SolarSample &b = Day[(index + 1) % Day.size()];
+  return {a.Irradiance + (b.Irradiance - a.Irradiance) * part, a.Ambient + (b.Ambient - a.Ambient) * part};
+}
+
+static void PlantStep()
+{
+  SolarSample now = SampleAt(SimMicros());
+  double dt = PlantStepUs / 1e6;
+  bool flowing = Plant.Pump && Plant.Solar;
+  double heat = flowing ? FlowCapacity * (Plant.Collector - Plant.Water) : 0.0;
+  double collector = CollectorGain * CollectorArea * now.Irradiance - CollectorLoss * CollectorArea * (Plant.Collector - now.Ambient) - heat;
+  Plant.Collector += collector * dt / CollectorCapacity;
+  Plant.Water += (heat - PoolLoss * (Plant.Water - now.Ambient)) * dt / PoolCapacity;
+  (heat >= 0 ? Plant.GainedJ : Plant.LostJ) += heat * dt;
+  Plant.PumpSolarSeconds += flowing ? dt : 0;
+
+  // Flow and return follow the water while it runs, the air otherwise
+  double settle = dt / (PipeMinutes * 60);
+  Plant.Vorlauf = flowing ? Plant.Collector : Plant.Vorlauf + (now.Ambient - Plant.Vorlauf) * settle;
+  Plant.Rucklauf = Plant.Pump ? Plant.Water : Plant.Rucklauf + (now.Ambient - Plant.Rucklauf) * settle;
+
+  SimSetTemperature(WaterAddress, (float)Plant.Water);
+  SimSetTemperature(VorlaufAddress, (float)Plant.Vorlauf);
+  SimSetTemperature(RucklaufAddress, (float)Plant.Rucklauf);
+  SimSetTemperature(RoofAddress, (float)Plant.Collector);
+  SimScheduleIn(PlantStepUs, PlantStep);
+}
+
+// The threshold rule the controller replaced, driven from outside: solar
+// when the automatic start switches the pump on, pool above the maximum
+static void LegacyStart()
+{
+  if (!Plant.Solar && WaterThermometerValue < WaterMaxTemperature - 2)
+  {
+    SimInjectCommand("ValveToHeat 1");
+  }
+}
+
+static void LegacyMaximum()
+{
+  if (Plant.Solar && WaterThermometerValue > WaterMaxTemperature)
+  {
+    SimInjectCommand("ValveToHeat 0");
+  }
+  SimScheduleIn(60 * 1000000ULL, LegacyMaximum);
+}
+
+static void RunSolarDay(const char *name, const SimOptions &options, bool legacy, const char *config = nullptr)
+{
+  if (options.Argument ? !LoadDay(options.Argument) : (BuiltInDay(), false))
+  {
+    printf("%-14s FAILED: %s needs 144 samples of minute,W/m2,degC\n", name, options.Argument);
+    exit(1);
+  }
+  Legacy = legacy;
+  SolarSample first = SampleAt(0);
+  Plant = {first.Ambient, 24.0, first.Ambient, first.Ambient, false, false, 0, 0, 0, 0};
+  SimBootNode();
+  SimInjectCommand("time 06:00:00");
+  // Filtering from 08:00 for 12 h, so the morning and evening are on the pump too
+  SimInjectCommand("schedule 0 1 08:00 12 4");
+  SimInjectCommand(legacy ? "ValveAutomaticMode 0" : "ValveAutomaticMode 1");
+  if (config)
+  {
+    SimInjectCommand(config);
+  }
+  SimOnRelayWrite = [](uint8_t port) {
+    // Active low: output 1 pump, 5 valve power, 6 valve direction
+    bool pump = !(port & 0x01);
+    if (Legacy && pump && !Plant.Pump)
+    {
+      SimScheduleIn(0, LegacyStart);
+    }
+    Plant.Pump = pump;
+    if (!(port & 0x10))
+    {
+      bool solar = !(port & 0x20);
+      Plant.ValveMoves += solar != Plant.Solar;
+      Plant.Solar = solar;
+    }
+  };
+  PlantStep();
+  if (legacy)
+  {
+    LegacyMaximum();
+  }
+
+  SimIdleWait = true;
+  uint64_t end = SimMicros() + 24ULL * 3600 * 1000000;
+  while (SimMicros() < end)
+  {
+    loop();
+  }
+  SimIdleWait = false;
+  SimOnRelayWrite = nullptr;
+
+  double gainedKWh = Plant.GainedJ / 3.6e6;
+  double lostKWh = fabs(Plant.LostJ) / 3.6e6;
+  uint32_t moves = Plant.ValveMoves;
+  printf("%-14s %.1f kWh gained, %.1f kWh lost to a cold roof, %u valve moves, %.1f kWh per move, %.1f h on solar, water %.2f C\n",
+         name, gainedKWh, lostKWh, moves, moves ? (gainedKWh - lostKWh) / moves : 0.0, Plant.PumpSolarSeconds / 3600,
+         Plant.Water);
+  if (!legacy && !config)
+  {
+    if (lostKWh > gainedKWh * 0.02 || moves > 6)
+    {
+      printf("%-14s FAILED: controller lost more than 2%% or moved the valve more than 6 times\n", name);
+      exit(1);
+    }
+    printf("%-14s dwell backoff %u, %u actuations counted by the controller\n", name, SolarValve.Backoff(),
+           SolarValve.Actuations());
+  }
+}
+
+SIM_SCENARIO(solarDay, "solar controller over a cool, cloudy day: heat gained per valve move (--arg day.csv)")
+{
+  RunSolarDay("solarDay", options, false);
+}
+
+SIM_SCENARIO(solarPlain, "the same day with a plain delta-T thermostat (1 K on, 0.5 K off, no dwell)")
+{
+  RunSolarDay("solarPlain", options, false, "SolarConfig 10 5 0 0");
+}
+
+SIM_SCENARIO(solarLegacy, "the same day with the old water-threshold valve rule")
+{
+  RunSolarDay("solarLegacy", options, true);
+}
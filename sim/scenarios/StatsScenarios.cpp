@@ -0,0 +1,88 @@
+#include "SimBench.h"
+#include "HotPathStats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// Hot-path statistics: the "stats" snapshot after a traffic run, and what a
+// probe costs
+
+static std::string Reply;
+
+static void Fail(const char *what)
+{
+  printf("stats          FAILED: %s\n", what);
+  exit(1);
+}
+
+static void RequestStats(const char *command)
+{
+  Reply.clear();
+  SimOnMeshSend = [](const char *data, size_t len) {
+    if (len > 11 && memcmp(data, "MQTT stats ", 11) == 0)
+    {
+      Reply.assign(data, len);
+    }
+  };
+  SimInjectCommand(command);
+  for (int i = 0; i < 10; i++)
+  {
+    SimAdvance(1000);
+    loop();
+  }
+  SimOnMeshSend = nullptr;
+  if (Reply.empty())
+  {
+    Fail("no reply to the stats command");
+  }
+}
+
+static void Press()
+{
+  SimPressButton(2);
+  SimScheduleIn(5 * 1000000ULL, Press);
+}
+
+static void Command()
+{
+  static uint32_t tick = 0;
+  SimInjectCommand(tick++ % 2 ? "output 7 1" : "output 7 0");
+  SimScheduleIn(3 * 1000000ULL, Command);
+}
+
+SIM_SCENARIO(stats, "stats command: hot-path cycle histograms after traffic, probe cost")
+{
+#if HOTPATH_STATS
+  SimBootNode();
+  Stats.Reset();
+  SimScheduleIn(1000000ULL, Press);
+  SimScheduleIn(1500000ULL, Command);
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("stats", latency);
+
+  RequestStats("stats reset");
+  printf("statsReply     %zu bytes: %s\n", Reply.size(), Reply.c_str() + 11);
+  if (Reply.find(" loop:") == std::string::npos || Reply.find(" mesh:") == std::string::npos ||
+      Reply.find(" onewire:") == std::string::npos || Reply.find("heap:") == std::string::npos)
+  {
+    Fail("snapshot misses a probe");
+  }
+  if (Stats.Probe(StatsDisplay).Count || Stats.Counter(StatsMeshIn))
+  {
+    Fail("stats reset did not clear the probes");
+  }
+
+  // Cost of one STATS_SCOPE on the host
+  const uint32_t calls = 1000000;
+  uint64_t start = SimHostNanos();
+  for (uint32_t i = 0; i < calls; i++)
+  {
+    STATS_SCOPE(StatsMqtt);
+  }
+  printf("statsProbe     %.1f ns per probe (two host clock reads, one ccount read on the device), %zu bytes of counters\n", (double)(SimHostNanos() - start) / calls,
+         sizeof(HotPathStats));
+#else
+  printf("stats          built without HOTPATH_STATS\n");
+#endif
+}
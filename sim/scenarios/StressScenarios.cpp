@@ -0,0 +1,301 @@
+#include "SimBench.h"
+#include "MeshMessageQueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Gateway commands through meshMessage() at increasing rates: latency from
+// arrival to the relay change, commands lost in the queue or overwritten by
+// the next one before they reached the card, and mesh packets sent per
+// command received.
+
+extern MeshMessageQueue InboundMessages;
+
+enum StressKind
+{
+  StressTime,
+  StressOutput,
+  StressValve,
+  StressInfo,
+  StressKinds
+};
+
+static const char *const StressNames[StressKinds] = {"time", "output", "ValveToHeat", "GetNodeInfo"};
+
+// Relays a command has to reach: outputs 7 and 8 are spare on the card,
+// the valve is done when output 6 is set and its power (output 5) is on
+struct StressTarget
+{
+  uint8_t Output;
+  bool Value = false;
+  bool Open = false;
+  uint64_t At = 0;
+};
+
+static StressTarget Targets[3] = {{7}, {8}, {6}};
+static SimLatency *RelayLatency;
+static uint32_t Overwritten = 0;
+static uint32_t Unchanged = 0;
+static uint64_t PacketsOut = 0;
+static uint64_t BytesOut = 0;
+static uint32_t Seed = 20240701;
+
+static uint32_t StressRandom()
+{
+  Seed = Seed * 1103515245 + 12345;
+  return Seed >> 8;
+}
+
+static bool Reached(const StressTarget &target, uint8_t port)
+{
+  // Active low card
+  bool on = !(port & (1 << (target.Output - 1)));
+  if (target.Output == 6)
+  {
+    return on == target.Value && !(port & 0x10);
+  }
+  return on == target.Value;
+}
+
+static void RelayWritten(uint8_t port)
+{
+  for (StressTarget &target : Targets)
+  {
+    if (target.Open && Reached(target, port))
+    {
+      target.Open = false;
+      RelayLatency->Add((SimMicros() - target.At) * 1000);
+    }
+  }
+}
+
+static void MeshSent(const char *, size_t len)
+{
+  PacketsOut++;
+  BytesOut += len;
+}
+
+static void Expect(StressTarget &target, bool value)
+{
+  if (target.Open)
+  {
+    Overwritten++;
+  }
+  target.Value = value;
+  target.At = SimMicros();
+  target.Open = !Reached(target, SimRelayValue());
+  Unchanged += !target.Open;
+}
+
+static void SendCommand(StressKind kind)
+{
+  static bool toggle[3];
+  char msg[32];
+  switch (kind)
+  {
+  case StressTime:
+  {
+    uint64_t minutes = 9 * 60 + SimMicros() / 60000000ULL;
+    snprintf(msg, sizeof(msg), "time %u:%02u", (unsigned)(minutes / 60 % 24), (unsigned)(minutes % 60));
+    break;
+  }
+  case StressOutput:
+  {
+    uint8_t index = StressRandom() % 2;
+    toggle[index] = !toggle[index];
+    Expect(Targets[index], toggle[index]);
+    snprintf(msg, sizeof(msg), "output %u %u", Targets[index].Output, toggle[index]);
+    break;
+  }
+  case StressValve:
+    toggle[2] = !toggle[2];
+    Expect(Targets[2], toggle[2]);
+    snprintf(msg, sizeof(msg), "ValveToHeat %u", toggle[2]);
+    break;
+  default:
+    snprintf(msg, sizeof(msg), "GetNodeInfo");
+    break;
+  }
+  SimInjectCommand(msg);
+}
+
+struct StressMix
+{
+  uint32_t Rate; // commands per second
+  uint32_t Weights[StressKinds];
+};
+
+static const StressMix *Mix;
+static uint32_t Sent = 0;
+
+static void NextCommand()
+{
+  uint32_t total = 0;
+  for (uint32_t weight : Mix->Weights)
+  {
+    total += weight;
+  }
+  uint32_t pick = StressRandom() % total;
+  uint8_t kind = 0;
+  while (pick >= Mix->Weights[kind])
+  {
+    pick -= Mix->Weights[kind++];
+  }
+  SendCommand((StressKind)kind);
+  Sent++;
+
+  // Gaps of 0 to 2 mean intervals, so commands also arrive in clumps
+  uint64_t mean = 1000000ULL / Mix->Rate;
+  SimScheduleIn(mean ? StressRandom() % (2 * mean + 1) : 0, NextCommand);
+}
+
+static const uint64_t StressSeconds = 30;
+
+static void RunStress(const StressMix &mix)
+{
+  Mix = &mix;
+  SimLatency latency;
+  RelayLatency = &latency;
+  SimBootNode();
+  SimIdleWait = true;
+  // Let the boot messages go out first
+  uint64_t settled = SimMicros() + 5000000ULL;
+  while (SimMicros() < settled)
+  {
+    loop();
+  }
+  SimOnRelayWrite = RelayWritten;
+  SimOnMeshSend = MeshSent;
+  uint32_t receivedBefore = InboundMessages.Received();
+  NextCommand();
+  uint64_t end = SimMicros() + StressSeconds * 1000000ULL;
+  while (SimMicros() < end)
+  {
+    loop();
+  }
+  SimClearEvents();
+  // Drain what is still queued or in a relay sequence
+  end = SimMicros() + 1000000ULL;
+  while (SimMicros() < end)
+  {
+    loop();
+  }
+  SimIdleWait = false;
+  SimOnRelayWrite = nullptr;
+  SimOnMeshSend = nullptr;
+
+  uint32_t unapplied = 0;
+  for (const StressTarget &target : Targets)
+  {
+    unapplied += target.Open;
+  }
+  uint32_t received = InboundMessages.Received() - receivedBefore;
+  uint32_t dropped = InboundMessages.Overflows() + InboundMessages.Oversized();
+  printf("meshStress %5u/s %6u sent %6u handled %5u dropped | relay p50 %7.2f p99 %7.2f max %7.2f ms, %u overwritten, %u unchanged, %u unapplied | %.2f packets %.0f bytes out per command\n",
+         mix.Rate, Sent, received - dropped, dropped, latency.Percentile(50) / 1e6, latency.Percentile(99) / 1e6,
+         latency.Max() / 1e6, Overwritten, Unchanged, unapplied, Sent ? (double)PacketsOut / Sent : 0.0,
+         Sent ? (double)BytesOut / Sent : 0.0);
+  RelayLatency = nullptr;
+  // Up to 10/s nothing may get lost, at 1/s every command has to reach the card
+  if (mix.Rate <= 10 && (dropped || unapplied || (mix.Rate == 1 && Overwritten)))
+  {
+    printf("meshStress     FAILED: commands lost at %u/s\n", mix.Rate);
+    exit(1);
+  }
+}
+
+SIM_SCENARIO(meshStress, "commands through meshMessage() at 1 to 2000/s (--arg rate[,time,output,valve,info weights])")
+{
+  static StressMix mixes[] = {
+      {1, {4, 3, 2, 1}}, {10, {4, 3, 2, 1}}, {100, {4, 3, 2, 1}}, {500, {4, 3, 2, 1}}, {2000, {4, 3, 2, 1}},
+  };
+  size_t count = sizeof(mixes) / sizeof(mixes[0]);
+  if (options.Argument)
+  {
+    StressMix &mix = mixes[0];
+    int fields = sscanf(options.Argument, "%u,%u,%u,%u,%u", &mix.Rate, &mix.Weights[0], &mix.Weights[1],
+                        &mix.Weights[2], &mix.Weights[3]);
+    if ((fields != 1 && fields != 5) || !mix.Rate || !(mix.Weights[0] + mix.Weights[1] + mix.Weights[2] + mix.Weights[3]))
+    {
+      printf("meshStress     FAILED: --arg rate or rate,time,output,valve,info\n");
+      exit(1);
+    }
+    count = 1;
+  }
+  // Every rate on a freshly booted node
+  for (size_t i = 0; i < count; i++)
+  {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      RunStress(mixes[i]);
+      fflush(stdout);
+      _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      exit(1);
+    }
+  }
+}
+
+SIM_SCENARIO(meshAmplification, "mesh packets and bytes sent per received command, by command")
+{
+  SimBootNode();
+  SimIdleWait = true;
+  SimOnMeshSend = MeshSent;
+
+  // Background: what the node sends without any command
+  const uint64_t window = 5000000ULL;
+  const uint32_t repeats = 12;
+  uint64_t end = SimMicros() + 10000000ULL;
+  while (SimMicros() < end)
+  {
+    loop();
+  }
+  PacketsOut = 0;
+  BytesOut = 0;
+  end = SimMicros() + repeats * window;
+  while (SimMicros() < end)
+  {
+    loop();
+  }
+  double idlePackets = (double)PacketsOut / repeats;
+  double idleBytes = (double)BytesOut / repeats;
+
+  // The valve last, its power off 35 s later would land in the next window
+  static const StressKind order[] = {StressTime, StressOutput, StressInfo, StressValve};
+  double valvePackets = 0;
+  for (StressKind kind : order)
+  {
+    PacketsOut = 0;
+    BytesOut = 0;
+    for (uint32_t i = 0; i < repeats; i++)
+    {
+      SendCommand(kind);
+      end = SimMicros() + window;
+      while (SimMicros() < end)
+      {
+        loop();
+      }
+    }
+    double packets = (double)PacketsOut / repeats - idlePackets;
+    double bytes = (double)BytesOut / repeats - idleBytes;
+    printf("meshAmplify    %-12s %5.2f packets %7.1f bytes per command\n", StressNames[kind], packets, bytes);
+    valvePackets = kind == StressValve ? packets : valvePackets;
+  }
+  SimIdleWait = false;
+  SimOnMeshSend = nullptr;
+  printf("meshAmplify    background %.2f packets %.1f bytes per %llu s\n", idlePackets, idleBytes,
+         (unsigned long long)(window / 1000000));
+  if (valvePackets <= 0)
+  {
+    printf("meshAmplify    FAILED: ValveToHeat sent nothing\n");
+    exit(1);
+  }
+}
@@ -0,0 +1,206 @@
+#include "SimBench.h"
+#include "TimerWheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+// TimerWheel under thousands of timers, against a Tasker-style linear table
+
+extern TimerWheel Timers;
+
+static const uint16_t Count = 4096;
+static const uint32_t Horizon = 12UL * 3600 * 1000; // longest firmware timeout
+
+struct BenchTimer
+{
+  uint32_t Due;
+  bool Cancelled;
+  bool Fired;
+};
+
+static uint32_t Early = 0;
+static uint32_t Fired = 0;
+
+static void Fail(const char *what)
+{
+  printf("timers         FAILED: %s\n", what);
+  exit(1);
+}
+
+static void OnTimer(void *context)
+{
+  BenchTimer *timer = (BenchTimer *)context;
+  if ((int32_t)(millis() - timer->Due) < 0)
+  {
+    Early++;
+  }
+  if (timer->Cancelled || timer->Fired)
+  {
+    Fail("cancelled or finished timer fired");
+  }
+  timer->Fired = true;
+  Fired++;
+}
+
+static uint32_t NextRandom()
+{
+  static uint32_t state = 0x12345678;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// Delays spread over all wheel levels: 1 ms up to 12 h
+static uint32_t RandomDelay()
+{
+  uint32_t range = 1UL << (NextRandom() % 26);
+  return 1 + NextRandom() % (range < Horizon ? range : Horizon);
+}
+
+// Tasker's approach: a flat table scanned on every loop()
+struct LinearTimers
+{
+  struct Entry
+  {
+    uint32_t Due;
+    BenchTimer *Timer;
+  };
+  std::vector<Entry> Entries;
+
+  void Loop()
+  {
+    uint32_t now = millis();
+    for (size_t i = 0; i < Entries.size(); i++)
+    {
+      if ((int32_t)(now - Entries[i].Due) >= 0)
+      {
+        OnTimer(Entries[i].Timer);
+        Entries[i] = Entries.back();
+        Entries.pop_back();
+        i--;
+      }
+    }
+  }
+};
+
+SIM_SCENARIO(timers, "timer wheel: 4096 timers, O(1) cancel, jitter, vs linear scan")
+{
+  static TimerSlot slots[Count];
+  static BenchTimer timers[Count];
+  static TimerHandle handles[Count];
+  TimerWheel wheel(slots, Count);
+  SimSetClock(0xFFFFF000ULL * 1000); // millis() wraps 4 s into the run
+
+  uint64_t start = SimHostNanos();
+  for (uint16_t i = 0; i < Count; i++)
+  {
+    uint32_t delay = RandomDelay();
+    timers[i] = {(uint32_t)(millis() + delay), false, false};
+    handles[i] = wheel.Schedule(delay, OnTimer, &timers[i]);
+  }
+  double scheduleNs = (double)(SimHostNanos() - start) / Count;
+  if (wheel.Schedule(1, OnTimer, nullptr) != 0 || wheel.Failures() != 1)
+  {
+    Fail("full wheel did not report the failed schedule");
+  }
+
+  // Cancel every other timer, move every fourth one
+  start = SimHostNanos();
+  uint32_t cancelled = 0;
+  for (uint16_t i = 0; i < Count; i += 2)
+  {
+    timers[i].Cancelled = true;
+    cancelled += wheel.Cancel(handles[i]);
+  }
+  double cancelNs = (double)(SimHostNanos() - start) / (Count / 2);
+  start = SimHostNanos();
+  for (uint16_t i = 1; i < Count; i += 4)
+  {
+    uint32_t delay = RandomDelay();
+    timers[i].Due = millis() + delay;
+    wheel.Reschedule(handles[i], delay);
+  }
+  double rescheduleNs = (double)(SimHostNanos() - start) / (Count / 4);
+  TimerHandle stale = handles[0];
+  if (wheel.Cancel(stale) || wheel.Reschedule(handles[0], 10))
+  {
+    Fail("stale handle still valid");
+  }
+
+  // Ten seconds at 1 ms per loop(), like the firmware, then coarse steps
+  SimLatency latency;
+  latency.Reserve(10000);
+  for (int i = 0; i < 10000; i++)
+  {
+    SimAdvance(1000);
+    start = SimHostNanos();
+    wheel.Loop();
+    latency.Add(SimHostNanos() - start);
+  }
+  uint32_t lateAt1ms = wheel.MaxLateMs();
+
+  // Then sleep from deadline to deadline like the idle loop(): none may be late
+  wheel.ResetStats();
+  uint32_t wakes = 0;
+  while (wheel.Armed())
+  {
+    uint32_t wait = wheel.NextDueMs();
+    if (wait == UINT32_MAX)
+    {
+      Fail("armed timers without a deadline");
+    }
+    SimAdvance((uint64_t)wait * 1000);
+    wheel.Loop();
+    wakes++;
+  }
+  if (wheel.MaxLateMs())
+  {
+    Fail("NextDueMs() slept past a due timer");
+  }
+  if (Early || Fired != Count - cancelled || wheel.Armed())
+  {
+    printf("timers         early %u, fired %u of %u, %u still armed\n", Early, Fired, Count - cancelled, wheel.Armed());
+    Fail("timers fired early or got lost");
+  }
+  printf("timerWheel     %u timers: schedule %.0f ns, cancel %.0f ns, reschedule %.0f ns, loop() p50 %llu ns p99 %llu ns\n",
+         Count, scheduleNs, cancelNs, rescheduleNs, (unsigned long long)latency.Percentile(50),
+         (unsigned long long)latency.Percentile(99));
+  printf("timerWheel     %u fired across the millis() wrap, none early, max late %u ms at 1 ms loops\n", Fired, lateAt1ms);
+  printf("timerWheel     sleeping until NextDueMs(): %u wakeups for %u timers over 12 h, none late\n", wakes,
+         (unsigned)wheel.Fired());
+
+  // Same load in a linear table
+  LinearTimers linear;
+  linear.Entries.reserve(Count);
+  Fired = 0;
+  for (uint16_t i = 0; i < Count; i++)
+  {
+    timers[i] = {(uint32_t)(millis() + RandomDelay()), false, false};
+    linear.Entries.push_back({timers[i].Due, &timers[i]});
+  }
+  SimLatency linearLatency;
+  linearLatency.Reserve(10000);
+  for (int i = 0; i < 10000; i++)
+  {
+    SimAdvance(1000);
+    start = SimHostNanos();
+    linear.Loop();
+    linearLatency.Add(SimHostNanos() - start);
+  }
+  printf("timerLinear    %u timers: loop() p50 %llu ns p99 %llu ns\n", Count,
+         (unsigned long long)linearLatency.Percentile(50), (unsigned long long)linearLatency.Percentile(99));
+}
+
+SIM_SCENARIO(timerJitter, "firmware timers under gateway traffic: late fires")
+{
+  SimBootNode();
+  SimSetWallClock(9, 58);
+  SimStartTimeBroadcasts();
+  Timers.ResetStats();
+  SimLatency latency;
+  SimRunLoop(options, latency);
+  SimReport("timerJitter", latency);
+  printf("timerJitter    %u fired, late avg %.2f ms max %u ms, %u armed, high water %u, %u failed\n", Timers.Fired(),
+         Timers.AverageLateMs(), Timers.MaxLateMs(), Timers.Armed(), Timers.HighWater(), Timers.Failures());
+}
@@ -2,14 +2,42 @@
 #include <ArduinoJson.h>
 #include "GBusHelpers.h"
 #include "GBusWifiMesh.h"
-#include <EEPROM.h>
 #include <WiFi.h>
-#include "Tasker.h"
+#include "TimerWheel.h"
 #include <Bounce2.h>
 #include <OneWire.h>
 #include <DallasTemperature.h>
 #include "SH1106Wire.h"
 #include "EasyPCF8574.h"
+#include "RelaySequencer.h"
+#include "MeshCommand.h"
+#include "MeshMessageQueue.h"
+#include "TelemetryPublisher.h"
+#include "TelemetryDelta.h"
+#include "TelemetryBacklog.h"
+#include "ValueSchema.h"
+#include "DisplayRenderer.h"
+#include "I2cScheduler.h"
+#include "RelayBank.h"
+#include "TemperatureSensor.h"
+#include "TemperatureHistory.h"
+#include "SettingsStore.h"
+#include "LoopWaker.h"
+#include "HotPathStats.h"
+#include "WallClock.h"
+#include "ScheduleTable.h"
+#include "SolarController.h"
+#include "TraceRecorder.h"
+#include "TextBuffer.h"
+#include "DeltaOta.h"
+#include <atomic>
+#include "freertos/task.h"
+#if CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "driver/gpio.h"
+#include "soc/gpio_struct.h"
+#endif
 
 #define FWVERSION "1.43"
 #define MODULNAME "GBusPool"
@@ -25,89 +53,368 @@
 #define NUM_BUTTONS 3
 #define ONE_WIRE_BUS 16
 #define TEMPERATURE_PRECISION 12
+#define TemperatureIntervall 2 * 60 * 1000 // The frequency of temperature measurement
+#define HistoryRawSamples 360  // 12 h of measurements, 10 bytes each
+#define HistoryHourRollups 168 // 7 days, 26 bytes each
+#define HistoryDayRollups 90   // 26 bytes each
+#define HistoryExportSize 1280 // deflated chunk, fits one mesh packet
+#define MeshPacketSize 1400     // longest outbound message, history chunk and header
 #define FilterpumpMaximumOnTime 12 * 3600 * 1000 // 12h
 #define SaltSystempowerOffDelay 20 * 60 * 1000   // xmin
 #define SaltSystemResetViaPowerCycle 2           // Power Off Salt System every X Cycle
 #define ValvePowerOffDelay 35 * 1000
-
-int WaterMAxTemperature = 30;
+#define TimerCapacity 16 // concurrently armed timers
+#define MeshMessagesPerLoop 4 // drained per loop() so buttons stay responsive
+#define RelayCardAddress 0x20
+#define DisplayAddress 0x3c
+#define DisplayChunksPerLoop 4 // display I2C chunks per loop(), relay writes go first
+#define TelemetryWindowMs 1000  // changes within this window go out as one update
+#define TelemetryKeyframeIntervall 15 * 60 * 1000 // full snapshot in delta mode
+#define BacklogSize 8192          // telemetry kept for the root, about 12 h of temperatures in an outage
+#define BacklogBatchIntervall 500 // ms between backlog batches after an outage
+#define TelemetryModeFull 0  // all values as JSON strings (legacy gateways)
+#define TelemetryModeDelta 1 // changed values only, as JSON numbers/booleans
+#define MeshEncodingJson 0    // "MQTT values {json}"
+#define MeshEncodingMsgPack 1 // "MQTT values " followed by a MessagePack map
+#define SettingsVersion 1          // bump when SettingsFields changes
+#define SettingsCommitDelay 5000   // quiet time before settings go to flash
+#define SettingsMaxDelay 60 * 1000 // commit at the latest this long after a change
+#define RunStateVersion 1                        // bump when RunStateFields changes
+#define RunStateCommitDelay 1000                 // run state changes come in bursts of a few calls
+#define RunStateMaxDelay 5000
+#define RunStateCheckpointIntervall 15 * 60 * 1000 // remaining run times, a resumed run is at most this much too long
+#define RebootCommitRetries 3                    // reboot postponed while settings or run state fail to commit
+#define RebootRetryDelay 1000
+#define MeshStartStack 4096                      // bytes, task that brings up the mesh
+#define MeshStartCore 0                          // the only core, CONFIG_FREERTOS_UNICORE
+#define LoopMaxIdleMs 1000            // longest sleep of loop(), GBusMesh.Task() still runs this often
+#define ButtonSettleMs 5              // loop() polls this often while a button bounces
+#define IdleSampleIntervall 60 * 1000 // idle CPU share reported in NodeInfo
+#define ScheduleSlotCount 4            // daily starts, slot 0 is AutomaticStartTime
+#define ScheduleGraceMinutes 15        // a start up to this late still runs (reboot, first sync)
+#define ScheduleRecheckMs 60 * 60 * 1000 // re-evaluated at least hourly, drift corrections apply
+
+// Node values, indexes into PoolValues and in the order of their telemetry bits
+enum PoolValue : uint8_t
+{
+  ValueWaterTemp,
+  ValueVLTemp,
+  ValueRLTemp,
+  ValueGarageRoofTemp,
+  ValueValveAutomaticMode,
+  ValueWaterMaxTemperature,
+  ValueAutomaticStartActive,
+  ValueSaltSystemModeAutomatic,
+  ValueSaltSystemAutomaticOnTime,
+  ValueValveToHeat,
+  ValueFilterPumpModeAutomatic,
+  ValueAutomaticStartTime,
+  ValueFilterpumpAutomaticOnTime,
+  PoolValueCount
+};
+
+// Telemetry fields, marked dirty by the setters and flushed by TelemetryPublisher
+#define TelemetryValue(Index) (1UL << (Index))
+#define TelemetryWaterTemp TelemetryValue(ValueWaterTemp)
+#define TelemetryVLTemp TelemetryValue(ValueVLTemp)
+#define TelemetryRLTemp TelemetryValue(ValueRLTemp)
+#define TelemetryGarageRoofTemp TelemetryValue(ValueGarageRoofTemp)
+#define TelemetryValveAutomaticMode TelemetryValue(ValueValveAutomaticMode)
+#define TelemetryWaterMaxTemperature TelemetryValue(ValueWaterMaxTemperature)
+#define TelemetryAutomaticStartActive TelemetryValue(ValueAutomaticStartActive)
+#define TelemetrySaltSystemModeAutomatic TelemetryValue(ValueSaltSystemModeAutomatic)
+#define TelemetrySaltSystemAutomaticOnTime TelemetryValue(ValueSaltSystemAutomaticOnTime)
+#define TelemetryValveToHeat TelemetryValue(ValueValveToHeat)
+#define TelemetryFilterPumpModeAutomatic TelemetryValue(ValueFilterPumpModeAutomatic)
+#define TelemetryAutomaticStartTime TelemetryValue(ValueAutomaticStartTime)
+#define TelemetryFilterpumpAutomaticOnTime TelemetryValue(ValueFilterpumpAutomaticOnTime)
+#define TelemetryTemperatures (TelemetryWaterTemp | TelemetryVLTemp | TelemetryRLTemp | TelemetryGarageRoofTemp)
+#define TelemetryValues (TelemetryValue(PoolValueCount) - 1)
+#define TelemetryOutput(Output) (1UL << (15 + (Output)))
+#define TelemetryOutputs 0xFF0000UL
+// Pump and salt system power are published without waiting for the window
+#define TelemetryUrgent (TelemetryOutput(FilterPumpOutput) | TelemetryOutput(SaltSystemPower))
+
+int WaterMaxTemperature = 30;
 bool ValveAutomaticMode = true;
 uint8_t SaltSystemResetViaPowerCycleCounter = 0;
 bool ValvePositionHeat = false;
+// 6 K roof over water to go to solar, 0.3 K flow over return to stay, back
+// to solar 2 K below WaterMaxTemperature, 15 min between valve moves
+SolarConfig SolarSettings = {60, 3, 20, 15};
+SolarController SolarValve(SolarSettings);
 bool DisplayIsOn = true;
-const uint8_t BUTTON_PINS[NUM_BUTTONS] = {15, 4, 2};
+DRAM_ATTR const uint8_t BUTTON_PINS[NUM_BUTTONS] = {15, 4, 2}; // read by ButtonChanged()
 
 void SetOutput(uint8_t Output, bool Value);
-String getValue(String data, char separator, int index);
+uint8_t PublishTelemetry(uint32_t Fields);
 void HandleDisplaypower(int DisplayOn);
-
-Tasker tasker;
+bool NextDisplayChunk(I2cTransaction &Next);
+bool WriteRelayCard(uint8_t Port);
+
+TimerSlot TimerSlots[TimerCapacity];
+TimerWheel Timers(TimerSlots, TimerCapacity);
+TimerHandle WatchdogTimer;
+TimerHandle DisplayTimer;
+TimerHandle FilterPumpTimer;
+TimerHandle SaltSystemTimer;
+TimerHandle SaltSystemPowerOffTimer;
+TimerHandle ValvePowerOffTimer;
 OneWire oneWire(ONE_WIRE_BUS);
 DallasTemperature sensors(&oneWire);
-SH1106Wire Display(0x3c, 13, 14);
-EasyPCF8574 RelaisCard(0x20, 0xFF);
+void TemperatureReading(uint8_t Role, float TempC);
+TemperatureSensorManager TemperatureSensors(sensors, TEMPERATURE_PRECISION, TemperatureIntervall, TemperatureReading);
+SH1106Wire Display(DisplayAddress, 13, 14);
+DisplayRenderer DisplayLines(Display, DisplayAddress);
+EasyPCF8574 RelaisCard(RelayCardAddress, 0xFF);
+I2cScheduler I2cBus(Wire, DisplayChunksPerLoop);
+RelayBank Outputs(WriteRelayCard, true); // relays are active low
 Bounce *buttons = new Bounce[NUM_BUTTONS];
-
-// Temperature definitions
-DeviceAddress WaterThermometer = {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46};
-DeviceAddress VorlaufThermometer = {0x28, 0x52, 0x04, 0xE8, 0x50, 0x20, 0x01, 0xF0};
-DeviceAddress RucklaufThermometer = {0x28, 0x47, 0x53, 0xF2, 0x50, 0x20, 0x01, 0xA7};
-DeviceAddress GarageRoofThermometer = {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C};
+TelemetryPublisher Telemetry(PublishTelemetry, TelemetryWindowMs, TelemetryUrgent);
+RelaySequencer SaltSystemSequencer(SetOutput);
+RelaySequencer ValveSequencer(SetOutput);
+LoopWaker LoopEvents;
+
+// Relay sequences, advanced from loop() instead of blocking in delay()
+const RelayStep SaltSystemOnSteps[] = {
+    {SaltSystemPower, 1, 3000},
+    // {SaltSystemEnableControl, 1, 300},
+    {SaltSystemActivate, 1, 300},
+    {SaltSystemActivate, 0, 0},
+    // {SaltSystemEnableControl, 0, 0},
+};
+const RelayStep SaltSystemOffSteps[] = {
+    // {SaltSystemEnableControl, 1, 200},
+    {SaltSystemActivate, 1, 200},
+    {SaltSystemActivate, 0, 0},
+    // {SaltSystemEnableControl, 0, 0},
+};
+const RelayStep ValveToHeatSteps[] = {
+    {ValvePowerOutput, 0, 100},
+    {ValveOutput, 1, 100},
+    {ValvePowerOutput, 1, 0},
+};
+const RelayStep ValveToPoolSteps[] = {
+    {ValvePowerOutput, 0, 100},
+    {ValveOutput, 0, 100},
+    {ValvePowerOutput, 1, 0},
+};
+const RelayStep ValvePowerOffSteps[] = {
+    {ValvePowerOutput, 0, 200},
+    {ValveOutput, 0, 0},
+};
+
+// Sensor roles 0..3: water, Vorlauf, Rücklauf, garage roof. Defaults are the
+// probes of the installation; replacements are stored with the settings.
+DeviceAddress SensorAddresses[TEMPERATURE_MAX_ROLES] = {
+    {0x28, 0x4F, 0x23, 0xEC, 0x50, 0x20, 0x01, 0x46},
+    {0x28, 0x52, 0x04, 0xE8, 0x50, 0x20, 0x01, 0xF0},
+    {0x28, 0x47, 0x53, 0xF2, 0x50, 0x20, 0x01, 0xA7},
+    {0x28, 0x3A, 0x0D, 0xD6, 0x50, 0x20, 0x01, 0x3C},
+};
 float WaterThermometerValue, VorlaufThermometerValue, RucklaufThermometerValue, GarageRoofThermometerValue;
-const long durationTemp = 2 * 60 * 1000; // The frequency of temperature measurement
+float *const SensorValues[TEMPERATURE_MAX_ROLES] = {&WaterThermometerValue, &VorlaufThermometerValue, &RucklaufThermometerValue, &GarageRoofThermometerValue};
 bool NewTemperatures = false;
 
+static_assert(HISTORY_CHANNELS == TEMPERATURE_MAX_ROLES, "History records one channel per sensor role");
+static_assert(HistoryExportSize >= HISTORY_EXPORT_MAX, "a history chunk always fits the export buffer");
+HistorySample HistorySamples[HistoryRawSamples];
+HistoryRollup HistoryHourRecords[HistoryHourRollups];
+HistoryRollup HistoryDayRecords[HistoryDayRollups];
+TemperatureHistory History(HistorySamples, HistoryRawSamples, HistoryHourRecords, HistoryHourRollups, HistoryDayRecords, HistoryDayRollups);
+
 bool FilterpumpAutomaticOn;
-int8_t FilterpumpAutomaticOnTime;
+int8_t FilterpumpAutomaticOnTime = 6;
 
 bool SaltSystemAutomaticOn;
-int8_t SaltSystemAutomaticOnTime;
+int8_t SaltSystemAutomaticOnTime = 4;
+
+// Run end times (millis) of timed runs, for the run state
+unsigned long FilterPumpStopAt;
+unsigned long SaltSystemStopAt;
 
-int8_t AutomaticStartTime;
-bool AutomaticStartActive;
+int8_t AutomaticStartTime = 10;
+bool AutomaticStartActive = true;
 
 uint8_t MaxDisplayPage = 8;
 uint8_t ActualDisplayPage = 1;
 
-uint32_t Minute = 0;
-uint32_t Hour = 0;
+// Local clock, disciplined by the gateway's "time" messages, and the daily
+// starts computed from it
+WallClock Clock;
+void ScheduledStart(uint8_t Slot, const ScheduleSlot &Entry);
+ScheduleSlot ScheduleSlots[ScheduleSlotCount] = {
+    {true, 10, 0, 6, 4},
+};
+ScheduleTable Schedule(ScheduleSlots, ScheduleSlotCount, ScheduledStart, ScheduleGraceMinutes);
+TimerHandle ScheduleTimer;
 MeshApp GBusMesh;
-
-bool NewMeshMessage = false;
-String LastMeshMessage;
-uint8_t LastSrcMac[6];
-void LastmeshMessage(String msg, uint8_t SrcMac[6]);
+// The mesh comes up in its own task: nothing may call into it before
+// start() returned, and nothing is sent before it connected
+std::atomic<bool> MeshStarted(false);
+std::atomic<bool> MeshConnected(false);
+std::atomic<bool> MeshConnectPending(false);
+// Boot timing for NodeInfo, 0 = not yet
+unsigned long BootDecisionMs;
+unsigned long MeshUpMs;
+// The mesh library sends a String: this one is reserved at boot and refilled
+// for every message, so sending does not allocate
+String MeshOutString;
+
+MeshMessageQueue InboundMessages;
+void LastmeshMessage(char *msg, uint16_t Length, uint8_t SrcMac[6]);
 
 // Prototypes
 void meshMessage(String msg, uint8_t SrcMac[6]);
+void SendMeshMessage(const char *Msg, size_t Length);
+void SendMeshMessage(const char *Msg);
+void SendMeshMessage(const TextBuffer &Msg);
 void SentNodeInfo();
 void RootNotActiveWatchdog();
+void RootSeen();
+void SendBacklogBatch(const uint8_t *Batch, size_t Length, uint16_t Records, uint16_t Remaining);
 void meshConnected();
+void MeshConnectedInLoop();
+void MeshStartTask(void *Parameter);
+void RestoreRunState();
+void SaveRunState();
 void SetSaltSystemModeAutomatic(int ModeOn);
-void TempSensorStartConversion();
+void SetSaltSystemModeAutomatic(int ModeOn, uint16_t RunMinutes);
+void SendSensorList();
+void SaveSensorRoles();
 void SaltSystemPowerOff();
 void SetAutomaticStartTime(int time);
 void UpdateDisplay();
 void SetFilterPumpModeAutomatic(int Mode);
-void SetFilterpumpAutomaticOnTime(uint8_t Time);
-void SetSaltSystemAutomaticOnTime(uint8_t Time);
+void SetFilterPumpModeAutomatic(int Mode, uint16_t RunMinutes);
+void SetFilterpumpAutomaticOnTime(int Time);
+void SetSaltSystemAutomaticOnTime(int Time);
 void ValvePowerOff();
-void SetAutomaticStartActive(bool Mode);
+void SetAutomaticStartActive(int Mode);
 void SetValvePosition(int ValveToHeat);
+void RunSolarValve();
 void UpdateMqtt();
+bool UpdateMqttDelta(uint32_t Fields);
+void SendMqttValues(JsonDocument &PoolJson);
+void RequestTelemetryKeyframe();
+void RebootNow();
+void DisplayTimeout(void *Context);
+void FilterPumpRunTimeElapsed(void *Context);
+void SaltSystemRunTimeElapsed(void *Context);
+void SampleIdle();
+void RunSchedule();
+void SendSchedule();
+void ButtonChanged();
+uint32_t LoopIdleTimeout();
+
+// Mesh command handlers
+void CommandRootAlive(const MeshCommandArgs &Args);
+void CommandConfig(const MeshCommandArgs &Args);
+void CommandGetNodeInfo(const MeshCommandArgs &Args);
+void CommandReboot(const MeshCommandArgs &Args);
+void CommandTime(const MeshCommandArgs &Args);
+void CommandOutput(const MeshCommandArgs &Args);
+void CommandOutputs(const MeshCommandArgs &Args);
+void CommandTelemetryWindow(const MeshCommandArgs &Args);
+void CommandTelemetryMode(const MeshCommandArgs &Args);
+void CommandEncoding(const MeshCommandArgs &Args);
+void CommandSensorRole(const MeshCommandArgs &Args);
+void CommandSensorScan(const MeshCommandArgs &Args);
+void CommandSolarConfig(const MeshCommandArgs &Args);
+void CommandHistory(const MeshCommandArgs &Args);
+void CommandStats(const MeshCommandArgs &Args);
+void CommandSchedule(const MeshCommandArgs &Args);
+void CommandOta(const MeshCommandArgs &Args);
+template <uint8_t Index>
+void CommandValue(const MeshCommandArgs &Args);
+bool ApplyValue(uint8_t Index, long Value);
+void StepValue(uint8_t Index, int Delta);
+
+// Delta firmware updates into the inactive app slot, see CommandOta()
+DeltaOta Ota(SendMeshMessage);
 
 uint8_t ModulType = 255;
 
+// Relay states (bit 0 = output 1) the gateway last got
+uint8_t PublishedOutputState = 0xFF;
+
+// Every value the node publishes, in PoolValue order. Writable values are
+// set by the command of the same name and by the buttons, within Min..Max.
+constexpr ValueField PoolValues[] = {
+    {"WaterTemp", ValueFloat, &WaterThermometerValue, 0.1, 0, 0, "Wasser", nullptr},
+    {"VLTemp", ValueFloat, &VorlaufThermometerValue, 0.1, 0, 0, "Vorlauf", nullptr},
+    {"RLTemp", ValueFloat, &RucklaufThermometerValue, 0.1, 0, 0, "Rücklauf", nullptr},
+    {"TemperatureGarageRoof", ValueFloat, &GarageRoofThermometerValue, 0.1, 0, 0, "Dach", nullptr},
+    {"ValveAutomaticMode", ValueBool, &ValveAutomaticMode, 0, 0, 1, nullptr, nullptr},
+    {"WaterMaxTemperature", ValueInt, &WaterMaxTemperature, 0, 10, 40, "Wasser Max Temp", nullptr},
+    {"AutomaticStartActive", ValueBool, &AutomaticStartActive, 0, 0, 1, "Autostart aktiv", SetAutomaticStartActive},
+    {"SaltSystemModeAutomatic", ValueBool, &SaltSystemAutomaticOn, 0, 0, 1, "Salzwasser", SetSaltSystemModeAutomatic},
+    {"SaltSystemAutomaticOnTime", ValueInt8, &SaltSystemAutomaticOnTime, 0, 1, 23, "Salzwasser Zeit", SetSaltSystemAutomaticOnTime},
+    {"ValveToHeat", ValueBool, &ValvePositionHeat, 0, 0, 1, "Valve", SetValvePosition},
+    {"FilterPumpModeAutomatic", ValueBool, &FilterpumpAutomaticOn, 0, 0, 1, "Filterpumpe", SetFilterPumpModeAutomatic},
+    {"AutomaticStartTime", ValueInt8, &AutomaticStartTime, 0, 0, 23, "Autostart Zeit", SetAutomaticStartTime},
+    {"FilterpumpAutomaticOnTime", ValueInt8, &FilterpumpAutomaticOnTime, 0, 1, 23, "Filter Zeit", SetFilterpumpAutomaticOnTime},
+};
+static_assert(sizeof(PoolValues) / sizeof(PoolValues[0]) == PoolValueCount, "PoolValues must match the PoolValue indexes");
+static_assert(ValueTableIsValid(PoolValues), "PoolValues has an invalid range");
+
+float TelemetryLastSent[PoolValueCount];
+TelemetryDelta TelemetryChanges(PoolValues, PoolValueCount, TelemetryLastSent);
+uint8_t TelemetryMode = TelemetryModeFull;
+bool TelemetryKeyframePending = true;
+uint8_t MeshEncoding = MeshEncodingJson;
+
+// Telemetry until the root confirmed it, resent after an outage
+static_assert(PoolValueCount <= TELEMETRY_BACKLOG_VALUES, "a backlog record holds at most 16 values");
+uint8_t BacklogRing[BacklogSize];
+TelemetryBacklog Backlog(PoolValues, PoolValueCount, BacklogRing, BacklogSize, SendBacklogBatch, BacklogBatchIntervall);
+
+// Persisted settings, the initializers above are the factory defaults
+const SettingsField SettingsFields[] = {
+    SETTINGS_FIELD(FilterpumpAutomaticOnTime),
+    SETTINGS_FIELD(SaltSystemAutomaticOnTime),
+    SETTINGS_FIELD(AutomaticStartTime),
+    SETTINGS_FIELD(AutomaticStartActive),
+    SETTINGS_FIELD(WaterMaxTemperature),
+    SETTINGS_FIELD(ValveAutomaticMode),
+    SETTINGS_FIELD(TelemetryMode),
+    SETTINGS_FIELD(MeshEncoding),
+    SETTINGS_FIELD(SensorAddresses),
+    SETTINGS_FIELD(ScheduleSlots),
+    SETTINGS_FIELD(SolarSettings),
+};
+SettingsStore Settings("GBusPool", SettingsFields, sizeof(SettingsFields) / sizeof(SettingsFields[0]), SettingsVersion,
+                       SettingsCommitDelay, SettingsMaxDelay);
+
+// What the outputs were doing, so a reboot resumes a run instead of waiting
+// for the next scheduled start. Kept apart from the settings: it changes
+// with every run and commits after a shorter delay.
+uint16_t FilterPumpMinutesLeft; // 0 = off
+uint16_t SaltSystemMinutesLeft;
+const SettingsField RunStateFields[] = {
+    SETTINGS_FIELD(FilterPumpMinutesLeft),
+    SETTINGS_FIELD(SaltSystemMinutesLeft),
+    SETTINGS_FIELD(ValvePositionHeat),
+};
+SettingsStore RunState("GBusPoolRun", RunStateFields, sizeof(RunStateFields) / sizeof(RunStateFields[0]), RunStateVersion,
+                       RunStateCommitDelay, RunStateMaxDelay);
+
 void setup()
 {
   Serial.begin(115200);
-
-  if (!RelaisCard.startI2C(13, 14))
-  {
-    Serial.println("RelaisCard Not started. Check pin and address.");
-  }
-
-  delay(100);
+  TRACE_BOOT_RECORD(FWVERSION);
+  MeshOutString.reserve(MeshPacketSize);
+
+  // Settings first, nothing may drive a relay with factory values
+  Settings.Begin();
+  // Slot 0 follows the classic settings, also when restored from a blob without slots
+  ScheduleSlots[0].Active = AutomaticStartActive;
+  ScheduleSlots[0].Hour = AutomaticStartTime;
+  ScheduleSlots[0].PumpHours = FilterpumpAutomaticOnTime;
+  ScheduleSlots[0].SaltHours = SaltSystemAutomaticOnTime;
+  RunState.Begin();
+  // Before the mesh starts, its task signals queued messages
+  LoopEvents.Begin();
 
   /**
    * @brief Set the log level for serial port printing.
@@ -117,166 +424,231 @@ void setup()
 
   MDF_LOGI("ModuleType: %u\n", ModulType);
 
-  Display.init();
-  Display.flipScreenVertically();
-  Display.setFont(ArialMT_Plain_10);
-
-  Display.clear();
-  Display.drawString(4, 0, "Connecting to GBusMesh"); //, OLED::DOUBLE_SIZE);
-  Display.display();
-
+  // Association takes seconds, or forever without a root: the mesh comes up
+  // in the background while the pool is controlled locally
   GBusMesh.onMessage(meshMessage);
   GBusMesh.onConnected(meshConnected);
-  GBusMesh.start(false);
+  xTaskCreatePinnedToCore(MeshStartTask, "MeshStart", MeshStartStack, nullptr, 1, nullptr, MeshStartCore);
+
+  if (!RelaisCard.startI2C(13, 14))
+  {
+    Serial.println("RelaisCard Not started. Check pin and address.");
+  }
 
-  Display.clear();
-  Display.drawString(4, 0, "Connected to Wifi"); //, OLED::DOUBLE_SIZE);
-  Display.display();
+  delay(100);
 
-  // DS18S20 Init
-  sensors.begin();
-  sensors.setResolution(WaterThermometer, TEMPERATURE_PRECISION);
-  sensors.setResolution(VorlaufThermometer, TEMPERATURE_PRECISION);
-  sensors.setResolution(RucklaufThermometer, TEMPERATURE_PRECISION);
-  sensors.setResolution(GarageRoofThermometer, TEMPERATURE_PRECISION);
-  sensors.setWaitForConversion(false);
+  Display.init();
+  Display.flipScreenVertically();
+  Display.setFont(ArialMT_Plain_10);
+
+  // DS18B20 Init, the first measurement starts with the first loop()
+  for (uint8_t Role = 0; Role < TEMPERATURE_MAX_ROLES; Role++)
+  {
+    TemperatureSensors.SetRole(Role, SensorAddresses[Role]);
+  }
+  TemperatureSensors.Discover();
 
-  Display.clear();
-  Display.drawString(4, 0, "Init output");
-  Display.display();
+  // From here on the panel is only written through the bus scheduler
+  I2cBus.SetBackground(NextDisplayChunk);
 
-  
   for (int x = 1; x <= 8; x++)
   {
     SetOutput(x, 0);
   }
 
+  SetFilterpumpAutomaticOnTime(FilterpumpAutomaticOnTime);
+  SetSaltSystemAutomaticOnTime(SaltSystemAutomaticOnTime);
+  // Resumes the runs of the previous life, the first relay write already
+  // carries them
+  RestoreRunState();
+  Outputs.Commit(true);
+  BootDecisionMs = millis();
+
   for (int i = 0; i < NUM_BUTTONS; i++)
   {
     buttons[i].attach(BUTTON_PINS[i], INPUT_PULLDOWN); // setup the bounce instance for the current button
     buttons[i].interval(40);                           // interval in ms
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PINS[i]), ButtonChanged, CHANGE);
   }
 
-  SetFilterpumpAutomaticOnTime(6);
-  SetFilterPumpModeAutomatic(false);
-
-  SetSaltSystemAutomaticOnTime(4);
-  SaltSystemPowerOff();
+#if CONFIG_PM_ENABLE
+  // Lower the clock and light sleep while loop() waits. The Wi-Fi driver
+  // holds a PM lock whenever the mesh needs the radio, so this only sleeps
+  // as far as the mesh allows. Light sleep only wakes on a level, so the
+  // buttons switch from the edge interrupt to a level one armed for the
+  // level they do not have; ButtonChanged() flips it after every change,
+  // otherwise a held button would fire the interrupt without end.
+  for (int i = 0; i < NUM_BUTTONS; i++)
+  {
+    gpio_wakeup_enable((gpio_num_t)BUTTON_PINS[i], digitalRead(BUTTON_PINS[i]) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  }
+  esp_sleep_enable_gpio_wakeup();
+  esp_pm_config_esp32_t PowerConfig = {.max_freq_mhz = 240, .min_freq_mhz = 80, .light_sleep_enable = true};
+  if (esp_pm_configure(&PowerConfig) != ESP_OK)
+  {
+    Serial.println("Power management not configured");
+  }
+#endif
 
-  SetAutomaticStartActive(true);
-  SetAutomaticStartTime(10);
+  SetAutomaticStartActive(AutomaticStartActive);
+  SetAutomaticStartTime(AutomaticStartTime);
 
   HandleDisplaypower(1);
 
-  tasker.setTimeout(RootNotActiveWatchdog, CheckForRootNodeIntervall);
+  Timers.Arm(WatchdogTimer, CheckForRootNodeIntervall, RootNotActiveWatchdog);
+
+  Timers.Schedule(TelemetryKeyframeIntervall, RequestTelemetryKeyframe, TelemetryKeyframeIntervall);
+  Timers.Schedule(IdleSampleIntervall, SampleIdle, IdleSampleIntervall);
+  Timers.Schedule(RunStateCheckpointIntervall, SaveRunState, RunStateCheckpointIntervall);
+  RunSchedule();
+}
+
+void MeshStartTask(void *Parameter)
+{
+  // Blocks until the node found its parent
+  GBusMesh.start(false);
+  MeshStarted = true;
+  LoopEvents.Signal(LOOP_WAKE_MESH);
+  vTaskDelete(nullptr);
+}
+
+void RestoreRunState()
+{
+  // ValvePositionHeat is restored as it is: the valve holds its position
+  // without power and is not moved. Starting a run saves the state again.
+  uint16_t PumpMinutes = FilterPumpMinutesLeft;
+  uint16_t SaltMinutes = SaltSystemMinutesLeft;
+  if (PumpMinutes)
+  {
+    SetFilterPumpModeAutomatic(1, PumpMinutes);
+    if (SaltMinutes)
+    {
+      SetSaltSystemModeAutomatic(1, SaltMinutes);
+    }
+  }
+  else
+  {
+    SetFilterPumpModeAutomatic(false);
+  }
+  if (!SaltSystemAutomaticOn)
+  {
+    SaltSystemPowerOff();
+  }
+}
+
+// Rounded up, a resumed run is never cut short. 0 once the run is over.
+static uint16_t MinutesLeft(bool Running, unsigned long StopAt, unsigned long Now)
+{
+  long Left = StopAt - Now;
+  return Running && Left > 0 ? (Left + 59999) / 60000 : 0;
+}
 
-  // Beginn with temperature task
-  //TempSensorStartConversion();
-  tasker.setInterval(TempSensorStartConversion,durationTemp);
+void SaveRunState()
+{
+  unsigned long Now = millis();
+  FilterPumpMinutesLeft = MinutesLeft(FilterpumpAutomaticOn, FilterPumpStopAt, Now);
+  SaltSystemMinutesLeft = MinutesLeft(SaltSystemAutomaticOn, SaltSystemStopAt, Now);
+  RunState.MarkDirty();
 }
 
 void loop()
 {
-  tasker.loop();
-  GBusMesh.Task();
+  STATS_BEGIN(StatsLoop);
+  Timers.Loop();
+  if (MeshStarted)
+  {
+    GBusMesh.Task();
+  }
+  // The connected callback runs inside GBusMesh.start(), the greeting
+  // waits until start() has returned
+  if (MeshStarted && MeshConnectPending.exchange(false))
+  {
+    MeshConnectedInLoop();
+  }
+  SaltSystemSequencer.Loop();
+  ValveSequencer.Loop();
+  Telemetry.Loop();
+  Backlog.Loop();
+  Settings.Loop();
+  RunState.Loop();
+  Ota.Loop();
+  if (TemperatureSensors.Loop())
+  {
+    NewTemperatures = true;
+    SaveSensorRoles();
+    const float Temperatures[HISTORY_CHANNELS] = {WaterThermometerValue, VorlaufThermometerValue, RucklaufThermometerValue, GarageRoofThermometerValue};
+    History.Add(millis() / 60000, Temperatures);
+  }
 
   for (int i = 0; i < NUM_BUTTONS; i++)
   {
     // Update the Bounce instance :
-    buttons[i].update();
+    if (buttons[i].update())
+    {
+      TRACE_BUTTON_RECORD(i, buttons[i].read());
+    }
   }
 
-  // Button 1
+  // Button 1 toggles or counts down the value of the page, button 2 counts up
   if (buttons[0].rose())
   {
     if (DisplayIsOn)
     {
       if (ActualDisplayPage == 2)
       {
-        SetFilterPumpModeAutomatic(!FilterpumpAutomaticOn);
+        StepValue(ValueFilterPumpModeAutomatic, 1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 4)
       {
-        FilterpumpAutomaticOnTime--;
-        if (FilterpumpAutomaticOnTime < 0)
-        {
-          FilterpumpAutomaticOnTime = 23;
-        }
-        SetFilterpumpAutomaticOnTime(FilterpumpAutomaticOnTime);
+        StepValue(ValueFilterpumpAutomaticOnTime, -1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 5)
       {
-        SaltSystemAutomaticOnTime--;
-        if (SaltSystemAutomaticOnTime < 0)
-        {
-          SaltSystemAutomaticOnTime = 23;
-        }
-        SetSaltSystemAutomaticOnTime(SaltSystemAutomaticOnTime);
+        StepValue(ValueSaltSystemAutomaticOnTime, -1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 6)
       {
-        SetAutomaticStartActive(!AutomaticStartActive);
+        StepValue(ValueAutomaticStartActive, 1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 7)
       {
-        AutomaticStartTime--;
-        if (AutomaticStartTime < 0)
-        {
-          AutomaticStartTime = 23;
-        }
-        SetAutomaticStartTime(AutomaticStartTime);
+        StepValue(ValueAutomaticStartTime, -1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 8)
       {
-        SetValvePosition(!ValvePositionHeat);
+        StepValue(ValueValveToHeat, 1);
         UpdateDisplay();
       }
     }
     HandleDisplaypower(true);
   }
-  // Button 2
   if (buttons[1].rose())
   {
     if (DisplayIsOn)
     {
       if (ActualDisplayPage == 2)
       {
-        SetSaltSystemModeAutomatic(!SaltSystemAutomaticOn);
+        StepValue(ValueSaltSystemModeAutomatic, 1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 4)
       {
-        FilterpumpAutomaticOnTime++;
-        if (FilterpumpAutomaticOnTime > 23)
-        {
-          FilterpumpAutomaticOnTime = 1;
-        }
-        SetFilterpumpAutomaticOnTime(FilterpumpAutomaticOnTime);
+        StepValue(ValueFilterpumpAutomaticOnTime, 1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 5)
       {
-        SaltSystemAutomaticOnTime++;
-        if (SaltSystemAutomaticOnTime > 23)
-        {
-          SaltSystemAutomaticOnTime = 1;
-        }
-        SetSaltSystemAutomaticOnTime(SaltSystemAutomaticOnTime);
+        StepValue(ValueSaltSystemAutomaticOnTime, 1);
         UpdateDisplay();
       }
       else if (ActualDisplayPage == 7)
       {
-        AutomaticStartTime++;
-        if (AutomaticStartTime > 23)
-        {
-          AutomaticStartTime = 0;
-        }
-        SetAutomaticStartTime(AutomaticStartTime);
+        StepValue(ValueAutomaticStartTime, 1);
         UpdateDisplay();
       }
     }
@@ -303,30 +675,96 @@ void loop()
 
     // Serial.println("Refresh Display");
 
-    if (WaterThermometerValue > WaterMAxTemperature &&
-        ValvePositionHeat == 1 &&
-        ValveAutomaticMode)
+    RunSolarValve();
+
+    Telemetry.MarkDirty(TelemetryTemperatures);
+    UpdateDisplay();
+  }
+
+  for (uint8_t i = 0; i < MeshMessagesPerLoop; i++)
+  {
+    MeshMessageSlot *Slot = InboundMessages.Front();
+    if (!Slot)
     {
-      SetValvePosition(0);
+      break;
     }
+    TRACE_MESSAGE(TRACE_INBOUND, Slot->Payload, Slot->Length, Slot->SrcMac);
+    LastmeshMessage(Slot->Payload, Slot->Length, Slot->SrcMac);
+    InboundMessages.Pop();
+  }
 
-    UpdateMqtt();
-    UpdateDisplay();
+  // Relay changes of this pass as one write, ahead of a few display chunks
+  Outputs.Commit();
+  if (I2cBus.Pending() || DisplayLines.Busy())
+  {
+    STATS_SCOPE(StatsI2c);
+    I2cBus.Loop();
   }
+  STATS_END(StatsLoop);
+
+  // Sleep until the next deadline, a mesh message or a button edge
+  LoopEvents.Wait(LoopIdleTimeout());
+}
 
-  if (NewMeshMessage)
+uint32_t LoopIdleTimeout()
+{
+  if (InboundMessages.Size() || NewTemperatures || Outputs.Pending() || I2cBus.Pending() || DisplayLines.Busy())
   {
-    NewMeshMessage = false;
-    LastmeshMessage(LastMeshMessage, LastSrcMac);
+    return 0;
   }
 
+  uint32_t Timeout = LoopMaxIdleMs;
+  for (int i = 0; i < NUM_BUTTONS; i++)
+  {
+    // Bounce only sees a stable level by polling
+    if ((bool)digitalRead(BUTTON_PINS[i]) != buttons[i].read())
+    {
+      Timeout = ButtonSettleMs;
+    }
+  }
+  const uint32_t Deadlines[] = {Timers.NextDueMs(), SaltSystemSequencer.NextDueMs(), ValveSequencer.NextDueMs(),
+                                Telemetry.NextDueMs(), Backlog.NextDueMs(), Settings.NextDueMs(),
+                                RunState.NextDueMs(), TemperatureSensors.NextDueMs(), Ota.NextDueMs()};
+  for (uint32_t Due : Deadlines)
+  {
+    Timeout = Due < Timeout ? Due : Timeout;
+  }
+  return Timeout;
+}
+
+void IRAM_ATTR ButtonChanged()
+{
+#if CONFIG_PM_ENABLE
+  // Re-arm the level interrupts for the opposite level. Registers only:
+  // gpio_wakeup_enable() and digitalRead() are not in IRAM. All button
+  // pins are below 32.
+  for (int i = 0; i < NUM_BUTTONS; i++)
+  {
+    uint8_t Pin = BUTTON_PINS[i];
+    GPIO.pin[Pin].int_type = (GPIO.in >> Pin) & 1 ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+  }
+#endif
+  LoopEvents.SignalFromIsr(LOOP_WAKE_GPIO);
+}
+
+void SampleIdle()
+{
+  LoopEvents.SampleIdle();
 }
 
 void RootNotActiveWatchdog()
 {
-  String MsgBack = "MQTT Reboot WatchdogReboot";
-  GBusMesh.SendMessage(MsgBack);
-  //ESP.restart();
+  // Nothing from the root for CheckForRootNodeIntervall: keep telemetry
+  // for it instead of sending it into the void, starting with a snapshot
+  Backlog.RootLost();
+  Telemetry.MarkDirty(TelemetryValues | TelemetryOutputs);
+}
+
+void RootSeen()
+{
+  // Any message proves the root is reachable, "I'm Root!" comes when nothing else does
+  Timers.Arm(WatchdogTimer, CheckForRootNodeIntervall, RootNotActiveWatchdog);
+  Backlog.RootAlive();
 }
 
 void SentNodeInfo()
@@ -334,395 +772,794 @@ void SentNodeInfo()
   mesh_addr_t bssid;
   esp_err_t err = esp_mesh_get_parent_bssid(&bssid);
 
-  char MsgBuffer[300];
-  sprintf(MsgBuffer, "MQTT Info ModulName:%s,SubType:%u,MAC:%s,WifiStrength:%d,Parent:%s,FW:%s", MODULNAME, ModulType, WiFi.macAddress().c_str(), getWifiStrength(3), hextab_to_string(bssid.addr).c_str(), FWVERSION);
-  String Msg = String(MsgBuffer);
-  GBusMesh.SendMessage(Msg);
+  uint8_t Mac[6];
+  WiFi.macAddress(Mac);
+
+  char MsgBuffer[512];
+  TextBuffer Msg(MsgBuffer, sizeof(MsgBuffer));
+  Msg.Printf("MQTT Info ModulName:%s,SubType:%u,MAC:", MODULNAME, ModulType);
+  Msg.AppendHex(Mac, sizeof(Mac), ':');
+  Msg.Printf(",WifiStrength:%d,Parent:", getWifiStrength(3));
+  Msg.AppendHex(bssid.addr, sizeof(bssid.addr), ':');
+  Msg.Printf(",FW:%s,RxDropped:%u,RxHighWater:%u,TxSaved:%u,Telemetry:%s,Encodings:json/msgpack,Encoding:%s,Settings:%s,SettingsWrites:%u,SettingsFailed:%u,Idle:%u%%,Clock:%s,ClockDriftPpb:%ld,Slot:%s,BootDecisionMs:%lu,MeshUpMs:%lu", FWVERSION,
+             InboundMessages.Overflows() + InboundMessages.Oversized(), InboundMessages.HighWater(), Telemetry.Saved(),
+             TelemetryMode == TelemetryModeDelta ? "delta" : "full", MeshEncoding == MeshEncodingMsgPack ? "msgpack" : "json",
+             Settings.Restored() ? "restored" : "defaults", Settings.Writes(), Settings.Failed() + RunState.Failed(), LoopEvents.IdlePercent(),
+             Clock.Synced() ? "synced" : "unsynced", (long)Clock.DriftPpb(), esp_ota_get_running_partition()->label,
+             BootDecisionMs, MeshUpMs);
+  Msg.Printf(",Backlog:%u/%u/%u,BacklogDropped:%lu,BacklogFlushed:%lu/%lu,LastFlush:%u/%lu", Backlog.Records(), Backlog.Used(),
+             Backlog.Capacity(), (unsigned long)Backlog.Dropped(), (unsigned long)Backlog.FlushedRecords(),
+             (unsigned long)Backlog.FlushedBytes(), Backlog.LastFlushRecords(), (unsigned long)Backlog.LastFlushMs());
+  SendMeshMessage(Msg);
+}
+
+void SendMeshMessage(const char *Msg, size_t Length)
+{
+  if (!MeshStarted || !MeshConnected)
+  {
+    return;
+  }
+  STATS_COUNT(StatsMeshOut);
+  TRACE_MESSAGE(TRACE_OUTBOUND, Msg, Length, nullptr);
+  MeshOutString = "";
+  MeshOutString.concat(Msg, Length);
+  GBusMesh.SendMessage(MeshOutString);
+}
+void SendMeshMessage(const char *Msg)
+{
+  SendMeshMessage(Msg, strlen(Msg));
+}
+void SendMeshMessage(const TextBuffer &Msg)
+{
+  SendMeshMessage(Msg.c_str(), Msg.Length());
 }
 
 void meshConnected()
 {
+  // Runs in the mesh task, loop() greets the gateway
+  MeshConnected = true;
+  MeshConnectPending = true;
+  LoopEvents.Signal(LOOP_WAKE_MESH);
+}
+
+void MeshConnectedInLoop()
+{
+  if (!MeshUpMs)
+  {
+    MeshUpMs = millis();
+  }
   SentNodeInfo();
+  if (!Clock.Synced())
+  {
+    // Gateways that know it answer with "time HH:MM:SS" right away
+    SendMeshMessage("MQTT GetTime");
+  }
+  // Whatever was published before association is lost, start with a full picture
+  PublishedOutputState = ~Outputs.State();
+  Telemetry.MarkDirty(TelemetryValues | TelemetryOutputs);
+  RequestTelemetryKeyframe();
 }
 
 void meshMessage(String msg, uint8_t SrcMac[6])
 {
-  LastMeshMessage = msg;
-  memcpy(LastSrcMac, SrcMac, sizeof(LastSrcMac));
-  NewMeshMessage = true;
+  // Runs in the mesh task: only copy into the queue, loop() handles it
+  InboundMessages.Push(msg.c_str(), msg.length(), SrcMac);
+  STATS_COUNT(StatsMeshIn);
+  LoopEvents.Signal(LOOP_WAKE_MESH);
 }
 
-void LastmeshMessage(String msg, uint8_t SrcMac[6])
+// Value commands are named after the schema key and find their entry by index
+#define VALUE_COMMAND(Index) {PoolValues[Index].Key, CommandValue<Index>}
+
+// Mesh commands, sorted by name (checked at compile time) for binary search;
+// extern so the dispatch benchmark in sim/ measures this very table
+extern constexpr MeshCommandEntry MeshCommands[] = {
+    VALUE_COMMAND(ValueAutomaticStartActive),
+    VALUE_COMMAND(ValueAutomaticStartTime),
+    {"Config", CommandConfig},
+    {"Encoding", CommandEncoding},
+    VALUE_COMMAND(ValueFilterPumpModeAutomatic),
+    VALUE_COMMAND(ValueFilterpumpAutomaticOnTime),
+    {"GetNodeInfo", CommandGetNodeInfo},
+    {"I'm", CommandRootAlive},
+    {"Reboot", CommandReboot},
+    VALUE_COMMAND(ValueSaltSystemAutomaticOnTime),
+    VALUE_COMMAND(ValueSaltSystemModeAutomatic),
+    {"SensorRole", CommandSensorRole},
+    {"SensorScan", CommandSensorScan},
+    {"SolarConfig", CommandSolarConfig},
+    {"TelemetryMode", CommandTelemetryMode},
+    {"TelemetryWindow", CommandTelemetryWindow},
+    VALUE_COMMAND(ValueValveAutomaticMode),
+    VALUE_COMMAND(ValueValveToHeat),
+    VALUE_COMMAND(ValueWaterMaxTemperature),
+    {"history", CommandHistory},
+    {"ota", CommandOta},
+    {"output", CommandOutput},
+    {"outputs", CommandOutputs},
+    {"schedule", CommandSchedule},
+    {"stats", CommandStats},
+    {"time", CommandTime},
+};
+static_assert(MeshCommandTableIsSorted(MeshCommands), "MeshCommands must be sorted by name");
+extern const size_t MeshCommandCount = sizeof(MeshCommands) / sizeof(MeshCommands[0]);
+
+void LastmeshMessage(char *msg, uint16_t Length, uint8_t SrcMac[6])
 {
-  MDF_LOGD("Rec msg %u: %s", msg.length(), msg.c_str());
-
-  String Type = getValue(msg, ' ', 0);
-  String Number = getValue(msg, ' ', 1);
-  String Command = getValue(msg, ' ', 2);
-  uint8_t NumberInt = Number.toInt();
+  STATS_SCOPE(StatsMeshMessage);
+  RootSeen();
+  if (DeltaOta::IsFragment(msg, Length))
+  {
+    Ota.Fragment((const uint8_t *)msg, Length);
+    return;
+  }
+  if (MeshCommandIsMsgPack(msg, Length))
+  {
+    char Line[MESH_COMMAND_MAX_LENGTH];
+    if (MeshCommandFromMsgPack(msg, Length, Line, sizeof(Line)))
+    {
+      MDF_LOGD("Rec msgpack %u: %s", Length, Line);
+      MeshCommandDispatch(MeshCommands, Line);
+    }
+    return;
+  }
 
-  //String MsgBack = "MQTT Get " + Type + " " + Number + " " + Command;
-  //mesh.SendMessage(MsgBack);
+  MDF_LOGD("Rec msg %u: %s", Length, msg);
 
-  if (msg.startsWith("I'm Root!"))
+  // Tokenized in place in the queue slot
+  MeshCommandDispatch(MeshCommands, msg);
+}
+void CommandRootAlive(const MeshCommandArgs &Args)
+{
+  if (strncmp(Args.Text(1), "Root!", 5) == 0)
   {
+    // LastmeshMessage() already re-armed the watchdog
     MDF_LOGI("Gateway hold alive received");
-    tasker.cancel(RootNotActiveWatchdog);
-    tasker.setTimeout(RootNotActiveWatchdog, CheckForRootNodeIntervall);
   }
-  else if (Type == "Config")
+}
+void CommandConfig(const MeshCommandArgs &Args)
+{
+  Serial.printf("Config\n");
+}
+void CommandGetNodeInfo(const MeshCommandArgs &Args)
+{
+  SentNodeInfo();
+  RequestTelemetryKeyframe();
+}
+void CommandReboot(const MeshCommandArgs &Args)
+{
+  // give the mesh time to deliver pending messages
+  Timers.Schedule(2000, RebootNow);
+}
+void CommandTime(const MeshCommandArgs &Args)
+{
+  // time HH:MM (valid for the whole minute) or HH:MM:SS
+  unsigned Hour = 0, Minute = 0, Second = 0;
+  int Fields = sscanf(Args.Text(1), "%u:%u:%u", &Hour, &Minute, &Second);
+  if (Fields < 2 || Hour > 23 || Minute > 59 || Second > 59)
   {
-    Serial.printf("Config\n");
+    return;
   }
-  else if (Type == "GetNodeInfo")
+  Clock.Sync(Hour * 3600UL + Minute * 60UL + Second, Fields == 3 ? 1 : 60);
+  RunSchedule();
+}
+void ScheduledStart(uint8_t Slot, const ScheduleSlot &Entry)
+{
+  if (FilterpumpAutomaticOn)
   {
-    SentNodeInfo();
+    return;
   }
-  else if (Type == "Reboot")
+
+  SetFilterPumpModeAutomatic(1, Entry.PumpHours * 60);
+  if (Entry.SaltHours && !SaltSystemAutomaticOn)
   {
-    delay(2000);
-    ESP.restart();
+    SetSaltSystemModeAutomatic(1, Entry.SaltHours * 60);
   }
-  else if (Type == "time")
+  // With the pump running the collector can be judged right away
+  RunSolarValve();
+  UpdateDisplay();
+}
+void RunSchedule()
+{
+  Clock.Tick();
+  uint32_t Next = Schedule.Run(Clock);
+  Timers.Arm(ScheduleTimer, Next < ScheduleRecheckMs ? Next : ScheduleRecheckMs, RunSchedule);
+}
+void CommandOutput(const MeshCommandArgs &Args)
+{
+  long Output = Args.Int(1);
+  if (Output < 1 || Output > 8)
   {
-    String ActualTime = getValue(msg, ' ', 1);
-    sscanf(ActualTime.c_str(), "%u:%u", &Hour, &Minute);
-
-    //String MsgBack = "MQTT time Time=" + String(Hour) + ":" + String(Minute) + "," + String(AutomaticStartTime) + "," + String(AutomaticStartActive) + "," + String(FilterpumpAutomaticOn);
-    //mesh.SendMessage(MsgBack);
-
-    if (Hour == AutomaticStartTime &&
-        Minute == 0 &&
-        AutomaticStartActive &&
-        !FilterpumpAutomaticOn)
+    Serial.printf("output: %s rejected\n", Args.Text(1));
+    return;
+  }
+  SetOutput(Output, Args.Int(2));
+}
+void CommandOutputs(const MeshCommandArgs &Args)
+{
+  // outputs <mask> <values>, bit 0 = output 1. Committed as one relay card write.
+  long Mask, Values;
+  if (!MeshParseInt(Args.Text(1), Mask) || !MeshParseInt(Args.Text(2), Values) || Mask < 0 || Mask > 255 ||
+      Values < 0 || Values > 255)
+  {
+    Serial.printf("outputs: %s %s rejected\n", Args.Text(1), Args.Text(2));
+    return;
+  }
+  for (uint8_t Output = 1; Output <= 8; Output++)
+  {
+    uint8_t Bit = 1 << (Output - 1);
+    if (Mask & Bit)
     {
-      if (WaterThermometerValue < (WaterMAxTemperature - 2) &&
-          ValvePositionHeat == 0 &&
-          ValveAutomaticMode)
-      {
-        SetValvePosition(1);
-      }
-
-      SetFilterPumpModeAutomatic(!FilterpumpAutomaticOn);
-      SetSaltSystemModeAutomatic(!SaltSystemAutomaticOn);
-      UpdateDisplay();
-      UpdateMqtt();
+      SetOutput(Output, Values & Bit);
     }
-
   }
-  else if (Type == "output")
+}
+template <uint8_t Index>
+void CommandValue(const MeshCommandArgs &Args)
+{
+  static_assert(PoolValues[Index].Min < PoolValues[Index].Max, "read only values have no command");
+  long Value;
+  if (!MeshParseInt(Args.Text(1), Value) || !ApplyValue(Index, Value))
   {
-    String OutputString = getValue(msg, ' ', 1);
-    uint8_t OutputNumber = OutputString.toInt();
-
-    SetOutput(OutputNumber, getValue(msg, ' ', 2).toInt());
+    Serial.printf("%s: %s rejected\n", PoolValues[Index].Key, Args.Text(1));
   }
-  else if (Type == "FilterPumpModeAutomatic")
+}
+bool ApplyValue(uint8_t Index, long Value)
+{
+  const ValueField &Field = PoolValues[Index];
+  if (!ValueInRange(Field, Value))
   {
-    SetFilterPumpModeAutomatic(getValue(msg, ' ', 1).toInt());
+    return false;
   }
-  else if (Type == "FilterpumpAutomaticOnTime")
+  if (Field.Set)
   {
-    SetFilterpumpAutomaticOnTime(getValue(msg, ' ', 1).toInt());
+    Field.Set(Value);
+    return true;
   }
-  else if (Type == "SaltSystemModeAutomatic")
+  ValueStore(Field, Value);
+  Settings.MarkDirty();
+  Telemetry.MarkDirty(TelemetryValue(Index));
+  return true;
+}
+void StepValue(uint8_t Index, int Delta)
+{
+  ApplyValue(Index, ValueStep(PoolValues[Index], Delta));
+}
+void CommandTelemetryWindow(const MeshCommandArgs &Args)
+{
+  long WindowMs = Args.Int(1);
+  Telemetry.SetWindow(WindowMs < 0 ? 0 : (WindowMs > 60000 ? 60000 : WindowMs));
+}
+void CommandTelemetryMode(const MeshCommandArgs &Args)
+{
+  TelemetryMode = Args.Int(1) == TelemetryModeDelta ? TelemetryModeDelta : TelemetryModeFull;
+  Settings.MarkDirty();
+  RequestTelemetryKeyframe();
+}
+void CommandEncoding(const MeshCommandArgs &Args)
+{
+  // The gateway opts in per node after reading "Encodings" from NodeInfo
+  MeshEncoding = Args.Int(1) == MeshEncodingMsgPack ? MeshEncodingMsgPack : MeshEncodingJson;
+  Settings.MarkDirty();
+  Telemetry.MarkDirty(TelemetryValues);
+}
+void CommandSensorRole(const MeshCommandArgs &Args)
+{
+  // SensorRole <role 0..3> <address as 16 hex digits>
+  DeviceAddress Address;
+  long Role = Args.Int(1);
+  if (Role >= 0 && Role < TEMPERATURE_MAX_ROLES && TemperatureSensorManager::ParseAddress(Args.Text(2), Address))
   {
-    SetSaltSystemModeAutomatic(getValue(msg, ' ', 1).toInt());
+    TemperatureSensors.SetRole(Role, Address);
+    TemperatureSensors.RequestNow();
+    SaveSensorRoles();
   }
-  else if (Type == "SaltSystemAutomaticOnTime")
+  SendSensorList();
+}
+void CommandSensorScan(const MeshCommandArgs &Args)
+{
+  TemperatureSensors.Discover();
+  TemperatureSensors.RequestNow();
+  SaveSensorRoles();
+  SendSensorList();
+}
+void CommandHistory(const MeshCommandArgs &Args)
+{
+  // history <0 raw, 1 hours, 2 days> <chunk, 0 = newest>
+  long Tier = Args.Int(1);
+  long Chunk = Args.Int(2);
+  if (Tier < HistoryRaw || Tier >= HistoryTiers || Chunk < 0 || Chunk > UINT16_MAX)
   {
-    SetSaltSystemAutomaticOnTime(getValue(msg, ' ', 1).toInt());
+    return;
   }
-  else if (Type == "AutomaticStartActive")
+  // "MQTT history <tier> <chunk> <chunks> <uptime minute> " and the zlib stream
+  uint8_t Compressed[HistoryExportSize];
+  size_t Length = History.Export((HistoryTier)Tier, Chunk, Compressed, sizeof(Compressed));
+  char MsgBuffer[MeshPacketSize];
+  TextBuffer Msg(MsgBuffer, sizeof(MsgBuffer));
+  Msg.Printf("MQTT history %ld %ld %u %lu ", Tier, Chunk, History.Chunks((HistoryTier)Tier), millis() / 60000);
+  Msg.Append((const char *)Compressed, Length);
+  SendMeshMessage(Msg);
+}
+void CommandSolarConfig(const MeshCommandArgs &Args)
+{
+  // SolarConfig [<on delta> <off delta> <hysteresis> <dwell minutes>], deltas
+  // in 1/10 K; replies with the config, the valve moves and the dwell backoff
+  if (Args.Count >= 5)
   {
-    SetAutomaticStartActive(getValue(msg, ' ', 1).toInt());
+    long OnDelta = Args.Int(1);
+    long OffDelta = Args.Int(2);
+    long Hysteresis = Args.Int(3);
+    long Dwell = Args.Int(4);
+    if (OnDelta < 1 || OnDelta > 250 || OffDelta < 0 || OffDelta > OnDelta || Hysteresis < 0 || Hysteresis > 250 ||
+        Dwell < 0 || Dwell > 120)
+    {
+      return;
+    }
+    SolarSettings = {(uint8_t)OnDelta, (uint8_t)OffDelta, (uint8_t)Hysteresis, (uint8_t)Dwell};
+    Settings.MarkDirty();
+  }
+  char MsgBuffer[64];
+  snprintf(MsgBuffer, sizeof(MsgBuffer), "MQTT SolarConfig %u %u %u %u moves:%u backoff:%u", SolarSettings.OnDelta,
+           SolarSettings.OffDelta, SolarSettings.Hysteresis, SolarSettings.DwellMinutes, SolarValve.Actuations(),
+           SolarValve.Backoff());
+  SendMeshMessage(MsgBuffer);
+}
+void CommandSchedule(const MeshCommandArgs &Args)
+{
+  // schedule [<slot> <active 0/1> <HH:MM> <pump hours> <salt hours>], replies
+  // "MQTT schedule <slot>=<active>,<HH:MM>,<pump>,<salt>;..."
+  if (Args.Count >= 6)
+  {
+    long Slot = Args.Int(1);
+    unsigned Hour = 24, Minute = 60;
+    sscanf(Args.Text(3), "%u:%u", &Hour, &Minute);
+    long Pump = Args.Int(4);
+    long Salt = Args.Int(5);
+    if (Slot < 0 || Slot >= ScheduleSlotCount || Hour > 23 || Minute > 59 || Pump < 1 || Pump > 23 || Salt < 0 || Salt > Pump)
+    {
+      return;
+    }
+    ScheduleSlots[Slot].Minute = Minute;
+    if (Slot == 0)
+    {
+      // Slot 0 is the classic automatic start of the display pages
+      SetAutomaticStartActive(Args.Int(2));
+      SetAutomaticStartTime(Hour);
+      SetFilterpumpAutomaticOnTime(Pump);
+      SetSaltSystemAutomaticOnTime(Salt);
+    }
+    else
+    {
+      ScheduleSlots[Slot] = {Args.Int(2) != 0, (uint8_t)Hour, (uint8_t)Minute, (uint8_t)Pump, (uint8_t)Salt};
+      Schedule.Changed(Slot, Clock);
+      Settings.MarkDirty();
+      RunSchedule();
+    }
   }
-  else if (Type == "AutomaticStartTime")
+  SendSchedule();
+}
+void SendSchedule()
+{
+  char MsgBuffer[24 + ScheduleSlotCount * 20] = "MQTT schedule ";
+  size_t Length = strlen(MsgBuffer);
+  for (uint8_t i = 0; i < ScheduleSlotCount; i++)
   {
-    SetAutomaticStartTime(getValue(msg, ' ', 1).toInt());
+    const ScheduleSlot &Slot = ScheduleSlots[i];
+    Length += snprintf(MsgBuffer + Length, sizeof(MsgBuffer) - Length, "%s%u=%u,%02u:%02u,%u,%u", i ? ";" : "", i, Slot.Active,
+                       Slot.Hour, Slot.Minute, Slot.PumpHours, Slot.SaltHours);
   }
-  else if (Type == "ValveToHeat")
+  SendMeshMessage(MsgBuffer);
+}
+void CommandOta(const MeshCommandArgs &Args)
+{
+  // ota begin <size> <crc> <source size> <source crc> (CRCs in hex) starts a
+  // delta update against the running slot, ota switch boots a verified one,
+  // ota abort drops it. Every form replies "MQTT ota <state> <window> <offset>".
+  const char *Action = Args.Text(1);
+  if (strcmp(Action, "begin") == 0)
   {
-    SetValvePosition(getValue(msg, ' ', 1).toInt());
+    Ota.Begin(strtoul(Args.Text(2), nullptr, 10), strtoul(Args.Text(3), nullptr, 16), strtoul(Args.Text(4), nullptr, 10),
+              strtoul(Args.Text(5), nullptr, 16));
   }
-  else if (Type == "WaterMaxTemperature")
+  else if (strcmp(Action, "switch") == 0)
   {
-    WaterMAxTemperature = getValue(msg, ' ', 1).toInt();
-    //String Msg = "MQTT WaterMaxTemperature " + String(WaterMAxTemperature);
-    //mesh.SendMessage(Msg);
-    UpdateMqtt();
-    // client.publish("gimpire/EspPool/WaterMaxTemperature", String(WaterMAxTemperature).c_str());
+    if (Ota.Switch())
+    {
+      // give the mesh time to deliver the reply
+      Timers.Schedule(2000, RebootNow);
+    }
   }
-  else if (Type == "ValveAutomaticMode")
+  else if (strcmp(Action, "abort") == 0)
   {
-    ValveAutomaticMode = getValue(msg, ' ', 1).toInt();
-    //String Msg = "MQTT ValveAutomaticMode " + String(ValveAutomaticMode);
-    //mesh.SendMessage(Msg);
-    UpdateMqtt();
-    // client.publish("gimpire/EspPool/ValveAutomaticMode", String(ValveAutomaticMode).c_str());
+    Ota.Abort();
+    Ota.Report();
+  }
+  else
+  {
+    Ota.Report();
+  }
+}
+void CommandStats(const MeshCommandArgs &Args)
+{
+  // stats [reset]: "MQTT stats heap:<free>/<min free> meshIn:<n> meshOut:<n>"
+  // and per probe " <name>:<count>/<min>/<avg>/<max>/<first bucket>:<n>.<n>..."
+  // in CPU cycles, bucket b counting 2^b..2^(b+1)-1 cycles. reset clears
+  // everything after the snapshot.
+#if HOTPATH_STATS
+  char MsgBuffer[640] = "MQTT stats ";
+  Stats.Format(MsgBuffer + 11, sizeof(MsgBuffer) - 11);
+  if (strcmp(Args.Text(1), "reset") == 0)
+  {
+    Stats.Reset();
   }
+  SendMeshMessage(MsgBuffer);
+#else
+  SendMeshMessage("MQTT stats disabled");
+#endif
 }
 void HandleDisplaypower(int DisplayOn)
 {
   if (DisplayOn == 1)
   {
     DisplayIsOn = true;
-    tasker.cancel(HandleDisplaypower, 0);
-    tasker.setTimeout(HandleDisplaypower, 10000, 0);
+    Timers.Arm(DisplayTimer, 10000, DisplayTimeout);
     UpdateDisplay();
   }
   else
   {
     Display.clear();
-    Display.display();
+    DisplayLines.Flush();
+    DisplayLines.Invalidate();
     DisplayIsOn = false;
   }
 }
-void readSensor()
+void TemperatureReading(uint8_t Role, float TempC)
 {
-  WaterThermometerValue = sensors.getTempC(WaterThermometer);
-  VorlaufThermometerValue = sensors.getTempC(VorlaufThermometer);
-  RucklaufThermometerValue = sensors.getTempC(RucklaufThermometer);
-  GarageRoofThermometerValue = sensors.getTempC(GarageRoofThermometer);
-  NewTemperatures = true;
+  TRACE_SENSOR_RECORD(Role, TempC);
+  *SensorValues[Role] = TempC;
+}
+void SaveSensorRoles()
+{
+  // Roles move on SensorRole and when a replaced probe is discovered
+  bool Changed = false;
+  for (uint8_t Role = 0; Role < TEMPERATURE_MAX_ROLES; Role++)
+  {
+    const uint8_t *Address = TemperatureSensors.RoleAddress(Role);
+    if (Address && memcmp(Address, SensorAddresses[Role], sizeof(DeviceAddress)))
+    {
+      memcpy(SensorAddresses[Role], Address, sizeof(DeviceAddress));
+      Changed = true;
+    }
+  }
+  if (Changed)
+  {
+    Settings.MarkDirty();
+  }
 }
-void TempSensorStartConversion()
+void SendSensorList()
 {
-  // start temperature conversion (does not block)
-  sensors.requestTemperatures();
-  // schedule reading the actual temperature in 750 milliseconds
-  tasker.setTimeout(readSensor, 1000);
-  
+  // "MQTT Sensors <address>=<role>,..." with '-' for sensors without a role
+  char MsgBuffer[16 + TEMPERATURE_MAX_SENSORS * 20] = "MQTT Sensors ";
+  size_t Used = strlen(MsgBuffer);
+  for (uint8_t i = 0; i < TemperatureSensors.Count(); i++)
+  {
+    char Hex[17];
+    TemperatureSensorManager::FormatAddress(TemperatureSensors.Address(i), Hex);
+    uint8_t Role = TemperatureSensors.RoleOfSensor(i);
+    char RoleText[4] = "-";
+    if (Role != TEMPERATURE_NO_ROLE)
+    {
+      snprintf(RoleText, sizeof(RoleText), "%u", Role);
+    }
+    Used += snprintf(MsgBuffer + Used, sizeof(MsgBuffer) - Used, "%s%s=%s", i ? "," : "", Hex, RoleText);
+  }
+  SendMeshMessage(MsgBuffer);
 }
 void UpdateMqtt()
 {
+  STATS_SCOPE(StatsMqtt);
   StaticJsonDocument<1000> PoolJson;
+  // Values as the strings String(value) made of them, in caller storage:
+  // the document keeps only the pointer to a const char *
+  char Text[PoolValueCount][12];
 
-  if (WaterThermometerValue > -127)
+  for (uint8_t i = 0; i < PoolValueCount; i++)
   {
-    PoolJson["WaterTemp"] = String(WaterThermometerValue);
+    const ValueField &Field = PoolValues[i];
+    // Sensor read errors are left out, as in delta mode
+    if (Field.Type == ValueFloat && ValueRead(Field) <= -127)
+    {
+      continue;
+    }
+    PoolJson[Field.Key] = ValueFormat(Field, Text[i], sizeof(Text[i]));
   }
 
-  PoolJson["VLTemp"] = String(VorlaufThermometerValue);
-  PoolJson["RLTemp"] = String(RucklaufThermometerValue);
-  PoolJson["TemperatureGarageRoof"] = String(GarageRoofThermometerValue);
-  PoolJson["ValveAutomaticMode"] = String(ValveAutomaticMode);
-  PoolJson["WaterMaxTemperature"] = String(WaterMAxTemperature);
-  PoolJson["AutomaticStartActive"] = String(AutomaticStartActive);
-  PoolJson["SaltSystemModeAutomatic"] = String(SaltSystemAutomaticOn);
-  PoolJson["SaltSystemAutomaticOnTime"] = String(SaltSystemAutomaticOnTime);
-  PoolJson["ValveToHeat"] = String(ValvePositionHeat);
-  PoolJson["FilterPumpModeAutomatic"] = String(FilterpumpAutomaticOn);
-  PoolJson["AutomaticStartTime"] = String(AutomaticStartTime);
-  PoolJson["FilterpumpAutomaticOnTime"] = String(FilterpumpAutomaticOnTime);
+  char MsgBuffer[512];
+  TextBuffer Msg(MsgBuffer, sizeof(MsgBuffer));
+  Msg.Append("MQTT values ");
+  Msg.Commit(serializeJson(PoolJson, Msg.Tail(), Msg.Free() + 1));
+  SendMeshMessage(Msg);
+}
+// Typed values: in delta mode only those that moved beyond their deadband,
+// otherwise all of them. Returns false if nothing was worth a packet.
+bool UpdateMqttDelta(uint32_t Fields)
+{
+  StaticJsonDocument<1000> PoolJson;
 
-  String PoolJsonString;
-  serializeJson(PoolJson, PoolJsonString);
-  String Msg = "MQTT values " + PoolJsonString;
-  GBusMesh.SendMessage(Msg);
+  bool Keyframe = TelemetryKeyframePending || TelemetryMode == TelemetryModeFull;
+  TelemetryKeyframePending = false;
+  if (!TelemetryChanges.Collect(PoolJson, Fields, Keyframe))
+  {
+    return false;
+  }
+  SendMqttValues(PoolJson);
+  return true;
 }
-void UpdateDisplay()
+void SendMqttValues(JsonDocument &PoolJson)
 {
-  if (DisplayIsOn)
+  char MsgBuffer[512];
+  TextBuffer Msg(MsgBuffer, sizeof(MsgBuffer));
+  Msg.Append("MQTT values ");
+  if (MeshEncoding == MeshEncodingMsgPack)
   {
+    Msg.Commit(serializeMsgPack(PoolJson, Msg.Tail(), Msg.Free()));
+  }
+  else
+  {
+    Msg.Commit(serializeJson(PoolJson, Msg.Tail(), Msg.Free() + 1));
+  }
+  SendMeshMessage(Msg);
+}
+void RequestTelemetryKeyframe()
+{
+  // Every full-mode update already is a snapshot
+  if (TelemetryMode == TelemetryModeDelta)
+  {
+    TelemetryKeyframePending = true;
+    Telemetry.MarkDirty(TelemetryValues);
+  }
+}
+uint8_t PublishTelemetry(uint32_t Fields)
+{
+  // Kept until the root confirmed it. In an outage, and until the backlog
+  // is flushed after one, the record is all the gateway gets.
+  if (!Backlog.Record(Fields & TelemetryValues, Outputs.State()))
+  {
+    PublishedOutputState = Outputs.State();
+    return 0;
+  }
 
-    if (ActualDisplayPage == 1)
-    {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText = "Wasser: " + String(WaterThermometerValue);
-      Display.drawString(4, 12, DisplayText.c_str());
-
-      DisplayText = "Vorlauf: " + String(VorlaufThermometerValue);
-      Display.drawString(4, 22, DisplayText.c_str());
-
-      DisplayText = "Rücklauf: " + String(RucklaufThermometerValue);
-      Display.drawString(4, 32, DisplayText.c_str());
-
-      DisplayText = "Dach: " + String(GarageRoofThermometerValue);
-      Display.drawString(4, 42, DisplayText.c_str());
-
-      Display.display();
-    }
-    else if (ActualDisplayPage == 2)
-    {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText = "Filterpumpe: " + String(FilterpumpAutomaticOn);
-      Display.drawString(4, 12, DisplayText.c_str());
-
-      DisplayText = "Salzwasser: " + String(SaltSystemAutomaticOn);
-      Display.drawString(4, 22, DisplayText.c_str());
-
-      DisplayText = "Waser Max Temp: " + String(WaterMAxTemperature);
-      Display.drawString(4, 32, DisplayText.c_str());
-
-      if (ValvePositionHeat)
-      {
-        DisplayText = "Valve: solar";
-      }
-      else
-      {
-        DisplayText = "Valve: pool";
-      }
-
-      Display.drawString(4, 42, DisplayText.c_str());
-
-      String ipString = WiFi.localIP().toString();
-
-      DisplayText = "IP: " + ipString;
-      Display.drawString(4, 52, DisplayText.c_str());
-
-      Display.display();
-    }
-    else if (ActualDisplayPage == 3)
-    {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText = "Filter Zeit: " + String(FilterpumpAutomaticOnTime);
-      Display.drawString(4, 12, DisplayText.c_str());
-
-      DisplayText = "Salzwasser Zeit: " + String(SaltSystemAutomaticOnTime);
-      Display.drawString(4, 22, DisplayText.c_str());
-
-      DisplayText = "Autostart Zeit: " + String(AutomaticStartTime);
-      Display.drawString(4, 32, DisplayText.c_str());
-
-      DisplayText = "Autostart aktiv: " + String(AutomaticStartActive);
-      Display.drawString(4, 42, DisplayText.c_str());
+  uint8_t Packets = 0;
 
-      Display.display();
-    }
-    else if (ActualDisplayPage == 4) // Set Filtertime
+  if (Fields & TelemetryValues)
+  {
+    // MessagePack always carries typed values, the string form is JSON only
+    if (TelemetryMode == TelemetryModeDelta || MeshEncoding == MeshEncodingMsgPack)
     {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText = "Set Filter Zeit: " + String(FilterpumpAutomaticOnTime);
-      Display.drawString(4, 12, DisplayText.c_str());
-
-      Display.display();
+      Packets += UpdateMqttDelta(Fields);
     }
-    else if (ActualDisplayPage == 5) // Set Saltwater time
+    else
     {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText = "Set Salzwasser Zeit: " + String(SaltSystemAutomaticOnTime);
-      Display.drawString(4, 12, DisplayText.c_str());
-
-      Display.display();
+      UpdateMqtt();
+      Packets++;
     }
-    else if (ActualDisplayPage == 6) // Set automatic begin active
-    {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText = "Set Autostart aktiv: " + String(AutomaticStartActive);
-      Display.drawString(4, 12, DisplayText.c_str());
-
-      DisplayText = "Stunde jetzt: " + String(Hour);
-      Display.drawString(4, 22, DisplayText.c_str());
-
-      DisplayText = "Minute jetzt: " + String(Minute);
-      Display.drawString(4, 32, DisplayText.c_str());
+  }
 
-      Display.display();
-    }
-    else if (ActualDisplayPage == 7) // Set automatic start time
+  // Only the final state of each output within the window is published,
+  // several changed outputs as one "MQTT outputs <mask> <values>"
+  uint8_t Changed = ((Fields & TelemetryOutputs) >> 16) & (Outputs.State() ^ PublishedOutputState);
+  if (Changed & (Changed - 1))
+  {
+    char Msg[40];
+    snprintf(Msg, sizeof(Msg), "MQTT outputs %u %u", Changed, Outputs.State() & Changed);
+    SendMeshMessage(Msg);
+    PublishedOutputState ^= Changed;
+    Packets++;
+  }
+  else if (Changed)
+  {
+    uint8_t Output = 1;
+    while (!(Changed & (1 << (Output - 1))))
     {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText = "Set Auto start Zeit: " + String(AutomaticStartTime);
-      Display.drawString(4, 12, DisplayText.c_str());
-
-      Display.display();
+      Output++;
     }
-    else if (ActualDisplayPage == 8) // valve position
-    {
-      Display.clear();
-
-      String ShowRssi = "RSSI: " + String(WiFi.RSSI()) + " " + String(Hour) + ":" + String(Minute);
-      Display.drawString(4, 0, ShowRssi.c_str());
-
-      String DisplayText;
-
-      if (ValvePositionHeat)
-      {
-        DisplayText = "Valve: solar";
-      }
-      else
-      {
-        DisplayText = "Valve: pool";
-      }
-      Display.drawString(4, 12, DisplayText.c_str());
+    char Msg[24];
+    snprintf(Msg, sizeof(Msg), "MQTT output/%u %u", Output, Outputs.Get(Output) ? 1 : 0);
+    SendMeshMessage(Msg);
+    PublishedOutputState ^= Changed;
+    Packets++;
+  }
+  return Packets;
+}
+void SendBacklogBatch(const uint8_t *Batch, size_t Length, uint16_t Records, uint16_t Remaining)
+{
+  // "MQTT backlog <records> <remaining> <millis now> " and the zlib stream,
+  // record times are millis as well
+  char MsgBuffer[48 + TELEMETRY_BACKLOG_PACKED];
+  TextBuffer Msg(MsgBuffer, sizeof(MsgBuffer));
+  Msg.Printf("MQTT backlog %u %u %lu ", Records, Remaining, millis());
+  Msg.Append((const char *)Batch, Length);
+  SendMeshMessage(Msg);
+  if (!Remaining)
+  {
+    // Delta mode continues from what the gateway has now
+    TelemetryChanges.Invalidate();
+    RequestTelemetryKeyframe();
+  }
+}
+// Display lines, each bound to the value it shows
+template <uint8_t Index>
+void DisplayLineValue(char *Text, size_t Size)
+{
+  static_assert(PoolValues[Index].Label != nullptr, "value has no display label");
+  ValueFormatLine(PoolValues[Index], "", Text, Size);
+}
+// The value the buttons on this page change
+template <uint8_t Index>
+void DisplayLineSetValue(char *Text, size_t Size)
+{
+  static_assert(PoolValues[Index].Label != nullptr, "value has no display label");
+  ValueFormatLine(PoolValues[Index], "Set ", Text, Size);
+}
+void DisplayLineStatus(char *Text, size_t Size)
+{
+  snprintf(Text, Size, "RSSI: %d %u:%02u", WiFi.RSSI(), Clock.Hour(), Clock.Minute());
+}
+void DisplayLineValve(char *Text, size_t Size)
+{
+  snprintf(Text, Size, "%s: %s", PoolValues[ValueValveToHeat].Label, ValvePositionHeat ? "solar" : "pool");
+}
+void DisplayLineIp(char *Text, size_t Size)
+{
+  IPAddress Ip = WiFi.localIP();
+  snprintf(Text, Size, "IP: %u.%u.%u.%u", Ip[0], Ip[1], Ip[2], Ip[3]);
+}
+void DisplayLineHour(char *Text, size_t Size)
+{
+  snprintf(Text, Size, "Stunde jetzt: %u", Clock.Hour());
+}
+void DisplayLineMinute(char *Text, size_t Size)
+{
+  snprintf(Text, Size, "Minute jetzt: %u", Clock.Minute());
+}
 
-      Display.display();
-    }
+const DisplayLine TemperaturePage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineValue<ValueWaterTemp>},
+    {4, 22, DisplayLineValue<ValueVLTemp>},
+    {4, 32, DisplayLineValue<ValueRLTemp>},
+    {4, 42, DisplayLineValue<ValueGarageRoofTemp>},
+};
+const DisplayLine ModePage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineValue<ValueFilterPumpModeAutomatic>},
+    {4, 22, DisplayLineValue<ValueSaltSystemModeAutomatic>},
+    {4, 32, DisplayLineValue<ValueWaterMaxTemperature>},
+    {4, 42, DisplayLineValve},
+    {4, 52, DisplayLineIp},
+};
+const DisplayLine TimesPage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineValue<ValueFilterpumpAutomaticOnTime>},
+    {4, 22, DisplayLineValue<ValueSaltSystemAutomaticOnTime>},
+    {4, 32, DisplayLineValue<ValueAutomaticStartTime>},
+    {4, 42, DisplayLineValue<ValueAutomaticStartActive>},
+};
+const DisplayLine SetFilterTimePage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineSetValue<ValueFilterpumpAutomaticOnTime>},
+};
+const DisplayLine SetSaltSystemTimePage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineSetValue<ValueSaltSystemAutomaticOnTime>},
+};
+const DisplayLine SetAutostartActivePage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineSetValue<ValueAutomaticStartActive>},
+    {4, 22, DisplayLineHour},
+    {4, 32, DisplayLineMinute},
+};
+const DisplayLine SetAutostartTimePage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineSetValue<ValueAutomaticStartTime>},
+};
+const DisplayLine ValvePage[] = {
+    {4, 0, DisplayLineStatus},
+    {4, 12, DisplayLineValve},
+};
+
+#define DISPLAY_PAGE(Lines) {Lines, sizeof(Lines) / sizeof(Lines[0])}
+// Indexed by ActualDisplayPage - 1
+const DisplayPage DisplayPages[] = {
+    DISPLAY_PAGE(TemperaturePage),
+    DISPLAY_PAGE(ModePage),
+    DISPLAY_PAGE(TimesPage),
+    DISPLAY_PAGE(SetFilterTimePage),        // Set Filtertime
+    DISPLAY_PAGE(SetSaltSystemTimePage),    // Set Saltwater time
+    DISPLAY_PAGE(SetAutostartActivePage),   // Set automatic begin active
+    DISPLAY_PAGE(SetAutostartTimePage),     // Set automatic start time
+    DISPLAY_PAGE(ValvePage),                // valve position
+};
+
+bool WriteRelayCard(uint8_t Port)
+{
+  TRACE_RELAY_RECORD(Port);
+  return I2cBus.Submit(RelayCardAddress, &Port, 1);
+}
+bool NextDisplayChunk(I2cTransaction &Next)
+{
+  return DisplayLines.NextChunk(Next);
+}
+void UpdateDisplay()
+{
+  STATS_SCOPE(StatsDisplay);
+  if (DisplayIsOn && ActualDisplayPage >= 1 && ActualDisplayPage <= sizeof(DisplayPages) / sizeof(DisplayPages[0]))
+  {
+    DisplayLines.Render(DisplayPages[ActualDisplayPage - 1]);
   }
 }
 void SetOutput(uint8_t Output, bool Value)
 {
-  Serial.println("SetOutput: " + String(Output) + " " + String(Value));
+  STATS_SCOPE(StatsOutput);
+  Serial.printf("SetOutput: %u %u\n", Output, Value);
+  if (Output < 1 || Output > 8)
+  {
+    // Outside the relay card and the telemetry output bits
+    return;
+  }
 
-  RelaisCard.WriteBit(!Value, Output - 1);
   // String PublishString = "gimpire/EspPool/output/" + String(Output);
 
-  String Msg = "MQTT output/" + String(Output) + " " + String(Value).c_str();
-  GBusMesh.SendMessage(Msg);
+  // Written to the card at the end of this loop pass, together with any
+  // other output changed in the meantime
+  Outputs.Set(Output, Value);
+  Telemetry.MarkDirty(TelemetryOutput(Output));
 
   // client.publish(PublishString.c_str(), String(Value).c_str());
 }
 void SetFilterPumpModeAutomatic(int Mode)
 {
-  Serial.println("Set FilterPumpModeAutomatic to: " + String(Mode));
+  SetFilterPumpModeAutomatic(Mode, FilterpumpAutomaticOnTime * 60);
+}
+void SetFilterPumpModeAutomatic(int Mode, uint16_t RunMinutes)
+{
+  Serial.printf("Set FilterPumpModeAutomatic to: %d\n", Mode);
   SetOutput(FilterPumpOutput, Mode);
   FilterpumpAutomaticOn = Mode;
 
   if (Mode)
   {
-    tasker.setTimeout(SetFilterPumpModeAutomatic, (unsigned long)FilterpumpAutomaticOnTime * 3600 * 1000, 0);
-    // tasker.setTimeout(SetFilterPumpModeAutomatic, (unsigned long)FilterpumpAutomaticOnTime * 1000, 0);
+    FilterPumpStopAt = millis() + (unsigned long)RunMinutes * 60 * 1000;
+    Timers.Arm(FilterPumpTimer, (unsigned long)RunMinutes * 60 * 1000, FilterPumpRunTimeElapsed);
+    // Timers.Arm(FilterPumpTimer, (unsigned long)FilterpumpAutomaticOnTime * 1000, FilterPumpRunTimeElapsed);
   }
   else
   {
-    tasker.cancel(SetFilterPumpModeAutomatic, 0);
+    Timers.Cancel(FilterPumpTimer);
     if (SaltSystemAutomaticOn == 1)
     {
       SetSaltSystemModeAutomatic(0);
     }
   }
 
-  UpdateMqtt();
+  Telemetry.MarkDirty(TelemetryFilterPumpModeAutomatic);
+  SaveRunState();
   //String Msg = "MQTT FilterPumpModeAutomatic " + String(FilterpumpAutomaticOn);
   //mesh.SendMessage(Msg);
 
   // client.publish("gimpire/EspPool/FilterPumpModeAutomatic", String(FilterpumpAutomaticOn).c_str());
 }
-void SetAutomaticStartActive(bool Mode)
+void SetAutomaticStartActive(int Mode)
 {
   //Serial.println("Set AutomaticStartActive to: " + String(Mode));
   AutomaticStartActive = Mode;
+  ScheduleSlots[0].Active = Mode;
+  Schedule.Changed(0, Clock);
+  Settings.MarkDirty();
+  RunSchedule();
 
-  UpdateMqtt();
+  Telemetry.MarkDirty(TelemetryAutomaticStartActive);
 
   //String Msg = "MQTT AutomaticStartActive " + String(AutomaticStartActive);
   //mesh.SendMessage(Msg);
@@ -731,55 +1568,51 @@ void SetAutomaticStartActive(bool Mode)
 }
 void SetAutomaticStartTime(int time)
 {
-  Serial.println("Set AutomaticStartTime to: " + String(time));
+  Serial.printf("Set AutomaticStartTime to: %d\n", time);
   AutomaticStartTime = time;
+  ScheduleSlots[0].Hour = time;
+  Schedule.Changed(0, Clock);
+  Settings.MarkDirty();
+  RunSchedule();
 
-  UpdateMqtt();
+  Telemetry.MarkDirty(TelemetryAutomaticStartTime);
   //String Msg = "MQTT AutomaticStartTimeback " + String(AutomaticStartTime);
   //mesh.SendMessage(Msg);
 }
 void SetSaltSystemModeAutomatic(int ModeOn)
 {
-  Serial.println("Set SaltSystemModeAutomatic: " + String(ModeOn));
+  SetSaltSystemModeAutomatic(ModeOn, SaltSystemAutomaticOnTime * 60);
+}
+void SetSaltSystemModeAutomatic(int ModeOn, uint16_t RunMinutes)
+{
+  Serial.printf("Set SaltSystemModeAutomatic: %d\n", ModeOn);
 
-  tasker.cancel(SetSaltSystemModeAutomatic, 0);
-  tasker.cancel(SaltSystemPowerOff);
+  Timers.Cancel(SaltSystemTimer);
+  Timers.Cancel(SaltSystemPowerOffTimer);
 
   SaltSystemAutomaticOn = ModeOn;
+  Telemetry.MarkDirty(TelemetrySaltSystemModeAutomatic);
 
   if (ModeOn)
   {
-    UpdateMqtt();
     //String Msg = "MQTT SaltSystemModeAutomatic " + String(SaltSystemAutomaticOn);
     //mesh.SendMessage(Msg);
 
     // client.publish("gimpire/EspPool/SaltSystemModeAutomatic", String(SaltSystemAutomaticOn).c_str());
 
-    SetOutput(SaltSystemPower, 1);
-    delay(3000);
+    SaltSystemSequencer.Start(SaltSystemOnSteps, sizeof(SaltSystemOnSteps) / sizeof(RelayStep));
 
-    // SetOutput(SaltSystemEnableControl, 1);
-    // delay(300);
-    SetOutput(SaltSystemActivate, 1);
-    delay(300);
-    SetOutput(SaltSystemActivate, 0);
-    // delay(300);
-    // SetOutput(SaltSystemEnableControl, 0);
-
-    tasker.setTimeout(SetSaltSystemModeAutomatic, (unsigned long)SaltSystemAutomaticOnTime * 3600 * 1000, 0);
-    // tasker.setTimeout(SetSaltSystemModeAutomatic, (unsigned long)SaltSystemAutomaticOnTime * 1000, 0);
+    SaltSystemStopAt = millis() + (unsigned long)RunMinutes * 60 * 1000;
+    Timers.Arm(SaltSystemTimer, (unsigned long)RunMinutes * 60 * 1000, SaltSystemRunTimeElapsed);
+    // Timers.Arm(SaltSystemTimer, (unsigned long)SaltSystemAutomaticOnTime * 1000, SaltSystemRunTimeElapsed);
   }
   else
   {
-    // SetOutput(SaltSystemEnableControl, 1);
-    //  delay(200);
-    SetOutput(SaltSystemActivate, 1);
-    delay(200);
-    SetOutput(SaltSystemActivate, 0);
-    // SetOutput(SaltSystemEnableControl, 0);
+    SaltSystemSequencer.Start(SaltSystemOffSteps, sizeof(SaltSystemOffSteps) / sizeof(RelayStep));
 
-    tasker.setTimeout(SaltSystemPowerOff, SaltSystempowerOffDelay);
+    Timers.Arm(SaltSystemPowerOffTimer, SaltSystempowerOffDelay, SaltSystemPowerOff);
   }
+  SaveRunState();
 }
 void SaltSystemPowerOff()
 {
@@ -794,55 +1627,107 @@ void SaltSystemPowerOff()
   SaltSystemResetViaPowerCycleCounter++;
 
   SaltSystemAutomaticOn = false;
-  UpdateMqtt();
+  Telemetry.MarkDirty(TelemetrySaltSystemModeAutomatic);
   // client.publish("gimpire/EspPool/SaltSystemModeAutomatic", String(SaltSystemAutomaticOn).c_str());
   //String Msg = "MQTT SaltSystemModeAutomatic " + String(SaltSystemAutomaticOn);
   //mesh.SendMessage(Msg);
 }
-void SetSaltSystemAutomaticOnTime(uint8_t Time)
+void SetSaltSystemAutomaticOnTime(int Time)
 {
   SaltSystemAutomaticOnTime = Time;
-  UpdateMqtt();
-  String Msg = "MQTT SetSetSaltSystemAutomaticOnTime " + String(SaltSystemAutomaticOnTime);
-  GBusMesh.SendMessage(Msg);
+  ScheduleSlots[0].SaltHours = Time;
+  Settings.MarkDirty();
+  Telemetry.MarkDirty(TelemetrySaltSystemAutomaticOnTime);
+  // Legacy echo under the name gateways already subscribe to, the value
+  // itself goes out with the telemetry as "SaltSystemAutomaticOnTime"
+  char Msg[48];
+  snprintf(Msg, sizeof(Msg), "MQTT SetSetSaltSystemAutomaticOnTime %d", SaltSystemAutomaticOnTime);
+  SendMeshMessage(Msg);
 }
-void SetFilterpumpAutomaticOnTime(uint8_t Time)
+void SetFilterpumpAutomaticOnTime(int Time)
 {
   FilterpumpAutomaticOnTime = Time;
-  UpdateMqtt();
+  ScheduleSlots[0].PumpHours = Time;
+  Settings.MarkDirty();
+  Telemetry.MarkDirty(TelemetryFilterpumpAutomaticOnTime);
   // client.publish("gimpire/EspPool/FilterpumpAutomaticOnTime", String(FilterpumpAutomaticOnTime).c_str());
   //String Msg = "MQTT FilterpumpAutomaticOnTime " + String(FilterpumpAutomaticOnTime);
   //mesh.SendMessage(Msg);
 
   //Serial.println("FilterpumpAutomaticOnTime: " + String(FilterpumpAutomaticOnTime));
 }
+void RunSolarValve()
+{
+  if (!ValveAutomaticMode)
+  {
+    return;
+  }
+  bool Solar = SolarValve.Update(SolarController::FromCelsius(WaterThermometerValue),
+                                 SolarController::FromCelsius(GarageRoofThermometerValue),
+                                 SolarController::FromCelsius(VorlaufThermometerValue),
+                                 SolarController::FromCelsius(RucklaufThermometerValue),
+                                 WaterMaxTemperature * SOLAR_TEMP_SCALE, Outputs.Get(FilterPumpOutput), ValvePositionHeat);
+  if (Solar != ValvePositionHeat)
+  {
+    SetValvePosition(Solar);
+  }
+}
 void SetValvePosition(int ValveToHeat)
 {
-  tasker.cancel(ValvePowerOff);
-  SetOutput(ValvePowerOutput, 0);
-  delay(100);
   ValvePositionHeat = ValveToHeat;
+  SolarValve.Moved(ValveToHeat);
 
   if (ValveToHeat)
   {
-    SetOutput(ValveOutput, 1);
+    ValveSequencer.Start(ValveToHeatSteps, sizeof(ValveToHeatSteps) / sizeof(RelayStep));
   }
   else
   {
-    SetOutput(ValveOutput, 0);
+    ValveSequencer.Start(ValveToPoolSteps, sizeof(ValveToPoolSteps) / sizeof(RelayStep));
   }
 
-  delay(100);
-  SetOutput(ValvePowerOutput, 1);
-  tasker.setTimeout(ValvePowerOff, ValvePowerOffDelay);
-  UpdateMqtt();
+  Timers.Arm(ValvePowerOffTimer, ValvePowerOffDelay, ValvePowerOff);
+  Telemetry.MarkDirty(TelemetryValveToHeat);
+  RunState.MarkDirty();
   //String Msg = "MQTT ValveToHeat " + String(ValvePositionHeat);
   //mesh.SendMessage(Msg);
   // client.publish("gimpire/EspPool/ValveToHeat", String(ValvePositionHeat).c_str());
 }
+void DisplayTimeout(void *Context)
+{
+  HandleDisplaypower(0);
+}
+void FilterPumpRunTimeElapsed(void *Context)
+{
+  SetFilterPumpModeAutomatic(0);
+}
+void SaltSystemRunTimeElapsed(void *Context)
+{
+  SetSaltSystemModeAutomatic(0);
+}
 void ValvePowerOff()
 {
-  SetOutput(ValvePowerOutput, 0);
-  delay(200);
-  SetOutput(ValveOutput, 0);
+  ValveSequencer.Start(ValvePowerOffSteps, sizeof(ValvePowerOffSteps) / sizeof(RelayStep));
+}
+void RebootNow()
+{
+  static uint8_t CommitRetries = 0;
+  Telemetry.Flush();
+  // A setting changed right before "Reboot" is still waiting for its commit delay
+  if (Settings.Pending())
+  {
+    Settings.Commit();
+  }
+  // So is a run started or stopped within RunStateCommitDelay; the minutes
+  // left are brought up to date as well
+  SaveRunState();
+  RunState.Commit();
+  // A write NVS refused would be lost with the restart
+  if ((Settings.Pending() || RunState.Pending()) && CommitRetries < RebootCommitRetries)
+  {
+    CommitRetries++;
+    Timers.Schedule(RebootRetryDelay, RebootNow);
+    return;
+  }
+  ESP.restart();
 }